@@ -0,0 +1,138 @@
+#ifndef BINARYFRAME_H
+#define BINARYFRAME_H
+
+#include <Arduino.h>
+#include "EepromJournal.h" // crc8()
+
+// Protocolo binario de configuración, opcional junto al ASCII.
+//
+// Cada mensaje va en una trama estilo SysEx: F0 7D <cuerpo empaquetado> F7
+// (0x7D = fabricante "no comercial"). El cuerpo es [op][len][payload len][crc8]
+// y viaja en grupos de 7 bytes precedidos por un byte con sus bits altos, así
+// ningún byte del medio llega a 0x80. Ventajas frente a las líneas de texto:
+//   - El puerto distingue solo: F0 abre trama, cualquier otro byte < 0x80 es
+//     ASCII. No hay modo pegajoso que se quede colgado si la App se reinicia.
+//   - Los registros van tal cual (un ButtonConfig = 12 bytes), sin strtok ni
+//     atoi, y se decodifican byte a byte según llegan (sin buffer de línea).
+//   - Cada trama lleva longitud y CRC: una trama rota se descarta entera.
+// Los MIDI realtime (F8..FF) pueden colarse en medio y se ignoran.
+//
+// Se negocia con HELLO:BIN -> READY:...:BIN. La respuesta a una trama binaria
+// es siempre binaria; las líneas ASCII siguen funcionando igual.
+
+const byte BF_START = 0xF0;
+const byte BF_END = 0xF7;
+const byte BF_MANUFACTURER = 0x7D;
+const byte BF_MAX_PAYLOAD = 18;
+const byte BF_BODY_MAX = BF_MAX_PAYLOAD + 3;               // op + len + payload + crc
+const byte BF_FRAME_MAX = 3 + BF_BODY_MAX + (BF_BODY_MAX + 6) / 7; // F0 7D ... F7
+
+// Peticiones (App -> pedal)
+const byte BF_OP_GETALL = 0x01;   // [desde:2][cuántas]
+const byte BF_OP_SAVE = 0x02;     // [b][p][ButtonConfig:12]
+const byte BF_OP_SAVEGLO = 0x03;  // [id][ButtonConfig:12]
+const byte BF_OP_SAVEBANK = 0x04; // [b][nombre:1..8]
+
+// Respuestas (pedal -> App)
+const byte BF_OP_ACK = 0x40;        // [op][estado]
+const byte BF_OP_BANK_COUNT = 0x41; // [seq:2][bancos]
+const byte BF_OP_BANK = 0x42;       // [seq:2][b][bpm][nombre]
+const byte BF_OP_GLOBAL = 0x43;     // [seq:2][id][ButtonConfig:12]
+const byte BF_OP_DATA = 0x44;       // [seq:2][b][p][ButtonConfig:12][escena:2]
+const byte BF_OP_MORE = 0x45;       // [siguiente:2][total:2]
+const byte BF_OP_END = 0x46;        // [total:2]
+const byte BF_OP_MACRO = 0x47;      // [seq:2][m][s][MacroStep:4]
+
+const byte BF_STATUS_OK = 0;
+const byte BF_STATUS_FAIL = 1;      // Parámetros fuera de rango
+const byte BF_STATUS_BAD_FRAME = 2; // CRC, longitud u op desconocido
+
+// Arma una trama completa en 'out' (al menos BF_FRAME_MAX bytes).
+// Devuelve su longitud.
+inline byte encodeFrame(byte op, const byte* payload, byte len, byte* out) {
+    byte body[BF_BODY_MAX];
+    if (len > BF_MAX_PAYLOAD) len = BF_MAX_PAYLOAD;
+    body[0] = op;
+    body[1] = len;
+    memcpy(body + 2, payload, len);
+    body[len + 2] = crc8(body, len + 2);
+    byte size = len + 3;
+
+    byte n = 0;
+    out[n++] = BF_START;
+    out[n++] = BF_MANUFACTURER;
+    for (byte i = 0; i < size; i += 7) {
+        byte msbs = n++;
+        out[msbs] = 0;
+        for (byte j = 0; j < 7 && i + j < size; j++) {
+            byte b = body[i + j];
+            if (b & 0x80) out[msbs] |= 1 << j;
+            out[n++] = b & 0x7F;
+        }
+    }
+    out[n++] = BF_END;
+    return n;
+}
+
+// Decodificador incremental: se le pasan los bytes según llegan
+class FrameDecoder {
+  private:
+    enum State { IDLE, MANUFACTURER, BODY };
+    byte _state;
+    byte _body[BF_BODY_MAX];
+    byte _len;
+    byte _msbs;
+    byte _group; // 0 = toca byte de bits altos, 1..7 = dato dentro del grupo
+
+  public:
+    enum Result { NONE, FRAME, ERROR };
+
+    FrameDecoder() : _state(IDLE), _len(0), _msbs(0), _group(0) {}
+
+    // Dentro de una trama: los bytes son para el decodificador, no para el ASCII
+    bool active() const { return _state != IDLE; }
+
+    byte feed(byte c) {
+        if (c == BF_START) {
+            _state = MANUFACTURER;
+            _len = 0;
+            _group = 0;
+            return NONE;
+        }
+        if (c >= 0xF8 || _state == IDLE) return NONE; // Realtime MIDI
+
+        if (c == BF_END) {
+            _state = IDLE;
+            if (_len < 3 || _body[1] != _len - 3) return ERROR;
+            return crc8(_body, _len - 1) == _body[_len - 1] ? FRAME : ERROR;
+        }
+        if (c & 0x80) {
+            _state = IDLE; // Otro status MIDI corta la trama
+            return ERROR;
+        }
+
+        if (_state == MANUFACTURER) {
+            // SysEx de otro fabricante: no es para nosotros
+            _state = c == BF_MANUFACTURER ? BODY : IDLE;
+            return NONE;
+        }
+        if (_group == 0) {
+            _msbs = c;
+            _group = 1;
+            return NONE;
+        }
+        if (_len >= BF_BODY_MAX) {
+            _state = IDLE;
+            return ERROR;
+        }
+        _body[_len++] = c | (((_msbs >> (_group - 1)) & 1) << 7);
+        _group = _group == 7 ? 0 : _group + 1;
+        return NONE;
+    }
+
+    byte op() const { return _len > 0 ? _body[0] : 0; }
+    byte length() const { return _body[1]; }
+    const byte* payload() const { return _body + 2; }
+};
+
+#endif
@@ -0,0 +1,280 @@
+#ifndef BLUETOOTHSETUP_H
+#define BLUETOOTHSETUP_H
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include "BtSerial.h"
+
+// Aprovisionamiento asíncrono del HC-06 (nombre, PIN y velocidad) desde loop().
+//
+// Antes se enviaban AT+NAME / AT+PIN a ciegas con delay() en cada arranque
+// (~2.5 s). Ahora:
+//  - Si la EEPROM recuerda que este módulo ya quedó con BT_NAME/BT_PIN, no se
+//    envía nada: solo se pone BtSerial a la velocidad guardada. El HC-06 no puede informar su nombre sin renombrarse
+//    ("AT+NAME?" lo llamaría "?"), por eso la prueba es la marca guardada.
+//  - Si no, se prueba "AT" y se configura esperando cada respuesta ("OK",
+//    "OKsetname", "OKsetPIN") con timeout. Cada comando va entero al ring TX
+//    de BtSerial, que lo saca por interrupciones sin frenar loop().
+//  - Si el módulo no responde (ya emparejado o ausente) se abandona sin marca
+//    y se reintenta en el próximo arranque.
+//
+// Velocidad: tras el PIN se sube el enlace con AT+BAUDn, de la más rápida a
+// la más lenta. El módulo confirma a la velocidad vieja y cambia; BtSerial
+// cambia también y se verifica con dos "AT". Si no vuelve "OK" (cable largo,
+// ruido), se le devuelve a la velocidad anterior a ciegas y se prueba la
+// siguiente. La marca guarda la que quedó, y el probe busca el módulo en
+// todas por si la marca se perdió con el módulo ya cambiado.
+
+const char BT_NAME[] PROGMEM = "MidiController";
+const char BT_PIN[] PROGMEM = "0290";
+
+const unsigned long BT_POWERUP_MS = 500;   // Arranque del módulo tras alimentar
+const unsigned long BT_REPLY_MS = 1500;    // El HC-06 responde tras ~1 s de silencio
+const int BT_MARKER_SIZE = 5;              // Últimos bytes de la EEPROM (CFG_EEPROM_RESERVED)
+const uint16_t BT_MARKER_MAGIC = 0x4255;   // "BU": marca con velocidad
+const byte BT_VERIFY_PROBES = 2;           // "AT" -> "OK" seguidos para dar por buena una velocidad
+
+// Velocidades candidatas; el código de AT+BAUD es '4' + índice. 115200 no:
+// con RX y TX a la vez el ISR de BtSerial no llega a tiempo a 16 MHz.
+const uint32_t BT_BAUDS[] PROGMEM = { 9600, 19200, 38400, 57600 };
+const byte BT_BAUD_COUNT = sizeof(BT_BAUDS) / sizeof(BT_BAUDS[0]);
+
+class BluetoothSetup {
+  private:
+    enum State { BT_POWERUP, BT_SENDING, BT_WAITING, BT_DONE };
+    enum Step { STEP_PROBE, STEP_NAME, STEP_PIN, STEP_BAUD, STEP_VERIFY, STEP_RESTORE };
+
+    State _state;
+    byte _step;
+    byte _rate;     // Índice de la velocidad que funciona
+    byte _try;      // Índice que se está probando
+    byte _verifies; // "OK" que faltan en STEP_VERIFY
+    unsigned long _deadline;
+    char _tx[24];
+    byte _txPos;
+    char _rx[12];
+    byte _rxLen;
+    bool _provisioned;
+
+    static int markerAddress() {
+        return EEPROM.length() - BT_MARKER_SIZE;
+    }
+
+    // Firma de nombre + PIN: si cambian las constantes, se reaprovisiona
+    static uint16_t identityHash() {
+        uint16_t h = 5381;
+        char c;
+        for (PGM_P p = BT_NAME; (c = pgm_read_byte(p)); p++) h = (h << 5) + h + c;
+        for (PGM_P p = BT_PIN; (c = pgm_read_byte(p)); p++) h = (h << 5) + h + c;
+        return h;
+    }
+
+    static long baudAt(byte index) {
+        return pgm_read_dword(&BT_BAUDS[index]);
+    }
+
+    // Índice de la velocidad guardada, o BT_BAUD_COUNT si no hay marca válida
+    byte markerRate() {
+        uint16_t magic, hash;
+        EEPROM.get(markerAddress(), magic);
+        EEPROM.get(markerAddress() + 2, hash);
+        byte rate = EEPROM.read(markerAddress() + 4);
+        if (magic != BT_MARKER_MAGIC || hash != identityHash()) return BT_BAUD_COUNT;
+        return rate < BT_BAUD_COUNT ? rate : BT_BAUD_COUNT;
+    }
+
+    void writeMarker() {
+        uint16_t magic = BT_MARKER_MAGIC;
+        uint16_t hash = identityHash();
+        EEPROM.put(markerAddress(), magic);
+        EEPROM.put(markerAddress() + 2, hash);
+        EEPROM.update(markerAddress() + 4, _rate);
+    }
+
+    void finish(BtSerial& port) {
+        port.begin(baudAt(_rate));
+        writeMarker();
+        _provisioned = true;
+        _state = BT_DONE;
+    }
+
+    // Siguiente velocidad por debajo de _try; si no queda ninguna mejor que
+    // la que ya funciona, se queda esa
+    void tryLower(BtSerial& port) {
+        if (_try > _rate + 1) {
+            _try--;
+            startStep(STEP_BAUD);
+        } else {
+            finish(port);
+        }
+    }
+
+    void startStep(byte step) {
+        _step = step;
+        // Comando armado desde flash (el %s de snprintf_P no lee PROGMEM)
+        if (step == STEP_PROBE) {
+            strcpy_P(_tx, PSTR("AT"));
+        } else if (step == STEP_NAME) {
+            strcpy_P(_tx, PSTR("AT+NAME"));
+            strcat_P(_tx, BT_NAME);
+        } else if (step == STEP_PIN) {
+            strcpy_P(_tx, PSTR("AT+PIN"));
+            strcat_P(_tx, BT_PIN);
+        } else if (step == STEP_VERIFY) {
+            strcpy_P(_tx, PSTR("AT"));
+        } else {
+            // STEP_BAUD sube a _try; STEP_RESTORE vuelve a _rate
+            strcpy_P(_tx, PSTR("AT+BAUD0"));
+            _tx[7] = '4' + (step == STEP_BAUD ? _try : _rate);
+        }
+        _txPos = 0;
+        _rxLen = 0;
+        _rx[0] = 0;
+        _state = BT_SENDING;
+    }
+
+    PGM_P expectedReply() {
+        if (_step == STEP_NAME) return PSTR("OKsetname");
+        if (_step == STEP_PIN) return PSTR("OKsetPIN");
+        return PSTR("OK");
+    }
+
+    void replied(BtSerial& port) {
+        switch (_step) {
+            case STEP_PROBE:
+            case STEP_NAME:
+                startStep(_step + 1);
+                break;
+            case STEP_PIN:
+                // Nombre y PIN listos: a por la velocidad, de arriba abajo
+                _try = BT_BAUD_COUNT;
+                tryLower(port);
+                break;
+            case STEP_BAUD:
+                // "OK<baud>" a la velocidad vieja; el módulo ya cambió
+                port.begin(baudAt(_try));
+                _verifies = BT_VERIFY_PROBES;
+                startStep(STEP_VERIFY);
+                break;
+            case STEP_VERIFY:
+                if (--_verifies > 0) {
+                    startStep(STEP_VERIFY);
+                } else if (port.baud() == baudAt(_rate)) {
+                    // Vuelta atrás confirmada: probar la siguiente más lenta
+                    tryLower(port);
+                } else {
+                    _rate = _try;
+                    finish(port);
+                }
+                break;
+        }
+    }
+
+    void timedOut(BtSerial& port) {
+        if (_step == STEP_PROBE && _rate + 1 < BT_BAUD_COUNT) {
+            // Puede que el módulo ya esté a otra velocidad (marca perdida)
+            _rate++;
+            port.begin(baudAt(_rate));
+            startStep(STEP_PROBE);
+        } else if (_step == STEP_BAUD) {
+            // Sin confirmación no sabemos si cambió: se verifica como si lo
+            // hubiera hecho y, si no responde, se deshace
+            replied(port);
+        } else if (_step == STEP_VERIFY && port.baud() != baudAt(_rate)) {
+            // La velocidad nueva no es fiable: deshacer con la orden a ciegas
+            startStep(STEP_RESTORE);
+        } else {
+            // Sin respuesta: emparejado o ausente. Sin módulo encontrado, el
+            // puerto vuelve a la velocidad de fábrica
+            if (_step == STEP_PROBE) {
+                _rate = 0;
+                port.begin(baudAt(_rate));
+            }
+            _state = BT_DONE;
+        }
+    }
+
+  public:
+    BluetoothSetup() : _state(BT_DONE), _step(STEP_PROBE), _rate(0), _try(0), _verifies(0), _deadline(0),
+                       _txPos(0), _rxLen(0), _provisioned(false) {
+        _tx[0] = 0;
+        _rx[0] = 0;
+    }
+
+    void begin() {
+        _state = BT_POWERUP;
+        _deadline = millis() + BT_POWERUP_MS;
+    }
+
+    bool isDone() {
+        return _state == BT_DONE;
+    }
+
+    // True si el módulo tiene (o ya tenía) el nombre y PIN esperados
+    bool isProvisioned() {
+        return _provisioned;
+    }
+
+    // Velocidad del enlace con el módulo (válida con isDone())
+    long baud() {
+        return baudAt(_rate);
+    }
+
+    void update(BtSerial& port) {
+        switch (_state) {
+            case BT_POWERUP: {
+                if ((long)(millis() - _deadline) < 0) return;
+                byte rate = markerRate();
+                if (rate < BT_BAUD_COUNT) {
+                    _rate = rate;
+                    port.begin(baudAt(_rate));
+                    _provisioned = true;
+                    _state = BT_DONE;
+                } else {
+                    _rate = 0;
+                    port.begin(baudAt(_rate));
+                    startStep(STEP_PROBE);
+                }
+                break;
+            }
+
+            case BT_SENDING:
+                // Lo que quepa en el ring TX de BtSerial: write() no espera
+                while (_tx[_txPos] && port.availableForWrite() > 0) {
+                    port.write((uint8_t)_tx[_txPos++]);
+                }
+                if (_tx[_txPos] == 0) {
+                    _state = BT_WAITING;
+                    _deadline = millis() + BT_REPLY_MS;
+                }
+                break;
+
+            case BT_WAITING:
+                while (port.available() > 0) {
+                    char c = (char)port.read();
+                    if (_rxLen < (byte)(sizeof(_rx) - 1)) {
+                        _rx[_rxLen++] = c;
+                        _rx[_rxLen] = 0;
+                    }
+                }
+                if (_step == STEP_RESTORE) {
+                    // La respuesta llega a una velocidad que no leemos bien:
+                    // solo se espera a que el módulo haya cambiado
+                    if ((long)(millis() - _deadline) < 0) return;
+                    port.begin(baudAt(_rate));
+                    _verifies = BT_VERIFY_PROBES;
+                    startStep(STEP_VERIFY);
+                } else if (strstr_P(_rx, expectedReply())) {
+                    replied(port);
+                } else if ((long)(millis() - _deadline) >= 0) {
+                    timedOut(port);
+                }
+                break;
+
+            case BT_DONE:
+                break;
+        }
+    }
+};
+
+#endif
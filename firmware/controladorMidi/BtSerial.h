@@ -0,0 +1,312 @@
+#ifndef BTSERIAL_H
+#define BTSERIAL_H
+
+#include <Arduino.h>
+
+// Transporte del HC-06: UART por software movido por Timer1, sin SoftwareSerial.
+//
+// SoftwareSerial recibe y transmite cada byte entero con las interrupciones
+// desactivadas (~1 ms a 9600): mientras tanto el UART del MIDI y el ISR de los
+// footswitches esperan, y lo que llega por BT durante un envío se pierde.
+// Aquí cada bit es una interrupción corta:
+//   - RX: el flanco del start bit (PCINT1, pines A0..A5) programa OCR1A al
+//     centro del bit 0; cada comparación muestrea un bit y reprograma la
+//     siguiente. Con el stop bit, el byte va al ring y vuelve el PCINT.
+//   - TX: OCR1B saca un bit por comparación desde un ring propio. write() no
+//     espera salvo que el ring esté lleno (como HardwareSerial), así que
+//     availableForWrite() dice de verdad cuánto cabe.
+// RX y TX usan canales distintos del timer: full duplex.
+//
+// Timer1 corre libre sin prescaler (16 MHz); el resto del firmware no lo usa
+// (los LEDs van con digitalWrite, sin PWM). La velocidad la negocia
+// BluetoothSetup con el módulo (AT+BAUD) y se fija con begin().
+
+const byte BT_RX_RING = 128; // Potencia de 2: ~33 ms de ráfaga a 38400
+const byte BT_TX_RING = 32;  // Potencia de 2: un comando AT o una línea corta entera
+
+class BtSerial : public Stream {
+  private:
+    volatile byte _rx[BT_RX_RING];
+    volatile byte _rxHead; // Solo lo escribe el ISR
+    volatile byte _rxTail; // Solo lo escribe loop()
+    volatile byte _tx[BT_TX_RING];
+    volatile byte _txHead; // Solo lo escribe loop()
+    volatile byte _txTail; // Solo lo escribe el ISR
+    volatile bool _txBusy;
+    volatile unsigned int _dropped;       // Ring RX lleno
+    volatile unsigned int _framingErrors; // Stop bit a 0 (velocidad equivocada o ruido)
+    long _baud;
+    uint8_t _rxPin;
+    uint8_t _txPin;
+
+#if defined(__AVR__)
+    static BtSerial* _active; // Instancia que atienden los ISR
+    byte _rxMask;
+    byte _txMask;
+    uint16_t _bitTicks;
+    volatile byte _rxBit;
+    volatile byte _rxByte;
+    volatile byte _txBits;
+    volatile uint16_t _txShift;
+#else
+    uint32_t _byteUs;
+    uint64_t _txDoneUs; // Fin del byte que está saliendo
+    std::string _out;
+#endif
+
+    void pushRx(byte c) {
+        byte next = (_rxHead + 1) & (BT_RX_RING - 1);
+        if (next == _rxTail) {
+            _dropped++;
+#if !defined(__AVR__)
+            sim::counters().btRxDropped++;
+#endif
+            return;
+        }
+        _rx[_rxHead] = c;
+        _rxHead = next;
+    }
+
+    bool txFull() const {
+        return ((_txHead + 1) & (BT_TX_RING - 1)) == _txTail;
+    }
+
+#if defined(__AVR__)
+    // Siguiente byte del ring a _txShift: start (0), 8 datos LSB primero, stop (1)
+    bool loadTx() {
+        if (_txTail == _txHead) return false;
+        _txShift = ((uint16_t)_tx[_txTail] << 1) | 0x200;
+        _txTail = (_txTail + 1) & (BT_TX_RING - 1);
+        _txBits = 10;
+        return true;
+    }
+
+    // Con interrupciones desactivadas
+    void startTx() {
+        if (_txBusy || !loadTx()) return;
+        _txBusy = true;
+        OCR1B = TCNT1 + 32;
+        TIFR1 = (1 << OCF1B);
+        TIMSK1 |= (1 << OCIE1B);
+    }
+#else
+    // Host: el byte tarda _byteUs en el cable y al acabar sale el siguiente
+    void startTx() {
+        if (_txBusy || _txTail == _txHead) return;
+        _txBusy = true;
+        _txDoneUs = sim::nowUs() + _byteUs;
+        sim::at(_txDoneUs, [this]() { txDone(); });
+    }
+
+    void txDone() {
+        byte c = _tx[_txTail];
+        _txTail = (_txTail + 1) & (BT_TX_RING - 1);
+        _txBusy = false;
+        sim::counters().btTxBytes++;
+        _out += (char)c;
+        if (peer) peer(c, _baud);
+        startTx();
+    }
+
+    // Espera a que salga el byte en curso (sim::reset() pudo borrar su evento)
+    void waitTx() {
+        uint64_t due = _txDoneUs;
+        if (sim::nowUs() < due) sim::advance(due - sim::nowUs());
+        if (_txBusy && _txDoneUs == due) txDone();
+    }
+#endif
+
+  public:
+    BtSerial(uint8_t rxPin, uint8_t txPin)
+        : _rxHead(0), _rxTail(0), _txHead(0), _txTail(0), _txBusy(false),
+          _dropped(0), _framingErrors(0), _baud(9600), _rxPin(rxPin), _txPin(txPin) {
+#if !defined(__AVR__)
+        _byteUs = 1042;
+        _txDoneUs = 0;
+#endif
+    }
+
+    // También sirve para cambiar de velocidad en marcha: lo que quedara en
+    // el ring TX sale antes del cambio.
+    void begin(long baud) {
+        while (_txBusy) {
+#if !defined(__AVR__)
+            waitTx();
+#endif
+        }
+        _baud = baud;
+#if defined(__AVR__)
+        _bitTicks = F_CPU / baud;
+        _rxMask = 1 << (_rxPin - A0);
+        _txMask = 1 << (_txPin - A0);
+        pinMode(_rxPin, INPUT_PULLUP);
+        pinMode(_txPin, OUTPUT);
+        digitalWrite(_txPin, HIGH); // Línea en reposo
+        noInterrupts();
+        _active = this;
+        _rxBit = 0;
+        TCCR1A = 0;
+        TCCR1B = (1 << CS10); // Normal, sin prescaler
+        TIMSK1 &= ~(1 << OCIE1A);
+        PCMSK1 |= _rxMask;
+        PCIFR = (1 << PCIF1);
+        PCICR |= (1 << PCIE1);
+        interrupts();
+#else
+        _byteUs = (uint32_t)(10000000UL / baud);
+#endif
+    }
+
+    long baud() const { return _baud; }
+
+    int available() override {
+        return (_rxHead - _rxTail) & (BT_RX_RING - 1);
+    }
+
+    int read() override {
+        if (_rxHead == _rxTail) return -1;
+        byte c = _rx[_rxTail];
+        _rxTail = (_rxTail + 1) & (BT_RX_RING - 1);
+        return c;
+    }
+
+    int peek() override {
+        return _rxHead == _rxTail ? -1 : _rx[_rxTail];
+    }
+
+    size_t write(uint8_t c) override {
+        // Ring lleno: esperar a que el ISR saque un byte
+        while (txFull()) {
+#if !defined(__AVR__)
+            waitTx();
+#endif
+        }
+        _tx[_txHead] = c;
+        _txHead = (_txHead + 1) & (BT_TX_RING - 1);
+        noInterrupts();
+        startTx();
+        interrupts();
+        return 1;
+    }
+    using Print::write;
+
+    int availableForWrite() override {
+        return BT_TX_RING - 1 - ((_txHead - _txTail) & (BT_TX_RING - 1));
+    }
+
+    void flush() override {
+        while (_txBusy) {
+#if !defined(__AVR__)
+            waitTx();
+#endif
+        }
+    }
+
+    unsigned int dropped() const { return _dropped; }
+    unsigned int framingErrors() const { return _framingErrors; }
+
+#if defined(__AVR__)
+    // --- ISR ---
+
+    // Flanco en el pin RX: si es de bajada, es un start bit
+    static void onPinChange() {
+        BtSerial* s = _active;
+        if (!s || (PINC & s->_rxMask)) return;
+        OCR1A = TCNT1 + s->_bitTicks + s->_bitTicks / 2; // Centro del bit 0
+        s->_rxBit = 0;
+        s->_rxByte = 0;
+        PCMSK1 &= ~s->_rxMask; // Hasta el stop bit manda el timer
+        TIFR1 = (1 << OCF1A);
+        TIMSK1 |= (1 << OCIE1A);
+    }
+
+    static void onRxSample() {
+        BtSerial* s = _active;
+        bool level = PINC & s->_rxMask;
+        if (s->_rxBit < 8) {
+            s->_rxByte >>= 1;
+            if (level) s->_rxByte |= 0x80;
+            s->_rxBit++;
+            OCR1A += s->_bitTicks;
+            return;
+        }
+        if (level) s->pushRx(s->_rxByte);
+        else s->_framingErrors++;
+        TIMSK1 &= ~(1 << OCIE1A);
+        PCIFR = (1 << PCIF1);
+        PCMSK1 |= s->_rxMask;
+    }
+
+    static void onTxBit() {
+        BtSerial* s = _active;
+        if (s->_txBits == 0 && !s->loadTx()) {
+            TIMSK1 &= ~(1 << OCIE1B);
+            s->_txBusy = false;
+            return;
+        }
+        if (s->_txShift & 1) PORTC |= s->_txMask;
+        else PORTC &= ~s->_txMask;
+        s->_txShift >>= 1;
+        s->_txBits--;
+        OCR1B += s->_bitTicks;
+    }
+#else
+    // --- Lado host ---
+    // Dispositivo al otro lado (emulador del HC-06): recibe cada byte enviado
+    // y la velocidad a la que salió.
+    std::function<void(uint8_t, long)> peer;
+
+    // Llega un byte por el cable a 'baud'. A otra velocidad que la nuestra el
+    // stop bit no cuadra: error de trama y el byte se pierde.
+    void receiveByte(uint8_t c, long baud) {
+        if (baud != _baud) {
+            _framingErrors++;
+            sim::counters().btRxDropped++;
+            return;
+        }
+        pushRx(c);
+    }
+
+    // Programa la llegada de 'len' bytes a 'baud' (0 = la nuestra) desde startUs
+    void feed(const uint8_t* data, size_t len, uint64_t startUs, long baud = 0) {
+        if (baud == 0) baud = _baud;
+        uint64_t byteUs = 10000000ULL / baud;
+        uint64_t t = startUs;
+        for (size_t i = 0; i < len; i++) {
+            t += byteUs;
+            uint8_t c = data[i];
+            sim::at(t, [this, c, baud]() { receiveByte(c, baud); });
+        }
+    }
+
+    void feed(const char* data, uint64_t startUs, long baud = 0) {
+        feed((const uint8_t*)data, strlen(data), startUs, baud);
+    }
+
+    std::string takeOutput() {
+        std::string s;
+        s.swap(_out);
+        return s;
+    }
+
+    uint32_t byteTimeUs() const { return _byteUs; }
+#endif
+};
+
+#if defined(__AVR__)
+BtSerial* BtSerial::_active = nullptr;
+
+ISR(PCINT1_vect) {
+    BtSerial::onPinChange();
+}
+
+ISR(TIMER1_COMPA_vect) {
+    BtSerial::onRxSample();
+}
+
+ISR(TIMER1_COMPB_vect) {
+    BtSerial::onTxBit();
+}
+#endif
+
+#endif
@@ -2,6 +2,7 @@
 #define BUTTON_H
 
 #include <Arduino.h>
+#include "ButtonEventQueue.h"
 
 class Button {
   private:
@@ -16,57 +17,121 @@ class Button {
     bool _ignoreNextRelease;
     const unsigned long LONG_PRESS_TIME = 1000;
 
+    // --- Cola de eventos y bloqueo por botón ---
+    ButtonEventQueue* _queue;
+    byte _id;
+    unsigned long _lockout;       // ms mínimos entre dos pulsaciones aceptadas
+    unsigned long _lastAccepted;
+    bool _suppressed;             // Pulsación actual descartada por lockout
+    static unsigned int _lockouts; // Pisadas descartadas (todos los botones)
+
+    void emit(byte type, unsigned long time) {
+        if (_queue) _queue->push(_id, type, time);
+    }
+
+    void checkLongPress(unsigned long now) {
+      if (!_isLongPressed && (now - _pressedTime > LONG_PRESS_TIME)) {
+        _isLongPressed = true;
+        _ignoreNextRelease = true; // Para no disparar 'pressed' (click corto) al soltar
+        if (!_suppressed) {
+          longPressed = true;
+          emit(BTN_EV_LONG, _pressedTime + LONG_PRESS_TIME);
+        }
+      }
+    }
+
   public:
     bool pressed;      // True un ciclo cuando se presiona
+    bool pushed;       // True un ciclo en el flanco de bajada (pie sobre el switch)
     bool released;     // True un ciclo cuando se suelta
     bool longPressed;  // True un ciclo cuando se detecta pulsación larga
 
-    Button(int pin) : _pin(pin), _debounceDelay(50) {
+    Button(int pin, unsigned long lockout = 120) : _pin(pin), _debounceDelay(50), _lockout(lockout) {
       pinMode(_pin, INPUT_PULLUP);
       _state = HIGH;
       _lastReading = HIGH;
+      _lastDebounceTime = 0;
+      _pressedTime = 0;
+      _isLongPressed = false;
       _ignoreNextRelease = false;
+      _queue = nullptr;
+      _id = 0;
+      _lastAccepted = 0UL - lockout; // Sin pulsación previa: la primera nunca se bloquea
+      _suppressed = false;
+    }
+
+    // Conecta el botón a una cola: cada flanco debounced genera un ButtonEvent
+    void attach(ButtonEventQueue* queue, byte id) {
+      _queue = queue;
+      _id = id;
     }
 
+    // Rebotes lentos o dobles pisadas dentro de este margen se ignoran
+    void setLockout(unsigned long ms) {
+      _lockout = ms;
+    }
+
+    // Modo polling clásico: lee el pin y resuelve todo en esta vuelta
     void update() {
-      bool reading = digitalRead(_pin);
+      beginCycle();
+      feed(digitalRead(_pin), millis());
+    }
+
+    // --- Modo consumidor (FootswitchScanner) ---
+
+    // Limpia los flags de "un ciclo" antes de entregar flancos nuevos
+    void beginCycle() {
       pressed = false;
+      pushed = false;
       released = false;
       longPressed = false;
+    }
 
+    // Nivel crudo del pin en 'time'. Antes de aceptarlo se resuelve el
+    // debounce hasta ese instante: una ráfaga de flancos acumulada mientras
+    // loop() estaba ocupado se procesa con sus tiempos reales.
+    void feed(bool reading, unsigned long time) {
+      tick(time);
       if (reading != _lastReading) {
-        _lastDebounceTime = millis();
+        _lastReading = reading;
+        _lastDebounceTime = time;
       }
+    }
+
+    // Avanza debounce y Long Press hasta 'now' sin leer el pin
+    void tick(unsigned long now) {
+      if (_lastReading != _state && (now - _lastDebounceTime) > _debounceDelay) {
+        _state = _lastReading;
 
-      if ((millis() - _lastDebounceTime) > _debounceDelay) {
-        if (reading != _state) {
-          _state = reading;
-
-          if (_state == LOW) {
-            // Flanco descendente (Presionado)
-            _pressedTime = millis();
-            _isLongPressed = false;
-            _ignoreNextRelease = false;
-            // Opcional: Si queremos acción inmediata al pulsar (sin esperar a soltar)
-            // pressed = true; 
-          } else {
-            // Flanco ascendente (Soltado)
-            if (!_ignoreNextRelease) {
-               pressed = true; // Consideramos "Click" al soltar si no fue Long Press
-            }
-            released = true;
+        if (_state == LOW) {
+          // Flanco descendente (Presionado)
+          // El timestamp es el último cambio del pin, no el fin del debounce
+          _pressedTime = _lastDebounceTime;
+          _isLongPressed = false;
+          _ignoreNextRelease = false;
+          _suppressed = (_pressedTime - _lastAccepted < _lockout);
+          if (_suppressed) _lockouts++;
+
+          if (!_suppressed) {
+            _lastAccepted = _pressedTime;
+            // Acción inmediata: el sketch decide por slot si usa 'pushed' o 'pressed'
+            pushed = true;
+            emit(BTN_EV_PUSH, _pressedTime);
+          }
+        } else {
+          // Flanco ascendente (Soltado)
+          // Un Long Press vencido antes de soltar se resuelve primero
+          checkLongPress(_lastDebounceTime);
+          if (!_ignoreNextRelease && !_suppressed) {
+             pressed = true; // Consideramos "Click" al soltar si no fue Long Press
+             emit(BTN_EV_CLICK, _lastDebounceTime);
           }
+          released = true;
         }
       }
-      
-      // Chequeo Long Press continuo mientras está presionado
-      if (_state == LOW && !_isLongPressed && (millis() - _pressedTime > LONG_PRESS_TIME)) {
-        _isLongPressed = true;
-        longPressed = true;
-        _ignoreNextRelease = true; // Para no disparar 'pressed' (click corto) al soltar
-      }
 
-      _lastReading = reading;
+      // Chequeo Long Press continuo mientras está presionado
+      if (_state == LOW) checkLongPress(now);
     }
 
     // Nuevo método para verificar si el botón está mantenido pulsado (sin debounce complex)
@@ -78,6 +143,12 @@ class Button {
     bool isLongPressedState() {
         return _isLongPressed;
     }
+
+    static unsigned int lockouts() {
+        return _lockouts;
+    }
 };
 
+unsigned int Button::_lockouts = 0;
+
 #endif
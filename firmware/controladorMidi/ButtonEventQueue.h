@@ -0,0 +1,65 @@
+#ifndef BUTTONEVENTQUEUE_H
+#define BUTTONEVENTQUEUE_H
+
+#include <Arduino.h>
+
+// Tipos de evento generados por Button::update()
+const byte BTN_EV_PUSH  = 0; // Flanco de bajada (pie sobre el switch)
+const byte BTN_EV_CLICK = 1; // Soltado sin Long Press
+const byte BTN_EV_LONG  = 2; // Long Press alcanzado
+
+struct ButtonEvent {
+    byte id;            // Identificador del botón (lo asigna el sketch)
+    byte type;          // BTN_EV_*
+    unsigned long time; // millis() del flanco que originó el evento
+};
+
+// Cola circular de eventos de botones, ordenada por timestamp.
+// Se despacha en orden en loop(), así ninguna pulsación se pierde aunque
+// lleguen varias en la misma vuelta (los botones se leen en orden fijo,
+// por eso push() inserta en su sitio en vez de añadir al final).
+const int BTN_EVENT_QUEUE_SIZE = 16;
+
+class ButtonEventQueue {
+  private:
+    ButtonEvent _events[BTN_EVENT_QUEUE_SIZE];
+    byte _head;
+    byte _count;
+    unsigned int _dropped;
+
+  public:
+    ButtonEventQueue() : _head(0), _count(0), _dropped(0) {}
+
+    bool push(byte id, byte type, unsigned long time) {
+        if (_count >= BTN_EVENT_QUEUE_SIZE) {
+            _dropped++;
+            return false;
+        }
+        int pos = _count;
+        while (pos > 0) {
+            ButtonEvent& prev = _events[(_head + pos - 1) % BTN_EVENT_QUEUE_SIZE];
+            if ((long)(time - prev.time) >= 0) break;
+            _events[(_head + pos) % BTN_EVENT_QUEUE_SIZE] = prev;
+            pos--;
+        }
+        ButtonEvent& ev = _events[(_head + pos) % BTN_EVENT_QUEUE_SIZE];
+        ev.id = id;
+        ev.type = type;
+        ev.time = time;
+        _count++;
+        return true;
+    }
+
+    bool pop(ButtonEvent& ev) {
+        if (_count == 0) return false;
+        ev = _events[_head];
+        _head = (_head + 1) % BTN_EVENT_QUEUE_SIZE;
+        _count--;
+        return true;
+    }
+
+    int size() { return _count; }
+    unsigned int dropped() { return _dropped; }
+};
+
+#endif
@@ -3,229 +3,1040 @@
 
 #include <EEPROM.h>
 #include <Arduino.h>
+#include "EepromJournal.h"
 
 // Definición de Configuración por Botón
 struct ButtonConfig {
     char name[5];     // Nombre de 4 letras + null terminator
-    char type;        // 'P' (Preset), 'D' (Dictionary/Effect), 'C' (Custom raw CC)
-    byte value1;      // Si 'P': ProgramNum. Si 'D': DictIndex. Si 'C': CC Number.
+    char type;        // 'P' (Preset), 'D' (Dictionary/Effect), 'C' (Custom raw CC), 'M' (Macro)
+    byte value1;      // Si 'P': ProgramNum. Si 'D': DictIndex. Si 'C': CC Number. Si 'M': macro.
     byte value2;      // Si 'P': BankNum. Si 'C': Value (0=Toggle).
-    
+
     // --- NUEVO: Configuración Long Press ---
-    char lpType;      // 'N' (None), 'C' (CC), 'P' (Program), 'D' (Dict)
+    char lpType;      // 'N' (None), 'C' (CC), 'P' (Program), 'D' (Dict), 'M' (Macro), 'S' (guardar escena)
     byte lpValue1;
     byte lpValue2;
+
+    // --- Momento de disparo de la acción corta ---
+    char pressMode;   // 'R' (Al soltar), 'I' (Inmediato al pisar), 'S' (Especulativo: corto al pisar + largo encima)
+};
+
+// Macros: lista ordenada de mensajes que un botón de tipo 'M' dispara de una
+// pisada (p.ej. preset + tres efectos). Cada paso espera 'delay' ticks desde
+// el anterior; la primera que no es 'P'/'C'/'D' termina la macro. Las lee y
+// las reproduce MacroPlayer.h, sin bloquear loop().
+const byte MACRO_COUNT = 4;
+const byte MACRO_STEPS = 6;
+const byte MACRO_TICK_MS = 10; // Resolución del retardo: hasta 2.55 s entre pasos
+const byte MACRO_NONE = 0xFF;
+
+struct MacroStep {
+    char type;        // 'P' (PC, value2 = banco), 'C' (CC crudo), 'D' (efecto del diccionario), 'N' (fin)
+    byte value1;
+    byte value2;      // Si 'D': >= 64 enciende
+    byte delay;       // Ticks de MACRO_TICK_MS desde el paso anterior (o la pisada)
+};
+
+// Pedales de expresión (ver ExpressionPedals.h): CC y curva de cada entrada
+// analógica y su calibración, las lecturas del ADC con el pedal atrás
+// (talón) y adelante (punta).
+const byte EXP_INPUTS = 2;
+const char EXP_CURVES[] PROGMEM = "LGES"; // Lineal, loGarítmica, Exponencial, en S
+
+struct ExpConfig {
+    byte cc;          // 1..127; 0 = entrada apagada
+    char curve;       // Código de EXP_CURVES
+    uint16_t heel;    // 0..1023; mayor que 'toe' si el pedal va al revés
+    uint16_t toe;
 };
 
-// Estructura global de datos
-// Eliminamos Guitarras, Single Context.
-const int MAX_BANKS_CFG = 4; // REDUCED FROM 10 TO SAVE RAM (CRITICAL)
-const int NUM_PRESETS_CFG = 3; 
+// Bancos paginados.
+//
+// En RAM solo viven unos pocos bancos (CFG_PAGES): el actual, el anterior y el
+// siguiente (precargados para que Bank Up/Down no lean EEPROM) y el último
+// visitado (para Toggle). El resto se lee de EEPROM cuando alguien lo pide:
+// imagen base + las entradas del journal de ese banco, ~110 bytes leídos.
+// Así el número de bancos lo limita la EEPROM, no la RAM.
+//
+// Las ediciones no dependen de que su banco siga en RAM: al marcarlas se
+// empaquetan en una cola (CFG_PENDING) de la que update() escribe el journal.
+// Un banco que se pagina de nuevo ve también lo que aún espera en la cola.
+//
+// Los punteros que devuelven getButtonConfig() y getBankName() apuntan a una
+// página: los del banco en pantalla y sus vecinos siguen valiendo; los de
+// cualquier otro banco, hasta que se pida otro banco de fuera.
+
+const int CFG_EEPROM_SIZE = 1024; // ATmega328P
+const int CFG_EEPROM_RESERVED = 8; // Final de la EEPROM: marca del HC-06 (BluetoothSetup)
+const int NUM_PRESETS_CFG = 3;
+const int MAX_BANKS_CFG = 16;     // Lo que cabe en la EEPROM junto a macros, escenas y pedales (ver static_assert)
+const byte TEMPO_MIN_BPM = 30;   // Tempo de banco (y del reloj MIDI); 0 = sin tempo
+const byte TEMPO_MAX_BPM = 250;
+const byte CFG_PAGES = 4;         // Bancos en RAM
+const byte CFG_PENDING = 12;      // Registros editados esperando al journal
+const byte CFG_SPILL = 6;         // Con más en cola se escriben sin esperar a save()/COMMIT
 
 // Magic number actualizado para forzar reset de estructura
-// Magic number actualizado para forzar reset de estructura por nuevos campos LP
-const int EEPROM_MAGIC = 12350; // Bump version to force Reset (1 Bank Default)
+const uint16_t EEPROM_MAGIC = 12356; // Bump version to force Reset (pedales de expresión)
+
+// Registros persistentes (8 bytes cada uno, ver EepromJournal.h).
+// Meta: [bancos activos][slot en EEPROM de cada banco][macros válidas]. Los
+// bancos se guardan por slot, así borrar uno solo reescribe la tabla y no
+// desplaza los demás. Cada slot ocupa un bloque contiguo: nombre + sus
+// presets + sus escenas. Los pedales de expresión van en un registro propio.
+// Una macro sin su bit en la máscara se lee vacía: RESET no tiene que borrarlas.
+const byte CFG_META_MACROS = 1 + MAX_BANKS_CFG; // Byte de meta con la máscara
+const byte CFG_META_BYTES = CFG_META_MACROS + 1;
+const byte REC_META = 0;
+const byte REC_META_COUNT = (CFG_META_BYTES + JOURNAL_RECORD_SIZE - 1) / JOURNAL_RECORD_SIZE;
+const byte REC_GLOBAL_FIRST = REC_META_COUNT; // 2 globales
+const byte REC_MACRO_FIRST = REC_GLOBAL_FIRST + 2;
+const byte MACRO_STEPS_PER_RECORD = JOURNAL_RECORD_SIZE / sizeof(MacroStep);
+const byte REC_PER_MACRO = MACRO_STEPS / MACRO_STEPS_PER_RECORD;
+const byte REC_EXP = REC_MACRO_FIRST + MACRO_COUNT * REC_PER_MACRO;
+const byte REC_BANK_FIRST = REC_EXP + 1;
+const byte REC_PER_BANK = 1 + NUM_PRESETS_CFG + 1;
+const byte CFG_RECORDS = REC_BANK_FIRST + MAX_BANKS_CFG * REC_PER_BANK;
+const byte CFG_NO_SLOT = 0xFF;
+
+static_assert(MACRO_STEPS % MACRO_STEPS_PER_RECORD == 0, "Pasos de macro por registro");
+static_assert(MACRO_COUNT <= 8, "Una macro por bit de la máscara");
+static_assert(NUM_PRESETS_CFG * 2 <= JOURNAL_RECORD_SIZE, "Escenas del banco en un registro");
+static_assert(EXP_INPUTS * 4 <= JOURNAL_RECORD_SIZE, "Pedales de expresión en un registro");
+static_assert(CFG_RECORDS <= JOURNAL_MAX_RECORDS, "Demasiados registros para el journal");
+static_assert(JOURNAL_HEADER_SIZE + CFG_RECORDS * JOURNAL_RECORD_SIZE +
+              JOURNAL_SLOTS * JOURNAL_ENTRY_SIZE <= CFG_EEPROM_SIZE - CFG_EEPROM_RESERVED,
+              "MAX_BANKS_CFG no cabe en la EEPROM");
+
+// ButtonConfig (12 bytes en RAM) <-> registro de 8 bytes.
+// Nombre y valores van en los 7 bits bajos de cada byte (MIDI no pasa de 127)
+// y los bits altos llevan tipo, tipo de Long Press y modo (2 bits cada uno).
+// 'M' no cabía en 2 bits: su tercer bit va en los bytes 6 (tipo) y 7 (Long
+// Press), que antes iban a 0, así los registros viejos se leen igual. El
+// Long Press 'S' usa el sexto código de esos 3 bits.
+const char CFG_TYPES[] PROGMEM = "PDCNM";
+const char CFG_LP_TYPES[] PROGMEM = "NCPDMS";
+const char CFG_MODES[] PROGMEM = "RIS";
+const byte CFG_TYPE_CODES = 5;
+const byte CFG_LP_CODES = 6;
+
+inline byte cfgCode(PGM_P codes, char c, byte fallback) {
+    char code;
+    for (byte i = 0; (code = pgm_read_byte(codes + i)); i++) {
+        if (code == c) return i;
+    }
+    return fallback;
+}
+
+inline void packButton(const ButtonConfig& cfg, byte* out) {
+    for (byte i = 0; i < 4; i++) out[i] = cfg.name[i] & 0x7F;
+    out[4] = cfg.value1 & 0x7F;
+    out[5] = cfg.value2 & 0x7F;
+    out[6] = cfg.lpValue1 & 0x7F;
+    out[7] = cfg.lpValue2 & 0x7F;
+    byte type = cfgCode(CFG_TYPES, cfg.type, 3);
+    byte lpType = cfgCode(CFG_LP_TYPES, cfg.lpType, 0);
+    byte flags = (type & 3) | (lpType & 3) << 2 |
+                 cfgCode(CFG_MODES, cfg.pressMode, 0) << 4 |
+                 (type >> 2) << 6 | (lpType >> 2) << 7;
+    for (byte i = 0; i < 8; i++) {
+        if (flags & (1 << i)) out[i] |= 0x80;
+    }
+}
+
+inline void unpackButton(const byte* in, ButtonConfig& cfg) {
+    byte flags = 0;
+    for (byte i = 0; i < 8; i++) {
+        if (in[i] & 0x80) flags |= 1 << i;
+    }
+    byte type = (flags & 3) | ((flags >> 6) & 1) << 2;
+    byte lpType = ((flags >> 2) & 3) | (flags >> 7) << 2;
+    for (byte i = 0; i < 4; i++) cfg.name[i] = in[i] & 0x7F;
+    cfg.name[4] = '\0';
+    cfg.type = type < CFG_TYPE_CODES ? pgm_read_byte(CFG_TYPES + type) : 'N';
+    cfg.value1 = in[4] & 0x7F;
+    cfg.value2 = in[5] & 0x7F;
+    cfg.lpType = lpType < CFG_LP_CODES ? pgm_read_byte(CFG_LP_TYPES + lpType) : 'N';
+    cfg.lpValue1 = in[6] & 0x7F;
+    cfg.lpValue2 = in[7] & 0x7F;
+    byte mode = (flags >> 4) & 3;
+    cfg.pressMode = mode < 3 ? pgm_read_byte(CFG_MODES + mode) : 'R';
+}
+
+// Escenas: cada preset puede llevar el estado ON/OFF de los efectos del
+// diccionario (bit i = entrada i, ver DICT_SCENE_MASK en MidiDictionary.h).
+// Al pisarlo el sketch manda solo los CC que no tienen ya ese valor. Las de
+// los tres presets van juntas en un registro del banco, 2 bytes cada una: 14
+// bits de efectos y en los dos altos "tiene escena" (10). Los 0xFF de un slot
+// sin escribir se leen sin escena.
+const uint16_t SCENE_NONE = 0xFFFF;
+const uint16_t SCENE_VALID = 0x8000;
+const uint16_t SCENE_BITS = 0x3FFF;
+
+inline void packScenes(const uint16_t* scenes, byte* out) {
+    memset(out, 0, JOURNAL_RECORD_SIZE);
+    for (byte p = 0; p < NUM_PRESETS_CFG; p++) {
+        uint16_t v = scenes[p] == SCENE_NONE ? 0 : (scenes[p] & SCENE_BITS) | SCENE_VALID;
+        out[2 * p] = v & 0xFF;
+        out[2 * p + 1] = v >> 8;
+    }
+}
+
+inline void unpackScenes(const byte* in, uint16_t* scenes) {
+    for (byte p = 0; p < NUM_PRESETS_CFG; p++) {
+        uint16_t v = in[2 * p] | (uint16_t)in[2 * p + 1] << 8;
+        scenes[p] = (v & 0xC000) == SCENE_VALID ? v & SCENE_BITS : SCENE_NONE;
+    }
+}
+
+// ExpConfig <-> 4 bytes por entrada: CC, 8 bits bajos de talón y de punta y
+// un byte con sus 2 bits altos y la curva. Los 2 bits de arriba de ese byte
+// van a 0: los 0xFF de un slot sin escribir se leen como entrada por defecto.
+inline void defaultExp(ExpConfig& exp) {
+    exp.cc = 0;
+    exp.curve = 'L';
+    exp.heel = 0;
+    exp.toe = 1023;
+}
+
+inline void packExp(const ExpConfig* exp, byte* out) {
+    memset(out, 0, JOURNAL_RECORD_SIZE);
+    for (byte i = 0; i < EXP_INPUTS; i++, out += 4) {
+        out[0] = exp[i].cc & 0x7F;
+        out[1] = exp[i].heel & 0xFF;
+        out[2] = exp[i].toe & 0xFF;
+        out[3] = (exp[i].heel >> 8 & 3) | (exp[i].toe >> 8 & 3) << 2 |
+                 cfgCode(EXP_CURVES, exp[i].curve, 0) << 4;
+    }
+}
+
+inline void unpackExp(const byte* in, ExpConfig* exp) {
+    for (byte i = 0; i < EXP_INPUTS; i++, in += 4) {
+        if ((in[0] & 0x80) || (in[3] & 0xC0)) {
+            defaultExp(exp[i]);
+            continue;
+        }
+        exp[i].cc = in[0];
+        exp[i].heel = in[1] | (uint16_t)(in[3] & 3) << 8;
+        exp[i].toe = in[2] | (uint16_t)(in[3] >> 2 & 3) << 8;
+        exp[i].curve = pgm_read_byte(EXP_CURVES + (in[3] >> 4));
+    }
+}
+
+// Dos MacroStep por registro, tal cual (tipo como carácter; 0xFF de una EEPROM
+// virgen o cualquier otro tipo se lee como fin)
+inline void unpackMacroStep(const byte* in, MacroStep& step) {
+    char t = in[0];
+    step.type = (t == 'P' || t == 'C' || t == 'D') ? t : 'N';
+    step.value1 = in[1] & 0x7F;
+    step.value2 = in[2] & 0x7F;
+    step.delay = in[3];
+}
+
+// CRC-16/CCITT de los hashes de HASHES: con los 8 bits de crc8() un banco
+// cambiado pasaría por igual una vez de cada 256
+inline uint16_t crc16(const byte* data, byte len, uint16_t crc = 0xFFFF) {
+    while (len--) {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (byte i = 0; i < 8; i++) crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
 
 class ConfigManager {
   private:
-    int _eepromStartAddress;
-    int _activeBanks; // Variable en RAM
-  
+    struct BankPage {
+        byte slot;          // Slot en EEPROM (CFG_NO_SLOT = libre)
+        unsigned int used;  // Para elegir la página menos usada
+        char name[9];
+        byte tempo;         // BPM del banco (0 = sin tempo propio)
+        ButtonConfig presets[NUM_PRESETS_CFG];
+        uint16_t scenes[NUM_PRESETS_CFG]; // SCENE_NONE = sin escena
+    };
+
+    // Registro ya empaquetado esperando su turno en el journal
+    struct PendingRecord {
+        byte id;
+        bool commit;        // Cierra un lote (save() o COMMIT)
+        byte data[JOURNAL_RECORD_SIZE];
+    };
+
+    EepromJournal _journal;
+    byte _meta[REC_META_COUNT * JOURNAL_RECORD_SIZE]; // [bancos activos][slots][macros válidas]
+    BankPage _pages[CFG_PAGES];
+    byte _macroId;              // Macro en RAM (MACRO_NONE = ninguna): la que se edita o suena
+    MacroStep _macro[MACRO_STEPS];
+    unsigned int _useClock;
+    int _focus;                 // Banco en pantalla: se precargan sus vecinos
+
+    // Cola de escritura (FIFO). Lo que hay tras el último commit es el lote
+    // abierto: ediciones sin save() o la transacción en curso.
+    PendingRecord _pending[CFG_PENDING];
+    byte _pendHead;
+    byte _pendCount;
+    bool _batchOpen;            // Ya hay entradas del lote en el journal sin su commit
+    uint16_t _lastCommitSeq;    // Última entrada con commit en el journal
+    unsigned int _stalls;       // Veces que una edición esperó a la EEPROM
+    unsigned int _lost;         // Ediciones que no cupieron en la cola (sin hasRoom())
+    byte _want;                 // Registros que espera una edición retenida (hasRoom())
+    unsigned int _pageMisses;   // Bancos leídos de EEPROM al pedirlos (sin precarga)
+    uint16_t _generation;       // Cambia con cada edición (HASHES)
+
+    // Transacción (BEGINTX/COMMIT/ABORT): las ediciones esperan en la cola
+    // hasta el COMMIT. Si no caben, van al journal sin commit (spill) y el
+    // ABORT las descarta con rewind(). Solo si el journal se llena de ellas
+    // hay que hacerlas definitivas y el ABORT ya no puede deshacerlas.
+    bool _txActive;
+    bool _txSpilled;
+    bool _txFolded;
+    bool _revertPending; // ABORT: descartar lo escrito y recargar de EEPROM
+    bool _revertPartial;
+
+    static byte bankNameRecord(byte slot) { return REC_BANK_FIRST + slot * REC_PER_BANK; }
+    static byte buttonRecord(byte slot, int p) { return bankNameRecord(slot) + 1 + p; }
+    static byte sceneRecord(byte slot) { return bankNameRecord(slot) + 1 + NUM_PRESETS_CFG; }
+    static byte macroRecord(byte m, byte step) {
+        return REC_MACRO_FIRST + m * REC_PER_MACRO + step / MACRO_STEPS_PER_RECORD;
+    }
+
+    bool macroValid(byte m) {
+        return _meta[CFG_META_MACROS] & (1 << m);
+    }
+
+    byte slotOf(int bank) {
+        return _meta[1 + bank];
+    }
+
+    PendingRecord& pendingAt(byte i) {
+        return _pending[(_pendHead + i) % CFG_PENDING];
+    }
+
+    // Entradas de la cola hasta el último commit (las que ya pueden escribirse)
+    byte closedCount() {
+        for (byte n = _pendCount; n > 0; n--) {
+            if (pendingAt(n - 1).commit) return n;
+        }
+        return 0;
+    }
+
+    // --- Páginas ---
+
+    BankPage* findPage(byte slot) {
+        for (byte i = 0; i < CFG_PAGES; i++) {
+            if (_pages[i].slot == slot) return &_pages[i];
+        }
+        return nullptr;
+    }
+
+    // ¿Es 'slot' el banco en pantalla o uno de sus vecinos?
+    bool wanted(byte slot) {
+        int n = getActiveBanksCount();
+        if (_focus < 0 || _focus >= n) return false;
+        return slot == slotOf(_focus) || slot == slotOf((_focus + 1) % n) ||
+               slot == slotOf((_focus + n - 1) % n);
+    }
+
+    // Página libre o la menos usada. 'keepWanted': no tocar las de alrededor
+    // del banco en pantalla (precarga).
+    BankPage* victim(bool keepWanted) {
+        BankPage* best = nullptr;
+        for (byte i = 0; i < CFG_PAGES; i++) {
+            BankPage& pg = _pages[i];
+            if (pg.slot == CFG_NO_SLOT) return &pg;
+            if (keepWanted && wanted(pg.slot)) continue;
+            if (!best || (unsigned int)(_useClock - pg.used) > (unsigned int)(_useClock - best->used)) best = &pg;
+        }
+        return best;
+    }
+
+    // Página del slot; si no está en RAM se lee de EEPROM ('read' = false:
+    // se va a sobrescribir entera, no hace falta leerla)
+    BankPage* page(byte slot, bool read = true) {
+        BankPage* pg = findPage(slot);
+        if (!pg) {
+            pg = victim(true);
+            if (!pg) pg = victim(false);
+            pg->slot = slot;
+            if (read) {
+                _pageMisses++;
+                loadRange(bankNameRecord(slot), bankNameRecord(slot) + REC_PER_BANK);
+            }
+        }
+        pg->used = _useClock++;
+        return pg;
+    }
+
+    // Como page(), para la única macro en RAM. Sin su bit en la máscara no se
+    // lee nada: está vacía.
+    MacroStep* macroPage(byte m) {
+        if (_macroId != m) {
+            _macroId = m;
+            for (byte i = 0; i < MACRO_STEPS; i++) {
+                _macro[i].type = 'N';
+                _macro[i].value1 = _macro[i].value2 = _macro[i].delay = 0;
+            }
+            if (macroValid(m)) loadRange(macroRecord(m, 0), macroRecord(m, 0) + REC_PER_MACRO);
+        }
+        return _macro;
+    }
+
+    // Precarga de un vecino del banco en pantalla (true si leyó algo)
+    bool prefetch() {
+        int n = getActiveBanksCount();
+        if (_focus < 0 || _focus >= n) return false;
+        int around[3] = { _focus, (_focus + 1) % n, (_focus + n - 1) % n };
+        for (byte i = 0; i < 3; i++) {
+            byte slot = slotOf(around[i]);
+            if (findPage(slot)) continue;
+            BankPage* pg = victim(true);
+            if (!pg) return false;
+            pg->slot = slot;
+            pg->used = _useClock++;
+            loadRange(bankNameRecord(slot), bankNameRecord(slot) + REC_PER_BANK);
+            return true;
+        }
+        return false;
+    }
+
+    // --- Registros ---
+
+    // Nombre del banco: 8 caracteres de 7 bits. El bit alto de cada byte
+    // lleva el tempo (antes siempre a 0: los registros viejos no tienen tempo).
+    static void packBankName(const BankPage* pg, byte* out) {
+        for (byte i = 0; i < 8; i++) out[i] = (pg->name[i] & 0x7F) | ((pg->tempo >> i) & 1) << 7;
+    }
+
+    static void unpackBankName(const byte* in, BankPage* pg) {
+        pg->tempo = 0;
+        for (byte i = 0; i < 8; i++) {
+            pg->name[i] = in[i] & 0x7F;
+            if (in[i] & 0x80) pg->tempo |= 1 << i;
+        }
+        // EEPROM borrada (0xFF) o basura: sin tempo
+        if (pg->tempo < TEMPO_MIN_BPM || pg->tempo > TEMPO_MAX_BPM) pg->tempo = 0;
+        pg->name[8] = '\0';
+    }
+
+    // RAM -> registro de 8 bytes
+    void packRecord(byte id, byte* out) {
+        memset(out, 0, JOURNAL_RECORD_SIZE);
+        if (id < REC_GLOBAL_FIRST) {
+            memcpy(out, _meta + id * JOURNAL_RECORD_SIZE, JOURNAL_RECORD_SIZE);
+        } else if (id < REC_MACRO_FIRST) {
+            packButton(globalConfigs[id - REC_GLOBAL_FIRST], out);
+        } else if (id == REC_EXP) {
+            packExp(expConfigs, out);
+        } else if (id < REC_BANK_FIRST) {
+            byte m = (id - REC_MACRO_FIRST) / REC_PER_MACRO;
+            byte first = (id - REC_MACRO_FIRST) % REC_PER_MACRO * MACRO_STEPS_PER_RECORD;
+            memcpy(out, macroPage(m) + first, JOURNAL_RECORD_SIZE);
+        } else {
+            byte slot = (id - REC_BANK_FIRST) / REC_PER_BANK;
+            int p = (id - REC_BANK_FIRST) % REC_PER_BANK - 1;
+            BankPage* pg = page(slot);
+            if (p < 0) packBankName(pg, out);
+            else if (p < NUM_PRESETS_CFG) packButton(pg->presets[p], out);
+            else packScenes(pg->scenes, out);
+        }
+    }
+
+    // Registro de 8 bytes -> RAM (los de bancos, solo si su página está cargada)
+    void unpackRecord(byte id, const byte* in) {
+        if (id < REC_GLOBAL_FIRST) {
+            memcpy(_meta + id * JOURNAL_RECORD_SIZE, in, JOURNAL_RECORD_SIZE);
+        } else if (id < REC_MACRO_FIRST) {
+            unpackButton(in, globalConfigs[id - REC_GLOBAL_FIRST]);
+        } else if (id == REC_EXP) {
+            unpackExp(in, expConfigs);
+        } else if (id < REC_BANK_FIRST) {
+            if ((id - REC_MACRO_FIRST) / REC_PER_MACRO != _macroId) return;
+            byte first = (id - REC_MACRO_FIRST) % REC_PER_MACRO * MACRO_STEPS_PER_RECORD;
+            for (byte i = 0; i < MACRO_STEPS_PER_RECORD; i++) {
+                unpackMacroStep(in + i * sizeof(MacroStep), _macro[first + i]);
+            }
+        } else {
+            byte slot = (id - REC_BANK_FIRST) / REC_PER_BANK;
+            int p = (id - REC_BANK_FIRST) % REC_PER_BANK - 1;
+            BankPage* pg = findPage(slot);
+            if (!pg) return;
+            if (p < 0) {
+                unpackBankName(in, pg);
+            } else if (p < NUM_PRESETS_CFG) {
+                unpackButton(in, pg->presets[p]);
+            } else {
+                unpackScenes(in, pg->scenes);
+            }
+        }
+    }
+
+    // Registros [first, last): imagen base + journal + lo que espera en la cola
+    void loadRange(byte first, byte last) {
+        byte rec[JOURNAL_RECORD_SIZE];
+        for (byte id = first; id < last; id++) {
+            _journal.readRecord(id, rec);
+            unpackRecord(id, rec);
+        }
+
+        JournalEntry e;
+        uint16_t seq = _journal.firstSeq();
+        for (byte n = _journal.pending(); n > 0; n--) {
+            byte id = _journal.entryId(seq);
+            if (id >= first && id < last && _journal.readEntry(seq, e)) unpackRecord(e.id, e.data);
+            seq = (seq + 1) & JOURNAL_SEQ_MASK;
+        }
+        // La que se está escribiendo ya no está en la cola
+        if (_journal.writingEntry(e) && e.id >= first && e.id < last) unpackRecord(e.id, e.data);
+
+        for (byte i = 0; i < _pendCount; i++) {
+            PendingRecord& r = pendingAt(i);
+            if (r.id >= first && r.id < last) unpackRecord(r.id, r.data);
+        }
+    }
+
+    // Como loadRange(), pero a 'out' sin tocar las páginas
+    void readRecords(byte first, byte count, byte* out) {
+        for (byte i = 0; i < count; i++) _journal.readRecord(first + i, out + i * JOURNAL_RECORD_SIZE);
+
+        JournalEntry e;
+        uint16_t seq = _journal.firstSeq();
+        for (byte n = _journal.pending(); n > 0; n--) {
+            byte id = _journal.entryId(seq);
+            if (id >= first && id < first + count && _journal.readEntry(seq, e)) {
+                memcpy(out + (id - first) * JOURNAL_RECORD_SIZE, e.data, JOURNAL_RECORD_SIZE);
+            }
+            seq = (seq + 1) & JOURNAL_SEQ_MASK;
+        }
+        if (_journal.writingEntry(e) && e.id >= first && e.id < first + count) {
+            memcpy(out + (e.id - first) * JOURNAL_RECORD_SIZE, e.data, JOURNAL_RECORD_SIZE);
+        }
+
+        for (byte i = 0; i < _pendCount; i++) {
+            PendingRecord& r = pendingAt(i);
+            if (r.id >= first && r.id < first + count) {
+                memcpy(out + (r.id - first) * JOURNAL_RECORD_SIZE, r.data, JOURNAL_RECORD_SIZE);
+            }
+        }
+    }
+
+    // Meta y globales (siempre en RAM)
+    void loadFixed() {
+        loadRange(0, REC_BANK_FIRST);
+
+        // Validar rango por si aca
+        if (_meta[0] < 1) _meta[0] = 1;
+        if (_meta[0] > MAX_BANKS_CFG) _meta[0] = MAX_BANKS_CFG;
+        // La tabla de slots debe ser una permutación; si no, la de siempre
+        byte seen[(MAX_BANKS_CFG + 7) / 8];
+        memset(seen, 0, sizeof(seen));
+        bool valid = true;
+        for (int b = 0; b < MAX_BANKS_CFG && valid; b++) {
+            byte slot = _meta[1 + b];
+            valid = slot < MAX_BANKS_CFG && !(seen[slot >> 3] & (1 << (slot & 7)));
+            if (valid) seen[slot >> 3] |= 1 << (slot & 7);
+        }
+        if (!valid) {
+            for (int b = 0; b < MAX_BANKS_CFG; b++) _meta[1 + b] = b;
+        }
+        _meta[CFG_META_MACROS] &= (1 << MACRO_COUNT) - 1;
+    }
+
+    void dropPages() {
+        for (byte i = 0; i < CFG_PAGES; i++) _pages[i].slot = CFG_NO_SLOT;
+        _macroId = MACRO_NONE;
+    }
+
+    // Encola el registro tal como está ahora en RAM. Si ya estaba en el lote
+    // abierto se actualiza en su sitio.
+    void markDirty(byte id) {
+        _generation++;
+        byte closed = closedCount();
+        for (byte i = closed; i < _pendCount; i++) {
+            PendingRecord& r = pendingAt(i);
+            if (r.id == id) {
+                packRecord(id, r.data);
+                return;
+            }
+        }
+        if (_pendCount >= CFG_PENDING) {
+            // Quien edita tenía que mirar hasRoom(): queda solo en RAM
+            _lost++;
+            return;
+        }
+        PendingRecord& r = pendingAt(_pendCount);
+        r.id = id;
+        r.commit = false;
+        packRecord(id, r.data);
+        _pendCount++;
+    }
+
+    void markMeta(const byte* before) {
+        for (byte i = 0; i < REC_META_COUNT; i++) {
+            const byte* now = _meta + i * JOURNAL_RECORD_SIZE;
+            if (!before || memcmp(before + i * JOURNAL_RECORD_SIZE, now, JOURNAL_RECORD_SIZE) != 0) {
+                markDirty(REC_META + i);
+            }
+        }
+    }
+
+    void markBankDirty(byte slot) {
+        for (byte i = 0; i < REC_PER_BANK; i++) markDirty(bankNameRecord(slot) + i);
+    }
+
+    // Cierra el lote abierto: su última entrada lleva el commit
+    void closeBatch() {
+        if (_pendCount > closedCount()) pendingAt(_pendCount - 1).commit = true;
+    }
+
+    // Entradas del lote en curso hasta su commit (cuántas hará falta escribir)
+    byte batchLength() {
+        for (byte i = 0; i < _pendCount; i++) {
+            if (pendingAt(i).commit) return i + 1;
+        }
+        return _pendCount;
+    }
+
+    // Journal lleno: volcar hasta el último commit. Si todo lo que hay es un
+    // lote sin commit, volcarlo también (ya no se podrá descartar).
+    void foldJournal() {
+        uint16_t base = (_journal.firstSeq() - 1) & JOURNAL_SEQ_MASK;
+        uint16_t upTo = _lastCommitSeq;
+        if (((upTo - base) & JOURNAL_SEQ_MASK) > _journal.pending() || upTo == base) {
+            upTo = _journal.lastSeq();
+            if (_txSpilled) _txFolded = true;
+        }
+        _journal.startFold(upTo);
+    }
+
+    // ABORT: lo escrito de la transacción fuera del journal y RAM de nuevo
+    // como en EEPROM
+    void revert() {
+        if (_txSpilled) {
+            uint16_t base = (_journal.firstSeq() - 1) & JOURNAL_SEQ_MASK;
+            _journal.rewind(_txFolded ? base : _lastCommitSeq);
+        }
+        _revertPartial = _txFolded;
+        _txSpilled = false;
+        _txFolded = false;
+        _batchOpen = false;
+        dropPages();
+        loadFixed();
+        _generation++;
+        _revertPending = false;
+    }
+
+    // Primer arranque: imagen completa y journal vacío
+    void format() {
+        byte rec[JOURNAL_RECORD_SIZE];
+        _journal.erase();
+        // Los slots sin banco no hace falta escribirlos: addBank() los inicializa
+        for (byte id = 0; id < REC_BANK_FIRST + REC_PER_BANK; id++) {
+            packRecord(id, rec);
+            _journal.writeRecord(id, rec);
+        }
+        _journal.format(EEPROM_MAGIC);
+        _pendCount = 0;
+        _lastCommitSeq = _journal.lastSeq();
+    }
+
   public:
-    // Matriz de configuraciones en RAM [Bank][Preset]
-    // Reservamos memoria para el máximo posible
-    ButtonConfig configs[MAX_BANKS_CFG][NUM_PRESETS_CFG];
-    
     // Configuraciones Globales (0=Lateral/Guitar, 1=Central/Ctrl2)
     ButtonConfig globalConfigs[2];
-    
-    // Nombres de Bancos (Max 8 chars + null)
-    char bankNames[MAX_BANKS_CFG][9];
+    // Pedales de expresión (se editan aquí y se marcan con markExpDirty())
+    ExpConfig expConfigs[EXP_INPUTS];
 
-    ConfigManager() {
-        _eepromStartAddress = 0;
-        _activeBanks = 1;
+    ConfigManager() : _journal(0, CFG_RECORDS) { // Desde el byte 0 de la EEPROM
+        memset(_meta, 0, sizeof(_meta));
+        _meta[0] = 1;
+        for (int b = 0; b < MAX_BANKS_CFG; b++) _meta[1 + b] = b;
+        for (byte i = 0; i < EXP_INPUTS; i++) defaultExp(expConfigs[i]);
+        dropPages();
+        _useClock = 0;
+        _focus = -1;
+        _pendHead = 0;
+        _pendCount = 0;
+        _batchOpen = false;
+        _lastCommitSeq = 0;
+        _stalls = 0;
+        _lost = 0;
+        _want = 0;
+        _pageMisses = 0;
+        _generation = 0;
+        _txActive = false;
+        _txSpilled = false;
+        _txFolded = false;
+        _revertPending = false;
+        _revertPartial = false;
     }
 
     void begin() {
-        int magic;
-        EEPROM.get(_eepromStartAddress, magic);
-        if (magic != EEPROM_MAGIC) {
+        if (!_journal.open(EEPROM_MAGIC)) {
             resetToDefaults();
-            save();
+            format();
         } else {
             load();
         }
     }
 
+    // Imagen base + journal reproducido en orden (los bancos, al pedirlos)
     void load() {
-        int addr = _eepromStartAddress + sizeof(int); // Saltar magic number
-        
-        // Cargar Count
-        EEPROM.get(addr, _activeBanks);
-        addr += sizeof(int);
-        
-        // Validar rango por si aca
-        if (_activeBanks < 1) _activeBanks = 1;
-        if (_activeBanks > MAX_BANKS_CFG) _activeBanks = MAX_BANKS_CFG;
-
-        // Cargar Botones de Banco
-        for (int b = 0; b < MAX_BANKS_CFG; b++) {
-            for (int p = 0; p < NUM_PRESETS_CFG; p++) {
-                EEPROM.get(addr, configs[b][p]);
-                addr += sizeof(ButtonConfig);
+        _pendCount = 0;
+        _lastCommitSeq = _journal.lastSeq();
+        // Tras un reinicio no repite la de antes salvo que no se guardara nada
+        _generation = _lastCommitSeq;
+        dropPages();
+        loadFixed();
+    }
+
+    // Banco en pantalla: update() mantiene en RAM sus vecinos
+    void focusBank(int bank) {
+        _focus = bank;
+    }
+
+    // Pide persistir los registros marcados como un lote del journal (el
+    // último lleva el commit). No toca la EEPROM: lo escribe update() de fondo.
+    void save() {
+        if (!_txActive) closeBatch();
+    }
+
+    // Llamar en cada loop(): avanza la escritura de fondo sin bloquear.
+    // Las ediciones ya están en RAM; esto solo las hace durables.
+    void update() {
+        if (!_journal.idle()) {
+            _journal.poll();
+            return;
+        }
+        if (_revertPending) {
+            revert();
+            return;
+        }
+        // Precarga antes que escritura: leer no espera si la EEPROM está libre
+        if (eeprom_is_ready() && prefetch()) return;
+
+        // El lote abierto sale sin commit si pasa de CFG_SPILL o si no deja
+        // sitio a una edición que espera
+        byte closed = closedCount();
+        if (closed == 0 && _pendCount <= CFG_SPILL && _pendCount + _want <= CFG_PENDING) return;
+
+        if (!_batchOpen) {
+            // Si el lote cabe en un journal vacío pero no en lo que queda,
+            // vaciarlo antes: así el lote entero se confirma de una vez.
+            byte count = batchLength();
+            if (count <= JOURNAL_SLOTS && _journal.pending() + count > JOURNAL_SLOTS) {
+                foldJournal();
+                return;
             }
         }
-        
-        // Cargar Globales
-        for (int i = 0; i < 2; i++) {
-            EEPROM.get(addr, globalConfigs[i]);
-            addr += sizeof(ButtonConfig);
+        if (_journal.full()) {
+            foldJournal();
+            return;
         }
-        
-        // Cargar Nombres de Banco
-        for (int b = 0; b < MAX_BANKS_CFG; b++) {
-            EEPROM.get(addr, bankNames[b]);
-            addr += 9; // 8 chars + null
+        PendingRecord& r = pendingAt(0);
+        if (closed == 0 && _txActive) _txSpilled = true;
+        _journal.append(r.id, r.data, r.commit);
+        _batchOpen = !r.commit;
+        if (r.commit) _lastCommitSeq = _journal.lastSeq();
+        _pendHead = (_pendHead + 1) % CFG_PENDING;
+        _pendCount--;
+    }
+
+    // --- Transacciones ---
+
+    bool beginTransaction() {
+        if (_txActive || _revertPending) return false;
+        closeBatch(); // Lo editado antes va en su propio lote
+        _txActive = true;
+        _txSpilled = false;
+        _txFolded = false;
+        return true;
+    }
+
+    // Cierra lo editado como un único lote del journal
+    bool commitTransaction() {
+        if (!_txActive) return false;
+        _txActive = false;
+        // Todo salió ya sin commit: hace falta una entrada que lo confirme
+        if (_pendCount == closedCount() && _txSpilled) markDirty(REC_META);
+        closeBatch();
+        _txSpilled = false;
+        _txFolded = false;
+        return true;
+    }
+
+    // Descarta lo editado: se recarga de EEPROM cuando termine lo pendiente
+    bool abortTransaction() {
+        if (!_txActive) return false;
+        _txActive = false;
+        _pendCount = closedCount(); // Lo de la transacción que seguía en cola
+        _revertPending = true;
+        return true;
+    }
+
+    bool inTransaction() {
+        return _txActive;
+    }
+
+    bool isReverting() {
+        return _revertPending;
+    }
+
+    // El último ABORT no pudo deshacerlo todo (transacción más grande que el journal)
+    bool revertWasPartial() {
+        return _revertPartial;
+    }
+
+    // Todo lo guardado con save() está ya en la EEPROM
+    bool isDurable() {
+        return closedCount() == 0 && _journal.idle();
+    }
+
+    // Espera activa hasta que todo sea durable (arranque y tests)
+    void flush() {
+        while (!isDurable()) {
+            eeprom_busy_wait();
+            update();
         }
     }
 
-    void save() {
-        int addr = _eepromStartAddress;
-        // Magic + Count
-        EEPROM.put(addr, EEPROM_MAGIC);
-        addr += sizeof(int);
-        EEPROM.put(addr, _activeBanks);
-        addr += sizeof(int);
-        
-        // Guardar Botones
-        for (int b = 0; b < MAX_BANKS_CFG; b++) {
-            for (int p = 0; p < NUM_PRESETS_CFG; p++) {
-                EEPROM.put(addr, configs[b][p]);
-                addr += sizeof(ButtonConfig);
+    // ¿Caben 'records' registros más en la cola? Quien edita lo mira antes y,
+    // si no, reintenta en otra vuelta de loop(): update() vacía la cola, y con
+    // una transacción abierta adelanta al journal lo suyo (sin commit) hasta
+    // que quepa la edición más grande que haya preguntado.
+    bool hasRoom(byte records) {
+        bool fits = _pendCount + records <= CFG_PENDING;
+        if (!fits && records > _want) _want = records;
+        if (fits && records >= _want) _want = 0;
+        return fits;
+    }
+
+    // Espera activa hasta que quepan 'records' registros (arranque y tests)
+    void waitRoom(byte records) {
+        if (hasRoom(records)) return;
+        _stalls++;
+        while (!hasRoom(records)) {
+            eeprom_busy_wait();
+            update();
+        }
+    }
+
+    // Una edición que tuvo que esperar a que hubiera sitio en la cola
+    void countStall() {
+        _stalls++;
+    }
+
+    unsigned int lost() {
+        return _lost;
+    }
+
+    unsigned int stalls() {
+        return _stalls;
+    }
+
+    unsigned int pageMisses() {
+        return _pageMisses;
+    }
+
+    // --- Hashes (sincronización por diferencias con la App) ---
+    // Del contenido tal como sale en GETALL, esté o no el banco en RAM: lo
+    // leído de EEPROM pasa por unpack/pack igual que al paginarlo, así el
+    // hash no depende de qué bancos estén cargados. No pagina nada.
+
+    uint16_t generation() {
+        return _generation;
+    }
+
+    uint16_t bankHash(int bank) {
+        if (bank < 0 || bank >= getActiveBanksCount()) return 0;
+        byte slot = slotOf(bank);
+        byte rec[REC_PER_BANK * JOURNAL_RECORD_SIZE];
+        if (findPage(slot)) {
+            for (byte i = 0; i < REC_PER_BANK; i++) packRecord(bankNameRecord(slot) + i, rec + i * JOURNAL_RECORD_SIZE);
+        } else {
+            readRecords(bankNameRecord(slot), REC_PER_BANK, rec);
+            BankPage tmp;
+            unpackBankName(rec, &tmp);
+            packBankName(&tmp, rec);
+            for (byte p = 0; p < NUM_PRESETS_CFG; p++) {
+                byte* r = rec + (1 + p) * JOURNAL_RECORD_SIZE;
+                unpackButton(r, tmp.presets[p]);
+                packButton(tmp.presets[p], r);
             }
+            byte* r = rec + (1 + NUM_PRESETS_CFG) * JOURNAL_RECORD_SIZE;
+            unpackScenes(r, tmp.scenes);
+            packScenes(tmp.scenes, r);
         }
-        
-        // Guardar Globales
-        for (int i = 0; i < 2; i++) {
-            EEPROM.put(addr, globalConfigs[i]);
-            addr += sizeof(ButtonConfig);
+        return crc16(rec, sizeof(rec));
+    }
+
+    uint16_t globalHash(int index) {
+        byte rec[JOURNAL_RECORD_SIZE];
+        if (index < 0 || index >= 2) return 0;
+        packButton(globalConfigs[index], rec);
+        return crc16(rec, sizeof(rec));
+    }
+
+    uint16_t macroHash(int macro) {
+        if (macro < 0 || macro >= MACRO_COUNT) return 0;
+        MacroStep steps[MACRO_STEPS];
+        if (macro == _macroId) {
+            memcpy(steps, _macro, sizeof(steps));
+        } else if (!macroValid(macro)) {
+            memset(steps, 0, sizeof(steps));
+            for (byte i = 0; i < MACRO_STEPS; i++) steps[i].type = 'N';
+        } else {
+            byte rec[REC_PER_MACRO * JOURNAL_RECORD_SIZE];
+            readRecords(macroRecord(macro, 0), REC_PER_MACRO, rec);
+            for (byte i = 0; i < MACRO_STEPS; i++) unpackMacroStep(rec + i * sizeof(MacroStep), steps[i]);
         }
-        
-        // Guardar Nombres de Banco
-        for (int b = 0; b < MAX_BANKS_CFG; b++) {
-            EEPROM.put(addr, bankNames[b]);
-            addr += 9;
+        return crc16((const byte*)steps, sizeof(steps));
+    }
+
+    // ¿Está el banco en RAM? (sin cargarlo)
+    bool isPaged(int bank) {
+        return bank >= 0 && bank < MAX_BANKS_CFG && findPage(slotOf(bank));
+    }
+
+    // Para quien edita un ButtonConfig a través del puntero (SerialCommander)
+    void markButtonDirty(int bank, int preset) {
+        if (getButtonConfig(bank, preset)) markDirty(buttonRecord(slotOf(bank), preset));
+    }
+
+    void markGlobalDirty(int index) {
+        if (getGlobalConfig(index)) markDirty(REC_GLOBAL_FIRST + index);
+    }
+
+    void markExpDirty() {
+        markDirty(REC_EXP);
+    }
+
+    // Paso editado a través de getMacro(). La primera edición de una macro
+    // la marca válida y escribe también sus otros pasos (vacíos en RAM, no
+    // en la EEPROM): 1 + REC_PER_MACRO registros.
+    void markMacroDirty(int macro, int step) {
+        if (!getMacro(macro) || step < 0 || step >= MACRO_STEPS) return;
+        if (macroValid(macro)) {
+            markDirty(macroRecord(macro, step));
+            return;
         }
+        _meta[CFG_META_MACROS] |= 1 << macro;
+        markDirty(REC_META + CFG_META_MACROS / JOURNAL_RECORD_SIZE);
+        for (byte r = 0; r < REC_PER_MACRO; r++) markDirty(macroRecord(macro, r * MACRO_STEPS_PER_RECORD));
     }
 
     // Default: Reset to 1 bank
     void resetToDefaults() {
-        _activeBanks = 1; // Solo 1 banco por defecto
-        
-        for (int b = 0; b < MAX_BANKS_CFG; b++) {
-            initBank(b);
-        }
-        
+        _meta[0] = 1; // Solo 1 banco por defecto
+        for (int b = 0; b < MAX_BANKS_CFG; b++) _meta[1 + b] = b;
+        _meta[CFG_META_MACROS] = 0; // Macros vacías sin tocar sus registros
+        _macroId = MACRO_NONE;
+        markMeta(nullptr);
+
+        initBank(0);
+
         // Init Global Defaults
         // 0: Lateral (Antes Guitar) -> Default PC ?? or Empty
-        snprintf(globalConfigs[0].name, 5, "LAT");
-        globalConfigs[0].type = 'P'; 
-        globalConfigs[0].value1 = 0; 
+        strcpy_P(globalConfigs[0].name, PSTR("LAT"));
+        globalConfigs[0].type = 'P';
+        globalConfigs[0].value1 = 0;
         globalConfigs[0].value2 = 0;
-        globalConfigs[0].lpType = 'N'; 
+        globalConfigs[0].lpType = 'N';
         globalConfigs[0].lpValue1 = 0;
         globalConfigs[0].lpValue2 = 0;
-        
+        globalConfigs[0].pressMode = 'R';
+
         // 1: Central (Antes Ctrl2) -> Default
-        snprintf(globalConfigs[1].name, 5, "CEN");
-        globalConfigs[1].type = 'P'; 
-        globalConfigs[1].value1 = 0; 
+        strcpy_P(globalConfigs[1].name, PSTR("CEN"));
+        globalConfigs[1].type = 'P';
+        globalConfigs[1].value1 = 0;
         globalConfigs[1].value2 = 0;
         globalConfigs[1].lpType = 'N';
         globalConfigs[1].lpValue1 = 0;
         globalConfigs[1].lpValue2 = 0;
+        globalConfigs[1].pressMode = 'R';
+        markDirty(REC_GLOBAL_FIRST);
+        markDirty(REC_GLOBAL_FIRST + 1);
+
+        for (byte i = 0; i < EXP_INPUTS; i++) defaultExp(expConfigs[i]);
+        markExpDirty();
     }
-    
+
     void initBank(int b) {
-        snprintf(bankNames[b], 9, "BANK %d", b);
+        byte slot = slotOf(b);
+        BankPage* pg = page(slot, false);
+        snprintf_P(pg->name, 9, PSTR("BANK %d"), b);
+        pg->tempo = 0;
         for (int p = 0; p < NUM_PRESETS_CFG; p++) {
-            snprintf(configs[b][p].name, 5, "P%d-%d", b, p);
-            configs[b][p].type = 'P';
-            configs[b][p].value1 = (b * 3) + p; 
-            configs[b][p].value2 = 0;
-            
+            ButtonConfig& cfg = pg->presets[p];
+            // 4 caracteres: desde el banco 10 sin la P ("12-0")
+            snprintf_P(cfg.name, 5, b < 10 ? PSTR("P%d-%d") : PSTR("%d-%d"), b, p);
+            cfg.type = 'P';
+            cfg.value1 = (b * 3) + p;
+            cfg.value2 = 0;
+
             // Init Long Press (None by default)
-            configs[b][p].lpType = 'N'; 
-            configs[b][p].lpValue1 = 0;
-            configs[b][p].lpValue2 = 0;       
+            cfg.lpType = 'N';
+            cfg.lpValue1 = 0;
+            cfg.lpValue2 = 0;
+            cfg.pressMode = 'R';
+            pg->scenes[p] = SCENE_NONE;
         }
+        markBankDirty(slot);
     }
-    
+
     // --- Dynamic Management ---
-    
+
     int getActiveBanksCount() {
-        return _activeBanks;
+        return _meta[0];
     }
-    
+
     bool addBank() {
-        if (_activeBanks < MAX_BANKS_CFG) {
+        if (getActiveBanksCount() < MAX_BANKS_CFG) {
             // Inicializar el nuevo banco antes de activarlo
-            initBank(_activeBanks); 
-            _activeBanks++;
+            initBank(getActiveBanksCount());
+            _meta[0]++;
+            markDirty(REC_META);
             save(); // Persistir cambio
             return true;
         }
         return false;
     }
-    
-    // Delete specific bank and shift down
+
+    // Delete specific bank: solo se reordena la tabla de slots
     bool removeBank(int index) {
-        if (_activeBanks <= 1 || index < 0 || index >= _activeBanks) return false;
-
-        // Shift everything down from index + 1
-        for (int b = index; b < _activeBanks - 1; b++) {
-             // Copy Bank b+1 into Bank b
-             for (int p = 0; p < NUM_PRESETS_CFG; p++) {
-                 configs[b][p] = configs[b+1][p];
-             }
-             strncpy(bankNames[b], bankNames[b+1], 9);
-        }
-
-        _activeBanks--;
-        
-        // CLEANUP: Wipe the old last bank (now unused) to avoid confusion
-        // if re-added later or accessed by mistake.
-        initBank(_activeBanks); // Reset to default Px-y logic
-        snprintf(bankNames[_activeBanks], 9, "EMPTY"); // Mark explicitly
-        
+        int active = getActiveBanksCount();
+        if (active <= 1 || index < 0 || index >= active) return false;
+
+        byte before[sizeof(_meta)];
+        memcpy(before, _meta, sizeof(_meta));
+        // El slot liberado pasa al final: lo reutilizará el próximo addBank()
+        byte freed = slotOf(index);
+        for (int b = index; b < active - 1; b++) _meta[1 + b] = _meta[2 + b];
+        _meta[active] = freed;
+        _meta[0]--;
+        markMeta(before);
+
         save();
         return true;
     }
 
     // Legacy/Default (Delete Last)
     bool removeBankLast() {
-        if (_activeBanks > 1) {
-            _activeBanks--;
-            
-            // Cleanup
-            initBank(_activeBanks);
-            snprintf(bankNames[_activeBanks], 9, "EMPTY");
-            
+        if (getActiveBanksCount() > 1) {
+            _meta[0]--;
+            markDirty(REC_META);
             save();
             return true;
         }
         return false;
     }
-    
+
     ButtonConfig* getButtonConfig(int bank, int preset) {
-        if (bank >= 0 && bank < MAX_BANKS_CFG && 
+        if (bank >= 0 && bank < MAX_BANKS_CFG &&
             preset >= 0 && preset < NUM_PRESETS_CFG) {
-            return &configs[bank][preset];
+            return &page(slotOf(bank))->presets[preset];
         }
         return nullptr;
     }
-    
+
     // Accessor para globales
     ButtonConfig* getGlobalConfig(int index) {
         if (index >= 0 && index < 2) {
@@ -233,18 +1044,62 @@ class ConfigManager {
         }
         return nullptr;
     }
-    
+
+    // Pasos de la macro (MACRO_STEPS). Como con los bancos, el puntero vale
+    // hasta que se pida otra macro.
+    MacroStep* getMacro(int macro) {
+        if (macro >= 0 && macro < MACRO_COUNT) return macroPage(macro);
+        return nullptr;
+    }
+
+    // ¿getMacro() vuelve sin esperar a la EEPROM? (fuera de rango: sí)
+    bool macroReady(int macro) {
+        return macro < 0 || macro >= MACRO_COUNT || macro == _macroId || eeprom_is_ready();
+    }
+
     char* getBankName(int bank) {
          if (bank >= 0 && bank < MAX_BANKS_CFG) {
-            return bankNames[bank];
+            return page(slotOf(bank))->name;
          }
          return (char*)"ERR";
     }
-    
+
+    // BPM del banco para el reloj MIDI (0 = sin tempo propio)
+    byte getBankTempo(int bank) {
+        if (bank >= 0 && bank < MAX_BANKS_CFG) return page(slotOf(bank))->tempo;
+        return 0;
+    }
+
+    void setBankTempo(int bank, byte bpm) {
+        if (bank >= 0 && bank < MAX_BANKS_CFG) {
+            BankPage* pg = page(slotOf(bank));
+            pg->tempo = bpm;
+            markDirty(bankNameRecord(pg->slot));
+        }
+    }
+
+    // Escena del preset (SCENE_NONE = sin escena)
+    uint16_t getScene(int bank, int preset) {
+        if (bank >= 0 && bank < MAX_BANKS_CFG && preset >= 0 && preset < NUM_PRESETS_CFG) {
+            return page(slotOf(bank))->scenes[preset];
+        }
+        return SCENE_NONE;
+    }
+
+    void setScene(int bank, int preset, uint16_t scene) {
+        if (bank >= 0 && bank < MAX_BANKS_CFG && preset >= 0 && preset < NUM_PRESETS_CFG) {
+            BankPage* pg = page(slotOf(bank));
+            pg->scenes[preset] = scene == SCENE_NONE ? SCENE_NONE : scene & SCENE_BITS;
+            markDirty(sceneRecord(pg->slot));
+        }
+    }
+
     void setBankName(int bank, const char* name) {
         if (bank >= 0 && bank < MAX_BANKS_CFG) {
-            strncpy(bankNames[bank], name, 8);
-            bankNames[bank][8] = '\0'; // Ensure null term
+            BankPage* pg = page(slotOf(bank));
+            strncpy(pg->name, name, 8);
+            pg->name[8] = '\0'; // Ensure null term
+            markDirty(bankNameRecord(pg->slot));
         }
     }
 };
@@ -3,74 +3,244 @@
 
 #include <Wire.h>
 #include <LiquidCrystal_I2C.h>
+#include "Scheduler.h"
 
-// Definición de caracteres personalizados
-const byte notaMusical[8] = { B00110, B00101, B00101, B00100, B01100, B01100, B00000, B00000 };
-const byte notaMusical2[8] = { 0b00001, 0b00011, 0b00101, 0b01001, 0b01001, 0b01011, 0b11011, 0b11000 };
+// Definición de caracteres personalizados (en flash; se copian al cargarlos)
+const byte notaMusical[8] PROGMEM = { B00110, B00101, B00101, B00100, B01100, B01100, B00000, B00000 };
+const byte notaMusical2[8] PROGMEM = { 0b00001, 0b00011, 0b00101, 0b01001, 0b01001, 0b01011, 0b11011, 0b11000 };
+
+// Render por diferencias: las vistas escriben en un framebuffer en RAM y
+// update() envía por I2C solo las celdas que cambiaron, unos pocos bytes
+// por vuelta de loop(). Ningún footswitch espera nunca al LCD.
+const byte LCD_COLS = 16;
+const byte LCD_ROWS = 2;
+const byte LCD_BYTES_PER_UPDATE = 6; // ~3 ms de bus I2C como máximo por loop()
+const char LCD_CELL_UNKNOWN = (char)0xFF; // Celda en estado desconocido (forzar reenvío)
+const unsigned int LCD_EXPIRE_SLICE_US = 300; // Caducar un mensaje o pintar el siguiente paso del splash
+
+// Duración (ms) de cada paso del splash, en flash como sus textos
+const uint16_t SPLASH_DURATIONS[] PROGMEM = {2000, 2000, 700, 700, 700, 2500};
 
 class DisplayManager {
   private:
     LiquidCrystal_I2C _lcd;
 
+    char _base[LCD_ROWS][LCD_COLS];    // Vista principal
+    char _overlay[LCD_ROWS][LCD_COLS]; // Mensaje temporal (showMessage)
+    char _shown[LCD_ROWS][LCD_COLS];   // Lo que hay realmente en el LCD
+
+    bool _overlayActive;
+    Scheduler* _sched;
+    byte _expireTask; // Fin del mensaje temporal en curso
+
+    static const byte SPLASH_OFF = 0xFF;
+    static const byte SPLASH_STEPS = 6;
+    byte _splashStep;
+
+    byte _cursorCol; // Posición del cursor hardware (LCD_COLS = desconocida)
+    byte _cursorRow;
+
+    static void fill(char buf[LCD_ROWS][LCD_COLS], char c) {
+        memset(buf, c, LCD_ROWS * LCD_COLS);
+    }
+
+    static void put(char buf[LCD_ROWS][LCD_COLS], byte col, byte row, const char* text) {
+        while (*text && col < LCD_COLS) {
+            buf[row][col++] = *text++;
+        }
+    }
+
+    // Como put(), pero leyendo de flash
+    static void put_P(char buf[LCD_ROWS][LCD_COLS], byte col, byte row, PGM_P text) {
+        char c;
+        while ((c = pgm_read_byte(text++)) && col < LCD_COLS) {
+            buf[row][col++] = c;
+        }
+    }
+
+    // Nombre de la config o, si no hay, un texto fijo ("---", "???")
+    static void putName(char buf[LCD_ROWS][LCD_COLS], byte col, byte row, const char* name, PGM_P missing) {
+        if (name) put(buf, col, row, name);
+        else put_P(buf, col, row, missing);
+    }
+
+    void renderSplashStep() {
+      if (_splashStep < 2) {
+        fill(_overlay, ' ');
+        put_P(_overlay, 0, 0, _splashStep == 0 ? PSTR("MIDI Controller") : PSTR("BY"));
+        put_P(_overlay, 0, 1, _splashStep == 0 ? PSTR("Valeton GP-200") : PSTR("ROBERT CODER"));
+      } else if (_splashStep == 2) {
+        fill(_overlay, ' ');
+        put_P(_overlay, 0, 0, PSTR("HI ROBERT "));
+      } else {
+        // Notas musicales (caracteres custom 0 y 1) en las columnas 10, 12, 14
+        _overlay[0][10 + (_splashStep - 3) * 2] = (_splashStep == 4) ? 1 : 0;
+      }
+      showOverlay(pgm_read_word(&SPLASH_DURATIONS[_splashStep]));
+    }
+
+    // El overlay tapa la vista principal durante 'duration' ms
+    void showOverlay(unsigned int duration) {
+      _overlayActive = true;
+      if (_sched) _sched->post(_expireTask, duration);
+    }
+
+    static void onOverlayExpired(void* ctx) {
+      DisplayManager* self = static_cast<DisplayManager*>(ctx);
+      self->_overlayActive = false;
+      if (self->_splashStep != SPLASH_OFF && ++self->_splashStep < SPLASH_STEPS) {
+          self->renderSplashStep();
+      } else {
+          self->_splashStep = SPLASH_OFF;
+      }
+    }
+
+    char (*target())[LCD_COLS] {
+        return _overlayActive ? _overlay : _base;
+    }
+
+    // Envía como mucho 'budget' bytes (comandos de cursor incluidos)
+    void push(int budget) {
+        char (*frame)[LCD_COLS] = target();
+        for (byte row = 0; row < LCD_ROWS; row++) {
+            for (byte col = 0; col < LCD_COLS; col++) {
+                if (frame[row][col] == _shown[row][col]) continue;
+
+                // El HD44780 avanza solo: si escribimos seguido no hace falta setCursor
+                int cost = (row == _cursorRow && col == _cursorCol) ? 1 : 2;
+                if (budget < cost) return;
+                if (cost == 2) _lcd.setCursor(col, row);
+                _lcd.write((byte)frame[row][col]);
+                _shown[row][col] = frame[row][col];
+                _cursorRow = row;
+                _cursorCol = col + 1;
+                budget -= cost;
+            }
+        }
+    }
+
   public:
     DisplayManager(uint8_t addr, uint8_t cols, uint8_t rows) : _lcd(addr, cols, rows) {
-      // Constructor vacío
+      fill(_base, ' ');
+      fill(_overlay, ' ');
+      fill(_shown, LCD_CELL_UNKNOWN);
+      _overlayActive = false;
+      _sched = nullptr;
+      _expireTask = SCHED_NONE;
+      _splashStep = SPLASH_OFF;
+      _cursorCol = LCD_COLS;
+      _cursorRow = 0;
     }
 
     void begin() {
       _lcd.init();
       _lcd.backlight();
-      _lcd.createChar(0, (uint8_t*)notaMusical);
-      _lcd.createChar(1, (uint8_t*)notaMusical2);
+      byte glyph[8];
+      memcpy_P(glyph, notaMusical, sizeof(glyph));
+      _lcd.createChar(0, glyph);
+      memcpy_P(glyph, notaMusical2, sizeof(glyph));
+      _lcd.createChar(1, glyph);
+      _lcd.clear();
+      fill(_shown, ' ');
+      _cursorCol = 0;
+      _cursorRow = 0;
+    }
+
+    // Los mensajes temporales caducan con una tarea del planificador
+    void attach(Scheduler* sched) {
+      _sched = sched;
+      _expireTask = sched->add(onOverlayExpired, this, LCD_EXPIRE_SLICE_US, PSTR("lcd-expire"));
+    }
+
+    // Llamar en cada loop(): envía unos pocos bytes pendientes
+    void update() {
+      push(LCD_BYTES_PER_UPDATE);
     }
 
+    // Envía todo lo pendiente de una vez (arranque)
+    void flush() {
+      push(3 * LCD_ROWS * LCD_COLS);
+    }
+
+    bool isIdle() {
+      return memcmp(target(), _shown, LCD_ROWS * LCD_COLS) == 0;
+    }
+
+    // Splash de bienvenida como secuencia de mensajes temporales: no bloquea,
+    // la vista principal ya está debajo y cualquier pisada lo cancela.
     void showWelcome() {
-      _lcd.clear();
-      _lcd.setCursor(0, 0); _lcd.print("MIDI Controller");
-      _lcd.setCursor(0, 1); _lcd.print("Valeton GP-200");
-      delay(2000);
-      _lcd.clear();
-      _lcd.setCursor(0, 0); _lcd.print("BY");
-      _lcd.setCursor(0, 1); _lcd.print("ROBERT CODER");
-      delay(2000);
-      _lcd.clear();
-      _lcd.setCursor(0, 0); _lcd.print("HI ROBERT ");
-      delay(700); _lcd.write((byte)0); _lcd.print(" ");
-      delay(700); _lcd.write((byte)1); _lcd.print(" ");
-      delay(700); _lcd.write((byte)0);
-      delay(2500);
+      _splashStep = 0;
+      renderSplashStep();
     }
 
-    void showMainView(const char* guitarName, const char* bankName, const char* p1, const char* p2, const char* p3) {
-      _lcd.clear();
-      _lcd.setCursor(0, 0); _lcd.print(guitarName); _lcd.print(": "); _lcd.print(bankName);
-      _lcd.setCursor(0, 1); _lcd.print(p1);
-      _lcd.setCursor(6, 1); _lcd.print(p2);
-      _lcd.setCursor(12, 1); _lcd.print(p3);
+    void cancelSplash() {
+      if (_splashStep == SPLASH_OFF) return;
+      _splashStep = SPLASH_OFF;
+      _overlayActive = false;
+      if (_sched) _sched->cancel(_expireTask);
+    }
+
+    bool isSplashActive() {
+      return _splashStep != SPLASH_OFF;
+    }
+
+    // Título fijo en flash (F("GP-200")); presets sin config (nullptr) salen como "---"
+    // Con el reloj MIDI en marcha el título deja su sitio al tempo ("120BPM")
+    void showMainView(const __FlashStringHelper* title, const char* bankName, const char* p1, const char* p2, const char* p3,
+                      unsigned int bpm = 0) {
+      PGM_P guitarName = reinterpret_cast<PGM_P>(title);
+      fill(_base, ' ');
+      byte col;
+      if (bpm) {
+        char tempo[4] = "   ";
+        for (int i = 2; i >= 0 && bpm; i--, bpm /= 10) tempo[i] = '0' + bpm % 10;
+        put(_base, 0, 0, tempo);
+        put_P(_base, 3, 0, PSTR("BPM"));
+        col = 6;
+      } else {
+        put_P(_base, 0, 0, guitarName);
+        col = strlen_P(guitarName);
+      }
+      put_P(_base, col, 0, PSTR(": "));
+      if (col + 2 < LCD_COLS) put(_base, col + 2, 0, bankName);
+      putName(_base, 0, 1, p1, PSTR("---"));
+      putName(_base, 6, 1, p2, PSTR("---"));
+      putName(_base, 12, 1, p3, PSTR("---"));
     }
 
     void showToggleView(const char* currentName, const char* previousName) {
-      _lcd.clear();
-      _lcd.setCursor(0, 0); _lcd.print("[");
-      _lcd.setCursor(1, 0); _lcd.print(currentName);
-      _lcd.setCursor(5, 0); _lcd.print("]");
-      _lcd.setCursor(7, 0); _lcd.print("<=>");
-      _lcd.setCursor(11, 0); _lcd.print(previousName);
-    }
-    
-    // Nuevo: Feedback temporal para acciones como Long Press
+      fill(_base, ' ');
+      put_P(_base, 0, 0, PSTR("["));
+      putName(_base, 1, 0, currentName, PSTR("???"));
+      put_P(_base, 5, 0, PSTR("]"));
+      put_P(_base, 7, 0, PSTR("<=>"));
+      putName(_base, 11, 0, previousName, PSTR("???"));
+    }
+
+    // Feedback temporal para acciones como Long Press. No bloquea: el mensaje
+    // tapa la vista principal hasta que vence y luego se restaura por diferencias.
     void showMessage(const char* line1, const char* line2, int duration) {
-        _lcd.clear();
-        _lcd.setCursor(0,0); _lcd.print(line1);
-        _lcd.setCursor(0,1); _lcd.print(line2);
-        delay(duration);
+        _splashStep = SPLASH_OFF;
+        fill(_overlay, ' ');
+        put(_overlay, 0, 0, line1);
+        put(_overlay, 0, 1, line2);
+        showOverlay(duration);
+    }
+
+    // Igual, con textos en flash (p.ej. getNameFromDict() y F("ON"))
+    void showMessage(const __FlashStringHelper* line1, const __FlashStringHelper* line2, int duration) {
+        _splashStep = SPLASH_OFF;
+        fill(_overlay, ' ');
+        put_P(_overlay, 0, 0, reinterpret_cast<PGM_P>(line1));
+        put_P(_overlay, 0, 1, reinterpret_cast<PGM_P>(line2));
+        showOverlay(duration);
     }
 
     // Nuevo: Mostrar texto custom directo (para Menú)
     void showCustom(const char* line1, const char* line2) {
-        _lcd.clear();
-        _lcd.setCursor(0,0); _lcd.print(line1);
-        _lcd.setCursor(0,1); _lcd.print(line2);
+        fill(_base, ' ');
+        put(_base, 0, 0, line1);
+        put(_base, 0, 1, line2);
     }
 };
 
@@ -0,0 +1,290 @@
+#ifndef EEPROMJOURNAL_H
+#define EEPROMJOURNAL_H
+
+#include <Arduino.h>
+#include <EEPROM.h>
+
+// Persistencia incremental en EEPROM: imagen base + journal circular.
+//
+// La configuración se divide en registros de tamaño fijo (un ButtonConfig,
+// un nombre de banco...). Guardar un cambio NO reescribe la imagen: se añade
+// una entrada {seq, id, crc, datos} al journal, en el hueco seq % JOURNAL_SLOTS.
+// Así un slot editado mil veces rota por 16 posiciones distintas en lugar de
+// machacar siempre las mismas celdas.
+//
+// Cuando el journal se llena, un fold vuelca la última versión de cada registro
+// a la imagen base (solo bytes distintos) y avanza baseSeq en la cabecera.
+// El fold puede pararse en una entrada concreta (el último commit) para no
+// hacer definitivo un lote que todavía se puede descartar con rewind().
+//
+// Las escrituras no bloquean: append() y startFold() solo preparan el trabajo
+// y poll(), llamado en cada loop(), programa como mucho un byte cuando la
+// EEPROM está libre (eeprom_is_ready). Los ~3.3 ms de cada byte corren en el
+// hardware mientras loop() sigue atendiendo footswitches.
+// Al cargar: imagen base + entradas baseSeq+1.. en orden, hasta la última
+// marcada como commit. Una entrada a medio escribir falla el CRC y se ignora,
+// igual que un lote que no llegó a su commit.
+//
+// Mapa (a partir de 'startAddress'):
+//   [magic:2][baseSeq:2][crc:1][-:1] [registro 0..n-1 x 8] [entrada 0..15 x 12]
+
+const byte JOURNAL_RECORD_SIZE = 8;    // Registro empaquetado (ver ConfigManager.h)
+const byte JOURNAL_SLOTS = 16;         // Potencia de 2 (divide a 32768)
+const byte JOURNAL_ENTRY_SIZE = 4 + JOURNAL_RECORD_SIZE;
+const byte JOURNAL_HEADER_SIZE = 6;
+const uint16_t JOURNAL_COMMIT = 0x8000;   // Bit alto de seq: fin de lote
+const uint16_t JOURNAL_SEQ_MASK = 0x7FFF;
+const byte JOURNAL_MAX_RECORDS = 128;
+const byte JOURNAL_READS_PER_POLL = 16; // Bytes iguales que se saltan por vuelta
+
+struct JournalEntry {
+    uint16_t seq;   // Secuencia (15 bits) | JOURNAL_COMMIT
+    byte id;        // Registro al que pertenece
+    byte crc;       // CRC-8 de seq, id y data
+    byte data[JOURNAL_RECORD_SIZE];
+};
+
+// CRC-8 Dallas/Maxim (poly 0x31 reflejado): pequeño y sin tablas
+inline byte crc8(const byte* data, byte len, byte crc = 0) {
+    while (len--) {
+        byte in = *data++;
+        for (byte i = 0; i < 8; i++) {
+            byte mix = (crc ^ in) & 0x01;
+            crc >>= 1;
+            if (mix) crc ^= 0x8C;
+            in >>= 1;
+        }
+    }
+    return crc;
+}
+
+class EepromJournal {
+  private:
+    int _headerAddr;
+    int _baseAddr;
+    int _journalAddr;
+    byte _records;
+    uint16_t _baseSeq;   // Última entrada ya volcada a la imagen base
+    uint16_t _head;      // Última entrada escrita (commit o no)
+
+    // Escritura en curso: _wlen bytes de _stage hacia _waddr (0 = ninguna)
+    JournalEntry _stage;
+    int _waddr;
+    byte _wlen;
+    byte _wpos;
+
+    enum FoldState { FOLD_NONE, FOLD_RECORDS, FOLD_HEADER };
+    byte _fold;
+    uint16_t _foldSeq;   // Próxima entrada a volcar (de la más nueva hacia atrás)
+    uint16_t _foldTo;    // Nueva baseSeq al terminar
+    byte _foldLeft;
+    byte _seen[JOURNAL_MAX_RECORDS / 8];
+
+    static byte entryCrc(const JournalEntry& e) {
+        byte crc = crc8((const byte*)&e.seq, sizeof(e.seq));
+        crc = crc8(&e.id, 1, crc);
+        return crc8(e.data, JOURNAL_RECORD_SIZE, crc);
+    }
+
+    int slotAddress(uint16_t seq) {
+        return _journalAddr + (seq % JOURNAL_SLOTS) * JOURNAL_ENTRY_SIZE;
+    }
+
+    static uint16_t nextSeq(uint16_t seq) {
+        return (seq + 1) & JOURNAL_SEQ_MASK;
+    }
+
+    void writeHeaderSeq(uint16_t seq) {
+        EEPROM.put(_headerAddr + 2, seq);
+        EEPROM.update(_headerAddr + 4, crc8((const byte*)&seq, sizeof(seq)));
+    }
+
+    void startWrite(int addr, byte len) {
+        _waddr = addr;
+        _wlen = len;
+        _wpos = 0;
+    }
+
+    // Avanza la escritura en curso sin esperar nunca a la EEPROM: salta los
+    // bytes que ya coinciden y arranca la programación del primero distinto.
+    // True cuando todos los bytes están escritos y la EEPROM quedó libre.
+    bool pump() {
+        const byte* src = (const byte*)&_stage;
+        for (byte n = 0; n < JOURNAL_READS_PER_POLL; n++) {
+            if (!eeprom_is_ready()) return false;
+            if (_wpos >= _wlen) return true;
+            int addr = _waddr + _wpos;
+            byte v = src[_wpos++];
+            if (EEPROM.read(addr) != v) EEPROM.write(addr, v);
+        }
+        return false;
+    }
+
+    // Siguiente registro del fold, o la cabecera cuando ya no quedan
+    void foldNext() {
+        while (_foldLeft > 0) {
+            uint16_t seq = _foldSeq;
+            _foldSeq = (_foldSeq - 1) & JOURNAL_SEQ_MASK;
+            _foldLeft--;
+            if (!readEntry(seq, _stage)) continue;
+            byte id = _stage.id;
+            if (_seen[id >> 3] & (1 << (id & 7))) continue;
+            _seen[id >> 3] |= 1 << (id & 7);
+            // Los datos van al principio del buffer de escritura
+            memmove(&_stage, _stage.data, JOURNAL_RECORD_SIZE);
+            startWrite(_baseAddr + id * JOURNAL_RECORD_SIZE, JOURNAL_RECORD_SIZE);
+            return;
+        }
+        // Cabecera al final: si se corta antes, el journal se reproduce entero
+        byte* h = (byte*)&_stage;
+        memcpy(h, &_foldTo, sizeof(_foldTo));
+        h[2] = crc8(h, sizeof(_foldTo));
+        _fold = FOLD_HEADER;
+        startWrite(_headerAddr + 2, 3);
+    }
+
+  public:
+    EepromJournal(int startAddress, byte records)
+        : _headerAddr(startAddress),
+          _baseAddr(startAddress + JOURNAL_HEADER_SIZE),
+          _journalAddr(startAddress + JOURNAL_HEADER_SIZE + records * JOURNAL_RECORD_SIZE),
+          _records(records), _baseSeq(0), _head(0),
+          _waddr(0), _wlen(0), _wpos(0), _fold(FOLD_NONE), _foldSeq(0), _foldTo(0), _foldLeft(0) {}
+
+    // Primer byte libre tras el journal
+    int endAddress() {
+        return _journalAddr + JOURNAL_SLOTS * JOURNAL_ENTRY_SIZE;
+    }
+
+    // Lee la cabecera y localiza el último commit. False si no hay imagen válida.
+    bool open(uint16_t magic) {
+        uint16_t stored;
+        EEPROM.get(_headerAddr, stored);
+        if (stored != magic) return false;
+
+        EEPROM.get(_headerAddr + 2, _baseSeq);
+        _baseSeq &= JOURNAL_SEQ_MASK;
+        _head = _baseSeq;
+        // Cabecera a medias (reset justo tras un fold): la base ya está completa,
+        // así que basta con no reproducir nada.
+        if (EEPROM.read(_headerAddr + 4) != crc8((const byte*)&_baseSeq, sizeof(_baseSeq))) {
+            return true;
+        }
+
+        JournalEntry e;
+        uint16_t seq = _baseSeq;
+        for (byte i = 0; i < JOURNAL_SLOTS; i++) {
+            seq = nextSeq(seq);
+            if (!readEntry(seq, e)) break;
+            if (e.seq & JOURNAL_COMMIT) _head = seq;
+        }
+        return true;
+    }
+
+    // Deja la cabecera inválida: si se corta la luz a mitad de un formateo,
+    // el próximo arranque vuelve a formatear.
+    void erase() {
+        EEPROM.put(_headerAddr, (uint16_t)0xFFFF);
+    }
+
+    // Cierra un formateo: imagen base ya escrita, journal vacío.
+    void format(uint16_t magic) {
+        _baseSeq = 0;
+        _head = 0;
+        writeHeaderSeq(0);
+        // Que la primera entrada a reproducir nunca coincida con basura vieja
+        EEPROM.put(slotAddress(1), (uint16_t)0xFFFF);
+        EEPROM.put(_headerAddr, magic);
+    }
+
+    void readRecord(byte id, byte* out) {
+        for (byte i = 0; i < JOURNAL_RECORD_SIZE; i++) {
+            out[i] = EEPROM.read(_baseAddr + id * JOURNAL_RECORD_SIZE + i);
+        }
+    }
+
+    // Escritura directa (bloqueante) a la imagen base para el formateo
+    void writeRecord(byte id, const byte* data) {
+        for (byte i = 0; i < JOURNAL_RECORD_SIZE; i++) {
+            EEPROM.update(_baseAddr + id * JOURNAL_RECORD_SIZE + i, data[i]);
+        }
+    }
+
+    // Entradas confirmadas pendientes de reproducir: firstSeq() .. lastSeq()
+    uint16_t firstSeq() { return nextSeq(_baseSeq); }
+    uint16_t lastSeq() { return _head; }
+    byte pending() { return (_head - _baseSeq) & JOURNAL_SEQ_MASK; }
+    bool full() { return pending() >= JOURNAL_SLOTS; }
+
+    // Sin escrituras ni fold en curso: todo lo añadido ya es durable
+    bool idle() { return _wlen == 0 && _fold == FOLD_NONE; }
+
+    bool readEntry(uint16_t seq, JournalEntry& e) {
+        EEPROM.get(slotAddress(seq), e);
+        return (e.seq & JOURNAL_SEQ_MASK) == seq && e.id < _records && e.crc == entryCrc(e);
+    }
+
+    // Solo el id de una entrada (3 bytes leídos en vez de 12): para buscar los
+    // registros de un banco sin leer el journal entero. 0xFF si no es esa seq.
+    byte entryId(uint16_t seq) {
+        int addr = slotAddress(seq);
+        uint16_t stored;
+        EEPROM.get(addr, stored);
+        if ((stored & JOURNAL_SEQ_MASK) != seq) return 0xFF;
+        return EEPROM.read(addr + 2);
+    }
+
+    // Entrada que append() está escribiendo: hasta que termine, readEntry()
+    // la da por mala (CRC a medias). False si no hay ninguna.
+    bool writingEntry(JournalEntry& e) {
+        if (_wlen == 0 || _fold != FOLD_NONE) return false;
+        e = _stage;
+        return true;
+    }
+
+    // Encola una entrada. Requiere idle() && !full().
+    void append(byte id, const byte* data, bool commit) {
+        _head = nextSeq(_head);
+        _stage.seq = _head | (commit ? JOURNAL_COMMIT : 0);
+        _stage.id = id;
+        memcpy(_stage.data, data, JOURNAL_RECORD_SIZE);
+        _stage.crc = entryCrc(_stage);
+        startWrite(slotAddress(_head), JOURNAL_ENTRY_SIZE);
+    }
+
+    // Empieza a volcar a la imagen base la última versión de cada registro
+    // del journal hasta 'upTo' (incluida). Requiere idle().
+    void startFold(uint16_t upTo) {
+        memset(_seen, 0, sizeof(_seen));
+        _foldSeq = upTo;
+        _foldTo = upTo;
+        _foldLeft = (upTo - _baseSeq) & JOURNAL_SEQ_MASK;
+        _fold = FOLD_RECORDS;
+        foldNext();
+    }
+
+    void startFold() {
+        startFold(_head);
+    }
+
+    // Descarta las entradas posteriores a 'seq' (un lote sin commit que ya no
+    // se quiere). Al arrancar ya se ignoraban: esto hace lo mismo en marcha y
+    // las siguientes append() reutilizan sus huecos. Requiere idle().
+    void rewind(uint16_t seq) {
+        _head = seq;
+    }
+
+    // Llamar en cada loop(): programa como mucho un byte por vuelta
+    void poll() {
+        if (_wlen == 0 || !pump()) return;
+        _wlen = 0;
+        if (_fold == FOLD_RECORDS) {
+            foldNext();
+        } else if (_fold == FOLD_HEADER) {
+            _baseSeq = _foldTo;
+            _fold = FOLD_NONE;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,322 @@
+#ifndef EXPRESSIONPEDALS_H
+#define EXPRESSIONPEDALS_H
+
+#include <Arduino.h>
+#include "ConfigManager.h"
+#include "MidiOut.h"
+#include "Scheduler.h"
+
+// Pedales de expresión (wah, volumen) en entradas analógicas libres.
+//
+// El ADC corre libre (auto-trigger) y su ISR solo acumula: EXP_OVERSAMPLE
+// conversiones seguidas de una entrada, sumadas y >> EXP_DECIMATE_SHIFT, dan
+// una lectura de 12 bits (el ruido del último bit se promedia). Luego pasa a
+// la otra entrada; la primera conversión tras cambiar el mux se tira, porque
+// el ADC ya la había empezado con el canal anterior. Con el prescaler 128
+// son ~9600 conversiones/s: una lectura nueva cada ~3.5 ms por entrada.
+//
+// Del resto se encarga una tarea del planificador, y solo si hay lecturas
+// nuevas: calibración (talón/punta), cuantización a 7 bits con histéresis
+// (la posición no cambia hasta que la lectura se sale EXP_HYSTERESIS de su
+// escalón: el ruido en una frontera no hace bailar el CC), la curva de la
+// entrada y el CC, solo si el valor cambió.
+//
+// Sin inundar el cable MIDI: como mucho un CC cada EXP_INTERVAL_MS por
+// entrada y nunca con mensajes esperando en MidiOut (lo de una pisada sale
+// antes). Lo que no puede salir no se pierde ni se acumula: sale en cuanto se
+// pueda, ya con la última posición. Al arrancar (o al activar una entrada)
+// la primera lectura solo fija la posición: nada sale hasta mover el pedal.
+
+const byte EXP_OVERSAMPLE = 16;          // Conversiones por lectura
+const byte EXP_DECIMATE_SHIFT = 2;       // 16 x 10 bits >> 2 = 12 bits
+const int EXP_FULL = 4095;               // Posición normalizada: 0..EXP_FULL
+const int EXP_STEP = (EXP_FULL + 1) / 128; // Un valor de CC
+const int EXP_HYSTERESIS = 12;           // Margen a cada lado del escalón actual
+const byte EXP_MARGIN_DIV = 32;          // ~3% de recorrido muerto en cada extremo
+const int EXP_MIN_SPAN = 64;             // Talón-punta mínimo (10 bits) para usar la entrada
+const byte EXP_INTERVAL_MS = 10;         // Entre dos CC de una entrada
+const byte EXP_MIDI_CHANNEL = 1;
+const byte EXP_NONE = 0xFF;
+const unsigned int EXP_SLICE_US = 300;   // EXP_INPUTS entradas: aritmética + un CC a la cola
+const uint32_t EXP_ADC_PERIOD_US = 104;  // 13 ciclos de ADC a 16 MHz / 128 (el host lo simula con un timer)
+
+static_assert(EXP_OVERSAMPLE * 1023UL <= 0xFFFF, "La suma del sobremuestreo no cabe en 16 bits");
+static_assert(EXP_INPUTS * 3UL * (1000 / EXP_INTERVAL_MS) <= 3125 / 4,
+              "Los pedales no pueden pasar de un cuarto del cable MIDI");
+
+// Curvas (posición de 0..127 -> valor del CC). 'L' es la identidad.
+// 'G': sube rápido al principio. 'E': despacio al principio (volumen).
+// 'S': despacio en los extremos y rápida en el centro (wah).
+const byte EXP_CURVE_TABLES[3][128] PROGMEM = {
+    {   0,   5,  10,  14,  18,  21,  25,  28,  30,  33,  36,  38,  40,  43,  45,  47,
+       49,  50,  52,  54,  56,  57,  59,  60,  62,  63,  64,  66,  67,  68,  69,  71,
+       72,  73,  74,  75,  76,  77,  78,  79,  80,  81,  82,  83,  84,  84,  85,  86,
+       87,  88,  89,  89,  90,  91,  92,  92,  93,  94,  94,  95,  96,  96,  97,  98,
+       98,  99, 100, 100, 101, 101, 102, 103, 103, 104, 104, 105, 105, 106, 106, 107,
+      107, 108, 109, 109, 110, 110, 110, 111, 111, 112, 112, 113, 113, 114, 114, 115,
+      115, 116, 116, 116, 117, 117, 118, 118, 118, 119, 119, 120, 120, 120, 121, 121,
+      122, 122, 122, 123, 123, 123, 124, 124, 125, 125, 125, 126, 126, 126, 127, 127 },
+    {   0,   0,   0,   1,   1,   1,   1,   1,   2,   2,   2,   2,   3,   3,   3,   3,
+        4,   4,   4,   4,   5,   5,   5,   6,   6,   6,   6,   7,   7,   7,   8,   8,
+        9,   9,   9,  10,  10,  11,  11,  11,  12,  12,  13,  13,  14,  14,  15,  15,
+       16,  16,  17,  17,  18,  18,  19,  20,  20,  21,  22,  22,  23,  24,  24,  25,
+       26,  27,  27,  28,  29,  30,  31,  31,  32,  33,  34,  35,  36,  37,  38,  39,
+       40,  41,  42,  43,  45,  46,  47,  48,  49,  51,  52,  53,  55,  56,  57,  59,
+       60,  62,  63,  65,  67,  68,  70,  72,  74,  75,  77,  79,  81,  83,  85,  87,
+       89,  91,  94,  96,  98, 100, 103, 105, 108, 110, 113, 116, 118, 121, 124, 127 },
+    {   0,   0,   0,   0,   0,   1,   1,   1,   1,   2,   2,   3,   3,   4,   4,   5,
+        6,   6,   7,   8,   8,   9,  10,  11,  12,  13,  14,  15,  16,  17,  18,  19,
+       20,  21,  22,  24,  25,  26,  27,  29,  30,  31,  32,  34,  35,  37,  38,  39,
+       41,  42,  44,  45,  46,  48,  49,  51,  52,  54,  55,  57,  58,  60,  61,  63,
+       64,  66,  67,  69,  70,  72,  73,  75,  76,  78,  79,  81,  82,  83,  85,  86,
+       88,  89,  90,  92,  93,  95,  96,  97,  98, 100, 101, 102, 103, 105, 106, 107,
+      108, 109, 110, 111, 112, 113, 114, 115, 116, 117, 118, 119, 119, 120, 121, 121,
+      122, 123, 123, 124, 124, 125, 125, 126, 126, 126, 126, 127, 127, 127, 127, 127 },
+};
+
+inline byte expCurve(char curve, byte pos) {
+    byte code = cfgCode(EXP_CURVES, curve, 0);
+    return code ? pgm_read_byte(&EXP_CURVE_TABLES[code - 1][pos]) : pos;
+}
+
+class ExpressionPedals {
+  private:
+    struct Input {
+        byte channel;        // Canal del mux del ADC
+        uint16_t heel;       // Calibración con la que se calculó la escala
+        uint16_t toe;
+        int origin;          // Lectura (12 bits) que da la posición 0
+        long scale;          // EXP_FULL / recorrido, en 1/4096; 0 = sin calibrar
+        byte pos;            // Posición cuantizada (EXP_NONE = sin lectura)
+        byte target;         // Valor de CC que toca mandar
+        byte sent;           // Último valor mandado (o el de arranque)
+        unsigned long sentMs;
+    };
+
+    ConfigManager* _config;
+    MidiOut* _midi;
+    Input _in[EXP_INPUTS];
+
+    // Estado del ISR
+    volatile uint16_t _reading[EXP_INPUTS]; // Última lectura de 12 bits
+    volatile byte _fresh;                   // Bit i: lectura nueva de la entrada i
+    volatile uint16_t _acc;
+    volatile byte _count;
+    volatile byte _current;                 // Entrada que se está muestreando
+    volatile bool _discard;                 // Conversión empezada con el canal anterior
+    volatile unsigned long _readings;
+#if !defined(__AVR__)
+    byte _mux;                              // ADMUX simulado
+    byte _converting;                       // Canal de la conversión en curso
+#endif
+
+    unsigned long _ccs;       // CC entregados a MidiOut
+    unsigned long _coalesced; // Valores que pisó otro más nuevo antes de salir
+
+    // Función-estática: la instancia que atiende el ISR
+    static ExpressionPedals*& active() {
+        static ExpressionPedals* pedals = nullptr;
+        return pedals;
+    }
+
+    void selectChannel(byte channel) {
+#if defined(__AVR__)
+        ADMUX = (1 << REFS0) | (channel & 0x07); // AVcc de referencia
+#else
+        _mux = channel;
+#endif
+    }
+
+    // Resultado de la conversión que acaba de terminar
+    uint16_t sample() {
+#if defined(__AVR__)
+        return ADC;
+#else
+        // Como en el AVR: la conversión terminada usaba el mux de cuando empezó
+        uint16_t v = sim::adcConvert(_converting);
+        _converting = _mux;
+        return v;
+#endif
+    }
+
+    void calibrate(Input& in, const ExpConfig& cfg) {
+        in.heel = cfg.heel;
+        in.toe = cfg.toe;
+        int lo = cfg.heel << 2;
+        int hi = cfg.toe << 2;
+        int margin = (hi - lo) / EXP_MARGIN_DIV;
+        lo += margin;
+        hi -= margin;
+        int span = hi - lo;
+        in.origin = lo;
+        in.scale = abs(span) < EXP_MIN_SPAN * 4 ? 0 : ((long)EXP_FULL << 12) / span;
+    }
+
+    // Lectura nueva de la entrada i -> posición y valor que toca mandar
+    void track(byte i, uint16_t reading) {
+        Input& in = _in[i];
+        const ExpConfig& cfg = _config->expConfigs[i];
+        if (cfg.heel != in.heel || cfg.toe != in.toe) calibrate(in, cfg);
+        if (!cfg.cc || !in.scale) {
+            in.pos = EXP_NONE;
+            return;
+        }
+
+        long norm = ((long)(reading - in.origin) * in.scale) >> 12;
+        if (norm < 0) norm = 0;
+        if (norm > EXP_FULL) norm = EXP_FULL;
+        if (in.pos != EXP_NONE) {
+            int lo = (int)in.pos * EXP_STEP - EXP_HYSTERESIS;
+            int hi = (int)(in.pos + 1) * EXP_STEP - 1 + EXP_HYSTERESIS;
+            if (norm >= lo && norm <= hi) return;
+        }
+        bool first = in.pos == EXP_NONE;
+        in.pos = norm / EXP_STEP;
+        byte value = expCurve(cfg.curve, in.pos);
+        if (first) {
+            in.sent = in.target = value;
+            return;
+        }
+        if (in.target != in.sent && value != in.target) _coalesced++;
+        in.target = value;
+    }
+
+    // El CC pendiente de la entrada i, si ya le toca y el cable está libre
+    void flush(byte i, unsigned long now) {
+        Input& in = _in[i];
+        if (in.pos == EXP_NONE || in.target == in.sent) return;
+        if (now - in.sentMs < EXP_INTERVAL_MS || !_midi->idle()) return;
+        _midi->sendControlChange(_config->expConfigs[i].cc, in.target, EXP_MIDI_CHANNEL);
+        in.sent = in.target;
+        in.sentMs = now;
+        _ccs++;
+    }
+
+    static void onTask(void* ctx) {
+        static_cast<ExpressionPedals*>(ctx)->update();
+    }
+
+  public:
+    ExpressionPedals(ConfigManager* config, MidiOut* midi)
+        : _config(config), _midi(midi), _fresh(0), _acc(0), _count(0),
+          _current(0), _discard(true), _readings(0), _ccs(0), _coalesced(0) {
+        for (byte i = 0; i < EXP_INPUTS; i++) {
+            _in[i].channel = i;
+            _in[i].heel = _in[i].toe = 0xFFFF; // Escala por calcular
+            _in[i].scale = 0;
+            _in[i].pos = EXP_NONE;
+            _in[i].target = _in[i].sent = 0;
+            _in[i].sentMs = 0;
+            _reading[i] = 0;
+        }
+#if !defined(__AVR__)
+        _mux = _converting = 0;
+#endif
+    }
+
+    // Tarea del planificador: cada vuelta de loop(), después de los botones
+    void attach(Scheduler* sched) {
+        sched->every(sched->add(onTask, this, EXP_SLICE_US, PSTR("expression")), 0);
+    }
+
+    // 'pins': A0..A7 de cada entrada. Arranca el ADC en modo libre.
+    void begin(const int* pins) {
+        for (byte i = 0; i < EXP_INPUTS; i++) _in[i].channel = (pins[i] - A0) & 0x07;
+        active() = this;
+        _current = 0;
+        _count = 0;
+        _acc = 0;
+        _discard = true;
+        selectChannel(_in[0].channel);
+#if defined(__AVR__)
+        noInterrupts();
+        for (byte i = 0; i < EXP_INPUTS; i++) {
+            if (_in[i].channel < 6) DIDR0 |= 1 << _in[i].channel; // Sin buffer digital: menos ruido
+        }
+        ADCSRB = 0; // Auto-trigger libre
+        ADCSRA = (1 << ADEN) | (1 << ADSC) | (1 << ADATE) | (1 << ADIE) |
+                 (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0); // 16 MHz / 128 = 125 kHz
+        interrupts();
+#else
+        _converting = _mux;
+        sim::attachTimer(EXP_ADC_PERIOD_US, isrEntry);
+#endif
+    }
+
+    static void isrEntry() {
+        if (active()) active()->isr();
+    }
+
+    // Fin de conversión del ADC
+    void isr() {
+        uint16_t v = sample();
+        if (_discard) {
+            _discard = false;
+            return;
+        }
+        _acc += v;
+        if (++_count < EXP_OVERSAMPLE) return;
+
+        byte i = _current;
+        _reading[i] = _acc >> EXP_DECIMATE_SHIFT;
+        _fresh |= 1 << i;
+        _readings++;
+        _acc = 0;
+        _count = 0;
+        if (EXP_INPUTS > 1) {
+            _current = (i + 1) % EXP_INPUTS;
+            selectChannel(_in[_current].channel);
+            _discard = true;
+        }
+    }
+
+    void update() {
+        uint16_t reading[EXP_INPUTS];
+        noInterrupts();
+        byte fresh = _fresh;
+        _fresh = 0;
+        for (byte i = 0; i < EXP_INPUTS; i++) reading[i] = _reading[i];
+        interrupts();
+
+        unsigned long now = millis();
+        bool queued = false;
+        for (byte i = 0; i < EXP_INPUTS; i++) {
+            if (fresh & (1 << i)) track(i, reading[i]);
+            unsigned long before = _ccs;
+            flush(i, now);
+            if (_ccs != before) queued = true;
+        }
+        if (queued) _midi->update();
+    }
+
+    // Lectura actual de la entrada (10 bits, como la calibración)
+    uint16_t raw(byte input) {
+        if (input >= EXP_INPUTS) return 0;
+        noInterrupts();
+        uint16_t v = _reading[input];
+        interrupts();
+        return v >> 2;
+    }
+
+    // Último valor de CC de la entrada (-1 = apagada, sin calibrar o sin lectura)
+    int value(byte input) const {
+        return input < EXP_INPUTS && _in[input].pos != EXP_NONE ? _in[input].target : -1;
+    }
+
+    // ¿Hay ya una lectura de la entrada? (para calibrar)
+    bool ready() const { return _readings >= EXP_INPUTS; }
+
+    unsigned long readings() const { return _readings; }
+    unsigned long ccs() const { return _ccs; }
+    unsigned long coalesced() const { return _coalesced; }
+};
+
+#if defined(__AVR__)
+// Interrumpible: el RX de BtSerial, el reloj MIDI y el escáner no esperan
+// a este ISR (no se puede anidar: la próxima conversión tarda 104 us)
+ISR(ADC_vect, ISR_NOBLOCK) {
+    ExpressionPedals::isrEntry();
+}
+#endif
+
+#endif
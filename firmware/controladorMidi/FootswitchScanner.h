@@ -0,0 +1,139 @@
+#ifndef FOOTSWITCHSCANNER_H
+#define FOOTSWITCHSCANNER_H
+
+#include <Arduino.h>
+#include "Button.h"
+
+// Escaneo de footswitches por interrupción de timer (Timer2 a 1 kHz).
+//
+// El ISR lee PIND y PINB de una vez (los 8 footswitches caben en un byte) y,
+// si algo cambió, guarda {niveles, timestamp} en un ring buffer sin locks
+// (un productor = ISR, un consumidor = loop()). Así un flanco queda registrado
+// con su instante real aunque loop() esté bloqueado por un save() o un GETALL.
+//
+// No usamos Pin Change Interrupts: el sondeo por Timer2 da el mismo
+// timestamp sin antirrebote en el ISR, y PCINT1 (A0) es del RX de BtSerial.
+//
+// Mapa de bits del snapshot:
+//   bit 0 = D11 (PB3), bit 1 = D12 (PB4), bits 2..7 = D2..D7 (PD2..PD7)
+
+const byte FS_MAX_BUTTONS = 8;
+const byte FS_RING_SIZE = 32; // Potencia de 2
+
+struct PinSample {
+    byte levels;        // Snapshot de los 8 footswitches (1 = suelto)
+    unsigned long time; // millis() en el ISR
+};
+
+class FootswitchScanner {
+  private:
+    static volatile PinSample _ring[FS_RING_SIZE];
+    static volatile byte _head;      // Solo lo escribe el ISR
+    static volatile byte _tail;      // Solo lo escribe loop()
+    static volatile byte _lastLevels;
+    static volatile unsigned int _overruns;
+
+    Button* _buttons[FS_MAX_BUTTONS];
+    byte _levels; // Último snapshot entregado a los botones
+
+    static byte readLevels() {
+        return (PIND & 0xFC) | ((PINB >> 3) & 0x03);
+    }
+
+  public:
+    FootswitchScanner() : _levels(0xFF) {
+        for (byte i = 0; i < FS_MAX_BUTTONS; i++) _buttons[i] = nullptr;
+    }
+
+    static byte bitForPin(int pin) {
+        if (pin >= 2 && pin <= 7) return pin;
+        if (pin == 11 || pin == 12) return pin - 11;
+        return 0xFF; // Pin no escaneable
+    }
+
+    void attach(Button* btn, int pin) {
+        byte bit = bitForPin(pin);
+        if (bit < FS_MAX_BUTTONS) _buttons[bit] = btn;
+    }
+
+    void begin() {
+        // Partimos de "todo suelto" (como Button): un switch ya pisado al
+        // encender genera su flanco en el primer tick y no se pierde.
+        _levels = 0xFF;
+        _lastLevels = 0xFF;
+#if defined(__AVR__)
+        noInterrupts();
+        TCCR2A = (1 << WGM21); // CTC
+        TCCR2B = (1 << CS22);  // Prescaler 64
+        OCR2A = 249;           // 16 MHz / 64 / 250 = 1 kHz
+        TIMSK2 |= (1 << OCIE2A);
+        interrupts();
+#else
+        sim::attachTimer(1000, isr);
+#endif
+    }
+
+    // Productor: solo desde el ISR del timer (o tests en host)
+    static void isr() {
+        byte levels = readLevels();
+        if (levels == _lastLevels) return;
+        pushSample(levels, millis());
+    }
+
+    static bool pushSample(byte levels, unsigned long time) {
+        byte next = (_head + 1) & (FS_RING_SIZE - 1);
+        if (next == _tail) {
+            // Lleno: no actualizamos _lastLevels, el cambio se reintenta en el próximo tick
+            _overruns++;
+            return false;
+        }
+        _ring[_head].levels = levels;
+        _ring[_head].time = time;
+        _head = next;
+        _lastLevels = levels;
+        return true;
+    }
+
+    // Consumidor: entrega los flancos encolados a cada botón, en orden,
+    // y luego resuelve debounce / Long Press hasta 'ahora'.
+    void update() {
+        for (byte i = 0; i < FS_MAX_BUTTONS; i++) {
+            if (_buttons[i]) _buttons[i]->beginCycle();
+        }
+
+        while (_tail != _head) {
+            byte levels = _ring[_tail].levels;
+            unsigned long time = _ring[_tail].time;
+            _tail = (_tail + 1) & (FS_RING_SIZE - 1);
+
+            byte changed = levels ^ _levels;
+            _levels = levels;
+            for (byte i = 0; i < FS_MAX_BUTTONS; i++) {
+                if ((changed & (1 << i)) && _buttons[i]) {
+                    _buttons[i]->feed((levels >> i) & 1, time);
+                }
+            }
+        }
+
+        unsigned long now = millis();
+        for (byte i = 0; i < FS_MAX_BUTTONS; i++) {
+            if (_buttons[i]) _buttons[i]->tick(now);
+        }
+    }
+
+    static unsigned int overruns() { return _overruns; }
+};
+
+volatile PinSample FootswitchScanner::_ring[FS_RING_SIZE];
+volatile byte FootswitchScanner::_head = 0;
+volatile byte FootswitchScanner::_tail = 0;
+volatile byte FootswitchScanner::_lastLevels = 0xFF;
+volatile unsigned int FootswitchScanner::_overruns = 0;
+
+#if defined(__AVR__)
+ISR(TIMER2_COMPA_vect) {
+    FootswitchScanner::isr();
+}
+#endif
+
+#endif
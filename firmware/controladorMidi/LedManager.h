@@ -2,16 +2,31 @@
 #define LEDMANAGER_H
 
 #include <Arduino.h>
+#include "Scheduler.h"
+
+const unsigned int LED_BLINK_SLICE_US = 50;
 
 class LedManager {
   private:
     int* _pins;
     int _count;
     bool* _states;
+    Scheduler* _sched;
+    byte _blinkTask; // Apaga el LED del parpadeo en curso
+    int _blinkIndex;
+
+    static void onBlinkDone(void* ctx) {
+        LedManager* self = static_cast<LedManager*>(ctx);
+        self->setLed(self->_blinkIndex, false);
+        self->_blinkIndex = -1;
+    }
 
   public:
     LedManager(const int pins[], int count) {
         _count = count;
+        _sched = nullptr;
+        _blinkTask = SCHED_NONE;
+        _blinkIndex = -1;
         _pins = new int[_count];
         _states = new bool[_count];
         for (int i = 0; i < _count; i++) {
@@ -22,6 +37,12 @@ class LedManager {
         }
     }
 
+    // blink() apaga el LED con una tarea del planificador
+    void attach(Scheduler* sched) {
+        _sched = sched;
+        _blinkTask = sched->add(onBlinkDone, this, LED_BLINK_SLICE_US, PSTR("led-blink"));
+    }
+
     void setLed(int index, bool state) {
       if (index >= 0 && index < _count) {
         _states[index] = state;
@@ -40,13 +61,14 @@ class LedManager {
       setLed(index, true);
     }
     
-    // Efecto de parpadeo simple
+    // Efecto de parpadeo simple: enciende y vuelve sin esperar. Un parpadeo
+    // nuevo termina el anterior.
     void blink(int index, int duration) {
-        if(index >= 0 && index < _count) {
-             setLed(index, true);
-             delay(duration);
-             setLed(index, false);
-        }
+        if (!_sched || index < 0 || index >= _count) return;
+        if (_blinkIndex >= 0 && _blinkIndex != index) setLed(_blinkIndex, false);
+        setLed(index, true);
+        _blinkIndex = index;
+        _sched->post(_blinkTask, duration);
     }
 };
 
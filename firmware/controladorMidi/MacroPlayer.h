@@ -0,0 +1,94 @@
+#ifndef MACROPLAYER_H
+#define MACROPLAYER_H
+
+#include <Arduino.h>
+#include "ConfigManager.h"
+#include "Scheduler.h"
+
+// Reproduce una macro (ConfigManager.h) paso a paso sin bloquear loop().
+//
+// Los pasos sin retardo salen en la misma llamada: una escena "preset + tres
+// efectos" entra entera en la cola MIDI de una vez (con running status). Para
+// un paso con retardo se arma una tarea del planificador. Los plazos se
+// cuentan desde el instante nominal del paso anterior, no desde cuando corrió
+// la tarea: el retraso de una vuelta de loop() no se acumula entre pasos.
+//
+// Qué hace cada paso lo decide el sketch (setHandler): el reproductor solo
+// lleva el tiempo. Una pisada nueva reinicia la macro desde el principio.
+// Los pasos se copian al pisar: la tarea no lee la EEPROM (la macro en RAM
+// del ConfigManager puede cambiar por una edición o un GETALL) y una edición
+// a mitad de reproducción vale para la siguiente pisada.
+
+const unsigned int MACRO_SLICE_US = 400; // MACRO_STEPS mensajes a la cola MIDI
+
+typedef void (*MacroHandler)(const MacroStep& step);
+
+class MacroPlayer {
+  private:
+    ConfigManager* _config;
+    Scheduler* _sched;
+    MacroHandler _handler;
+    byte _task;
+    byte _macro;         // En curso (MACRO_NONE = parado)
+    byte _next;          // Siguiente paso
+    MacroStep _steps[MACRO_STEPS];
+    unsigned long _due;  // millis() nominal del último paso enviado
+    unsigned int _played;
+
+    static void onStep(void* ctx) {
+        static_cast<MacroPlayer*>(ctx)->step();
+    }
+
+    // Envía lo que ya ha vencido y arma la tarea para el siguiente paso
+    void step() {
+        if (_macro == MACRO_NONE) return;
+        unsigned long now = millis();
+        while (_next < MACRO_STEPS && _steps[_next].type != 'N') {
+            unsigned long at = _due + (unsigned long)_steps[_next].delay * MACRO_TICK_MS;
+            if ((long)(at - now) > 0) {
+                _sched->post(_task, at - now);
+                return;
+            }
+            _due = at;
+            if (_handler) _handler(_steps[_next]);
+            _next++;
+        }
+        _macro = MACRO_NONE;
+        _played++;
+    }
+
+  public:
+    explicit MacroPlayer(ConfigManager* config)
+        : _config(config), _sched(nullptr), _handler(nullptr), _task(SCHED_NONE),
+          _macro(MACRO_NONE), _next(0), _due(0), _played(0) {}
+
+    void attach(Scheduler* sched) {
+        _sched = sched;
+        _task = sched->add(onStep, this, MACRO_SLICE_US, PSTR("macro"));
+    }
+
+    void setHandler(MacroHandler handler) {
+        _handler = handler;
+    }
+
+    // Desde la pisada: los pasos sin retardo salen ya
+    void play(byte macro) {
+        if (!_sched || macro >= MACRO_COUNT) return;
+        _sched->cancel(_task);
+        memcpy(_steps, _config->getMacro(macro), sizeof(_steps));
+        _macro = macro;
+        _next = 0;
+        _due = millis();
+        step();
+    }
+
+    void stop() {
+        if (_sched) _sched->cancel(_task);
+        _macro = MACRO_NONE;
+    }
+
+    bool playing() const { return _macro != MACRO_NONE; }
+    unsigned int played() const { return _played; } // Macros terminadas
+};
+
+#endif
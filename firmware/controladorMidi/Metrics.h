@@ -0,0 +1,233 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+
+// Métricas de funcionamiento medidas en el propio pedal, para ver en directo
+// lo que el benchmark solo ve en el host: período de loop(), latencia
+// flanco -> MIDI, tiempo de las escrituras de EEPROM, bytes recibidos por
+// puerto, comandos por tipo y todo lo que se pierde o se bloquea.
+//
+// Cada histograma son 8 cubetas en escala log2 (la 0 cuenta lo que no llega
+// a una unidad, la 7 todo lo que pasa de 64 unidades) y un máximo. Los contadores son
+// de 16 bits: cuando una cubeta se satura se dividen todas entre 2, así el
+// reparto sigue siendo válido tras horas de uso sin gastar más RAM.
+//
+// Los contadores que ya llevan otros módulos (drops de la cola de eventos,
+// stalls del journal...) no se duplican: se leen con la función que registra
+// el sketch y STATSRESET solo guarda su valor de partida.
+//
+// Se leen con STATS (SerialCommander) y se ponen a cero con STATSRESET.
+// Con METRICS_ENABLED 0 la clase queda vacía: las llamadas se compilan a nada
+// y STATS responde ERR:NO_STATS.
+
+#ifndef METRICS_ENABLED
+#define METRICS_ENABLED 1
+#endif
+
+// Histogramas
+const byte MET_LOOP_US = 0;    // Período de loop() (cubeta 0: < 128 us)
+const byte MET_LATENCY_MS = 1; // Flanco del footswitch -> MIDI en el UART (cubeta 0: < 1 ms)
+const byte MET_EEPROM_US = 2;  // ConfigManager::update() con escrituras pendientes (cubeta 0: < 128 us)
+const byte MET_HISTS = 3;
+const byte MET_BUCKETS = 8;
+
+// Puertos de la App
+const byte MET_PORT_USB = 0;
+const byte MET_PORT_BT = 1;
+const byte MET_PORTS = 2;
+
+// Comandos por tipo
+const byte MET_CMD_READ = 0;  // HELLO, GETALL, HASHES, GETBANK
+const byte MET_CMD_EDIT = 1;  // SAVE, SAVEGLO, SAVEBANK, MACRO, TEMPO, SCENE, EXP, EXPCAL
+const byte MET_CMD_BANK = 2;  // ADDBANK, DELBANK, RESET
+const byte MET_CMD_TX = 3;    // BEGINTX, COMMIT, ABORT, FLUSH
+const byte MET_CMD_FRAME = 4; // Tramas binarias
+const byte MET_CMD_OTHER = 5; // GETEXP, CLOCK, STATS, STATSRESET y desconocidos
+const byte MET_CMDS = 6;
+
+// Contadores de otros módulos, en el orden en que los rellena MetricsSource
+const byte MET_EXT_LOCKOUTS = 0; // Pisadas descartadas por el lockout de su botón
+const byte MET_EXT_EVENTS = 1;   // Eventos perdidos con la cola de botones llena
+const byte MET_EXT_OVERRUNS = 2; // Flancos que el ISR no pudo encolar
+const byte MET_EXT_STALLS = 3;   // Ediciones que esperaron a la EEPROM (cola llena)
+const byte MET_EXT_MIDI_OVF = 4; // MIDI OUT que esperó al UART (cola llena)
+const byte MET_EXT_BT_LOST = 5;  // Bytes BT perdidos (ring RX lleno o error de trama)
+const byte MET_EXTS = 6;
+
+typedef void (*MetricsSource)(unsigned int* out);
+
+#if METRICS_ENABLED
+
+class Metrics {
+  private:
+    unsigned int _hist[MET_HISTS][MET_BUCKETS];
+    unsigned int _max[MET_HISTS];
+
+    unsigned long _rx[MET_PORTS];
+    unsigned int _cmds[MET_CMDS];
+    unsigned int _overflows; // ERR:BUFF_OVF
+    unsigned int _base[MET_EXTS];
+    MetricsSource _source;
+
+    unsigned long _since;    // millis() del último STATSRESET
+    unsigned long _loopUs;   // micros() al empezar la vuelta anterior
+    unsigned long _edgeMs;   // Flanco más antiguo con MIDI aún en cola
+    bool _edgePending;
+
+    // Escala de cada histograma: cubeta 0 = valores < (1 << shift)
+    static byte shift(byte hist) {
+        return hist == MET_LATENCY_MS ? 0 : 7;
+    }
+
+    static byte bucket(unsigned long v) {
+        byte b = 0;
+        while (v && b < MET_BUCKETS - 1) {
+            v >>= 1;
+            b++;
+        }
+        return b;
+    }
+
+    void readExternal(unsigned int* out) {
+        if (_source) _source(out);
+        else memset(out, 0, MET_EXTS * sizeof(unsigned int));
+    }
+
+  public:
+    Metrics() : _source(nullptr) {
+        reset();
+    }
+
+    void setSource(MetricsSource source) {
+        _source = source;
+        readExternal(_base);
+    }
+
+    // Desde aquí cuentan los períodos de loop() (al final de setup())
+    void begin() {
+        _loopUs = micros();
+    }
+
+    void reset() {
+        memset(_hist, 0, sizeof(_hist));
+        memset(_max, 0, sizeof(_max));
+        memset(_rx, 0, sizeof(_rx));
+        memset(_cmds, 0, sizeof(_cmds));
+        _overflows = 0;
+        readExternal(_base);
+        _since = millis();
+        _edgePending = false;
+    }
+
+    void record(byte hist, unsigned long value) {
+        unsigned int v = value > 0xFFFF ? 0xFFFF : value;
+        if (v > _max[hist]) _max[hist] = v;
+        unsigned int* h = _hist[hist];
+        byte b = bucket(value >> shift(hist));
+        if (h[b] == 0xFFFF) {
+            for (byte i = 0; i < MET_BUCKETS; i++) h[i] >>= 1;
+        }
+        h[b]++;
+    }
+
+    // Al empezar cada loop(): período desde la vuelta anterior
+    void loopStart() {
+        unsigned long now = micros();
+        record(MET_LOOP_US, now - _loopUs);
+        _loopUs = now;
+    }
+
+    // Una acción de este flanco dejó MIDI en la cola. Solo se mide el más
+    // antiguo de cada tanda: la latencia que importa es la peor.
+    void midiQueued(unsigned long edgeMs) {
+        if (_edgePending) return;
+        _edgeMs = edgeMs;
+        _edgePending = true;
+    }
+
+    // La cola MIDI se vació en el UART
+    void midiSent() {
+        if (!_edgePending) return;
+        _edgePending = false;
+        record(MET_LATENCY_MS, millis() - _edgeMs);
+    }
+
+    void countRx(byte port, unsigned int bytes) { _rx[port] += bytes; }
+    void countCommand(byte type) { if (_cmds[type] < 0xFFFF) _cmds[type]++; }
+    void countOverflow() { _overflows++; }
+
+    // Línea 'i' de STATS en 'out' (sin fin de línea); false si no hay más
+    bool renderLine(byte i, char* out, size_t size) {
+        static const char NAMES[MET_HISTS][5] PROGMEM = { "LOOP", "LAT", "EEP" };
+        if (i == 0) {
+            // Segundos desde STATSRESET, para sacar tasas
+            snprintf_P(out, size, PSTR("STATS:BEGIN:%lu"), (millis() - _since) / 1000);
+        } else if (i <= MET_HISTS) {
+            const unsigned int* h = _hist[i - 1];
+            char name[5];
+            strcpy_P(name, NAMES[i - 1]);
+            snprintf_P(out, size, PSTR("STAT:%s:%u:%u:%u:%u:%u:%u:%u:%u"), name,
+                       h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7]);
+        } else if (i == 4) {
+            snprintf_P(out, size, PSTR("STAT:MAX:%u:%u:%u"), _max[0], _max[1], _max[2]);
+        } else if (i == 5) {
+            snprintf_P(out, size, PSTR("STAT:RX:%lu:%lu"), _rx[MET_PORT_USB], _rx[MET_PORT_BT]);
+        } else if (i == 6) {
+            snprintf_P(out, size, PSTR("STAT:CMD:%u:%u:%u:%u:%u:%u"), _cmds[0], _cmds[1], _cmds[2],
+                       _cmds[3], _cmds[4], _cmds[5]);
+        } else if (i == 7) {
+            unsigned int ext[MET_EXTS];
+            readExternal(ext);
+            for (byte e = 0; e < MET_EXTS; e++) ext[e] -= _base[e];
+            // BUFF_OVF, lockout, cola de eventos, ISR, journal, MIDI OUT, RX BT
+            snprintf_P(out, size, PSTR("STAT:DROP:%u:%u:%u:%u:%u:%u:%u"), _overflows,
+                       ext[MET_EXT_LOCKOUTS], ext[MET_EXT_EVENTS], ext[MET_EXT_OVERRUNS],
+                       ext[MET_EXT_STALLS], ext[MET_EXT_MIDI_OVF], ext[MET_EXT_BT_LOST]);
+        } else if (i == 8) {
+            strcpy_P(out, PSTR("STATS:END"));
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // --- Lectura directa (tests y benchmark) ---
+    unsigned int count(byte hist, byte b) const { return _hist[hist][b]; }
+    unsigned int maximum(byte hist) const { return _max[hist]; }
+    unsigned long rx(byte port) const { return _rx[port]; }
+    unsigned int commands(byte type) const { return _cmds[type]; }
+    unsigned int overflows() const { return _overflows; }
+
+    static const bool enabled = true;
+};
+
+#else
+
+// Métricas desactivadas: misma interfaz, sin estado ni código
+class Metrics {
+  public:
+    void setSource(MetricsSource) {}
+    void begin() {}
+    void reset() {}
+    void record(byte, unsigned long) {}
+    void loopStart() {}
+    void midiQueued(unsigned long) {}
+    void midiSent() {}
+    void countRx(byte, unsigned int) {}
+    void countCommand(byte) {}
+    void countOverflow() {}
+    bool renderLine(byte, char*, size_t) { return false; }
+
+    unsigned int count(byte, byte) const { return 0; }
+    unsigned int maximum(byte) const { return 0; }
+    unsigned long rx(byte) const { return 0; }
+    unsigned int commands(byte) const { return 0; }
+    unsigned int overflows() const { return 0; }
+
+    static const bool enabled = false;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,267 @@
+#ifndef MIDICLOCK_H
+#define MIDICLOCK_H
+
+#include <Arduino.h>
+
+// Reloj MIDI (0xF8, 24 por negra) generado desde un ISR de timer, no desde
+// loop(): ni el LCD, ni un GETALL, ni una escritura de EEPROM lo mueven.
+//
+// Timer1 es de BtSerial y Timer2 del escáner de footswitches. Queda la
+// comparación A de Timer0, el timer de millis(): corre libre con prescaler
+// 64 (un tick = 4 us) y su desbordamiento sigue siendo de millis(). Se pasa
+// de Fast PWM a modo normal (mismo período de 256 ticks; los pines 5 y 6 son
+// footswitches, no hay analogWrite) para que OCR0A cambie en el acto y no al
+// desbordar: cada comparación programa la siguiente, a saltos de como mucho
+// 256 ticks, hasta el tick exacto del pulso.
+//
+// Cada plazo se cuenta desde el pulso nominal anterior, con el resto de la
+// división acumulado: el tempo no deriva aunque un pulso salga tarde.
+//
+// El 0xF8 va directo al registro de datos del UART, por delante de lo que
+// espera en el buffer TX del core (MIDI deja meter un mensaje de tiempo real
+// en medio de otro). Si el registro está ocupado se para el ISR de TX del
+// core y se reintenta a los CLOCK_RETRY_TICKS: el pulso sale detrás de los
+// dos bytes que ya están en el UART, como mucho ~640 us tarde a 31250.
+//
+// HardwareSerial::write() con el buffer TX vacío mira UDRE0 fuera de su
+// ATOMIC_BLOCK y escribe UDR0 directamente: un pulso entre las dos cosas
+// llenaría el registro y el byte del core lo pisaría. Por eso todo lo que
+// loop() manda por Serial pasa por clockSafeWrite() (MidiOut y ClockSafePort
+// para las respuestas a la App), que enmascara la comparación A mientras
+// tanto. El pulso que caiga ahí sale al desenmascarar, unos us tarde.
+
+const byte CLOCK_PPQN = 24;
+const byte CLOCK_TICK_US = 4;       // 16 MHz / 64
+const byte CLOCK_RETRY_TICKS = 16;  // UART ocupado: otra vez en 64 us
+const byte CLOCK_MIN_STEP = 8;      // Menos que la latencia de otro ISR perdería la comparación
+const byte CLOCK_TICKS_DIV = CLOCK_PPQN * CLOCK_TICK_US; // us de negra -> ticks de pulso
+
+class MidiClock {
+  private:
+    volatile bool _running;
+    volatile unsigned int _period;  // Ticks enteros por pulso
+    volatile byte _frac;            // Resto por pulso, en 1/CLOCK_TICKS_DIV de tick
+    volatile byte _fracAcc;
+    volatile long _left;            // Ticks hasta el pulso (negativo: va tarde)
+    volatile unsigned int _step;    // Ticks entre la comparación anterior y la siguiente
+    volatile unsigned long _pulses;
+    volatile unsigned int _retries; // Pulsos que esperaron al UART
+    unsigned long _beatUs;
+#if defined(__AVR__)
+    volatile bool _paused;          // UDRIE0 apagado por nosotros
+#else
+    uint64_t _matchUs;              // Instante de la próxima comparación
+#endif
+
+    // Función-estática: la instancia que atiende el ISR
+    static MidiClock*& active() {
+        static MidiClock* clock = nullptr;
+        return clock;
+    }
+
+    // Ticks hasta la comparación ya programada
+    long ticksToMatch() {
+#if defined(__AVR__)
+        byte ticks = OCR0A - TCNT0;
+        return ticks ? ticks : 256;
+#else
+        uint64_t now = sim::nowUs();
+        return _matchUs > now ? (long)((_matchUs - now) / CLOCK_TICK_US) : 0;
+#endif
+    }
+
+    void schedule(unsigned int step) {
+        _step = step;
+#if defined(__AVR__)
+        OCR0A += (byte)step; // 256 = mismo valor: una vuelta entera
+#else
+        _matchUs += (uint64_t)step * CLOCK_TICK_US;
+        sim::at(_matchUs, isrEntry);
+#endif
+    }
+
+    bool sendPulse() {
+#if defined(__AVR__)
+        if (!(UCSR0A & (1 << UDRE0))) {
+            // Que el core no vuelva a llenar UDR0 antes de que entremos
+            if (UCSR0B & (1 << UDRIE0)) {
+                UCSR0B &= ~(1 << UDRIE0);
+                _paused = true;
+            }
+            return false;
+        }
+        UDR0 = 0xF8;
+        if (_paused) {
+            UCSR0B |= (1 << UDRIE0);
+            _paused = false;
+        }
+#else
+        // Host: el UART simulado lo coloca tras el byte que está en el cable
+        sim::MidiEvent ev;
+        ev.queuedUs = sim::nowUs();
+        ev.wireUs = Serial.transmitRealtime(0xF8);
+        ev.status = 0xF8;
+        ev.data1 = ev.data2 = 0;
+        ev.length = 1;
+        sim::midiLog().push_back(ev);
+#endif
+        return true;
+    }
+
+    // Próximo pulso en 'delayTicks' desde ahora (con interrupciones desactivadas)
+    void phase(long delayTicks) {
+        // El ISR resta _step al entrar: solo ticksToMatch() quedan por delante
+        _left = delayTicks - ticksToMatch() + _step;
+    }
+
+    void setPeriod(unsigned long beatUs) {
+        _beatUs = beatUs;
+        _period = beatUs / CLOCK_TICKS_DIV;
+        _frac = beatUs % CLOCK_TICKS_DIV;
+        _fracAcc = 0;
+    }
+
+  public:
+    MidiClock()
+        : _running(false), _period(0), _frac(0), _fracAcc(0), _left(0), _step(256), _pulses(0),
+          _retries(0), _beatUs(0) {
+#if defined(__AVR__)
+        _paused = false;
+#else
+        _matchUs = 0;
+#endif
+    }
+
+    void begin() {
+        active() = this;
+#if defined(__AVR__)
+        noInterrupts();
+        TCCR0A = 0; // Modo normal; prescaler (TCCR0B) y desbordamiento de millis() intactos
+        OCR0A = TCNT0;
+        TIFR0 = (1 << OCF0A);
+        TIMSK0 |= (1 << OCIE0A);
+        interrupts();
+#else
+        _matchUs = sim::nowUs() + 256UL * CLOCK_TICK_US;
+        sim::at(_matchUs, isrEntry);
+#endif
+    }
+
+    static void isrEntry() {
+        if (active()) active()->isr();
+    }
+
+    // Comparación A de Timer0: pulso si toca y siguiente comparación
+    void isr() {
+        if (!_running) {
+            schedule(256);
+            return;
+        }
+        _left -= _step;
+        if (_left <= 0) {
+            if (!sendPulse()) {
+                _retries++;
+                schedule(CLOCK_RETRY_TICKS);
+                return;
+            }
+            _pulses++;
+            _fracAcc += _frac;
+            long period = _period;
+            if (_fracAcc >= CLOCK_TICKS_DIV) {
+                _fracAcc -= CLOCK_TICKS_DIV;
+                period++;
+            }
+            _left += period;
+        }
+        long left = _left;
+        unsigned int step = left > 512 ? 256 : (left > 256 ? left / 2 : (left > 0 ? left : 0));
+        schedule(step < CLOCK_MIN_STEP ? CLOCK_MIN_STEP : step);
+    }
+
+    // Nuevo tempo conservando la fase: vale desde el siguiente pulso. Si
+    // estaba parado, el primer pulso sale ya. 0 = parar.
+    void setTempo(unsigned long beatUs) {
+        if (!beatUs) {
+            stop();
+            return;
+        }
+        noInterrupts();
+        setPeriod(beatUs);
+        if (!_running) phase(0);
+        _running = true;
+        interrupts();
+    }
+
+    // Tempo de un tap: la rejilla de pulsos pasa por la última pisada, que
+    // fue hace 'sinceUs' (el pie marca la negra, no cuando loop() lo vio)
+    void sync(unsigned long beatUs, unsigned long sinceUs) {
+        if (!beatUs) return;
+        unsigned long pulseUs = beatUs / CLOCK_PPQN;
+        noInterrupts();
+        setPeriod(beatUs);
+        phase((long)((pulseUs - sinceUs % pulseUs) / CLOCK_TICK_US));
+        _running = true;
+        interrupts();
+    }
+
+    void stop() {
+        _running = false;
+    }
+
+    bool running() const { return _running; }
+    unsigned long beatUs() const { return _running ? _beatUs : 0; }
+
+    // BPM x10 (0 parado), para el LCD
+    unsigned int bpm10() const {
+        return _running && _beatUs ? (unsigned int)((600000000UL + _beatUs / 2) / _beatUs) : 0;
+    }
+
+    unsigned long pulses() const { return _pulses; }
+    unsigned int retries() const { return _retries; }
+
+    static unsigned long beatFromBpm(byte bpm) {
+        return bpm ? 60000000UL / bpm : 0;
+    }
+};
+
+#if defined(__AVR__)
+ISR(TIMER0_COMPA_vect) {
+    MidiClock::isrEntry();
+}
+#endif
+
+// Un byte a 'port' desde loop() sin carrera con el 0xF8 del ISR. Solo hace
+// falta enmascarar si hay hueco: con el buffer TX lleno el core no toma el
+// atajo de UDR0, y esperar hueco con el ISR enmascarado no acabaría nunca si
+// el reloj dejó parado el ISR de TX.
+inline size_t clockSafeWrite(HardwareSerial& port, byte c) {
+#if defined(__AVR__)
+    if (port.availableForWrite() > 0) {
+        byte mask = TIMSK0;
+        TIMSK0 = mask & ~(1 << OCIE0A);
+        size_t n = port.write(c);
+        TIMSK0 = mask;
+        return n;
+    }
+#endif
+    return port.write(c);
+}
+
+// Serial para SerialCommander: lo mismo, escribiendo con clockSafeWrite()
+class ClockSafePort : public Stream {
+  private:
+    HardwareSerial& _port;
+
+  public:
+    explicit ClockSafePort(HardwareSerial& port) : _port(port) {}
+
+    size_t write(uint8_t c) override { return clockSafeWrite(_port, c); }
+    using Print::write;
+    int availableForWrite() override { return _port.availableForWrite(); }
+    int available() override { return _port.available(); }
+    int read() override { return _port.read(); }
+    int peek() override { return _port.peek(); }
+    void flush() override { _port.flush(); }
+};
+
+#endif
@@ -3,43 +3,78 @@
 
 #include <Arduino.h>
 
+// Diccionario de funciones comunes para Valeton GP-200.
+//
+// Vive en flash (PROGMEM): en el AVR cualquier tabla const normal se copia a
+// SRAM al arrancar. Una sola lista genera los índices, la tabla y la versión
+// constexpr de los CC, así que no pueden desincronizarse. La última columna
+// marca los efectos con estado que guarda una escena (ConfigManager.h): los
+// disparos (afinador, looper, tap) no se recuperan al pisar un preset.
+#define MIDI_DICTIONARY(X) \
+  X(DIST,  "DIST",  49, 1) /* Distortion Module */ \
+  X(AMP,   "AMP",   50, 1) /* Amp Module */ \
+  X(MOD,   "MOD",   54, 1) /* Modulation Module */ \
+  X(DLY,   "DLY",   55, 1) /* Delay Module */ \
+  X(REV,   "REV",   56, 1) /* Reverb Module */ \
+  X(WAH,   "WAH",   57, 1) /* Wah Module */ \
+  X(TUNER, "TUNER", 58, 0) /* Tuner */ \
+  X(LOOP,  "LOOP",  59, 0) /* Looper On/Off */ \
+  X(LREC,  "L.REC", 60, 0) /* Looper Record */ \
+  X(LPLY,  "L.PLY", 62, 0) /* Looper Play/Stop */ \
+  X(CTRL1, "CTRL1", 69, 1) /* CTRL 1 */ \
+  X(CTRL2, "CTRL2", 70, 1) /* CTRL 2 */ \
+  X(CTRL3, "CTRL3", 71, 1) /* CTRL 3 */ \
+  X(TAP,   "TAP",   75, 0) /* Tap Tempo */
+
+const byte DICT_LABEL_SIZE = 6; // 5 letras + null terminator
+
 struct MidiDefinition {
-  const char* label;
+  char label[DICT_LABEL_SIZE];
   byte cc;
 };
 
-// Diccionario de funciones comunes para Valeton GP-200
-const int DICT_SIZE = 14; 
-const MidiDefinition midiDictionary[DICT_SIZE] = {
-  {"DIST",  49}, // Distortion Module
-  {"AMP",   50}, // Amp Module
-  {"MOD",   54}, // Modulation Module
-  {"DLY",   55}, // Delay Module
-  {"REV",   56}, // Reverb Module
-  {"WAH",   57}, // Wah Module
-  {"TUNER", 58}, // Tuner
-  {"LOOP",  59}, // Looper On/Off
-  {"L.REC", 60}, // Looper Record
-  {"L.PLY", 62}, // Looper Play/Stop
-  {"CTRL1", 69}, // CTRL 1
-  {"CTRL2", 70}, // CTRL 2
-  {"CTRL3", 71}, // CTRL 3
-  {"TAP",   75}  // Tap Tempo
-};
+#define DICT_ENUM(id, label, cc, scene) DICT_##id,
+enum DictIndex { MIDI_DICTIONARY(DICT_ENUM) DICT_SIZE };
+#undef DICT_ENUM
+
+#define DICT_ENTRY(id, label, cc, scene) {label, cc},
+const MidiDefinition midiDictionary[DICT_SIZE] PROGMEM = { MIDI_DICTIONARY(DICT_ENTRY) };
+#undef DICT_ENTRY
+
+// CC de un índice constante, resuelto al compilar (p.ej. dictCC(DICT_TAP))
+#define DICT_CC_CASE(id, label, cc, scene) index == DICT_##id ? cc :
+constexpr byte dictCC(int index) {
+  return MIDI_DICTIONARY(DICT_CC_CASE) 0;
+}
+#undef DICT_CC_CASE
 
-// Función helper para obtener CC por índice o nombre (opcional)
-int getCCFromDict(int index) {
+static_assert(dictCC(DICT_TAP) == 75, "Diccionario desordenado");
+
+// Bit i = entrada i del diccionario, en las escenas
+#define DICT_SCENE_BIT(id, label, cc, scene) | (scene ? 1u << DICT_##id : 0u)
+const uint16_t DICT_SCENE_MASK = 0 MIDI_DICTIONARY(DICT_SCENE_BIT);
+#undef DICT_SCENE_BIT
+
+static_assert(DICT_SIZE <= 14, "Una escena ocupa 14 bits (ver SCENE_BITS)");
+
+inline byte dictCCFromFlash(int index) {
   if (index >= 0 && index < DICT_SIZE) {
-    return midiDictionary[index].cc;
+    return pgm_read_byte(&midiDictionary[index].cc);
   }
   return 0;
 }
 
-const char* getNameFromDict(int index) {
+// Con índice constante no toca la flash; con el de un ButtonConfig la lee
+inline __attribute__((always_inline)) int getCCFromDict(int index) {
+  return __builtin_constant_p(index) ? dictCC(index) : dictCCFromFlash(index);
+}
+
+// Etiqueta en flash: para print() y DisplayManager sin copiarla a RAM
+inline const __FlashStringHelper* getNameFromDict(int index) {
   if (index >= 0 && index < DICT_SIZE) {
-    return midiDictionary[index].label;
+    return reinterpret_cast<const __FlashStringHelper*>(midiDictionary[index].label);
   }
-  return "???";
+  return F("???");
 }
 
 #endif
@@ -0,0 +1,141 @@
+#ifndef MIDIINPUT_H
+#define MIDIINPUT_H
+
+#include <Arduino.h>
+#include "BinaryFrame.h"
+
+// MIDI IN y comandos de la App por el mismo Serial.
+//
+// MIDI.read() se come todo lo que llega, texto incluido, así que no se usa:
+// cada byte que lee SerialCommander pasa antes por route(), que decide de
+// quién es sin copiarlo a ningún buffer intermedio:
+//   - Status 0x80..0xEF y sus datos: mensaje MIDI (con running status).
+//   - F0 7D ... F7: trama binaria de configuración (BinaryFrame.h).
+//   - F0 <otro fabricante> ... F7: SysEx ajeno, se descarta.
+//   - F8..FF (Clock, Start...): MIDI realtime, se cuela en cualquier parte.
+//   - Resto: texto ASCII de la App.
+// Un mensaje MIDI puede llegar en medio de una línea de texto: al acabar el
+// mensaje, los bytes de datos vuelven a ser de la línea.
+//
+// Lo único ambiguo es un byte de datos justo después de un mensaje completo:
+// puede ser running status o el principio de un comando. Se toma como MIDI si
+// llega antes de MIDI_RS_TIMEOUT_MS desde el último byte MIDI; cualquier status
+// de sistema (un SysEx, por ejemplo) cancela el running status, como manda la
+// especificación.
+
+const unsigned long MIDI_RS_TIMEOUT_MS = 10;
+
+// Mensaje de canal completo: status (0x80..0xEF) y sus datos
+typedef void (*MidiInHandler)(byte status, byte data1, byte data2);
+
+class MidiInput {
+  public:
+    enum Route {
+        ROUTE_MIDI,        // Consumido por la capa MIDI
+        ROUTE_TEXT,        // Byte de una línea ASCII
+        ROUTE_FRAME_START, // 2º byte de una trama: va F0 (retenido) + este
+        ROUTE_FRAME        // Byte de una trama binaria
+    };
+
+  private:
+    enum SysexState { SX_NONE, SX_START, SX_FOREIGN, SX_FRAME };
+
+    MidiInHandler _handler;
+    byte _running;   // Status para running status (0 = ninguno)
+    byte _pending;   // Status del mensaje a medias (0 = ninguno)
+    byte _need;      // Bytes de datos que faltan
+    byte _data[2];
+    byte _count;
+    byte _sysex;
+    bool _textLine;  // Hay una línea de texto empezada
+    unsigned long _lastMidi;
+    unsigned int _messages;
+
+    static byte dataBytes(byte status) {
+        if (status < 0xF0) return (status & 0xE0) == 0xC0 ? 1 : 2; // PC y Aftertouch: 1
+        if (status == 0xF2) return 2;                              // Song Position
+        if (status == 0xF1 || status == 0xF3) return 1;            // MTC, Song Select
+        return 0;
+    }
+
+    void startMessage(byte status) {
+        _pending = status;
+        _need = dataBytes(status);
+        _count = 0;
+    }
+
+    void dataByte(byte c) {
+        _data[_count++] = c;
+        if (--_need > 0) return;
+        byte status = _pending;
+        _pending = 0;
+        if (status >= 0xF0) return; // Sistema común: nada que hacer con él
+        _messages++;
+        if (_handler) _handler(status, _data[0], _count > 1 ? _data[1] : 0);
+    }
+
+  public:
+    MidiInput()
+        : _handler(nullptr), _running(0), _pending(0), _need(0), _count(0),
+          _sysex(SX_NONE), _textLine(false), _lastMidi(0), _messages(0) {}
+
+    void setHandler(MidiInHandler handler) { _handler = handler; }
+
+    byte route(byte c, unsigned long now) {
+        if (c >= 0xF8) return ROUTE_MIDI; // Realtime: no rompe nada
+
+        if (_sysex == SX_FRAME) {
+            // F7 cierra la trama; otro status la corta (el decodificador la tira)
+            if (c >= 0x80) _sysex = SX_NONE;
+            return ROUTE_FRAME;
+        }
+        if (_sysex == SX_START) {
+            if (c == BF_MANUFACTURER) {
+                _sysex = SX_FRAME;
+                return ROUTE_FRAME_START;
+            }
+            _sysex = SX_FOREIGN;
+        }
+        if (_sysex == SX_FOREIGN) {
+            _lastMidi = now;
+            if (c < 0x80) return ROUTE_MIDI;
+            _sysex = SX_NONE;
+            if (c == 0xF7) return ROUTE_MIDI;
+        }
+
+        if (c >= 0x80) {
+            _lastMidi = now;
+            if (c == 0xF0) {
+                _sysex = SX_START;
+                _running = 0;
+                _pending = 0;
+                return ROUTE_MIDI;
+            }
+            // Sistema común cancela el running status; canal lo fija
+            _running = c < 0xF0 ? c : 0;
+            startMessage(c);
+            if (_need == 0) _pending = 0;
+            return ROUTE_MIDI;
+        }
+
+        if (_pending) {
+            _lastMidi = now;
+            dataByte(c);
+            return ROUTE_MIDI;
+        }
+        if (!_textLine && _running && now - _lastMidi < MIDI_RS_TIMEOUT_MS) {
+            _lastMidi = now;
+            startMessage(_running);
+            dataByte(c);
+            return ROUTE_MIDI;
+        }
+
+        _running = 0;
+        _textLine = c != '\n' && c != '\r';
+        return ROUTE_TEXT;
+    }
+
+    unsigned int messages() const { return _messages; }
+};
+
+#endif
@@ -0,0 +1,242 @@
+#ifndef MIDIOUT_H
+#define MIDIOUT_H
+
+#include <Arduino.h>
+#include "MidiClock.h"
+
+// Salida MIDI con cola y sin mensajes redundantes.
+//
+// Las acciones solo encolan (ring buffer); update(), llamado en loop() justo
+// después de despachar los botones, pasa al UART lo que cabe en su buffer TX
+// sin esperar nunca. Por el camino:
+//   - Bank Select (CC#0) se omite si el canal ya está en ese banco.
+//   - Un CC "con estado" (efecto ON/OFF) se omite si ya tiene ese valor.
+//     Los CC custom se mandan siempre (pueden ser disparos, p.ej. afinador).
+//   - Running status: dentro de una misma tanda se omite el status repetido.
+//     Entre tandas se vuelve a mandar completo, porque por el mismo Serial
+//     también salen las respuestas a la App.
+// El MIDI IN (handleMidiIn) mantiene las cachés al día con noteIncoming().
+
+const byte MIDI_TX_RING = 16;  // Mensajes en cola (potencia de 2)
+const byte MIDI_CC_CACHE = 16; // Controladores recordados (reemplazo circular)
+const byte MIDI_UNKNOWN = 0xFF;
+
+class MidiOut {
+  private:
+    struct Message {
+        byte status;
+        byte data1;
+        byte data2;
+#if !defined(__AVR__)
+        uint64_t queuedUs; // Solo para medir latencias en el host
+#endif
+    };
+    struct CcValue {
+        byte channel; // MIDI_UNKNOWN = libre
+        byte cc;
+        byte value;
+    };
+
+    HardwareSerial& _port;
+    Message _ring[MIDI_TX_RING];
+    byte _head;
+    byte _tail;
+
+    byte _bank[16];                 // Último CC#0 por canal
+    byte _program[16];              // Último Program Change por canal
+    CcValue _cc[MIDI_CC_CACHE];
+    byte _ccNext;
+    bool _inBankFresh;              // El último mensaje entrante fue un CC#0
+
+    unsigned long _sent;
+    unsigned long _suppressed;
+    unsigned long _bytesSaved;
+    unsigned int _overflows;
+
+    static byte length(byte status) {
+        return (status & 0xE0) == 0xC0 ? 2 : 3; // PC y Aftertouch: 1 dato
+    }
+
+    CcValue* findCc(byte channel, byte cc) {
+        for (byte i = 0; i < MIDI_CC_CACHE; i++) {
+            if (_cc[i].channel == channel && _cc[i].cc == cc) return &_cc[i];
+        }
+        return nullptr;
+    }
+
+    void rememberCc(byte channel, byte cc, byte value) {
+        CcValue* slot = findCc(channel, cc);
+        if (!slot) {
+            slot = &_cc[_ccNext];
+            _ccNext = (_ccNext + 1) % MIDI_CC_CACHE;
+            slot->channel = channel;
+            slot->cc = cc;
+        }
+        slot->value = value;
+    }
+
+    // Un preset nuevo cambia los efectos: lo recordado de ese canal ya no vale
+    void forgetChannel(byte channel) {
+        for (byte i = 0; i < MIDI_CC_CACHE; i++) {
+            if (_cc[i].channel == channel) _cc[i].channel = MIDI_UNKNOWN;
+        }
+    }
+
+    void suppress(byte status) {
+        _suppressed++;
+        _bytesSaved += length(status);
+    }
+
+    void enqueue(byte status, byte data1, byte data2) {
+        byte next = (_head + 1) & (MIDI_TX_RING - 1);
+        if (next == _tail) {
+            // Cola llena: mejor esperar al UART que perder un mensaje
+            _overflows++;
+            drain(true);
+        }
+        _ring[_head].status = status;
+        _ring[_head].data1 = data1;
+        _ring[_head].data2 = data2;
+#if !defined(__AVR__)
+        _ring[_head].queuedUs = sim::nowUs();
+#endif
+        _head = next;
+    }
+
+    // Un mensaje entero al UART; sin status si va con running status
+    void writeMessage(const Message& m, bool withStatus) {
+        byte len = length(m.status);
+#if defined(__AVR__)
+        if (withStatus) clockSafeWrite(_port, m.status);
+        clockSafeWrite(_port, m.data1);
+        if (len == 3) clockSafeWrite(_port, m.data2);
+#else
+        // Host: los bytes van al UART simulado y el mensaje al registro MIDI
+        sim::MidiEvent ev;
+        ev.queuedUs = m.queuedUs;
+        ev.status = m.status;
+        ev.data1 = m.data1;
+        ev.data2 = len == 3 ? m.data2 : 0;
+        ev.length = len;
+        if (withStatus) _port.transmit(m.status);
+        ev.wireUs = _port.transmit(m.data1);
+        if (len == 3) ev.wireUs = _port.transmit(m.data2);
+        sim::midiLog().push_back(ev);
+#endif
+    }
+
+    // Pasa mensajes enteros al UART; 'block' espera hueco para al menos uno
+    void drain(bool block) {
+        byte running = 0;
+        while (_tail != _head) {
+            const Message& m = _ring[_tail];
+            byte len = length(m.status);
+            bool withStatus = m.status != running;
+            if (!block && _port.availableForWrite() < (withStatus ? len : len - 1)) return;
+            block = false;
+
+            writeMessage(m, withStatus);
+            if (!withStatus) _bytesSaved++;
+            running = m.status;
+            _sent++;
+            _tail = (_tail + 1) & (MIDI_TX_RING - 1);
+        }
+    }
+
+  public:
+    explicit MidiOut(HardwareSerial& port)
+        : _port(port), _head(0), _tail(0), _ccNext(0), _inBankFresh(false),
+          _sent(0), _suppressed(0), _bytesSaved(0), _overflows(0) {
+        invalidate();
+    }
+
+    // Olvida todo lo enviado (p.ej. la pedalera se reinició)
+    void invalidate() {
+        memset(_bank, MIDI_UNKNOWN, sizeof(_bank));
+        memset(_program, MIDI_UNKNOWN, sizeof(_program));
+        for (byte i = 0; i < MIDI_CC_CACHE; i++) _cc[i].channel = MIDI_UNKNOWN;
+    }
+
+    // CC#0 (omitido si ya está en ese banco) + Program Change
+    void sendPreset(byte bank, byte program, byte channel) {
+        byte ch = (channel - 1) & 0x0F;
+        bank &= 0x7F;
+        if (_bank[ch] == bank) {
+            suppress(0xB0);
+        } else {
+            _bank[ch] = bank;
+            enqueue(0xB0 | ch, 0, bank);
+        }
+        sendProgramChange(program, channel);
+    }
+
+    void sendProgramChange(byte program, byte channel) {
+        byte ch = (channel - 1) & 0x0F;
+        forgetChannel(ch);
+        _program[ch] = program & 0x7F;
+        enqueue(0xC0 | ch, program & 0x7F, 0);
+    }
+
+    // ¿Está el canal ya en ese banco y programa? (escenas: sin PC de más)
+    bool onPreset(byte bank, byte program, byte channel) const {
+        byte ch = (channel - 1) & 0x0F;
+        return _bank[ch] == (bank & 0x7F) && _program[ch] == (program & 0x7F);
+    }
+
+    // CC con estado: no sale si el controlador ya tiene ese valor
+    void sendControlChange(byte cc, byte value, byte channel) {
+        byte ch = (channel - 1) & 0x0F;
+        CcValue* known = findCc(ch, cc & 0x7F);
+        if (known && known->value == (value & 0x7F)) {
+            suppress(0xB0);
+            return;
+        }
+        forceControlChange(cc, value, channel);
+    }
+
+    // CC que sale siempre (disparos): solo actualiza lo recordado
+    void forceControlChange(byte cc, byte value, byte channel) {
+        byte ch = (channel - 1) & 0x0F;
+        cc &= 0x7F;
+        value &= 0x7F;
+        if (cc == 0) _bank[ch] = value;
+        else rememberCc(ch, cc, value);
+        enqueue(0xB0 | ch, cc, value);
+    }
+
+    // Lo que la pedalera cuenta por MIDI IN también es estado conocido
+    void noteIncoming(byte status, byte data1, byte data2) {
+        byte ch = status & 0x0F;
+        byte type = status & 0xF0;
+        bool bankFresh = _inBankFresh;
+        _inBankFresh = false;
+        if (type == 0xB0) {
+            if (data1 == 0) {
+                _bank[ch] = data2;
+                _inBankFresh = true;
+            } else {
+                rememberCc(ch, data1, data2);
+            }
+        } else if (type == 0xC0) {
+            forgetChannel(ch);
+            _program[ch] = data1;
+            // Cambio de preset sin Bank Select delante: banco desconocido
+            if (!bankFresh) _bank[ch] = MIDI_UNKNOWN;
+        }
+    }
+
+    // En cada loop(): manda lo que quepa en el buffer TX sin bloquear
+    void update() {
+        drain(false);
+    }
+
+    bool idle() const { return _head == _tail; }
+    byte pending() const { return (_head - _tail) & (MIDI_TX_RING - 1); }
+
+    unsigned long sent() const { return _sent; }
+    unsigned long suppressed() const { return _suppressed; }
+    unsigned long bytesSaved() const { return _bytesSaved; }
+    unsigned int overflows() const { return _overflows; }
+};
+
+#endif
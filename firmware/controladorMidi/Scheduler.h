@@ -0,0 +1,166 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+// Planificador cooperativo: loop() ya no duerme en ningún sitio. Cada etapa
+// de loop() (comandos, footswitches, LCD, EEPROM) es una tarea que corre en
+// cada vuelta, y lo que antes era un delay() (caducar un mensaje, apagar un
+// LED, el siguiente paso del splash) es una tarea armada con un plazo.
+//
+// Sin memoria dinámica: las tareas se registran en setup() con add() en una
+// tabla fija y después solo se arman (post/every) o desarman (cancel). Las
+// armadas van en un array ordenado por vencimiento (millis()), así run() solo
+// mira la primera para saber si hay algo que hacer.
+//
+// Cada tarea declara su rodaja (us): lo más que puede tardar en una llamada.
+// run() la mide con micros() y cuenta las que se pasan. Con eso el peor
+// loop() queda acotado por la suma de las rodajas de lo que vence a la vez
+// (más los ISR); el build host lo comprueba en cada llamada (sim::sliceOverrun).
+
+typedef void (*TaskFn)(void* ctx);
+
+const byte SCHED_MAX_TASKS = 10;
+const byte SCHED_NONE = 0xFF;
+const unsigned int SCHED_ONCE = 0xFFFF; // Período de una tarea de un solo disparo
+
+class Scheduler {
+  private:
+    struct Task {
+        TaskFn fn;
+        void* ctx;
+        PGM_P name;
+        unsigned long due;   // millis() de vencimiento
+        unsigned int period; // ms entre ejecuciones; 0 = cada run(), SCHED_ONCE = una vez
+        unsigned int sliceUs;
+        unsigned int worstUs;
+    };
+
+    Task _tasks[SCHED_MAX_TASKS];
+    byte _order[SCHED_MAX_TASKS]; // Índices de las armadas, por vencimiento
+    byte _count;                  // Tareas registradas
+    byte _armed;                  // Entradas válidas en _order
+    byte _running;                // Tarea en curso (SCHED_NONE fuera de run())
+    bool _rearm;                  // La tarea en curso se volvió a armar o se canceló
+    unsigned int _overruns;
+
+    // Tras las que vencen a la vez o antes: las de período 0 se turnan
+    void insert(byte task) {
+        unsigned long due = _tasks[task].due;
+        byte i = _armed;
+        while (i > 0 && (long)(_tasks[_order[i - 1]].due - due) > 0) {
+            _order[i] = _order[i - 1];
+            i--;
+        }
+        _order[i] = task;
+        _armed++;
+    }
+
+    bool remove(byte task) {
+        for (byte i = 0; i < _armed; i++) {
+            if (_order[i] != task) continue;
+            _armed--;
+            memmove(&_order[i], &_order[i + 1], _armed - i);
+            return true;
+        }
+        return false;
+    }
+
+    void arm(byte task, unsigned long due, unsigned int period) {
+        if (task >= _count) return;
+        if (task == _running) _rearm = true;
+        remove(task);
+        _tasks[task].due = due;
+        _tasks[task].period = period;
+        insert(task);
+    }
+
+  public:
+    Scheduler() : _count(0), _armed(0), _running(SCHED_NONE), _rearm(false), _overruns(0) {}
+
+    // Registra una tarea (desarmada). SCHED_NONE si la tabla está llena.
+    byte add(TaskFn fn, void* ctx, unsigned int sliceUs, PGM_P name) {
+        if (_count >= SCHED_MAX_TASKS) return SCHED_NONE;
+        Task& t = _tasks[_count];
+        t.fn = fn;
+        t.ctx = ctx;
+        t.name = name;
+        t.due = 0;
+        t.period = SCHED_ONCE;
+        t.sliceUs = sliceUs;
+        t.worstUs = 0;
+        return _count++;
+    }
+
+    // Una vez, dentro de delayMs. Si ya estaba armada, se mueve el plazo.
+    void post(byte task, unsigned long delayMs) {
+        arm(task, millis() + delayMs, SCHED_ONCE);
+    }
+
+    // Cada periodMs desde ahora (0 = en cada run())
+    void every(byte task, unsigned int periodMs) {
+        arm(task, millis() + periodMs, periodMs);
+    }
+
+    void cancel(byte task) {
+        if (task == _running) _rearm = true;
+        remove(task);
+    }
+
+    bool armed(byte task) {
+        for (byte i = 0; i < _armed; i++) {
+            if (_order[i] == task) return true;
+        }
+        return false;
+    }
+
+    // Desde loop(): ejecuta una vez cada tarea vencida al entrar. Las
+    // periódicas se vuelven a armar al final, así ninguna corre dos veces en
+    // la misma vuelta aunque otra se desarme por el camino.
+    void run() {
+        unsigned long now = millis();
+        byte again[SCHED_MAX_TASKS];
+        byte nAgain = 0;
+        byte n = _armed;
+        unsigned long t0 = micros(); // Un micros() por tarea: el fin de una es el inicio de la siguiente
+        while (n-- > 0 && _armed > 0 && (long)(now - _tasks[_order[0]].due) >= 0) {
+            byte id = _order[0];
+            _armed--;
+            memmove(&_order[0], &_order[1], _armed);
+            Task& t = _tasks[id];
+
+            _running = id;
+            _rearm = false;
+            t.fn(t.ctx);
+            unsigned long t1 = micros();
+            unsigned long us = t1 - t0;
+            t0 = t1;
+            _running = SCHED_NONE;
+
+            if (us > t.worstUs) t.worstUs = us > 0xFFFF ? 0xFFFF : us;
+            if (us > t.sliceUs) {
+                _overruns++;
+#if !defined(__AVR__)
+                sim::sliceOverrun(t.name, us, t.sliceUs);
+#endif
+            }
+
+            // Periódica: siguiente vencimiento sin acumular retraso
+            if (!_rearm && t.period != SCHED_ONCE) {
+                t.due += t.period;
+                if ((long)(now - t.due) > 0) t.due = now + t.period;
+                again[nAgain++] = id;
+            }
+        }
+        for (byte i = 0; i < nAgain; i++) insert(again[i]);
+    }
+
+    // --- Lectura directa (tests y benchmark) ---
+    byte count() const { return _count; }
+    PGM_P name(byte task) const { return _tasks[task].name; }
+    unsigned int slice(byte task) const { return _tasks[task].sliceUs; }
+    unsigned int worst(byte task) const { return _tasks[task].worstUs; }
+    unsigned int overruns() const { return _overruns; }
+};
+
+#endif
@@ -4,63 +4,413 @@
 
 #include <Arduino.h>
 #include "ConfigManager.h"
+#include "BinaryFrame.h"
+#include "MidiInput.h"
+#include "MidiDictionary.h"
+#include "Metrics.h"
+#include "ExpressionPedals.h"
 
 // Buffer para entrada serial
 const int SC_BUFFER_SIZE = 40; // Reduced to save RAM
 
+// Volcado GETALL por ventanas, enviado desde loop() a trozos. Cada línea lleva
+// su número ("7|DATA:..."); tras SC_DUMP_WINDOW líneas el pedal se para con
+// MORE:<siguiente>:<total> y la App pide la siguiente ventana, o solo los
+// huecos, con GETALL:<desde>:<cuántas>. La última termina en END:CONFIG:<total>.
+const int SC_DUMP_WINDOW = 8;
+const int SC_DUMP_MIN_BYTES = 2; // Por vuelta si el puerto no informa su hueco TX
+const int SC_LINE_SIZE = 64; // Cabe una línea STAT:... con 8 cubetas de 5 cifras
+
+// Lo que llega con una edición retenida se aparta aquí y no se queda en el
+// buffer RX (64 bytes). La App no manda más de SC_STAGE_SIZE + RX sin esperar
+// su OK:TX_SYNC (ver TXSYNC).
+const int SC_STAGE_SIZE = 48;
+
+// Registros que encola RESET (meta, banco 0, globales y pedales). Cada
+// edición tiene que caber en la cola vacía o esperaría para siempre.
+const byte SC_RESET_RECORDS = REC_META_COUNT + REC_PER_BANK + 3;
+static_assert(SC_RESET_RECORDS <= CFG_PENDING && 1 + REC_PER_MACRO <= CFG_PENDING,
+              "Edición más grande que la cola de la EEPROM");
+
+// Sincronización por diferencias: HASHES devuelve la generación y un CRC-16
+// por banco, global y macro (HASHES:<gen>:<bancos>, HASH:B|G|M:<primero>:<hex>
+// con SC_HASHES_PER_LINE hashes de 4 cifras, HASHES:END:<gen>). La App lo
+// compara con su caché y pide solo lo cambiado: GETBANK:<n> (nombre y slots
+// del banco, numerados como en GETALL, y END:BANK:<n>) o GETALL:<desde>:<n>.
+const int SC_HASHES_PER_LINE = 8;
+
+// CLOCK:BPM lo atiende el sketch (0 = parar)
+typedef void (*ClockHandler)(int bpm);
+
 class SerialCommander {
   private:
     ConfigManager* _config;
     char _inputBuffer[SC_BUFFER_SIZE];
     int _bufferIndex;
+    bool _flushPending; // FLUSH recibido: responder cuando todo sea durable
+    bool _abortPending; // ABORT recibido: responder cuando la RAM se haya recargado
+    int _txCount;       // Ediciones aceptadas dentro de la transacción
+
+    enum DumpState { DUMP_IDLE, DUMP_HEADER, DUMP_ITEMS, DUMP_STATS, DUMP_HASHES, DUMP_BANK };
+    byte _dumpState;
+    int _dumpNext;      // Próximo ítem (o línea de STATS/HASHES/GETBANK) a enviar
+    int _dumpEnd;       // Fin (exclusivo) de la ventana en curso; en GETBANK, el banco
+    bool _dumpBinary;   // Volcado pedido por trama binaria: responde en tramas
+    char _line[SC_LINE_SIZE]; // Línea (o trama) en curso de envío
+    byte _linePos;
+    byte _lineLen;
+
+    FrameDecoder _frame;
+
+    // Edición completa que no cabe en la cola de la EEPROM (o una MACRO que
+    // tendría que leer su macro con la EEPROM ocupada): espera aquí en vez de
+    // parar loop() dentro de getMacro(). Lo que sigue llegando va a _stage.
+    enum HeldState { HELD_NONE, HELD_LINE, HELD_FRAME };
+    byte _held;
+    byte _heldRecords;  // Registros que necesita
+
+    // Bytes de la App leídos mientras no se podían atender, en orden
+    char _stage[SC_STAGE_SIZE];
+    byte _stageLen;
+    byte _stagePos;     // Siguiente a atender
+
+    Metrics* _metrics;  // Opcional: STATS y contadores de este puerto
+    ClockHandler _clock; // Opcional: CLOCK (el reloj MIDI es del sketch)
+    ExpressionPedals* _exp; // Opcional: lecturas para EXPCAL y GETEXP
+    byte _portId;       // MET_PORT_*
 
-    // Moved sendAllConfig to be before processCommand as per snippet,
-    // but keeping processCommand private as it was originally.
-    void sendAllConfig(Stream& port) {
-        port.println(F("BEGIN:CONFIG"));
-        port.print(F("BANK_COUNT:"));
-        port.println(_config->getActiveBanksCount());
-        // 1. Enviar Info de Bancos
-        // Protocolo: BANK:ID:NAME
-        for (int b = 0; b < MAX_BANKS_CFG; b++) {
-            port.print(F("BANK:"));
-            port.print(b); port.print(F(":"));
-            port.println(_config->getBankName(b));
-            delay(5);
+    void count(byte type) {
+        if (_metrics) _metrics->countCommand(type);
+    }
+
+    // Registros que encolará la línea 'cmd' (peor caso; 0 = no edita)
+    static byte lineRecords(const char* cmd) {
+        if (strncmp_P(cmd, PSTR("SAVE"), 4) == 0) return 1;
+        if (strncmp_P(cmd, PSTR("ADDBANK"), 7) == 0) return 1 + REC_PER_BANK;
+        if (strncmp_P(cmd, PSTR("DELBANK"), 7) == 0) return REC_META_COUNT;
+        if (strncmp_P(cmd, PSTR("MACRO"), 5) == 0) return 1 + REC_PER_MACRO;
+        if (strncmp_P(cmd, PSTR("TEMPO"), 5) == 0) return 1;
+        if (strncmp_P(cmd, PSTR("SCENE"), 5) == 0) return 1;
+        if (strncmp_P(cmd, PSTR("EXP"), 3) == 0) return 1; // EXP y EXPCAL (GETEXP empieza por G)
+        if (strncmp_P(cmd, PSTR("RESET"), 5) == 0) return SC_RESET_RECORDS;
+        if (strncmp_P(cmd, PSTR("COMMIT"), 6) == 0) return 1; // Confirmación si todo salió sin commit
+        return 0;
+    }
+
+    static byte frameRecords(byte op) {
+        return op == BF_OP_SAVE || op == BF_OP_SAVEGLO || op == BF_OP_SAVEBANK ? 1 : 0;
+    }
+
+    bool canRun(byte state, byte records) {
+        if (!_config->hasRoom(records)) return false;
+        if (state != HELD_LINE || strncmp_P(_inputBuffer, PSTR("MACRO:"), 6) != 0) return true;
+        return _config->macroReady(atoi(_inputBuffer + 6));
+    }
+
+    // A mitad de una línea del volcado, o con una edición retenida, no se
+    // atiende nada más (no se intercalan respuestas)
+    bool busy() {
+        return _linePos < _lineLen || _held != HELD_NONE;
+    }
+
+    // ¿Tiene que esperar? Si sí, queda retenida hasta que haya sitio.
+    bool hold(byte state, byte records) {
+        if (canRun(state, records)) return false;
+        _held = state;
+        _heldRecords = records;
+        _config->countStall();
+        return true;
+    }
+
+    // Ejecuta la edición retenida si ya cabe
+    bool releaseHeld(Stream& port) {
+        if (_held == HELD_NONE || !canRun(_held, _heldRecords)) return false;
+        byte state = _held;
+        _held = HELD_NONE;
+        if (state == HELD_FRAME) return processFrame(port);
+        bool changed = processCommand(_inputBuffer, port);
+        _bufferIndex = 0;
+        memset(_inputBuffer, 0, SC_BUFFER_SIZE);
+        return changed;
+    }
+
+    // Ítems del volcado: BANK_COUNT, nombres de bancos activos, 2 globales,
+    // 3 slots por banco activo y los pasos de las macros
+    int dumpTotal() {
+        return 3 + 4 * _config->getActiveBanksCount() + MACRO_COUNT * MACRO_STEPS;
+    }
+
+    // Formatea el ítem 'seq' como "seq|LINEA\r\n" en _line
+    void renderItem(int seq) {
+        int banks = _config->getActiveBanksCount();
+        int n = snprintf_P(_line, SC_LINE_SIZE, PSTR("%d|"), seq);
+        char* out = _line + n;
+        size_t room = SC_LINE_SIZE - n - 2;
+
+        if (seq == 0) {
+            snprintf_P(out, room, PSTR("BANK_COUNT:%d"), banks);
+        } else if (seq <= banks) {
+            // Protocolo: BANK:ID:NAME:BPM (BPM 0 = sin tempo propio)
+            snprintf_P(out, room, PSTR("BANK:%d:%s:%d"), seq - 1, _config->getBankName(seq - 1),
+                       _config->getBankTempo(seq - 1));
+        } else if (seq <= banks + 2) {
+            // Protocolo: DATAGLO:ID:NAME:TYPE:V1:V2
+            int i = seq - banks - 1;
+            ButtonConfig* btn = _config->getGlobalConfig(i);
+            snprintf_P(out, room, PSTR("DATAGLO:%d:%s:%c:%d:%d"), i, btn->name, btn->type,
+                     btn->value1, btn->value2);
+        } else if (seq < 3 + 4 * banks) {
+            // Protocolo: DATA:B:P:NAME:TYPE:V1:V2:LPT:LPV1:LPV2:MODE:SCENE (- = sin escena)
+            int b = (seq - banks - 3) / NUM_PRESETS_CFG;
+            int p = (seq - banks - 3) % NUM_PRESETS_CFG;
+            ButtonConfig* btn = _config->getButtonConfig(b, p);
+            int n = snprintf_P(out, room, PSTR("DATA:%d:%d:%s:%c:%d:%d:%c:%d:%d:%c:"), b, p, btn->name, btn->type,
+                     btn->value1, btn->value2, btn->lpType, btn->lpValue1, btn->lpValue2,
+                     btn->pressMode);
+            uint16_t scene = _config->getScene(b, p);
+            if (scene == SCENE_NONE) strncpy_P(out + n, PSTR("-"), room - n);
+            else snprintf_P(out + n, room - n, PSTR("%u"), (unsigned int)scene);
+        } else {
+            // Protocolo: MACRO:M:S:TYPE:V1:V2:MS
+            int m = (seq - 3 - 4 * banks) / MACRO_STEPS;
+            int i = (seq - 3 - 4 * banks) % MACRO_STEPS;
+            const MacroStep& st = _config->getMacro(m)[i];
+            snprintf_P(out, room, PSTR("MACRO:%d:%d:%c:%d:%d:%u"), m, i, st.type, st.value1, st.value2,
+                       (unsigned int)st.delay * MACRO_TICK_MS);
         }
+        strcat_P(_line, PSTR("\r\n"));
+    }
+
+    // Mismo ítem como trama binaria; devuelve su longitud
+    byte renderBinaryItem(int seq) {
+        int banks = _config->getActiveBanksCount();
+        byte rec[BF_MAX_PAYLOAD];
+        rec[0] = seq & 0xFF;
+        rec[1] = seq >> 8;
+        byte op, len;
 
-        // 2b. Enviar Datos Globales
-        // Protocolo: DATAGLO:ID:NAME:TYPE:V1:V2
-        for(int i=0; i<2; i++) {
-             ButtonConfig* btn = _config->getGlobalConfig(i);
-                port.print(F("DATAGLO:"));
-                port.print(i); port.print(F(":"));
-                port.print(btn->name); port.print(F(":"));
-                port.print(btn->type); port.print(F(":"));
-                port.print(btn->value1); port.print(F(":"));
-                port.println(btn->value2);
-                delay(5);
+        if (seq == 0) {
+            op = BF_OP_BANK_COUNT;
+            rec[2] = banks;
+            len = 3;
+        } else if (seq <= banks) {
+            op = BF_OP_BANK;
+            rec[2] = seq - 1;
+            rec[3] = _config->getBankTempo(seq - 1);
+            const char* name = _config->getBankName(seq - 1);
+            len = 4 + strlen(name);
+            memcpy(rec + 4, name, len - 4);
+        } else if (seq <= banks + 2) {
+            op = BF_OP_GLOBAL;
+            rec[2] = seq - banks - 1;
+            memcpy(rec + 3, _config->getGlobalConfig(rec[2]), sizeof(ButtonConfig));
+            len = 3 + sizeof(ButtonConfig);
+        } else if (seq < 3 + 4 * banks) {
+            op = BF_OP_DATA;
+            rec[2] = (seq - banks - 3) / NUM_PRESETS_CFG;
+            rec[3] = (seq - banks - 3) % NUM_PRESETS_CFG;
+            memcpy(rec + 4, _config->getButtonConfig(rec[2], rec[3]), sizeof(ButtonConfig));
+            uint16_t scene = _config->getScene(rec[2], rec[3]);
+            rec[4 + sizeof(ButtonConfig)] = scene & 0xFF;
+            rec[5 + sizeof(ButtonConfig)] = scene >> 8;
+            len = 6 + sizeof(ButtonConfig);
+        } else {
+            op = BF_OP_MACRO;
+            rec[2] = (seq - 3 - 4 * banks) / MACRO_STEPS;
+            rec[3] = (seq - 3 - 4 * banks) % MACRO_STEPS;
+            memcpy(rec + 4, &_config->getMacro(rec[2])[rec[3]], sizeof(MacroStep));
+            len = 4 + sizeof(MacroStep);
         }
+        return encodeFrame(op, rec, len, (byte*)_line);
+    }
 
-        // 2. Enviar Datos de Botones
-        // Protocolo: DATA:B:P:NAME:TYPE:V1:V2
-        for (int b = 0; b < _config->getActiveBanksCount(); b++) { // Use active
-            for (int p = 0; p < NUM_PRESETS_CFG; p++) {
-                ButtonConfig* btn = _config->getButtonConfig(b, p);
-                port.print(F("DATA:"));
-                port.print(b); port.print(F(":"));
-                port.print(p); port.print(F(":"));
-                port.print(btn->name); port.print(F(":"));
-                port.print(btn->type); port.print(F(":"));
-                port.print(btn->value1); port.print(F(":"));
-                port.print(btn->value2); port.print(F(":"));
-                port.print(btn->lpType); port.print(F(":"));
-                port.print(btn->lpValue1); port.print(F(":"));
-                port.print(btn->lpValue2); port.println();
-                delay(10); // Aumentado para dar respiro a la App
+    // Línea 'i' de HASHES en _line; false si es la última. Cada línea de
+    // bancos lee de EEPROM los que no están en RAM (~110 bytes cada uno).
+    bool renderHashes(int i) {
+        int banks = _config->getActiveBanksCount();
+        int bankLines = (banks + SC_HASHES_PER_LINE - 1) / SC_HASHES_PER_LINE;
+        int n = 0;
+        if (i == 0) {
+            n = snprintf_P(_line, SC_LINE_SIZE, PSTR("HASHES:%u:%d"), _config->generation(), banks);
+        } else if (i <= bankLines + 2) {
+            char kind = i <= bankLines ? 'B' : (i == bankLines + 1 ? 'G' : 'M');
+            int first = kind == 'B' ? (i - 1) * SC_HASHES_PER_LINE : 0;
+            int last = kind == 'B' ? first + SC_HASHES_PER_LINE : (kind == 'G' ? 2 : MACRO_COUNT);
+            if (kind == 'B' && last > banks) last = banks;
+            n = snprintf_P(_line, SC_LINE_SIZE, PSTR("HASH:%c:%d:"), kind, first);
+            for (int k = first; k < last; k++) {
+                uint16_t h = kind == 'B' ? _config->bankHash(k) : (kind == 'G' ? _config->globalHash(k) : _config->macroHash(k));
+                n += snprintf_P(_line + n, SC_LINE_SIZE - n, PSTR("%04X"), (unsigned int)h);
             }
+        } else {
+            n = snprintf_P(_line, SC_LINE_SIZE, PSTR("HASHES:END:%u"), _config->generation());
         }
-        port.println(F("END:CONFIG"));
+        strcpy_P(_line + n, PSTR("\r\n"));
+        return i <= bankLines + 2;
+    }
+
+    // GETALL[:DESDE[:CUANTOS]]: arranca una ventana del volcado
+    void startDump(int from, int count, bool binary) {
+        int total = dumpTotal();
+        if (from < 0) from = 0;
+        if (count < 1 || count > SC_DUMP_WINDOW) count = SC_DUMP_WINDOW;
+        _dumpNext = from < total ? from : total;
+        _dumpEnd = from + count < total ? from + count : total;
+        // BEGIN:CONFIG solo en texto: en binario cada trama dice lo que es
+        _dumpState = from == 0 && !binary ? DUMP_HEADER : DUMP_ITEMS;
+        _dumpBinary = binary;
+        _linePos = _lineLen = 0;
+    }
+
+    // Prepara la siguiente línea del volcado; false si no queda nada
+    bool nextDumpLine() {
+        _linePos = _lineLen = 0;
+        if (_dumpState == DUMP_IDLE) return false;
+
+        if (_dumpState == DUMP_STATS) {
+            if (!_metrics->renderLine(_dumpNext++, _line, SC_LINE_SIZE - 2)) {
+                _dumpState = DUMP_IDLE;
+                return false;
+            }
+            strcat_P(_line, PSTR("\r\n"));
+        } else if (_dumpState == DUMP_HASHES) {
+            // Libre ya con la última línea, como al cerrar una ventana de GETALL
+            if (!renderHashes(_dumpNext++)) _dumpState = DUMP_IDLE;
+        } else if (_dumpState == DUMP_BANK) {
+            // Mismos números que en GETALL: nombre y luego sus NUM_PRESETS_CFG slots
+            int b = _dumpEnd;
+            int k = _dumpNext++;
+            if (k == 0) {
+                renderItem(b + 1);
+            } else if (k <= NUM_PRESETS_CFG) {
+                renderItem(_config->getActiveBanksCount() + 3 + NUM_PRESETS_CFG * b + k - 1);
+            } else {
+                snprintf_P(_line, SC_LINE_SIZE, PSTR("END:BANK:%d\r\n"), b);
+                _dumpState = DUMP_IDLE;
+            }
+        } else if (_dumpState == DUMP_HEADER) {
+            strcpy_P(_line, PSTR("BEGIN:CONFIG\r\n"));
+            _dumpState = DUMP_ITEMS;
+        } else if (_dumpNext < _dumpEnd) {
+            if (_dumpBinary) {
+                _lineLen = renderBinaryItem(_dumpNext++);
+                return true;
+            }
+            renderItem(_dumpNext++);
+        } else {
+            // Cierre de ventana: dónde seguir y cuántos ítems hay en total
+            int total = dumpTotal();
+            _dumpState = DUMP_IDLE;
+            if (_dumpBinary) {
+                byte tail[4] = { (byte)(_dumpEnd & 0xFF), (byte)(_dumpEnd >> 8),
+                                 (byte)(total & 0xFF), (byte)(total >> 8) };
+                if (_dumpEnd < total) _lineLen = encodeFrame(BF_OP_MORE, tail, 4, (byte*)_line);
+                else _lineLen = encodeFrame(BF_OP_END, tail + 2, 2, (byte*)_line);
+                return true;
+            }
+            if (_dumpEnd < total) snprintf_P(_line, SC_LINE_SIZE, PSTR("MORE:%d:%d\r\n"), _dumpEnd, total);
+            else snprintf_P(_line, SC_LINE_SIZE, PSTR("END:CONFIG:%d\r\n"), total);
+        }
+        _lineLen = strlen(_line);
+        return true;
+    }
+
+    // Envía un trozo del volcado sin esperar por el puerto: lo que quepa en el
+    // buffer TX (UART, ring de BtSerial) o unos pocos bytes si el puerto no
+    // lo informa.
+    void pumpDump(Stream& port) {
+        int budget = port.availableForWrite();
+        if (budget < SC_DUMP_MIN_BYTES) budget = SC_DUMP_MIN_BYTES;
+        while (budget-- > 0) {
+            // Las líneas de HASHES leen EEPROM: no esperar a una escritura en curso
+            if (_linePos >= _lineLen && _dumpState == DUMP_HASHES && !eeprom_is_ready()) return;
+            if (_linePos >= _lineLen && !nextDumpLine()) return;
+            port.write((uint8_t)_line[_linePos++]);
+        }
+    }
+
+    // Edición ya aplicada en RAM. Fuera de transacción se guarda y se confirma;
+    // dentro, se acumula en silencio hasta el COMMIT: el emisor no espera por
+    // línea y no hace falta intercalar respuestas con lo que sigue llegando.
+    bool applied(Stream& port, const __FlashStringHelper* ok) {
+        if (_config->inTransaction()) {
+            _txCount++;
+            return false;
+        }
+        _config->save();
+        port.println(ok);
+        return true;
+    }
+
+    void sendAck(Stream& port, byte op, byte status) {
+        byte ack[2] = { op, status };
+        byte frame[BF_FRAME_MAX];
+        port.write(frame, encodeFrame(BF_OP_ACK, ack, 2, frame));
+    }
+
+    // Como applied(), pero con ACK binario
+    bool appliedBinary(Stream& port, byte op) {
+        if (_config->inTransaction()) {
+            _txCount++;
+            return false;
+        }
+        _config->save();
+        sendAck(port, op, BF_STATUS_OK);
+        return true;
+    }
+
+    // Trama binaria ya validada (CRC y longitud). Mismo efecto que su línea ASCII.
+    bool processFrame(Stream& port) {
+        byte op = _frame.op();
+        byte len = _frame.length();
+        const byte* in = _frame.payload();
+        const byte CFG = sizeof(ButtonConfig);
+        count(MET_CMD_FRAME);
+
+        if (op == BF_OP_GETALL && len == 3) {
+            startDump(in[0] | (in[1] << 8), in[2], true);
+            return false;
+
+        } else if (op == BF_OP_SAVE && len == 2 + CFG) {
+            ButtonConfig* btn = _config->getButtonConfig(in[0], in[1]);
+            if (btn) {
+                // El registro llega tal cual: se copia y se sanea
+                memcpy(btn, in + 2, CFG);
+                btn->name[4] = 0;
+                if (btn->pressMode != 'I' && btn->pressMode != 'S') btn->pressMode = 'R';
+                _config->markButtonDirty(in[0], in[1]);
+                return appliedBinary(port, op);
+            }
+
+        } else if (op == BF_OP_SAVEGLO && len == 1 + CFG) {
+            ButtonConfig* btn = _config->getGlobalConfig(in[0]);
+            if (btn) {
+                // Como SAVEGLO: nombre, tipo y valores; el resto no se toca
+                const ButtonConfig* src = (const ButtonConfig*)(in + 1);
+                memcpy(btn->name, src->name, 4);
+                btn->name[4] = 0;
+                btn->type = src->type;
+                btn->value1 = src->value1;
+                btn->value2 = src->value2;
+                _config->markGlobalDirty(in[0]);
+                return appliedBinary(port, op);
+            }
+
+        } else if (op == BF_OP_SAVEBANK && len >= 2 && len <= 9) {
+            if (in[0] < _config->getActiveBanksCount()) {
+                char name[9];
+                memcpy(name, in + 1, len - 1);
+                name[len - 1] = 0;
+                _config->setBankName(in[0], name);
+                return appliedBinary(port, op);
+            }
+
+        } else {
+            sendAck(port, op, BF_STATUS_BAD_FRAME);
+            return false;
+        }
+        sendAck(port, op, BF_STATUS_FAIL);
+        return false;
     }
 
     bool processCommand(char* cmd, Stream& port) {
@@ -68,15 +418,42 @@ class SerialCommander {
         char* token = strtok(cmd, ":");
         if (!token) return false;
 
-        if (strcmp(token, "HELLO") == 0) {
-            port.println(F("READY:GP200_CONTROLLER_V3")); // Version bumped
+        if (strcmp_P(token, PSTR("HELLO")) == 0) {
+            count(MET_CMD_READ);
+            // HELLO:BIN -> la App puede usar tramas binarias (BinaryFrame.h)
+            char* sProto = strtok(NULL, ":");
+            port.print(F("READY:GP200_CONTROLLER_V3")); // Version bumped
+            if (sProto && strcmp_P(sProto, PSTR("BIN")) == 0) port.print(F(":BIN"));
+            port.println();
             return false;
             
-        } else if (strcmp(token, "GETALL") == 0) {
-            sendAllConfig(port);
+        } else if (strcmp_P(token, PSTR("GETALL")) == 0) {
+            count(MET_CMD_READ);
+            char* sFrom = strtok(NULL, ":");
+            char* sCount = strtok(NULL, ":");
+            startDump(sFrom ? atoi(sFrom) : 0, sCount ? atoi(sCount) : SC_DUMP_WINDOW, false);
+            return false;
+
+        } else if (strcmp_P(token, PSTR("HASHES")) == 0 || strcmp_P(token, PSTR("GETBANK")) == 0) {
+            count(MET_CMD_READ);
+            bool hashes = token[0] == 'H';
+            // GETBANK:N
+            char* sBank = hashes ? nullptr : strtok(NULL, ":");
+            int b = sBank ? atoi(sBank) : -1;
+            if (_dumpState != DUMP_IDLE) {
+                port.println(F("ERR:BUSY"));
+            } else if (!hashes && (b < 0 || b >= _config->getActiveBanksCount())) {
+                port.println(F("ERR:GETBANK_FAIL"));
+            } else {
+                _dumpState = hashes ? DUMP_HASHES : DUMP_BANK;
+                _dumpNext = 0;
+                _dumpEnd = b;
+                _dumpBinary = false;
+            }
             return false;
         
-        } else if (strcmp(token, "ADDBANK") == 0) {
+        } else if (strcmp_P(token, PSTR("ADDBANK")) == 0) {
+             count(MET_CMD_BANK);
              if (_config->addBank()) {
                  port.println(F("OK:BANK_ADDED"));
              } else {
@@ -84,7 +461,8 @@ class SerialCommander {
              }
              return true; 
              
-        } else if (strcmp(token, "DELBANK") == 0) {
+        } else if (strcmp_P(token, PSTR("DELBANK")) == 0) {
+             count(MET_CMD_BANK);
              char* sId = strtok(NULL, ":");
              bool success = false;
              
@@ -104,8 +482,9 @@ class SerialCommander {
              }
              return true;
             
-        } else if (strcmp(token, "SAVE") == 0) {
-            // SAVE:B:P:NAME:TYPE:V1:V2:LPT:LPV1:LPV2
+        } else if (strcmp_P(token, PSTR("SAVE")) == 0) {
+            count(MET_CMD_EDIT);
+            // SAVE:B:P:NAME:TYPE:V1:V2:LPT:LPV1:LPV2:MODE
             char* sBank   = strtok(NULL, ":");
             char* sPreset = strtok(NULL, ":");
             char* sName   = strtok(NULL, ":");
@@ -116,6 +495,7 @@ class SerialCommander {
             char* sLpType = strtok(NULL, ":");
             char* sLpV1   = strtok(NULL, ":");
             char* sLpV2   = strtok(NULL, ":");
+            char* sMode   = strtok(NULL, ":");
             
             if (sBank && sPreset && sName && sType && sVal1 && sVal2) {
                 int b = atoi(sBank);
@@ -144,14 +524,18 @@ class SerialCommander {
                         btn->lpValue2 = 0;
                     }
                     
-                    _config->save();
-                    port.println(F("OK:SAVED"));
-                    return true; 
+                    // Modo de disparo (opcional, por defecto al soltar)
+                    char m = sMode ? sMode[0] : 'R';
+                    btn->pressMode = (m == 'I' || m == 'S') ? m : 'R';
+                    
+                    _config->markButtonDirty(b, p);
+                    return applied(port, F("OK:SAVED"));
                 } 
             }
             port.println(F("ERR:SAVE_FAIL"));
 
-        } else if (strcmp(token, "SAVEGLO") == 0) {
+        } else if (strcmp_P(token, PSTR("SAVEGLO")) == 0) {
+            count(MET_CMD_EDIT);
             // SAVEGLO:ID:NAME:TYPE:V1:V2
             char* sID     = strtok(NULL, ":");
             char* sName   = strtok(NULL, ":");
@@ -173,14 +557,14 @@ class SerialCommander {
                     btn->value1 = v1;
                     btn->value2 = v2;
                     
-                    _config->save();
-                    port.println(F("OK:SAVED_GLO"));
-                    return true; 
+                    _config->markGlobalDirty(id);
+                    return applied(port, F("OK:SAVED_GLO"));
                 } 
             }
             port.println(F("ERR:SAVE_GLO_FAIL"));
 
-        } else if (strcmp(token, "SAVEBANK") == 0) {
+        } else if (strcmp_P(token, PSTR("SAVEBANK")) == 0) {
+             count(MET_CMD_EDIT);
              // SAVEBANK:B:NAME
              char* sBank = strtok(NULL, ":");
              char* sName = strtok(NULL, ":");
@@ -188,59 +572,353 @@ class SerialCommander {
              if (sBank && sName) {
                  int b = atoi(sBank);
                  _config->setBankName(b, sName);
-                 _config->save();
-                 port.println(F("OK:BANK_RENAMED"));
-                 return true; // Refrescar UI (título banco)
+                 return applied(port, F("OK:BANK_RENAMED")); // Refrescar UI (título banco)
+             }
+        } else if (strcmp_P(token, PSTR("MACRO")) == 0) {
+             count(MET_CMD_EDIT);
+             // MACRO:M:S:TYPE:V1:V2:MS (MS = retardo desde el paso anterior)
+             char* sMacro = strtok(NULL, ":");
+             char* sStep  = strtok(NULL, ":");
+             char* sType  = strtok(NULL, ":");
+             char* sVal1  = strtok(NULL, ":");
+             char* sVal2  = strtok(NULL, ":");
+             char* sMs    = strtok(NULL, ":");
+
+             if (sMacro && sStep && sType && sVal1 && sVal2 && sMs) {
+                 int m = atoi(sMacro);
+                 int i = atoi(sStep);
+                 char t = sType[0];
+                 MacroStep* steps = _config->getMacro(m);
+                 if (steps && i >= 0 && i < MACRO_STEPS && strchr_P(PSTR("PCDN"), t)) {
+                     // Resolución de MACRO_TICK_MS, redondeando al más cercano
+                     long ticks = (atol(sMs) + MACRO_TICK_MS / 2) / MACRO_TICK_MS;
+                     steps[i].type = t;
+                     steps[i].value1 = atoi(sVal1) & 0x7F;
+                     steps[i].value2 = atoi(sVal2) & 0x7F;
+                     steps[i].delay = ticks < 0 ? 0 : (ticks > 255 ? 255 : ticks);
+                     _config->markMacroDirty(m, i);
+                     return applied(port, F("OK:MACRO_SAVED"));
+                 }
+             }
+             port.println(F("ERR:MACRO_FAIL"));
+
+        } else if (strcmp_P(token, PSTR("TEMPO")) == 0) {
+             count(MET_CMD_EDIT);
+             // TEMPO:B:BPM (0 = el banco no cambia el reloj)
+             char* sBank = strtok(NULL, ":");
+             char* sBpm  = strtok(NULL, ":");
+
+             if (sBank && sBpm) {
+                 int b = atoi(sBank);
+                 int bpm = atoi(sBpm);
+                 bool valid = bpm == 0 || (bpm >= TEMPO_MIN_BPM && bpm <= TEMPO_MAX_BPM);
+                 if (valid && b >= 0 && b < _config->getActiveBanksCount()) {
+                     _config->setBankTempo(b, bpm);
+                     return applied(port, F("OK:TEMPO_SAVED"));
+                 }
              }
-        } else if (strcmp(token, "RESET") == 0) {
+             port.println(F("ERR:TEMPO_FAIL"));
+
+        } else if (strcmp_P(token, PSTR("SCENE")) == 0) {
+             count(MET_CMD_EDIT);
+             // SCENE:B:P:MASK (bit i = efecto i del diccionario encendido; - = quitarla)
+             char* sBank   = strtok(NULL, ":");
+             char* sPreset = strtok(NULL, ":");
+             char* sMask   = strtok(NULL, ":");
+
+             if (sBank && sPreset && sMask) {
+                 int b = atoi(sBank);
+                 int p = atoi(sPreset);
+                 if (b >= 0 && b < _config->getActiveBanksCount() && p >= 0 && p < NUM_PRESETS_CFG) {
+                     // Los efectos sin estado (DICT_SCENE_MASK) no entran en la escena
+                     uint16_t scene = sMask[0] == '-' ? SCENE_NONE : (uint16_t)atol(sMask) & DICT_SCENE_MASK;
+                     _config->setScene(b, p, scene);
+                     return applied(port, F("OK:SCENE_SAVED"));
+                 }
+             }
+             port.println(F("ERR:SCENE_FAIL"));
+
+        } else if (strcmp_P(token, PSTR("EXP")) == 0) {
+             count(MET_CMD_EDIT);
+             // EXP:N:CC:CURVA (CC 0 = entrada apagada; curva L, G, E o S)
+             char* sInput = strtok(NULL, ":");
+             char* sCc    = strtok(NULL, ":");
+             char* sCurve = strtok(NULL, ":");
+
+             if (sInput && sCc && sCurve) {
+                 int n = atoi(sInput);
+                 int cc = atoi(sCc);
+                 bool curve = sCurve[0] && cfgCode(EXP_CURVES, sCurve[0], 0xFF) != 0xFF;
+                 if (n >= 0 && n < EXP_INPUTS && cc >= 0 && cc <= 127 && curve) {
+                     _config->expConfigs[n].cc = cc;
+                     _config->expConfigs[n].curve = sCurve[0];
+                     _config->markExpDirty();
+                     return applied(port, F("OK:EXP_SAVED"));
+                 }
+             }
+             port.println(F("ERR:EXP_FAIL"));
+
+        } else if (strcmp_P(token, PSTR("EXPCAL")) == 0) {
+             count(MET_CMD_EDIT);
+             // EXPCAL:N:HEEL|TOE: la lectura de ahora es el talón o la punta
+             char* sInput = strtok(NULL, ":");
+             char* sEnd   = strtok(NULL, ":");
+
+             if (_exp && _exp->ready() && sInput && sEnd) {
+                 int n = atoi(sInput);
+                 bool heel = strcmp_P(sEnd, PSTR("HEEL")) == 0;
+                 if (n >= 0 && n < EXP_INPUTS && (heel || strcmp_P(sEnd, PSTR("TOE")) == 0)) {
+                     if (heel) _config->expConfigs[n].heel = _exp->raw(n);
+                     else _config->expConfigs[n].toe = _exp->raw(n);
+                     _config->markExpDirty();
+                     return applied(port, F("OK:EXP_CALIBRATED"));
+                 }
+             }
+             port.println(F("ERR:EXP_FAIL"));
+
+        } else if (strcmp_P(token, PSTR("GETEXP")) == 0) {
+             count(MET_CMD_OTHER);
+             // EXP:N:CC:CURVA:TALÓN:PUNTA:LECTURA:VALOR por entrada (VALOR -1 = sin lectura)
+             char line[SC_BUFFER_SIZE];
+             for (byte n = 0; n < EXP_INPUTS; n++) {
+                 const ExpConfig& e = _config->expConfigs[n];
+                 snprintf_P(line, sizeof(line), PSTR("EXP:%d:%d:%c:%u:%u:%u:%d"), n, e.cc, e.curve,
+                            e.heel, e.toe, _exp ? _exp->raw(n) : 0, _exp ? _exp->value(n) : -1);
+                 port.println(line);
+             }
+             port.println(F("END:EXP"));
+             return false;
+
+        } else if (strcmp_P(token, PSTR("CLOCK")) == 0) {
+             count(MET_CMD_OTHER);
+             // CLOCK:BPM: tempo del reloj MIDI ya, sin guardarlo (0 = parar)
+             char* sBpm = strtok(NULL, ":");
+             int bpm = sBpm ? atoi(sBpm) : -1;
+             if (_clock && (bpm == 0 || (bpm >= TEMPO_MIN_BPM && bpm <= TEMPO_MAX_BPM))) {
+                 _clock(bpm);
+                 port.println(F("OK:CLOCK"));
+             } else {
+                 port.println(_clock ? F("ERR:CLOCK_FAIL") : F("ERR:NO_CLOCK"));
+             }
+             return false;
+
+        } else if (strcmp_P(token, PSTR("BEGINTX")) == 0) {
+             count(MET_CMD_TX);
+             // Subida en lote: SAVE/SAVEGLO/SAVEBANK sin respuesta hasta el COMMIT
+             if (_config->beginTransaction()) {
+                 _txCount = 0;
+                 port.println(F("OK:TX_BEGIN"));
+             } else {
+                 port.println(F("ERR:TX_ACTIVE"));
+             }
+             return false;
+
+        } else if (strcmp_P(token, PSTR("COMMIT")) == 0) {
+             count(MET_CMD_TX);
+             // Todo lo acumulado va a un único lote del journal
+             if (_config->commitTransaction()) {
+                 port.print(F("OK:TX_COMMIT:"));
+                 port.println(_txCount);
+                 return true;
+             }
+             port.println(F("ERR:NO_TX"));
+
+        } else if (strcmp_P(token, PSTR("TXSYNC")) == 0) {
+             count(MET_CMD_TX);
+             // Control de flujo de la subida: llega tras todo lo anterior ya
+             // aplicado (en la cola o en el journal), con las ediciones contadas
+             if (_config->inTransaction()) {
+                 port.print(F("OK:TX_SYNC:"));
+                 port.println(_txCount);
+             } else {
+                 port.println(F("ERR:NO_TX"));
+             }
+             return false;
+
+        } else if (strcmp_P(token, PSTR("ABORT")) == 0) {
+             count(MET_CMD_TX);
+             // La RAM se recarga de EEPROM en segundo plano; OK:TX_ABORTED al terminar
+             if (_config->abortTransaction()) {
+                 _abortPending = true;
+             } else {
+                 port.println(F("ERR:NO_TX"));
+             }
+             return false;
+
+        } else if (strcmp_P(token, PSTR("FLUSH")) == 0) {
+             count(MET_CMD_TX);
+             // Los SAVE responden en cuanto la RAM está al día; la EEPROM se
+             // escribe de fondo. OK:FLUSHED llega cuando ya es durable.
+             _flushPending = true;
+             return false;
+
+        } else if (strcmp_P(token, PSTR("RESET")) == 0) {
+             count(MET_CMD_BANK);
              _config->resetToDefaults();
              _config->save();
              port.println(F("OK:RESET_DONE"));
              return true;  
+
+        } else if (strcmp_P(token, PSTR("STATS")) == 0) {
+             count(MET_CMD_OTHER);
+             // Varias líneas: salen desde loop() como el volcado, sin bloquear
+             if (!_metrics || !Metrics::enabled) {
+                 port.println(F("ERR:NO_STATS"));
+             } else if (_dumpState != DUMP_IDLE) {
+                 port.println(F("ERR:BUSY")); // No se corta un GETALL a medias
+             } else {
+                 _dumpState = DUMP_STATS;
+                 _dumpNext = 0;
+                 _dumpBinary = false;
+             }
+             return false;
+
+        } else if (strcmp_P(token, PSTR("STATSRESET")) == 0) {
+             count(MET_CMD_OTHER);
+             if (_metrics && Metrics::enabled) {
+                 _metrics->reset();
+                 port.println(F("OK:STATS_RESET"));
+             } else {
+                 port.println(F("ERR:NO_STATS"));
+             }
+             return false;
+
+        } else {
+            count(MET_CMD_OTHER);
         }
 
         return false;
     }
 
   public:
-    SerialCommander(ConfigManager* config) {
+    SerialCommander(ConfigManager* config, Metrics* metrics = nullptr, byte portId = MET_PORT_USB) {
         _config = config;
+        _metrics = metrics;
+        _clock = nullptr;
+        _exp = nullptr;
+        _portId = portId;
         _bufferIndex = 0;
+        _flushPending = false;
+        _abortPending = false;
+        _txCount = 0;
+        _held = HELD_NONE;
+        _heldRecords = 0;
+        _stageLen = _stagePos = 0;
+        _dumpState = DUMP_IDLE;
+        _dumpNext = _dumpEnd = 0;
+        _dumpBinary = false;
+        _linePos = _lineLen = 0;
         // Inicializar buffer limpio
         memset(_inputBuffer, 0, SC_BUFFER_SIZE);
     }
 
-    bool update(Stream& port) {
+    void setClockHandler(ClockHandler handler) {
+        _clock = handler;
+    }
+
+    void setExpression(ExpressionPedals* exp) {
+        _exp = exp;
+    }
+
+    // Un byte de la App (texto o trama). 'framed': va al decodificador binario.
+    bool handleByte(Stream& port, char inChar, bool framed) {
+        bool changed = false;
+
+        // Visual Feedback: Blink LED on RX
+        digitalWrite(LED_BUILTIN, !digitalRead(LED_BUILTIN));
+
+        // Trama binaria: se decodifica según llega, sin pasar por el buffer ASCII
+        if (framed) {
+            byte r = _frame.feed(inChar);
+            if (r == FrameDecoder::FRAME) {
+                if (!hold(HELD_FRAME, frameRecords(_frame.op())) && processFrame(port)) changed = true;
+            } else if (r == FrameDecoder::ERROR) {
+                sendAck(port, _frame.op(), BF_STATUS_BAD_FRAME);
+            }
+        } else if (inChar == '\n' || inChar == '\r') {
+            // Al recibir Enter, procesamos
+            if (_bufferIndex > 0) {
+                _inputBuffer[_bufferIndex] = 0; // Null terminate
+                if (hold(HELD_LINE, lineRecords(_inputBuffer))) return false;
+
+                if (processCommand(_inputBuffer, port)) {
+                    changed = true;
+                }
+                _bufferIndex = 0;
+                memset(_inputBuffer, 0, SC_BUFFER_SIZE); // Clean buffer after process
+            }
+        } else {
+            if (_bufferIndex < SC_BUFFER_SIZE - 1) {
+                _inputBuffer[_bufferIndex] = inChar;
+                _bufferIndex++;
+            } else {
+                // Buffer Overflow protection
+                 _bufferIndex = 0; 
+                 memset(_inputBuffer, 0, SC_BUFFER_SIZE); // Force reset
+                 port.println(F("ERR:BUFF_OVF"));
+                 if (_metrics) _metrics->countOverflow();
+            }
+        }
+        return changed;
+    }
+
+    // 'midi': demux de MIDI IN si el puerto también lo recibe (ver MidiInput.h)
+    bool update(Stream& port, MidiInput* midi = nullptr) {
         bool changed = false;
+
+        pumpDump(port);
+        if (_linePos >= _lineLen && releaseHeld(port)) changed = true;
+        // Lo apartado va antes que lo que siga en el puerto. Se reclasifica
+        // como en un puerto sin MIDI: el MIDI IN ya se quitó al apartarlo.
+        while (!busy() && _stagePos < _stageLen) {
+            char c = _stage[_stagePos++];
+            if (handleByte(port, c, _frame.active() || (byte)c == BF_START)) changed = true;
+        }
+        if (_stagePos > 0) {
+            memmove(_stage, _stage + _stagePos, _stageLen - _stagePos);
+            _stageLen -= _stagePos;
+            _stagePos = 0;
+        }
+        unsigned long now = midi ? millis() : 0;
+        unsigned int received = 0;
+
         while (port.available() > 0) {
+            // Ocupado: se sigue leyendo hacia _stage (y el MIDI IN se atiende)
+            // para que no se llene el buffer RX; con _stage lleno, espera allí
+            bool staging = busy();
+            if (staging && _stageLen > SC_STAGE_SIZE - 2) break;
             char inChar = (char)port.read();
-            
-            // Visual Feedback: Blink LED on RX
-            digitalWrite(LED_BUILTIN, !digitalRead(LED_BUILTIN));
-            
-            if (inChar == '\n' || inChar == '\r') {
-                // Al recibir Enter, procesamos
-                if (_bufferIndex > 0) {
-                    _inputBuffer[_bufferIndex] = 0; // Null terminate
-                    
-                    if (processCommand(_inputBuffer, port)) {
-                        changed = true;
-                    }
-                    _bufferIndex = 0;
-                    memset(_inputBuffer, 0, SC_BUFFER_SIZE); // Clean buffer after process
+            received++;
+            bool framed;
+            if (midi) {
+                byte route = midi->route(inChar, now);
+                if (route == MidiInput::ROUTE_MIDI) continue;
+                if (route == MidiInput::ROUTE_FRAME_START) {
+                    if (staging) _stage[_stageLen++] = (char)BF_START;
+                    else _frame.feed(BF_START);
                 }
+                framed = route != MidiInput::ROUTE_TEXT;
             } else {
-                if (_bufferIndex < SC_BUFFER_SIZE - 1) {
-                    _inputBuffer[_bufferIndex] = inChar;
-                    _bufferIndex++;
-                } else {
-                    // Buffer Overflow protection
-                     _bufferIndex = 0; 
-                     memset(_inputBuffer, 0, SC_BUFFER_SIZE); // Force reset
-                     port.println(F("ERR:BUFF_OVF"));
-                }
+                framed = _frame.active() || (byte)inChar == BF_START;
+            }
+            if (staging) {
+                _stage[_stageLen++] = inChar;
+            } else if (handleByte(port, inChar, framed)) {
+                changed = true;
             }
         }
+        if (_metrics && received) _metrics->countRx(_portId, received);
+        if (busy()) return changed;
+        if (_abortPending && !_config->isReverting()) {
+            _abortPending = false;
+            // PARTIAL: la transacción no cabía en el journal y parte ya es definitiva
+            port.println(_config->revertWasPartial() ? F("OK:TX_ABORTED:PARTIAL") : F("OK:TX_ABORTED"));
+            changed = true; // Refrescar UI con lo recargado
+        }
+        if (_flushPending && _config->isDurable()) {
+            _flushPending = false;
+            port.println(F("OK:FLUSHED"));
+        }
         return changed; // Retorna true si hubo cambios (SAVE)
     }
 };
@@ -0,0 +1,103 @@
+#ifndef TAPTEMPO_H
+#define TAPTEMPO_H
+
+#include <Arduino.h>
+
+// Tempo a partir de las pisadas de un botón TAP.
+//
+// Cada pisada llega con el instante del flanco que guardó el ISR del escáner,
+// no con el de cuando loop() la despachó (~50 ms de debounce después): el
+// intervalo entre pisadas es el del pie, sin el ruido de loop().
+//
+// El tempo es la media de los últimos TAP_HISTORY intervalos. Un intervalo
+// que se aleja de la media más de TAP_TOLERANCE_PCT es un fallo:
+//   - Casi el doble: una pisada que no llegó. Cuenta como dos intervalos.
+//   - Otro cualquiera se descarta. Si el siguiente coincide con él, el tempo
+//     cambió de verdad y la media vuelve a empezar con los dos.
+// Más de TAP_TIMEOUT_MS sin pisar empieza una serie nueva.
+
+const byte TAP_HISTORY = 6;
+const unsigned int TAP_TIMEOUT_MS = 2000; // 30 BPM
+const unsigned int TAP_MIN_MS = 240;      // 250 BPM: más rápido es un rebote o un doble disparo
+const byte TAP_TOLERANCE_PCT = 20;
+
+class TapTempo {
+  private:
+    unsigned int _intervals[TAP_HISTORY]; // ms, circular
+    byte _count;
+    byte _next;
+    bool _started;
+    unsigned long _last;     // millis() de la última pisada
+    unsigned int _rejected;  // Último intervalo descartado (0 = ninguno)
+    unsigned long _beatUs;   // 0 = todavía sin tempo
+    unsigned int _taps;
+
+    static bool near(unsigned long value, unsigned long ref) {
+        unsigned long tol = ref * TAP_TOLERANCE_PCT / 100;
+        return value + tol >= ref && value <= ref + tol;
+    }
+
+    void push(unsigned int ms) {
+        _intervals[_next] = ms;
+        _next = (_next + 1) % TAP_HISTORY;
+        if (_count < TAP_HISTORY) _count++;
+    }
+
+    unsigned long sum() const {
+        unsigned long total = 0;
+        for (byte i = 0; i < _count; i++) total += _intervals[i];
+        return total;
+    }
+
+  public:
+    TapTempo() : _count(0), _next(0), _started(false), _last(0), _rejected(0), _beatUs(0), _taps(0) {}
+
+    // Pisada en 'time' (millis() del flanco). true si el tempo cambió.
+    bool tap(unsigned long time) {
+        unsigned long interval = time - _last;
+        bool first = !_started || interval > TAP_TIMEOUT_MS;
+        if (!first && interval < TAP_MIN_MS) return false; // No mueve la referencia
+        _started = true;
+        _last = time;
+        _taps++;
+        if (first) {
+            _count = 0;
+            _next = 0;
+            _rejected = 0;
+            return false;
+        }
+
+        if (_count > 0 && !near(interval, sum() / _count)) {
+            unsigned long mean = sum() / _count;
+            if (near(interval, 2 * mean)) {
+                push(interval / 2);
+                push(interval - interval / 2);
+            } else if (_rejected && near(interval, _rejected)) {
+                _count = 0;
+                _next = 0;
+                push(_rejected);
+                push(interval);
+            } else {
+                _rejected = interval;
+                return false;
+            }
+        } else {
+            push(interval);
+        }
+        _rejected = 0;
+        _beatUs = sum() * 1000UL / _count;
+        return true;
+    }
+
+    // Olvida la serie en curso (el tempo calculado se mantiene)
+    void restart() {
+        _started = false;
+    }
+
+    unsigned long beatUs() const { return _beatUs; } // Negra en us (0 = sin tempo)
+    unsigned long lastTap() const { return _last; }
+    byte samples() const { return _count; }          // Intervalos en la media
+    unsigned int taps() const { return _taps; }
+};
+
+#endif
@@ -1,28 +1,49 @@
 //================================================================
-//      Controlador MIDI Personalizado para Valeton GP-200 v7.0 (SoftSerial)
+//      Controlador MIDI Personalizado para Valeton GP-200 v7.0 (UART por software)
 //================================================================
 // Por: ROBERT CODER
-// Refactorizado: Dual Comm (USB + SoftwareSerial)
+// Refactorizado: Dual Comm (USB + UART por software con Timer1)
 //================================================================
 
-#include <MIDI.h>
-#include <SoftwareSerial.h>
+#include "BtSerial.h"
 #include "Button.h"
+#include "FootswitchScanner.h"
 #include "LedManager.h"
 #include "DisplayManager.h"
 #include "ConfigManager.h"
 #include "SerialCommander.h"
+#include "MidiInput.h"
+#include "MidiOut.h"
+#include "BluetoothSetup.h"
 #include "MidiDictionary.h"
+#include "Metrics.h"
+#include "Scheduler.h"
+#include "MacroPlayer.h"
+#include "TapTempo.h"
+#include "MidiClock.h"
+#include "ExpressionPedals.h"
 
 // --- CONFIGURACIÓN MIDI ---
-MIDI_CREATE_DEFAULT_INSTANCE();
+// Sin instancia de arduino_midi_library: envíos por midiOut y lectura por
+// midiIn. Solo la usábamos para begin() y su buffer de SysEx ocupaba RAM.
+MidiOut midiOut(Serial);         // Cola de salida sin CC#0 ni CC repetidos
+ClockSafePort usbPort(Serial);   // Respuestas a la App sin pisar el reloj MIDI
 
-// --- BLUETOOTH (Software Serial) ---
+// --- BLUETOOTH (BtSerial: ring RX/TX por interrupciones) ---
 // Usaremos A0 como RX (Recibe del TX del HC-06)
 // Usaremos A1 como TX (Envía al RX del HC-06)
 const int BT_RX_PIN = A0; 
 const int BT_TX_PIN = A1;
-SoftwareSerial btSerial(BT_RX_PIN, BT_TX_PIN);
+BtSerial btSerial(BT_RX_PIN, BT_TX_PIN);
+BluetoothSetup btSetup; // Nombre/PIN/velocidad del HC-06, asíncrono y solo si hace falta
+
+// --- PEDALES DE EXPRESIÓN ---
+// Jack TRS: punta al cursor del potenciómetro, anillo a 5V, malla a masa.
+// A4/A5 son del I2C del LCD; en un Nano también valen A6 y A7.
+const int EXP_PINS[EXP_INPUTS] = {A2, A3};
+
+// Splash de bienvenida al arrancar (no bloquea; cualquier pisada lo corta)
+const bool SHOW_SPLASH = true;
 
 // --- OBJETOS DE HARDWARE ---
 // Definición de Pines
@@ -35,15 +56,34 @@ const int BTN_PRESET_3_PIN = 7;
 const int BTN_GUITAR_CHANGE_PIN = 11;
 const int BTN_CTRL_2_PIN = 3;
 
+// Bloqueo por botón (ms): una segunda pisada del MISMO switch dentro de este
+// margen se descarta (rebote lento / doble disparo). Otros botones no esperan.
+const unsigned long LOCKOUT_BANK_MS = 80;    // Permite saltos de banco rápidos
+const unsigned long LOCKOUT_ACTION_MS = 150; // Presets, Toggle y Globales
+
 // Objetos Botones
-Button btnBankDown(BTN_BANK_DOWN_PIN);
-Button btnBankUp(BTN_BANK_UP_PIN);
-Button btnToggle(BTN_TOGGLE_PIN);
-Button btnPreset1(BTN_PRESET_1_PIN);
-Button btnPreset2(BTN_PRESET_2_PIN);
-Button btnPreset3(BTN_PRESET_3_PIN);
-Button btnGuitarChange(BTN_GUITAR_CHANGE_PIN);
-Button btnCtrl2(BTN_CTRL_2_PIN);
+Button btnBankDown(BTN_BANK_DOWN_PIN, LOCKOUT_BANK_MS);
+Button btnBankUp(BTN_BANK_UP_PIN, LOCKOUT_BANK_MS);
+Button btnToggle(BTN_TOGGLE_PIN, LOCKOUT_ACTION_MS);
+Button btnPreset1(BTN_PRESET_1_PIN, LOCKOUT_ACTION_MS);
+Button btnPreset2(BTN_PRESET_2_PIN, LOCKOUT_ACTION_MS);
+Button btnPreset3(BTN_PRESET_3_PIN, LOCKOUT_ACTION_MS);
+Button btnGuitarChange(BTN_GUITAR_CHANGE_PIN, LOCKOUT_ACTION_MS);
+Button btnCtrl2(BTN_CTRL_2_PIN, LOCKOUT_ACTION_MS);
+
+// Escáner por interrupción: captura los flancos con su timestamp aunque
+// loop() esté ocupado, y los entrega a los botones en orden.
+FootswitchScanner footswitches;
+
+// Cola de eventos: todos los botones encolan sus flancos y loop() los
+// despacha en orden de llegada.
+ButtonEventQueue buttonEvents;
+const byte BTN_ID_BANK_DOWN = 0;
+const byte BTN_ID_BANK_UP = 1;
+const byte BTN_ID_TOGGLE = 2;
+const byte BTN_ID_PRESET_1 = 3; // 3, 4, 5 -> presets 0, 1, 2
+const byte BTN_ID_GUITAR_CHANGE = 6;
+const byte BTN_ID_CTRL_2 = 7;
 
 // Leds
 const int ledPins[] = {8, 9, 10}; 
@@ -52,13 +92,33 @@ LedManager ledManager(ledPins, 3);
 // Display
 DisplayManager display(0x27, 16, 2);
 
+// Planificador: las etapas de loop() y los plazos (mensajes, LEDs) son tareas.
+// Rodaja de cada etapa = lo más que puede tardar en una vuelta; su suma acota
+// el peor loop(). El build host avisa si alguna se pasa.
+Scheduler scheduler;
+const unsigned int SLICE_COMMS_US = 4500;   // Una línea de la App + refreshUI (puede esperar a la EEPROM)
+const unsigned int SLICE_BUTTONS_US = 4500; // Despacho de eventos (+ página de banco desde la EEPROM)
+const unsigned int SLICE_DISPLAY_US = 3600; // LCD_BYTES_PER_UPDATE bytes I2C
+const unsigned int SLICE_EEPROM_US = 3600;  // Un byte del journal (espera a que la EEPROM quede libre)
+
 // Configuration & Comm
 // Configuration & Comm
 ConfigManager configManager;
+// Métricas en vivo (STATS); METRICS_ENABLED 0 en Metrics.h las quita
+Metrics metrics;
 // Instanciamos dos comandantes separados para tener buffers independientes
 // y evitar conflictos si llegan datos simultáneos por USB y BT.
-SerialCommander commanderUSB(&configManager); 
-SerialCommander commanderBT(&configManager);
+SerialCommander commanderUSB(&configManager, &metrics, MET_PORT_USB); 
+SerialCommander commanderBT(&configManager, &metrics, MET_PORT_BT);
+// Macros: varios mensajes por pisada, con retardos, sin bloquear loop()
+MacroPlayer macroPlayer(&configManager);
+// Tap tempo y reloj MIDI (0xF8) desde el ISR de comparación de Timer0
+TapTempo tapTempo;
+MidiClock midiClock;
+// Pedales de expresión: ADC libre por interrupción y CC sin inundar el cable
+ExpressionPedals expression(&configManager, &midiOut);
+// MIDI IN de la GP-200 por el mismo Serial que la App: el demux separa ambos
+MidiInput midiIn;
 
 // --- DATOS Y ESTADO ---
 // --- DATOS Y ESTADO ---
@@ -80,6 +140,14 @@ bool ledStates[3] = {false, false, false};
 // Global Effect States (for toggling via Long Press / Global buttons)
 bool globalEffectStates[DICT_SIZE]; 
 
+// Tempo de banco ya aplicado al reloj: se aplica al entrar en el banco (o si
+// se edita), no en cada refresco, para no pisar el tempo de un tap
+int tempoBank = -1;
+byte tempoBankBpm = 0;
+
+// Último Bank Select (CC#0) recibido por MIDI IN
+byte midiInBank = 0;
+
 // --- SCROLL CONTROL ---
 unsigned long lastScrollTime = 0;
 const unsigned long SCROLL_DELAY = 250; // ms entre saltos de banco 
@@ -94,24 +162,36 @@ void refreshUI() {
     memset(line1, 0, 17);
     memset(line2, 0, 17);
 
+    // Sus vecinos se precargan de fondo: Bank Up/Down no esperan a la EEPROM
+    configManager.focusBank(currentBank);
+
+    byte bpm = configManager.getBankTempo(currentBank);
+    if (bpm && (tempoBank != currentBank || tempoBankBpm != bpm)) {
+        midiClock.setTempo(MidiClock::beatFromBpm(bpm));
+    }
+    tempoBank = currentBank;
+    tempoBankBpm = bpm;
+
     if (inToggleView && previousPresetIndex != -1) {
         // --- TOGGLE VIEW ---
         ButtonConfig* currCfg = configManager.getButtonConfig(currentBank, currentPresetIndex);
         ButtonConfig* prevCfg = configManager.getButtonConfig(previousBank, previousPresetIndex);
         
-        display.showToggleView(currCfg ? currCfg->name : "???", prevCfg ? prevCfg->name : "???");
+        display.showToggleView(currCfg ? currCfg->name : nullptr, prevCfg ? prevCfg->name : nullptr);
     } else {
         // --- MAIN VIEW ---
         ButtonConfig* p1 = configManager.getButtonConfig(currentBank, 0);
         ButtonConfig* p2 = configManager.getButtonConfig(currentBank, 1);
         ButtonConfig* p3 = configManager.getButtonConfig(currentBank, 2);
 
+        // Textos fijos en flash; sin config (nullptr) el display pone "---"
         display.showMainView(
-            "GP-200", 
+            F("GP-200"),
             configManager.getBankName(currentBank),
-            p1 ? p1->name : "---",
-            p2 ? p2->name : "---",
-            p3 ? p3->name : "---"
+            p1 ? p1->name : nullptr,
+            p2 ? p2->name : nullptr,
+            p3 ? p3->name : nullptr,
+            (midiClock.bpm10() + 5) / 10
         );
     }
         
@@ -135,14 +215,102 @@ void refreshUI() {
     }
 }
 
-void triggerMidiAction(int presetIndex) {
+// --- TAP TEMPO ---
+// Slot 'D' con el TAP del diccionario: el CC sale igual (la GP-200 lleva su
+// propio tap) y además la pisada marca el reloj MIDI. 'time' es el millis()
+// del flanco que vio el ISR del escáner, no el de ahora.
+bool isTap(ButtonConfig* cfg) {
+    return cfg && cfg->type == 'D' && cfg->value1 == DICT_TAP;
+}
+
+void handleTap(unsigned long time) {
+    midiOut.forceControlChange(dictCC(DICT_TAP), 127, 1);
+    if (tapTempo.tap(time)) {
+        // La rejilla de pulsos pasa por la pisada, aunque loop() la vea tarde
+        midiClock.sync(tapTempo.beatUs(), (millis() - time) * 1000UL);
+    }
+
+    char line2[17];
+    unsigned int bpm10 = midiClock.bpm10();
+    if (bpm10) {
+        snprintf_P(line2, sizeof(line2), PSTR("%u.%u BPM"), bpm10 / 10, bpm10 % 10);
+    } else {
+        strcpy_P(line2, PSTR("..."));
+    }
+    char line1[10];
+    strcpy_P(line1, PSTR("TAP TEMPO"));
+    display.showMessage(line1, line2, 600);
+}
+
+// Estado de un efecto del diccionario y LEDs del banco actual que lo muestran
+void setEffectState(int idx, bool on) {
+    globalEffectStates[idx] = on;
+    for (int i = 0; i < 3; i++) {
+        ButtonConfig* cfg = configManager.getButtonConfig(currentBank, i);
+        if (cfg && cfg->type == 'D' && cfg->value1 == idx) ledStates[i] = on;
+    }
+}
+
+// --- ESCENAS ---
+// Estado de los efectos con escena (DICT_SCENE_MASK) como el de una escena
+uint16_t currentScene() {
+    uint16_t scene = 0;
+    for (int idx = 0; idx < DICT_SIZE; idx++) {
+        if (globalEffectStates[idx]) scene |= 1u << idx;
+    }
+    return scene & DICT_SCENE_MASK;
+}
+
+// Escena capturada con el Long Press 'S' que aún no cabía en la cola de la
+// EEPROM (p.ej. la App subiendo un lote). El botón no espera: la guarda la
+// tarea de EEPROM en cuanto haya sitio.
+int pendingSceneBank = -1;
+int pendingScenePreset = 0;
+uint16_t pendingScene = 0;
+
+bool storePendingScene() {
+    if (pendingSceneBank < 0 || !configManager.hasRoom(1)) return false;
+    if (pendingSceneBank < configManager.getActiveBanksCount()) {
+        configManager.setScene(pendingSceneBank, pendingScenePreset, pendingScene);
+        configManager.save();
+    }
+    pendingSceneBank = -1;
+    return true;
+}
+
+void recallScene(uint16_t scene) {
+    for (int idx = 0; idx < DICT_SIZE; idx++) {
+        if (!(DICT_SCENE_MASK & (1u << idx))) continue;
+        bool on = scene & (1u << idx);
+        setEffectState(idx, on);
+        // midiOut no repite un CC que la GP-200 ya tiene (lo enviado o lo
+        // que contó por MIDI IN); tras un PC no sabe ninguno y salen todos
+        midiOut.sendControlChange(getCCFromDict(idx), on ? 127 : 0, 1);
+    }
+}
+
+// PC del slot y su escena. Si la GP-200 ya está en ese programa el PC no se
+// repite (no recarga el preset ni corta el sonido): solo cambian los efectos
+// que difieren de la escena.
+void recallPreset(int bank, int presetIndex, ButtonConfig* cmd) {
+    uint16_t scene = configManager.getScene(bank, presetIndex);
+    if (scene == SCENE_NONE || !midiOut.onPreset(cmd->value2, cmd->value1, 1)) {
+        midiOut.sendPreset(cmd->value2, cmd->value1, 1);
+    }
+    if (scene != SCENE_NONE) recallScene(scene);
+}
+
+void triggerMidiAction(int presetIndex, unsigned long time) {
     inToggleView = false;
     
     ButtonConfig* cmd = configManager.getButtonConfig(currentBank, presetIndex);
     if (!cmd) return;
 
     // Interpretamos la configuración
-    if (cmd->type == 'P') {
+    if (isTap(cmd)) {
+        // --- TAP --- (sin LED: no es un efecto que se encienda)
+        handleTap(time);
+    } else if (cmd->type == 'P') {
         // --- PRESET MODE (PROGRAM CHANGE) ---
         // FIX: Solo actualizar historial si cambiamos a un preset DIFERENTE
         // Esto evita que "machaquemos" el historial si pulsamos el mismo botón 2 veces.
@@ -159,8 +327,7 @@ void triggerMidiAction(int presetIndex) {
         lastPresetBank = currentBank;
         
         // Value2 = Bank, Value1 = Program
-        MIDI.sendControlChange(0, cmd->value2, 1);
-        MIDI.sendProgramChange(cmd->value1, 1);
+        recallPreset(currentBank, presetIndex, cmd);
         
     } else if (cmd->type == 'D') {
         // --- DICTIONARY MODE (EFFECTS) ---
@@ -176,8 +343,11 @@ void triggerMidiAction(int presetIndex) {
         int val = ledStates[presetIndex] ? 127 : 0;
         
         int cc = getCCFromDict(cmd->value1); // Value1 is index
-        MIDI.sendControlChange(cc, val, 1);
+        midiOut.sendControlChange(cc, val, 1);
         
+    } else if (cmd->type == 'M') {
+        // --- MACRO --- (Value1 = macro)
+        macroPlayer.play(cmd->value1);
     } else {
         // Custom
     }
@@ -192,13 +362,12 @@ void triggerLongPressAction(int presetIndex) {
     if (cmd->lpType == 'N') return; // Sin acción
 
     if (cmd->lpType == 'C') {
-        // CC Custom
-        MIDI.sendControlChange(cmd->lpValue1, cmd->lpValue2, 1);
+        // CC Custom: siempre sale (puede ser un disparo, p.ej. el afinador)
+        midiOut.forceControlChange(cmd->lpValue1, cmd->lpValue2, 1);
     } else if (cmd->lpType == 'P') {
         // Program Change (Bank LSB only? Or just PC)
         // Usamos Value1=PC, Value2=Bank
-        MIDI.sendControlChange(0, cmd->lpValue2, 1);
-        MIDI.sendProgramChange(cmd->lpValue1, 1);
+        midiOut.sendPreset(cmd->lpValue2, cmd->lpValue1, 1);
     } else if (cmd->lpType == 'D') {
         // Dict Effect
         int idx = cmd->lpValue1;
@@ -206,12 +375,25 @@ void triggerLongPressAction(int presetIndex) {
             globalEffectStates[idx] = !globalEffectStates[idx]; // Toggle State
             int val = globalEffectStates[idx] ? 127 : 0;
             int cc = getCCFromDict(idx);
-            MIDI.sendControlChange(cc, val, 1);
+            midiOut.sendControlChange(cc, val, 1);
             
             // Visual feedback
-            display.showMessage(getNameFromDict(idx), val ? "ON" : "OFF", 600);
+            display.showMessage(getNameFromDict(idx), val ? F("ON") : F("OFF"), 600);
             refreshUI();
         }
+    } else if (cmd->lpType == 'M') {
+        macroPlayer.play(cmd->lpValue1);
+    } else if (cmd->lpType == 'S') {
+        // Escena: lo que suena ahora queda guardado en este slot
+        pendingSceneBank = currentBank;
+        pendingScenePreset = presetIndex;
+        pendingScene = currentScene();
+        if (storePendingScene()) {
+            display.showMessage(F("ESCENA"), F("GUARDADA"), 600);
+        } else {
+            configManager.countStall();
+            display.showMessage(F("ESCENA"), F("EN COLA"), 600);
+        }
     }
 }
 
@@ -234,25 +416,91 @@ void handleToggle() {
     // Re-enviar comando MIDI
     ButtonConfig* cmd = configManager.getButtonConfig(currentBank, currentPresetIndex);
     if (cmd && cmd->type == 'P') {
-        MIDI.sendControlChange(0, cmd->value2, 1);
-        MIDI.sendProgramChange(cmd->value1, 1);
+        recallPreset(currentBank, currentPresetIndex, cmd);
     }
     
     inToggleView = true;
     refreshUI();
 }
 
+// --- MACROS ---
+// Un paso de macro: lo mismo que la acción equivalente de un botón, pero
+// sin tocar el historial de presets (la macro no es un slot del banco).
+void playMacroStep(const MacroStep& step) {
+    if (step.type == 'P') {
+        midiOut.sendPreset(step.value2, step.value1, 1);
+    } else if (step.type == 'C') {
+        midiOut.forceControlChange(step.value1, step.value2, 1);
+    } else if (step.type == 'D' && step.value1 < DICT_SIZE) {
+        bool on = step.value2 >= 64;
+        setEffectState(step.value1, on);
+        midiOut.sendControlChange(getCCFromDict(step.value1), on ? 127 : 0, 1);
+        refreshUI();
+    }
+}
+
+// CLOCK:BPM desde la App: tempo en vivo, sin tocar el del banco (0 = parar)
+void setClockTempo(int bpm) {
+    midiClock.setTempo(MidiClock::beatFromBpm(bpm));
+    refreshUI();
+}
+
+// --- MIDI IN ---
+// La GP-200 avisa de lo que cambia en ella misma (preset o efecto pisado en la
+// pedalera, o cambiado desde su editor): LEDs y estados se ponen al día en vez
+// de suponerlos. No se reenvía nada por MIDI OUT, pero midiOut lo apunta para
+// no repetir lo que la pedalera ya tiene.
+void handleMidiIn(byte status, byte data1, byte data2) {
+    byte type = status & 0xF0;
+    midiOut.noteIncoming(status, data1, data2);
+
+    if (type == 0xB0) {
+        if (data1 == 0) {
+            midiInBank = data2; // Se aplica con el Program Change que sigue
+            return;
+        }
+        bool on = data2 >= 64;
+        for (int idx = 0; idx < DICT_SIZE; idx++) {
+            if (getCCFromDict(idx) == data1) setEffectState(idx, on);
+        }
+        refreshUI();
+
+    } else if (type == 0xC0) {
+        // ¿Algún slot del banco actual apunta a este preset?
+        int found = -1;
+        for (int i = 0; i < 3; i++) {
+            ButtonConfig* cfg = configManager.getButtonConfig(currentBank, i);
+            if (cfg && cfg->type == 'P' && cfg->value1 == data1 && cfg->value2 == midiInBank) found = i;
+        }
+        if (found >= 0 && (found != currentPresetIndex || lastPresetBank != currentBank)) {
+            // Mismo historial que una pisada, para que Toggle vuelva al anterior
+            if (currentPresetIndex != -1) {
+                previousBank = lastPresetBank;
+                previousPresetIndex = currentPresetIndex;
+            }
+            currentPresetIndex = found;
+            lastPresetBank = currentBank;
+        } else if (found < 0) {
+            currentPresetIndex = -1; // Preset fuera de este banco: ningún LED de preset
+        }
+        inToggleView = false;
+        refreshUI();
+    }
+}
+
 // --- SETUP & LOOP ---
 
-void triggerGlobalAction(int globalId) {
+void triggerGlobalAction(int globalId, unsigned long time) {
     ButtonConfig* cmd = configManager.getGlobalConfig(globalId);
     if (!cmd) return;
 
     // Interpretamos la configuración
-    if (cmd->type == 'P') {
+    if (isTap(cmd)) {
+        handleTap(time);
+        refreshUI();
+    } else if (cmd->type == 'P') {
         // --- PRESET MODE ---
-        MIDI.sendControlChange(0, cmd->value2, 1);
-        MIDI.sendProgramChange(cmd->value1, 1);
+        midiOut.sendPreset(cmd->value2, cmd->value1, 1);
     } else if (cmd->type == 'D') {
         // --- EFFECT MODE ---
         // Para botones globales, toggleamos un estado interno local o simplemente enviamos trigger?
@@ -267,10 +515,151 @@ void triggerGlobalAction(int globalId) {
         // Vamos a usar una estática fea aquí por ahora.
         static bool gState[2] = {false, false};
         gState[globalId] = !gState[globalId];
-        MIDI.sendControlChange(cc, gState[globalId] ? 127 : 0, 1);
+        midiOut.sendControlChange(cc, gState[globalId] ? 127 : 0, 1);
+    } else if (cmd->type == 'M') {
+        macroPlayer.play(cmd->value1);
+    }
+}
+
+// Devuelve true si la acción corta del preset se dispara al pisar.
+// 'I' la adelanta solo si no hay Long Press que desambiguar;
+// 'S' la adelanta siempre y deja que el Long Press se dispare encima.
+// Un TAP siempre al pisar: el tempo es el del pie, no el de soltar.
+bool firesOnPush(int presetIndex) {
+    ButtonConfig* cfg = configManager.getButtonConfig(currentBank, presetIndex);
+    if (isTap(cfg)) return true;
+    return cfg && (cfg->pressMode == 'S' || (cfg->pressMode == 'I' && cfg->lpType == 'N'));
+}
+
+// Los globales disparan al soltar, salvo el TAP
+bool globalFires(int globalId, const ButtonEvent& ev) {
+    bool tap = isTap(configManager.getGlobalConfig(globalId));
+    return ev.type == (tap ? BTN_EV_PUSH : BTN_EV_CLICK);
+}
+
+void dispatchButtonEvent(const ButtonEvent& ev) {
+    switch (ev.id) {
+        case BTN_ID_BANK_UP:
+            if (ev.type != BTN_EV_CLICK) break;
+            currentBank++;
+            if (currentBank >= configManager.getActiveBanksCount()) currentBank = 0; 
+            inToggleView = false;
+            refreshUI();
+            break;
+
+        case BTN_ID_BANK_DOWN:
+            if (ev.type != BTN_EV_CLICK) break;
+            currentBank--;
+            if (currentBank < 0) currentBank = configManager.getActiveBanksCount() - 1;
+            inToggleView = false;
+            refreshUI();
+            break;
+
+        case BTN_ID_TOGGLE:
+            // Long Press DISABLED: User rule
+            if (ev.type == BTN_EV_CLICK) handleToggle();
+            break;
+
+        case BTN_ID_PRESET_1:
+        case BTN_ID_PRESET_1 + 1:
+        case BTN_ID_PRESET_1 + 2: {
+            int idx = ev.id - BTN_ID_PRESET_1;
+            if (ev.type == BTN_EV_LONG) {
+                triggerLongPressAction(idx);
+            } else if ((ev.type == BTN_EV_PUSH) == firesOnPush(idx)) {
+                // Short: al soltar o al pisar, según pressMode del slot
+                triggerMidiAction(idx, ev.time);
+            }
+            break;
+        }
+
+        case BTN_ID_GUITAR_CHANGE:
+            if (globalFires(0, ev)) triggerGlobalAction(0, ev.time);
+            break;
+
+        case BTN_ID_CTRL_2:
+            if (globalFires(1, ev)) triggerGlobalAction(1, ev.time);
+            break;
+    }
+}
+
+// Contadores que ya llevan los módulos, en el orden MET_EXT_* (ver Metrics.h)
+void readCounters(unsigned int* out) {
+    out[MET_EXT_LOCKOUTS] = Button::lockouts();
+    out[MET_EXT_EVENTS] = buttonEvents.dropped();
+    out[MET_EXT_OVERRUNS] = FootswitchScanner::overruns();
+    out[MET_EXT_STALLS] = configManager.stalls();
+    out[MET_EXT_MIDI_OVF] = midiOut.overflows();
+    out[MET_EXT_BT_LOST] = btSerial.dropped() + btSerial.framingErrors();
+}
+
+// --- TAREAS DE LOOP ---
+
+// 1. ESCUCHAR COMANDOS DE LA APP (y MIDI IN)
+void taskComms(void*) {
+    // MIDI.read() no se usa: se comería el texto de la App. midiIn reparte
+    // cada byte de Serial entre la App y handleMidiIn().
+    bool configChanged = false;
+    // Usamos instancias separadas para cada puerto
+    if (commanderUSB.update(usbPort, &midiIn)) configChanged = true;
+    // El puerto BT es del aprovisionamiento AT hasta que termine
+    if (btSetup.isDone()) {
+        if (commanderBT.update(btSerial)) configChanged = true;
+    } else {
+        btSetup.update(btSerial);
+    }
+    
+    if (configChanged) {
+        // CRASH FIX: Update currentBank if we deleted the last one
+        if (currentBank >= configManager.getActiveBanksCount()) {
+            currentBank = configManager.getActiveBanksCount() - 1;
+            if (currentBank < 0) currentBank = 0; // Safety for 1 bank
+        }
+        refreshUI();
     }
 }
 
+// 2. Update Hardware + 3. LOGICA PERFORMANCE
+void taskButtons(void*) {
+    // El ISR ya capturó los flancos; aquí cada botón los consume y encola
+    // sus eventos con el timestamp real del flanco.
+    footswitches.update();
+    
+    // 3. LOGICA PERFORMANCE
+    // Despachamos en orden todo lo encolado: un combo rápido (preset -> efecto,
+    // doble salto de banco) ya no se pierde. El doble disparo lo evita el
+    // lockout de cada botón, no un cooldown global.
+    ButtonEvent ev;
+    while (buttonEvents.pop(ev)) {
+        // Cualquier pisada corta el splash y además ejecuta su acción
+        if (ev.type == BTN_EV_PUSH) display.cancelSplash();
+        unsigned long out = midiOut.sent() + midiOut.pending();
+        dispatchButtonEvent(ev);
+        if (midiOut.sent() + midiOut.pending() != out) metrics.midiQueued(ev.time);
+    }
+    // Las acciones solo encolan: todo sale junto (running status) y sin
+    // esperar al UART. Lo que no quepa en su buffer sale en la siguiente vuelta.
+    midiOut.update();
+    if (midiOut.idle()) metrics.midiSent(); // Latencia flanco -> UART
+}
+
+// 4. LCD: solo unas pocas celdas cambiadas por vuelta (nunca bloquea)
+void taskDisplay(void*) {
+    display.update();
+}
+
+// 5. EEPROM de fondo: como mucho un byte por vuelta y solo si está libre
+void taskEeprom(void*) {
+    if (!Metrics::enabled || configManager.isDurable()) {
+        configManager.update(); // Sin escrituras pendientes: solo precarga
+    } else {
+        unsigned long t0 = micros();
+        configManager.update();
+        metrics.record(MET_EEPROM_US, micros() - t0);
+    }
+    storePendingScene();
+}
+
 // --- SETUP & LOOP ---
 
 void setup() {
@@ -278,25 +667,52 @@ void setup() {
     digitalWrite(LED_BUILTIN, LOW);
 
     // 1. HARDWARE SERIAL (USB + MIDI) -> 31250
-    // MIDI.begin() inicializa Serial a 31250 automáticamente.
-    MIDI.begin(MIDI_CHANNEL_OMNI); 
+    Serial.begin(31250);
+    midiIn.setHandler(handleMidiIn);
+    midiOut.invalidate(); // No sabemos en qué banco/estado está la GP-200
     // Serial.begin(9600); // DEBUG ONLY
     
-    // 2. SOFTWARE SERIAL (BLUETOOTH) -> 9600
-    // Usamos la velocidad por defecto segura del HC-06.
-    btSerial.begin(9600); 
+    // 2. BLUETOOTH -> 9600 de fábrica
+    // btSetup la cambia a la que guardó o negocie con el módulo (AT+BAUD).
+    btSerial.begin(9600);
     
-    // --- BT CONFIGURATION (AUTO-RUN) ---
-    // Configura Name y PIN al arrancar.
-    // Una vez configurado, estas lineas se pueden comentar para ahorrar 2 segundos de inicio.
-    delay(500); 
-    btSerial.print("AT+NAMEMidiController"); 
-    delay(1000); 
-    btSerial.print("AT+PIN0290"); 
-    delay(1000); 
+    // --- BT CONFIGURATION (ASYNC) ---
+    // Name, PIN y velocidad se configuran desde loop() y solo si el módulo no los tiene ya.
+    btSetup.begin();
     
+    // Botones -> cola de eventos
+    btnBankDown.attach(&buttonEvents, BTN_ID_BANK_DOWN);
+    btnBankUp.attach(&buttonEvents, BTN_ID_BANK_UP);
+    btnToggle.attach(&buttonEvents, BTN_ID_TOGGLE);
+    btnPreset1.attach(&buttonEvents, BTN_ID_PRESET_1);
+    btnPreset2.attach(&buttonEvents, BTN_ID_PRESET_1 + 1);
+    btnPreset3.attach(&buttonEvents, BTN_ID_PRESET_1 + 2);
+    btnGuitarChange.attach(&buttonEvents, BTN_ID_GUITAR_CHANGE);
+    btnCtrl2.attach(&buttonEvents, BTN_ID_CTRL_2);
+
+    // Botones <- escáner (ISR de Timer2 lee los puertos completos)
+    footswitches.attach(&btnBankDown, BTN_BANK_DOWN_PIN);
+    footswitches.attach(&btnBankUp, BTN_BANK_UP_PIN);
+    footswitches.attach(&btnToggle, BTN_TOGGLE_PIN);
+    footswitches.attach(&btnPreset1, BTN_PRESET_1_PIN);
+    footswitches.attach(&btnPreset2, BTN_PRESET_2_PIN);
+    footswitches.attach(&btnPreset3, BTN_PRESET_3_PIN);
+    footswitches.attach(&btnGuitarChange, BTN_GUITAR_CHANGE_PIN);
+    footswitches.attach(&btnCtrl2, BTN_CTRL_2_PIN);
+    footswitches.begin();
+    midiClock.begin(); // Comparación A de Timer0 (millis() sigue en el desbordamiento)
+    expression.begin(EXP_PINS); // ADC en modo libre
+
     // Display Init
     display.begin();
+    display.attach(&scheduler);
+    ledManager.attach(&scheduler);
+    macroPlayer.attach(&scheduler);
+    macroPlayer.setHandler(playMacroStep);
+    commanderUSB.setClockHandler(setClockTempo);
+    commanderBT.setClockHandler(setClockTempo);
+    commanderUSB.setExpression(&expression);
+    commanderBT.setExpression(&expression);
 
     /* HARDWARE RESET DISABLED - CAUSING BOOT LOOP
     // HARDWARE FACTORY RESET CHECK
@@ -316,109 +732,27 @@ void setup() {
     }
     */
 
-    display.showWelcome();
-    
     configManager.begin(); // Carga de EEPROM
     
+    // Vista principal ya lista; el splash va encima como mensaje temporal
     refreshUI();
+    if (SHOW_SPLASH) display.showWelcome();
+    display.flush();
+
+    // Etapas de loop(), en este orden en cada vuelta
+    scheduler.every(scheduler.add(taskComms, nullptr, SLICE_COMMS_US, PSTR("comms")), 0);
+    scheduler.every(scheduler.add(taskButtons, nullptr, SLICE_BUTTONS_US, PSTR("buttons")), 0);
+    expression.attach(&scheduler); // Tras los botones: lo de una pisada sale antes
+    scheduler.every(scheduler.add(taskDisplay, nullptr, SLICE_DISPLAY_US, PSTR("display")), 0);
+    scheduler.every(scheduler.add(taskEeprom, nullptr, SLICE_EEPROM_US, PSTR("eeprom")), 0);
+
+    metrics.setSource(readCounters);
+    metrics.begin();
 }
 
-unsigned long lastHeartbeat = 0;
-
-// --- DEBUG LOOP ---
 void loop() {
-    // 0. HEARTBEAT (Debug suave)
-    if (millis() - lastHeartbeat > 2000) {
-        lastHeartbeat = millis();
-        // Serial.println(F("DEBUG:HEARTBEAT"));
-    }
-
-    // 0.1 MIDI READ - PERMANENTLY DISABLED
-    // We prioritize App Commands (Text). MIDI.read() consumes characters and breaks commands.
-    // If we need MIDI IN in the future, we must use a separate port or advanced parsing.
-    /*
-    if (MIDI.read()) {
-    }
-    */
-
-    // 1. ESCUCHAR COMANDOS DE LA APP
-    bool configChanged = false;
-    // Usamos instancias separadas para cada puerto
-    if (commanderUSB.update(Serial)) configChanged = true;
-    if (commanderBT.update(btSerial)) configChanged = true;
-    
-    if (configChanged) {
-        // CRASH FIX: Update currentBank if we deleted the last one
-        if (currentBank >= configManager.getActiveBanksCount()) {
-            currentBank = configManager.getActiveBanksCount() - 1;
-            if (currentBank < 0) currentBank = 0; // Safety for 1 bank
-        }
-        refreshUI();
-    }
-    
-    // 2. Update Hardware
-    // Global Cooldown Check to prevent "stacking"
-    static unsigned long lastActionTime = 0;
-    const unsigned long ACTION_COOLDOWN = 300; 
-
-    btnBankUp.update();
-    btnBankDown.update();
-    btnToggle.update();
-    btnPreset1.update();
-    btnPreset2.update();
-    btnPreset3.update();
-    btnGuitarChange.update(); 
-    btnCtrl2.update();        
-    
-    // Si hace menos de 300ms que hicimos algo, ignoramos nuevas acciones
-    if (millis() - lastActionTime < ACTION_COOLDOWN) return;
-
-    // 3. LOGICA PERFORMANCE
-    
-    // Cambios de Banco Global (Short Press)
-    if (btnBankUp.pressed) {
-        lastActionTime = millis(); // Reset cooldown
-        currentBank++;
-        if (currentBank >= configManager.getActiveBanksCount()) currentBank = 0; 
-        inToggleView = false;
-        refreshUI();
-    }
-    
-    if (btnBankDown.pressed) {
-        lastActionTime = millis();
-        currentBank--;
-        if (currentBank < 0) currentBank = configManager.getActiveBanksCount() - 1;
-        inToggleView = false;
-        refreshUI();
-    }
-    
-    // --- BANK SCROLL LONG PRESS ---
-    // DISABLED: User rule "Solo los preseset 1,2,3 usan long press/toggle"
-    // (Intentionally removed scrolling logic)
-
-    // Toggle short press
-    // Toggle short press
-    if (btnToggle.pressed) {
-        lastActionTime = millis();
-        handleToggle();
-    }
-    // Toggle Long Press
-    // DISABLED: User rule
-    if (btnToggle.longPressed) {
-        // Do nothing
-    }
-    
-    // Presets Short
-    if (btnPreset1.pressed) { lastActionTime = millis(); triggerMidiAction(0); }
-    if (btnPreset2.pressed) { lastActionTime = millis(); triggerMidiAction(1); }
-    if (btnPreset3.pressed) { lastActionTime = millis(); triggerMidiAction(2); }
-    
-    // Presets Long
-    if (btnPreset1.longPressed) { lastActionTime = millis(); triggerLongPressAction(0); }
-    if (btnPreset2.longPressed) { lastActionTime = millis(); triggerLongPressAction(1); }
-    if (btnPreset3.longPressed) { lastActionTime = millis(); triggerLongPressAction(2); }
-    
-    // Globales
-    if (btnGuitarChange.pressed) { lastActionTime = millis(); triggerGlobalAction(0); }
-    if (btnCtrl2.pressed)        { lastActionTime = millis(); triggerGlobalAction(1); }
+    metrics.loopStart();
+    // Sin delay() en ningún sitio: cada vuelta corre las etapas y lo que haya
+    // vencido (fin de un mensaje, paso del splash, apagar un LED...)
+    scheduler.run();
 }
@@ -0,0 +1,80 @@
+#include "SimHarness.h"
+#include <ConfigManager.h>
+
+namespace harness {
+
+static LoopObserver loopObserver = nullptr;
+
+void setLoopObserver(LoopObserver observer) { loopObserver = observer; }
+
+void boot() {
+    static bool booted = false;
+    if (booted) return;
+    booted = true;
+    setup();
+}
+
+void step() {
+    uint64_t start = sim::nowUs();
+    loop();
+    if (loopObserver) loopObserver(sim::nowUs() - start);
+    sim::advance(LOOP_OVERHEAD_US);
+}
+
+void runFor(uint64_t us) {
+    uint64_t end = sim::nowUs() + us;
+    while (sim::nowUs() < end) step();
+}
+
+bool runUntil(const std::function<bool()>& done, uint64_t timeoutUs) {
+    uint64_t end = sim::nowUs() + timeoutUs;
+    while (!done()) {
+        if (sim::nowUs() >= end) return false;
+        step();
+    }
+    return true;
+}
+
+void press(uint8_t pin, uint64_t atUs, uint64_t holdUs) {
+    sim::schedulePin(atUs, pin, LOW);
+    sim::schedulePin(atUs + holdUs, pin, HIGH);
+}
+
+std::string command(const char* line, uint64_t timeoutUs) {
+    Serial.takeOutput();
+    Serial.inject(line);
+    Serial.inject("\n");
+    std::string out;
+    runUntil([&out]() {
+        out += Serial.takeOutput();
+        return out.find('\n') != std::string::npos;
+    }, timeoutUs);
+    size_t eol = out.find_first_of("\r\n");
+    return eol == std::string::npos ? out : out.substr(0, eol);
+}
+
+std::string send(const char* line) {
+    std::string reply = command(line);
+    runFor(20000);
+    return reply;
+}
+
+void freshEeprom() {
+    sim::eepromCutAfter(-1);
+    sim::eepromFill(0xFF);
+    ConfigManager cfg;
+    cfg.begin();
+}
+
+int addBanks(ConfigManager& cfg, int count) {
+    int added = 0;
+    for (; added < count; added++) {
+        cfg.waitRoom(1 + REC_PER_BANK);
+        if (!cfg.addBank()) break;
+        cfg.save();
+    }
+    cfg.flush();
+    return added;
+}
+
+} // namespace harness
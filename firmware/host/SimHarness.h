@@ -0,0 +1,62 @@
+#ifndef SIMHARNESS_H
+#define SIMHARNESS_H
+
+// Utilidades para conducir el sketch simulado desde benchmarks y tests:
+// arranque, pasos de loop(), pulsaciones programadas y comandos por USB.
+
+#include <Arduino.h>
+#include <BtSerial.h>
+#include <ConfigManager.h>
+#include <functional>
+#include <string>
+
+void setup();
+void loop();
+
+extern BtSerial btSerial;
+
+namespace harness {
+
+// Mismo mapeo de pines que controladorMidi.ino
+const uint8_t PIN_BANK_DOWN = 2;
+const uint8_t PIN_BANK_UP = 4;
+const uint8_t PIN_TOGGLE = 12;
+const uint8_t PIN_PRESET_1 = 5;
+const uint8_t PIN_PRESET_2 = 6;
+const uint8_t PIN_PRESET_3 = 7;
+const uint8_t PIN_GUITAR_CHANGE = 11;
+const uint8_t PIN_CTRL_2 = 3;
+
+// Coste fijo de llamada/retorno de loop() y del main() de Arduino (serialEventRun).
+const uint32_t LOOP_OVERHEAD_US = 20;
+
+// Observador opcional: recibe el tiempo simulado que consumió cada loop().
+typedef void (*LoopObserver)(uint64_t loopUs);
+void setLoopObserver(LoopObserver observer);
+
+void boot();                    // setup() una sola vez por proceso
+void step();                    // Una iteración de loop()
+void runFor(uint64_t us);
+bool runUntil(const std::function<bool()>& done, uint64_t timeoutUs);
+
+// Footswitch a masa en 'atUs' durante 'holdUs' (pull-up: LOW = pisado).
+void press(uint8_t pin, uint64_t atUs, uint64_t holdUs);
+
+// Envía una línea por USB y corre loop() hasta recibir una respuesta completa.
+// Devuelve la primera línea de respuesta ("" si vence el timeout).
+std::string command(const char* line, uint64_t timeoutUs = 5000000);
+
+// command() y 20 ms más, para que la respuesta salga del todo del UART
+std::string send(const char* line);
+
+// EEPROM borrada (0xFF) y formateada por un ConfigManager nuevo
+void freshEeprom();
+
+// Hasta 'count' bancos nuevos, cada uno en su lote como ADDBANK, esperando
+// sitio en la cola de la EEPROM; al volver ya es durable. Devuelve cuántos
+// se añadieron.
+int addBanks(ConfigManager& cfg, int count);
+
+} // namespace harness
+
+#endif
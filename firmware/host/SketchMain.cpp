@@ -0,0 +1,4 @@
+// Unidad de traducción del sketch para el build host.
+// Un .ino es C++ normal; el IDE solo añade prototipos, y aquí no hacen falta
+// porque las funciones del sketch ya están definidas antes de usarse.
+#include "../controladorMidi/controladorMidi.ino"
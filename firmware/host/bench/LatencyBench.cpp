@@ -0,0 +1,890 @@
+// Benchmark host: coste de loop() y latencia footswitch -> MIDI en el cable.
+//
+// Uso: latency_bench [iteraciones_por_escenario]
+//
+// Cada pulsación empieza en un instante aleatorio dentro del ciclo de loop()
+// y se mantiene 80-300 ms (lo habitual en directo). La latencia se mide desde
+// el flanco eléctrico hasta que el último byte de la acción sale por el UART.
+
+#include <SimHarness.h>
+#include <MIDI.h>
+#include <ConfigManager.h>
+#include <SerialCommander.h>
+#include <MidiOut.h>
+#include <Metrics.h>
+#include <Scheduler.h>
+#include <MidiClock.h>
+#include <MidiDictionary.h>
+#include <ExpressionPedals.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <random>
+#include <vector>
+
+using harness::press;
+using harness::runFor;
+using harness::runUntil;
+
+extern MidiOut midiOut;
+extern Metrics metrics;
+extern Scheduler scheduler;
+extern ConfigManager configManager;
+extern int currentBank;
+extern MidiClock midiClock;
+extern ExpressionPedals expression;
+
+namespace {
+
+struct Samples {
+    std::vector<double> values;
+
+    void add(double v) { values.push_back(v); }
+
+    double pct(double p) {
+        if (values.empty()) return 0;
+        std::sort(values.begin(), values.end());
+        size_t i = (size_t)(p * (values.size() - 1) + 0.5);
+        return values[i];
+    }
+};
+
+// Histograma de duración de loop() (us sim -> veces): millones de vueltas
+// caben en pocas entradas porque casi todas cuestan lo mismo.
+std::map<uint64_t, uint64_t> loopHistogram;
+void recordLoop(uint64_t us) {
+    loopHistogram[us]++;
+}
+
+double histogramPct(double p) {
+    uint64_t total = 0;
+    for (auto& kv : loopHistogram) total += kv.second;
+    uint64_t target = (uint64_t)(p * (total - 1) + 0.5);
+    uint64_t seen = 0;
+    for (auto& kv : loopHistogram) {
+        seen += kv.second;
+        if (seen > target) return (double)kv.first;
+    }
+    return 0;
+}
+
+struct Scenario {
+    const char* name;
+    uint8_t pin;
+    const char* setup; // Comando SAVE previo (o nullptr)
+};
+
+std::mt19937 rng(1234);
+
+uint32_t uniform(uint32_t lo, uint32_t hi) {
+    return std::uniform_int_distribution<uint32_t>(lo, hi)(rng);
+}
+
+// Una pulsación; devuelve la latencia en us o -1 si no salió nada.
+double measurePress(uint8_t pin) {
+    std::vector<sim::MidiEvent>& log = sim::midiLog();
+    size_t before = log.size();
+    uint64_t t0 = sim::nowUs() + uniform(500, 1500);
+    uint64_t hold = (uint64_t)uniform(80, 300) * 1000;
+    press(pin, t0, hold);
+
+    // Soltar, dejar pasar cualquier lockout y recoger la ráfaga completa.
+    runUntil([&]() { return sim::nowUs() > t0 + hold + 400000; }, 10000000);
+    if (log.size() == before) return -1;
+    return (double)(log.back().wireUs - t0);
+}
+
+// Acciones completas en el registro desde 'from': cada PC o CC de efecto
+// (el CC0 de bank select va pegado al PC y no cuenta aparte).
+int countActions(size_t from) {
+    std::vector<sim::MidiEvent>& log = sim::midiLog();
+    int n = 0;
+    for (size_t i = from; i < log.size(); i++) {
+        bool bankSelect = (log[i].status & 0xF0) == 0xB0 && log[i].data1 == 0;
+        if (!bankSelect) n++;
+    }
+    return n;
+}
+
+// Combos rápidos alternando preset (P1) y efecto (P2) cada 'spacingMs'.
+// Devuelve cuántas de 'presses' pulsaciones llegaron a MIDI.
+int runCombo(int presses, uint32_t spacingMs, uint32_t holdMs) {
+    size_t before = sim::midiLog().size();
+    uint64_t t = sim::nowUs() + 1000;
+    for (int i = 0; i < presses; i++) {
+        press(i % 2 ? harness::PIN_PRESET_2 : harness::PIN_PRESET_1, t, (uint64_t)holdMs * 1000);
+        t += (uint64_t)spacingMs * 1000;
+    }
+    runUntil([&]() { return sim::nowUs() > t + 400000; }, 60000000);
+    return countActions(before);
+}
+
+// Pisada con rebotes de contacto en ambos flancos: debe dar UNA acción.
+int runBouncyPress(uint8_t pin) {
+    size_t before = sim::midiLog().size();
+    uint64_t t = sim::nowUs() + 1000;
+    for (int i = 0; i < 6; i++) sim::schedulePin(t + i * 700, pin, i % 2 ? HIGH : LOW);
+    sim::schedulePin(t + 4200, pin, LOW);
+    uint64_t up = t + 150000;
+    for (int i = 0; i < 6; i++) sim::schedulePin(up + i * 900, pin, i % 2 ? LOW : HIGH);
+    runUntil([&]() { return sim::nowUs() > up + 400000; }, 10000000);
+    return countActions(before);
+}
+
+// Coste de un comando de configuración: tiempo hasta la respuesta (RAM al
+// día), tiempo hasta que FLUSH confirma que es durable y bytes de EEPROM
+// programados. Devuelve la peor vuelta de loop() mientras se escribía.
+uint64_t worstLoop = 0;
+void recordWorstLoop(uint64_t us) {
+    if (us > worstLoop) worstLoop = us;
+}
+
+void measureCommand(const char* line) {
+    uint64_t bytes = sim::counters().eepromBytesWritten;
+    uint64_t t0 = sim::nowUs();
+    worstLoop = 0;
+    harness::setLoopObserver(recordWorstLoop);
+    std::string reply = harness::command(line);
+    uint64_t replyUs = sim::nowUs() - t0;
+    std::string flushed = harness::command("FLUSH");
+    harness::setLoopObserver(nullptr);
+    printf("  %-26s %-16s %6.1f ms %8.1f ms %5llu B %6.2f ms%s\n", line, reply.c_str(),
+           replyUs / 1000.0, (sim::nowUs() - t0) / 1000.0,
+           (unsigned long long)(sim::counters().eepromBytesWritten - bytes), worstLoop / 1000.0,
+           flushed == "OK:FLUSHED" ? "" : "  (FLUSH sin respuesta)");
+}
+
+// Envía 'data' por Bluetooth (a la velocidad de btSerial) y corre loop()
+// hasta que la respuesta contenga 'until' y su línea haya salido entera
+// (BtSerial la saca byte a byte por interrupciones). Devuelve lo recibido
+// ("" si vence).
+std::string btExchange(const std::string& data, const char* until, uint64_t timeoutUs = 10000000) {
+    btSerial.takeOutput();
+    btSerial.feed(data.c_str(), sim::nowUs());
+    std::string out;
+    bool ok = runUntil([&]() {
+        out += btSerial.takeOutput();
+        return out.find(until) != std::string::npos && out.back() == '\n';
+    }, timeoutUs);
+    return ok ? out : "";
+}
+
+// Rig completo: nombre y 3 slots de cada banco + los 2 globales
+std::vector<std::string> rigLines(int banks) {
+    std::vector<std::string> lines;
+    char buf[48];
+    for (int b = 0; b < banks; b++) {
+        snprintf(buf, sizeof(buf), "SAVEBANK:%d:SONG %d", b, b);
+        lines.push_back(buf);
+        for (int p = 0; p < 3; p++) {
+            snprintf(buf, sizeof(buf), "SAVE:%d:%d:S%dP%d:P:%d:0:C:20:127:R", b, p, b, p, b * 3 + p);
+            lines.push_back(buf);
+        }
+    }
+    lines.push_back("SAVEGLO:0:LAT:P:9:0");
+    lines.push_back("SAVEGLO:1:CEN:D:6:0");
+    return lines;
+}
+
+// GETALL completo pidiendo ventana tras ventana, como la App.
+// Devuelve los ítems recibidos.
+int btDump() {
+    int items = 0;
+    int from = 0;
+    while (from >= 0) {
+        std::string out = btExchange("GETALL:" + std::to_string(from) + "\n", "\n", 5000000);
+        size_t more;
+        while ((more = out.find("MORE:")) == std::string::npos && out.find("END:CONFIG:") == std::string::npos) {
+            std::string tail = btExchange("", "\n", 5000000);
+            if (tail.empty()) return items;
+            out += tail;
+        }
+        for (char c : out) items += c == '|';
+        from = more == std::string::npos ? -1 : atoi(out.c_str() + more + 5);
+    }
+    return items;
+}
+
+// Cambio de banco con el rig entero: el banco nuevo tiene que estar en RAM
+// (precargado) o leerse de EEPROM en el momento. El simulador no cobra las
+// lecturas, así que se suman aparte a ~1 us por byte (EEPROM.read() en AVR).
+// El peor loop() incluye los ~3 ms de I2C que el LCD se permite por vuelta.
+const double EEPROM_READ_US = 1.0;
+
+int benchBankSwitch(int banks) {
+    printf("\nbank switch (%d banks, %d in RAM)\n", banks, CFG_PAGES);
+    worstLoop = 0;
+    harness::setLoopObserver(recordWorstLoop);
+    double worstUs = 0;
+    unsigned int misses = configManager.pageMisses();
+    uint64_t reads = sim::counters().eepromBytesRead;
+    int presses = 0;
+    const uint8_t pins[] = {harness::PIN_BANK_UP, harness::PIN_BANK_DOWN, harness::PIN_TOGGLE};
+    for (uint8_t pin : pins) {
+        // Vuelta entera hacia arriba, otra hacia abajo; luego ida y vuelta con TOGGLE
+        int n = pin == harness::PIN_TOGGLE ? 8 : banks + 1;
+        for (int i = 0; i < n; i++, presses++) {
+            uint64_t before = sim::counters().eepromBytesRead;
+            worstLoop = 0;
+            uint64_t t0 = sim::nowUs() + 1000;
+            press(pin, t0, 80000);
+            runUntil([&]() { return sim::nowUs() > t0 + 300000; }, 1000000);
+            worstUs = std::max(worstUs, worstLoop + (sim::counters().eepromBytesRead - before) * EEPROM_READ_US);
+        }
+    }
+    unsigned int stepMisses = configManager.pageMisses() - misses;
+    printf("  up/down/toggle   %3d presses, %u misses, %llu B prefetched, worst loop %.2f ms\n", presses, stepMisses,
+           (unsigned long long)(sim::counters().eepromBytesRead - reads), worstUs / 1000.0);
+
+    // Salto a un banco lejano sin precarga: lo que cuesta leer una página
+    uint64_t before = sim::counters().eepromBytesRead;
+    uint64_t t0 = sim::nowUs();
+    int far = (currentBank + banks / 2) % banks;
+    bool wasPaged = configManager.isPaged(far);
+    configManager.getBankName(far);
+    double missUs = (sim::nowUs() - t0) + (sim::counters().eepromBytesRead - before) * EEPROM_READ_US;
+    printf("  cold page load   bank %d, %llu B read, %.2f ms\n", far,
+           (unsigned long long)(sim::counters().eepromBytesRead - before), missUs / 1000.0);
+    harness::setLoopObserver(nullptr);
+
+    if (stepMisses != 0 || wasPaged || missUs > 2000) {
+        printf("FAIL: cambio de banco lento o sin precarga\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Coste de parseo por comando, ASCII frente a trama binaria. Dentro de una
+// transacción para que no cuenten las respuestas; 'reps' copias en un solo update().
+double parseNs(SerialCommander& commander, const std::vector<uint8_t>& cmd, int reps) {
+    for (int i = 0; i < reps; i++) {
+        for (uint8_t c : cmd) Serial.injectByte(c);
+    }
+    auto start = std::chrono::steady_clock::now();
+    commander.update(Serial);
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    return (double)ns / reps;
+}
+
+std::vector<uint8_t> asciiBytes(const char* line) {
+    std::vector<uint8_t> v(line, line + strlen(line));
+    v.push_back('\n');
+    return v;
+}
+
+std::vector<uint8_t> frameBytes(uint8_t op, const std::vector<uint8_t>& payload) {
+    uint8_t out[BF_FRAME_MAX];
+    uint8_t n = encodeFrame(op, payload.data(), payload.size(), out);
+    return std::vector<uint8_t>(out, out + n);
+}
+
+void benchProtocols() {
+    ConfigManager cfg;
+    cfg.begin();
+    SerialCommander commander(&cfg);
+    Serial.takeOutput();
+    commander.update(Serial);
+    Serial.inject("BEGINTX\n");
+    commander.update(Serial);
+
+    ButtonConfig wah = {"WAH", 'C', 20, 127, 'C', 21, 127, 'S'};
+    std::vector<uint8_t> save = {0, 2};
+    save.insert(save.end(), (uint8_t*)&wah, (uint8_t*)&wah + sizeof(wah));
+    std::vector<uint8_t> glo = {1};
+    glo.insert(glo.end(), (uint8_t*)&wah, (uint8_t*)&wah + sizeof(wah));
+    std::vector<uint8_t> bank = {0, 'C', 'H', 'O', 'R', 'U', 'S'};
+
+    struct Row {
+        const char* name;
+        std::vector<uint8_t> ascii;
+        std::vector<uint8_t> binary;
+    } rows[] = {
+        {"SAVE", asciiBytes("SAVE:0:2:WAH:C:20:127:C:21:127:S"), frameBytes(BF_OP_SAVE, save)},
+        {"SAVEGLO", asciiBytes("SAVEGLO:1:WAH:C:20:127"), frameBytes(BF_OP_SAVEGLO, glo)},
+        {"SAVEBANK", asciiBytes("SAVEBANK:0:CHORUS"), frameBytes(BF_OP_SAVEBANK, bank)},
+        {"GETALL", asciiBytes("GETALL:8:8"), frameBytes(BF_OP_GETALL, {8, 0, 8})},
+    };
+    printf("\nconfig protocol: ascii vs binary frames\n");
+    printf("  %-9s %9s %9s %12s %12s\n", "command", "ascii B", "binary B", "ascii ns", "binary ns");
+    const int REPS = 2000;
+    for (Row& row : rows) {
+        if (strcmp(row.name, "GETALL") == 0) {
+            // Petición de ventana: lo que cuenta es la respuesta (abajo)
+            printf("  %-9s %9zu %9zu %12s %12s\n", row.name, row.ascii.size(), row.binary.size(), "-", "-");
+            continue;
+        }
+        double a = parseNs(commander, row.ascii, REPS);
+        double b = parseNs(commander, row.binary, REPS);
+        printf("  %-9s %9zu %9zu %12.0f %12.0f\n", row.name, row.ascii.size(), row.binary.size(), a, b);
+    }
+    Serial.inject("ABORT\n");
+    commander.update(Serial);
+
+    // Volcado completo por cada protocolo: bytes en el cable
+    size_t bytes[2];
+    for (int binary = 0; binary < 2; binary++) {
+        Serial.takeOutput();
+        int from = 0, total = 3 + 4 * cfg.getActiveBanksCount() + MACRO_COUNT * MACRO_STEPS;
+        size_t sum = 0;
+        while (from < total) {
+            char line[24];
+            snprintf(line, sizeof(line), "GETALL:%d:8", from);
+            std::vector<uint8_t> req = binary ? frameBytes(BF_OP_GETALL, {(uint8_t)from, 0, 8}) : asciiBytes(line);
+            for (uint8_t c : req) Serial.injectByte(c);
+            for (int i = 0; i < 200; i++) {
+                commander.update(Serial);
+                sim::advance(1000);
+            }
+            sum += Serial.takeOutput().size();
+            from += 8;
+        }
+        bytes[binary] = sum;
+    }
+    printf("  full dump %d items: %zu B ascii, %zu B binary (%.0f%%)\n",
+           3 + 4 * cfg.getActiveBanksCount() + MACRO_COUNT * MACRO_STEPS,
+           bytes[0], bytes[1], 100.0 * bytes[1] / bytes[0]);
+}
+
+void printRow(const char* name, Samples& s, int missed) {
+    printf("%-8s %5zu %8.2f %8.2f %8.2f %8.2f %8.2f %7d\n", name, s.values.size(),
+           s.pct(0) / 1000.0, s.pct(0.5) / 1000.0, s.pct(0.95) / 1000.0,
+           s.pct(0.99) / 1000.0, s.pct(1) / 1000.0, missed);
+}
+
+// Macro de 4 CC a 0/0/50/100 ms en el preset 1 (modo I): pisada -> cable
+// del primer y del último paso, y desvío de cada paso respecto a su plazo
+// nominal contado desde el primero. Devuelve las pisadas sin macro completa.
+int benchMacro(int iterations) {
+    const char* setup[] = { "MACRO:0:0:C:20:1:0", "MACRO:0:1:C:21:2:0", "MACRO:0:2:C:22:3:50",
+                            "MACRO:0:3:C:23:4:50", "MACRO:0:4:N:0:0:0", "SAVE:0:0:MAC:M:0:0:N:0:0:I" };
+    for (const char* line : setup) {
+        if (harness::command(line).compare(0, 3, "OK:") != 0) {
+            printf("FAIL: %s rechazado\n", line);
+            return iterations;
+        }
+        runFor(50000);
+    }
+
+    const uint64_t OFFSETS[] = { 0, 0, 50000, 100000 };
+    Samples first, last, jitter;
+    int missed = 0;
+    std::vector<sim::MidiEvent>& log = sim::midiLog();
+    for (int i = 0; i < iterations; i++) {
+        size_t before = log.size();
+        uint64_t t0 = sim::nowUs() + uniform(500, 1500);
+        press(harness::PIN_PRESET_1, t0, (uint64_t)uniform(80, 300) * 1000);
+        runUntil([&]() { return sim::nowUs() > t0 + 600000; }, 10000000);
+
+        std::vector<sim::MidiEvent> steps;
+        for (size_t k = before; k < log.size(); k++) {
+            if (log[k].status == 0xB0 && log[k].data1 >= 20 && log[k].data1 <= 23) steps.push_back(log[k]);
+        }
+        if (steps.size() != 4) {
+            missed++;
+            continue;
+        }
+        first.add(steps[0].wireUs - t0);
+        last.add(steps[3].wireUs - t0);
+        for (int k = 1; k < 4; k++) {
+            int64_t err = (int64_t)(steps[k].queuedUs - steps[0].queuedUs) - (int64_t)OFFSETS[k];
+            jitter.add((double)(err < 0 ? -err : err));
+        }
+    }
+
+    printf("\nmacro dispatch (4 CC at 0/0/50/100 ms, edge->wire ms)\n");
+    printf("%-8s %5s %8s %8s %8s %8s %8s %7s\n", "step", "n", "min", "p50", "p95", "p99", "max", "missed");
+    printRow("first", first, missed);
+    printRow("last", last, missed);
+    printf("  step offset error: p50 %.0f us, p99 %.0f us, max %.0f us\n", jitter.pct(0.5), jitter.pct(0.99),
+           jitter.pct(1));
+    return missed;
+}
+
+// Escenas: mensajes, bytes y pisada -> último byte por recuperación. P1 y P2
+// son el mismo programa con escenas distintas (solo los CC que cambian, sin
+// PC); P3 es otro programa con la escena de P1, así que P3 y el P1 de
+// después la mandan entera tras el PC, lo que costaría cada cambio sin el
+// estado conocido de MidiOut. Devuelve 1 si un cambio de escena manda de más.
+int benchScenes(int iterations) {
+    const uint16_t A = 1u << DICT_DIST | 1u << DICT_DLY | 1u << DICT_REV;
+    const uint16_t B = 1u << DICT_DIST | 1u << DICT_MOD | 1u << DICT_CTRL1;
+    char sceneA[24], sceneB[24], sceneC[24];
+    snprintf(sceneA, sizeof(sceneA), "SCENE:0:0:%u", A);
+    snprintf(sceneB, sizeof(sceneB), "SCENE:0:1:%u", B);
+    snprintf(sceneC, sizeof(sceneC), "SCENE:0:2:%u", A);
+    const char* setup[] = { "SAVE:0:0:SCA:P:5:0:N:0:0:I", "SAVE:0:1:SCB:P:5:0:N:0:0:I",
+                            "SAVE:0:2:SCC:P:9:0:N:0:0:I", sceneA, sceneB, sceneC };
+    for (const char* line : setup) {
+        if (harness::command(line).compare(0, 3, "OK:") != 0) {
+            printf("FAIL: %s rechazado\n", line);
+            return 1;
+        }
+        runFor(50000);
+    }
+
+    struct Row {
+        const char* name;
+        uint8_t pin;
+        Samples msgs, bytes, lat;
+    } rows[] = {
+        {"same program", harness::PIN_PRESET_2, {}, {}, {}},
+        {"new program", harness::PIN_PRESET_3, {}, {}, {}},
+        {"back (new)", harness::PIN_PRESET_1, {}, {}, {}},
+    };
+    std::vector<sim::MidiEvent>& log = sim::midiLog();
+    measurePress(harness::PIN_PRESET_1);
+    for (int i = 0; i < iterations; i++) {
+        for (Row& row : rows) {
+            size_t before = log.size();
+            double us = measurePress(row.pin);
+            int n = (int)(log.size() - before), b = 0;
+            for (size_t k = before; k < log.size(); k++) b += (log[k].status & 0xF0) == 0xC0 ? 2 : 3;
+            row.msgs.add(n);
+            row.bytes.add(b);
+            if (us >= 0) row.lat.add(us);
+        }
+    }
+
+    int diff = __builtin_popcount(A ^ B), full = __builtin_popcount(DICT_SCENE_MASK);
+    printf("\nscene recall (A/B same program: %d CC differ; full scene: %d CC)\n", diff, full);
+    printf("  %-14s %6s %6s %10s %10s\n", "recall", "msgs", "bytes", "p50 ms", "max ms");
+    for (Row& row : rows) {
+        printf("  %-14s %6.0f %6.0f %10.2f %10.2f\n", row.name, row.msgs.pct(0.5), row.bytes.pct(0.5),
+               row.lat.pct(0.5) / 1000.0, row.lat.pct(1) / 1000.0);
+    }
+
+    for (int p = 0; p < 3; p++) {
+        char line[16];
+        snprintf(line, sizeof(line), "SCENE:0:%d:-", p);
+        harness::command(line);
+    }
+    if (rows[0].msgs.pct(1) != diff) {
+        printf("FAIL: el cambio de escena manda %.0f mensajes, no %d\n", rows[0].msgs.pct(1), diff);
+        return 1;
+    }
+    return 0;
+}
+
+// Instantes de fin de cada loop(): referencia de un reloj generado desde loop()
+std::vector<uint64_t> loopEnds;
+
+void recordLoopEnd(uint64_t us) {
+    recordLoop(us);
+    loopEnds.push_back(sim::nowUs());
+}
+
+// Reloj MIDI a 120 BPM mientras loop() trabaja: GETALL, ediciones que
+// escriben la EEPROM, efectos y cambios de banco que redibujan el LCD.
+// Retraso de cada 0xF8 respecto a la rejilla nominal y error entre
+// pulsos seguidos; al lado, lo que daría el mismo reloj enviado desde loop()
+// (primer fin de vuelta tras cada plazo). Devuelve 1 si el ISR se pasa.
+int benchClock() {
+    const double PULSE = 500000.0 / 24;
+    const uint64_t BYTE_US = 320;
+    if (harness::command("CLOCK:120") != "OK:CLOCK") {
+        printf("FAIL: CLOCK rechazado\n");
+        return 1;
+    }
+    runFor(100000);
+    std::vector<sim::MidiEvent>& log = sim::midiLog();
+    size_t from = log.size();
+    loopEnds.clear();
+    harness::setLoopObserver(recordLoopEnd);
+
+    const int CHUNKS = 8;
+    char line[40];
+    for (int i = 0; i < CHUNKS; i++) {
+        uint64_t t0 = sim::nowUs();
+        snprintf(line, sizeof(line), "SAVE:0:2:WAH:C:%d:0:N:0:0", 20 + i);
+        harness::command(line);
+        harness::command("GETALL");
+        press(harness::PIN_PRESET_2, t0 + 100000, 60000);
+        press(i % 2 ? harness::PIN_BANK_DOWN : harness::PIN_BANK_UP, t0 + 250000, 60000);
+        runUntil([&]() { return sim::nowUs() > t0 + 500000; }, 10000000);
+    }
+    harness::setLoopObserver(recordLoop);
+    harness::command("CLOCK:0");
+
+    std::vector<uint64_t> pulses;
+    for (size_t k = from; k < log.size(); k++) {
+        if (log[k].status == 0xF8) pulses.push_back(log[k].wireUs - BYTE_US);
+    }
+    if (pulses.size() < 2) {
+        printf("FAIL: reloj MIDI sin pulsos\n");
+        return 1;
+    }
+    // Rejilla nominal: la del pulso que salió más pronto (los demás van tarde)
+    double origin = pulses[0];
+    for (size_t k = 0; k < pulses.size(); k++) origin = std::min(origin, pulses[k] - k * PULSE);
+    Samples phase, interval, loopPhase, loopInterval;
+    size_t end = 0;
+    uint64_t prevLoop = 0;
+    for (size_t k = 0; k < pulses.size(); k++) {
+        double due = origin + k * PULSE;
+        phase.add(pulses[k] - due);
+        if (k) interval.add(std::abs((double)(pulses[k] - pulses[k - 1]) - PULSE));
+        while (end < loopEnds.size() && loopEnds[end] < due) end++;
+        if (end == loopEnds.size()) continue;
+        loopPhase.add(loopEnds[end] - due);
+        if (k) loopInterval.add(std::abs((double)(loopEnds[end] - prevLoop) - PULSE));
+        prevLoop = loopEnds[end];
+    }
+
+    printf("\nmidi clock 120 BPM under load (%zu pulses, error us)\n", pulses.size());
+    printf("  %-16s %8s %8s %8s\n", "", "p50", "p99", "max");
+    printf("  %-16s %8.0f %8.0f %8.0f\n", "isr phase", phase.pct(0.5), phase.pct(0.99), phase.pct(1));
+    printf("  %-16s %8.0f %8.0f %8.0f\n", "isr interval", interval.pct(0.5), interval.pct(0.99), interval.pct(1));
+    printf("  %-16s %8.0f %8.0f %8.0f\n", "loop() phase", loopPhase.pct(0.5), loopPhase.pct(0.99), loopPhase.pct(1));
+    printf("  %-16s %8.0f %8.0f %8.0f\n", "loop() interval", loopInterval.pct(0.5), loopInterval.pct(0.99),
+           loopInterval.pct(1));
+    // Como mucho detrás de los dos bytes que ya estaban en el UART
+    if (phase.pct(1) > 2 * BYTE_US + 2 * CLOCK_RETRY_TICKS * CLOCK_TICK_US) {
+        printf("FAIL: reloj MIDI fuera de rejilla\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Vueltas de loop() de una fase del bench de pedales (además del histograma global)
+Samples phaseLoops;
+void recordPhaseLoop(uint64_t us) {
+    recordLoop(us);
+    phaseLoops.add(us);
+}
+
+// Pedal de expresión (A2, CC 11, lineal) con ruido de +-'noise' cuentas:
+// quieto, y de talón a punta y vuelta cada 'sweepMs', con una pisada de
+// preset a mitad de cada barrido. CC por segundo, parte del cable MIDI que
+// usan, vueltas de loop() y latencia de la pisada frente al pedal quieto.
+int benchExpression(int iterations) {
+    const uint8_t CH = 2;
+    const byte CC = 11;
+    const uint64_t SWEEP_US = 400000;
+    const uint16_t NOISE = 4;
+    const double LINK_BYTES_S = 3125.0;
+    sim::setAnalog(CH, 0, NOISE);
+    runFor(50000);
+    if (harness::command("EXP:0:11:L") != "OK:EXP_SAVED") {
+        printf("FAIL: EXP rechazado\n");
+        return 1;
+    }
+    runFor(50000);
+    std::vector<sim::MidiEvent>& log = sim::midiLog();
+    int rounds = std::max(2, std::min(iterations / 5, 40));
+
+    struct Phase {
+        const char* name;
+        bool moving;
+        Samples lat;
+        Samples loops;
+        double hostNs = 0;       // Por vuelta de loop(), ISR del ADC simulado incluido
+        size_t ccs = 0;
+        double minGapMs = 1e9;
+    } phases[] = { {"pedal still", false, {}, {}}, {"pedal sweeping", true, {}, {}} };
+
+    for (Phase& ph : phases) {
+        phaseLoops.values.clear();
+        harness::setLoopObserver(recordPhaseLoop);
+        auto h0 = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; r++) {
+            uint64_t t0 = sim::nowUs();
+            size_t from = log.size();
+            if (ph.moving) {
+                int a = r % 2 ? 1023 : 0, b = r % 2 ? 0 : 1023;
+                for (uint64_t t = 0; t <= SWEEP_US; t += 1000) {
+                    int v = a + (int)((b - a) * (int64_t)t / (int64_t)SWEEP_US);
+                    sim::at(t0 + t, [CH, v, NOISE]() { sim::setAnalog(CH, v, NOISE); });
+                }
+            }
+            // Pisada a mitad del barrido; latencia hasta que su PC sale del UART
+            uint64_t tp = t0 + SWEEP_US / 2 + uniform(0, 1000);
+            press(harness::PIN_PRESET_1, tp, 100000);
+            runUntil([&]() { return sim::nowUs() > t0 + SWEEP_US + 300000; }, 10000000);
+            uint64_t prev = 0;
+            bool pc = false;
+            for (size_t k = from; k < log.size(); k++) {
+                if (!pc && (log[k].status & 0xF0) == 0xC0 && log[k].queuedUs >= tp) {
+                    ph.lat.add(log[k].wireUs - tp);
+                    pc = true;
+                }
+                if ((log[k].status & 0xF0) != 0xB0 || log[k].data1 != CC) continue;
+                if (prev) ph.minGapMs = std::min(ph.minGapMs, (log[k].queuedUs - prev) / 1000.0);
+                prev = log[k].queuedUs;
+                ph.ccs++;
+            }
+        }
+        ph.hostNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - h0).count() /
+                    std::max<size_t>(1, phaseLoops.values.size());
+        ph.loops = phaseLoops;
+    }
+    harness::setLoopObserver(recordLoop);
+
+    printf("\nexpression pedal (A2, %d rounds, %.0f ms sweeps, noise +-%u)\n", rounds, SWEEP_US / 1000.0,
+           NOISE);
+    printf("  %-15s %7s %7s %7s %9s %9s %8s %10s %10s\n", "", "CC/s", "link %", "gap ms", "loop p50",
+           "loop p99", "host ns", "PC p50 ms", "PC max ms");
+    for (Phase& ph : phases) {
+        double rate = ph.ccs / (rounds * SWEEP_US / 1e6); // Mientras dura el barrido
+        printf("  %-15s %7.1f %7.2f %7.1f %9.0f %9.0f %8.0f %10.2f %10.2f\n", ph.name, rate,
+               100.0 * rate * 3 / LINK_BYTES_S, ph.ccs > 1 ? ph.minGapMs : 0.0, ph.loops.pct(0.5),
+               ph.loops.pct(0.99), ph.hostNs, ph.lat.pct(0.5) / 1000.0, ph.lat.pct(1) / 1000.0);
+    }
+    printf("  cap %d CC/s per pedal; adc isr %.0f conv/s, %lu readings, %lu values coalesced\n",
+           1000 / EXP_INTERVAL_MS, (double)sim::counters().adcConversions / (sim::nowUs() / 1e6),
+           expression.readings(), expression.coalesced());
+
+    harness::command("EXP:0:0:L");
+    sim::setAnalog(CH, 0);
+    runFor(50000);
+    if (phases[0].ccs) {
+        printf("FAIL: el pedal quieto mandó %zu CC\n", phases[0].ccs);
+        return 1;
+    }
+    if (phases[1].minGapMs < EXP_INTERVAL_MS - 1) {
+        printf("FAIL: CC del pedal a %.1f ms\n", phases[1].minGapMs);
+        return 1;
+    }
+    // El pedal no retrasa una pisada más que un CC ya en el UART (3 bytes)
+    if (phases[1].lat.values.size() != (size_t)rounds || phases[1].lat.pct(1) > phases[0].lat.pct(1) + 1000) {
+        printf("FAIL: el pedal retrasa las pisadas\n");
+        return 1;
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 200;
+    if (iterations < 1) iterations = 1;
+
+    printf("== controladorMidi host benchmark ==\n");
+
+    // Equipo ya en uso: EEPROM formateada (el primer arranque de fábrica la
+    // escribe entera). Luego "encendemos" con P1 pisado a los 20 ms.
+    {
+        ConfigManager formatted;
+        formatted.begin();
+    }
+    sim::reset();
+    press(harness::PIN_PRESET_1, 20000, 60000);
+    harness::boot();
+    printf("setup(): %.1f ms (sim)\n", sim::nowUs() / 1000.0);
+    if (!runUntil([]() { return !sim::midiLog().empty(); }, 5000000)) {
+        printf("FAIL: ningún MIDI tras el arranque\n");
+        return 1;
+    }
+    printf("boot -> first MIDI: %.1f ms (P1 pisado a los 20 ms, 60 ms)\n",
+           sim::midiLog().front().wireUs / 1000.0);
+
+    // Preset 2 como efecto (DLY) para medir el camino 'D'.
+    if (harness::command("SAVE:0:1:FX:D:3:0:N:0:0") != "OK:SAVED") {
+        printf("FAIL: SAVE rechazado\n");
+        return 1;
+    }
+    runFor(500000);
+
+    // --- Coste de loop() en reposo ---
+    const int IDLE_LOOPS = 10000;
+    uint64_t simStart = sim::nowUs();
+    auto hostStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < IDLE_LOOPS; i++) loop();
+    auto hostNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - hostStart).count();
+    printf("loop() idle: %.1f us/iter (sim), %.0f ns/iter (host)\n",
+           (double)(sim::nowUs() - simStart) / IDLE_LOOPS, (double)hostNs / IDLE_LOOPS);
+
+    // --- Latencia por tipo de acción ---
+    // Historial para Toggle: P1 -> P3 deja 'previous' válido.
+    measurePress(harness::PIN_PRESET_1);
+    measurePress(harness::PIN_PRESET_3);
+
+    Scenario scenarios[] = {
+        {"preset", harness::PIN_PRESET_1, nullptr},
+        {"effect", harness::PIN_PRESET_2, nullptr},
+        {"toggle", harness::PIN_TOGGLE, nullptr},
+        {"global", harness::PIN_GUITAR_CHANGE, nullptr},
+        // Disparo al pisar: inmediato sin Long Press y especulativo con él
+        {"preset-I", harness::PIN_PRESET_1, "SAVE:0:0:P1:P:0:0:N:0:0:I"},
+        {"preset-S", harness::PIN_PRESET_1, "SAVE:0:0:P1:P:0:0:C:20:127:S"},
+    };
+
+    harness::setLoopObserver(recordLoop);
+
+    printf("\nedge->wire latency (ms)\n");
+    printf("%-8s %5s %8s %8s %8s %8s %8s %7s\n", "action", "n", "min", "p50", "p95", "p99", "max", "missed");
+    int totalMissed = 0;
+    for (Scenario& sc : scenarios) {
+        if (sc.setup && harness::command(sc.setup) != "OK:SAVED") {
+            printf("FAIL: %s rechazado\n", sc.setup);
+            return 1;
+        }
+        Samples lat;
+        int missed = 0;
+        for (int i = 0; i < iterations; i++) {
+            double us = measurePress(sc.pin);
+            if (us < 0) missed++;
+            else lat.add(us);
+        }
+        printRow(sc.name, lat, missed);
+        totalMissed += missed;
+    }
+
+    // --- Persistencia: latencia y bytes escritos por comando ---
+    printf("\nconfig save cost (write-behind)\n");
+    printf("  %-26s %-16s %9s %11s %7s %9s\n", "command", "reply", "reply", "durable", "bytes", "max loop");
+    const char* saves[] = {
+        "SAVE:0:2:WAH:C:20:0:N:0:0",
+        "SAVE:0:2:WAH:C:21:0:N:0:0",
+        "SAVEGLO:0:LAT:P:5:0",
+        "SAVEBANK:0:VERSE",
+        "ADDBANK",
+        "SAVEBANK:1:CHORUS",
+        "DELBANK:0",
+        "RESET",
+    };
+    for (const char* line : saves) measureCommand(line);
+
+    benchProtocols();
+
+    // --- Subida de un rig completo por Bluetooth ---
+    // Sin módulo, el aprovisionamiento prueba las 4 velocidades y suelta el
+    // puerto a 9600 tras el último timeout.
+    runFor(7000000);
+    while (harness::command("ADDBANK") == "OK:BANK_ADDED") {}
+    int banks = MAX_BANKS_CFG;
+    std::vector<std::string> rig = rigLines(banks);
+    printf("\nrig upload over BT @%ld (%zu lines)\n", btSerial.baud(), rig.size());
+
+    uint64_t t0 = sim::nowUs();
+    int acked = 0;
+    for (const std::string& line : rig) {
+        if (!btExchange(line + "\n", "\n").empty()) acked++;
+    }
+    printf("  line by line (wait OK)  %8.1f ms  %d/%zu acked\n", (sim::nowUs() - t0) / 1000.0, acked, rig.size());
+
+    // Una sola transacción, por ventanas que terminan en TXSYNC, como la App:
+    // la siguiente no sale hasta su OK:TX_SYNC, así que lo que llega mientras
+    // el pedal espera a la EEPROM nunca pasa de su apartado + el ring RX.
+    const size_t TX_WINDOW_BYTES = 96;
+    uint64_t dropped = sim::counters().btRxDropped;
+    t0 = sim::nowUs();
+    btExchange("BEGINTX\n", "OK:TX_BEGIN");
+    size_t sent = 0;
+    size_t synced = 0;
+    int windows = 0;
+    for (size_t first = 0; first < rig.size() && synced == sent; windows++) {
+        std::string window;
+        while (first < rig.size() && window.size() + rig[first].size() + 1 + strlen("TXSYNC\n") <= TX_WINDOW_BYTES) {
+            window += rig[first++] + "\n";
+            sent++;
+        }
+        std::string sync = btExchange(window + "TXSYNC\n", "OK:TX_SYNC:");
+        size_t at = sync.find("OK:TX_SYNC:");
+        synced = at == std::string::npos ? 0 : atoi(sync.c_str() + at + 11);
+    }
+    std::string commit = btExchange("COMMIT\n", "OK:TX_COMMIT:");
+    uint64_t replyUs = sim::nowUs() - t0;
+    size_t at = commit.find("OK:TX_COMMIT:");
+    size_t committed = at == std::string::npos ? 0 : atoi(commit.c_str() + at + 13);
+    bool durable = !btExchange("FLUSH\n", "OK:FLUSHED").empty();
+    printf("  BEGINTX + %2d windows  %8.1f ms  %zu/%zu committed, durable after %.1f ms, %llu RX bytes dropped\n",
+           windows, replyUs / 1000.0, committed, rig.size(), (sim::nowUs() - t0) / 1000.0,
+           (unsigned long long)(sim::counters().btRxDropped - dropped));
+    if (committed != rig.size() || !durable || sim::counters().btRxDropped != dropped) {
+        printf("FAIL: transacción incompleta\n");
+        return 1;
+    }
+
+    // --- Lectura del rig: GETALL por ventanas ---
+    worstLoop = 0;
+    harness::setLoopObserver(recordWorstLoop);
+    t0 = sim::nowUs();
+    int items = btDump();
+    printf("  GETALL in windows       %8.1f ms  %d items, max loop %.2f ms\n",
+           (sim::nowUs() - t0) / 1000.0, items, worstLoop / 1000.0);
+    if (items != 3 + 4 * banks + MACRO_COUNT * MACRO_STEPS) {
+        printf("FAIL: volcado incompleto\n");
+        return 1;
+    }
+
+    if (benchBankSwitch(banks) != 0) return 1;
+
+    harness::command("SAVE:0:1:FX:D:3:0:N:0:0");
+    harness::setLoopObserver(recordLoop);
+
+    // --- Throughput de pulsaciones distintas ---
+    harness::command("SAVE:0:0:P1:P:0:0:N:0:0:I");
+    harness::command("SAVE:0:1:FX:D:3:0:N:0:0:I");
+    printf("\ncombo throughput (P1/P2 alternos, hold 60 ms)\n");
+    const int COMBO_PRESSES = 40;
+    const uint32_t spacings[] = {300, 200, 150, 120};
+    for (uint32_t spacing : spacings) {
+        int delivered = runCombo(COMBO_PRESSES, spacing, 60);
+        printf("  every %3u ms: %2d/%d delivered, %.1f presses/s\n", spacing, delivered,
+               COMBO_PRESSES, delivered * 1000.0 / (COMBO_PRESSES * spacing));
+        if (delivered != COMBO_PRESSES) totalMissed += COMBO_PRESSES - delivered;
+    }
+
+    // --- Macros: varios mensajes con retardos desde una pisada ---
+    totalMissed += benchMacro(iterations);
+
+    // --- Escenas: cuánto MIDI cuesta cada recuperación ---
+    if (benchScenes(iterations) != 0) return 1;
+    harness::command("SAVE:0:0:P1:P:0:0:N:0:0:I");
+    harness::command("SAVE:0:1:FX:D:3:0:N:0:0:I");
+
+    // --- Reloj MIDI desde el ISR frente a loop() ---
+    if (benchClock() != 0) return 1;
+
+    // --- Pedal de expresión: CC por segundo y lo que cuesta a loop() ---
+    if (benchExpression(iterations) != 0) return 1;
+
+    // --- Doble disparo ---
+    int bouncy = runBouncyPress(harness::PIN_PRESET_1);
+    printf("bouncy press -> %d action(s)\n", bouncy);
+    if (bouncy != 1) {
+        printf("FAIL: rebote generó %d acciones\n", bouncy);
+        return 1;
+    }
+
+    // --- Salida MIDI: lo que la cola se ahorró en todo el benchmark ---
+    printf("\nmidi tx: %lu sent, %lu suppressed, %lu bytes saved, %u queue overflows\n", midiOut.sent(),
+           midiOut.suppressed(), midiOut.bytesSaved(), midiOut.overflows());
+
+    harness::setLoopObserver(nullptr);
+    uint64_t loops = 0;
+    for (auto& kv : loopHistogram) loops += kv.second;
+    printf("\nloop() under load: n=%llu p50=%.0f us p99=%.0f us max=%.1f ms (sim)\n",
+           (unsigned long long)loops, histogramPct(0.5), histogramPct(0.99),
+           loopHistogram.rbegin()->first / 1000.0);
+
+    // --- Lo mismo visto desde el pedal (STATS): cubetas log2 de 16 bits ---
+    if (Metrics::enabled) {
+        static const char* const NAMES[MET_HISTS] = { "loop us", "edge ms", "eeprom us" };
+        printf("\non-device metrics (STATS)\n");
+        for (byte h = 0; h < MET_HISTS; h++) {
+            printf("  %-10s", NAMES[h]);
+            for (byte b = 0; b < MET_BUCKETS; b++) printf(" %6u", metrics.count(h, b));
+            printf("  max %u\n", metrics.maximum(h));
+        }
+    }
+
+    // --- Planificador: peor tiempo de cada tarea frente a su rodaja ---
+    printf("\nscheduler tasks (worst / slice, us)\n");
+    for (byte i = 0; i < scheduler.count(); i++) {
+        printf("  %-11s %5u / %5u\n", scheduler.name(i), scheduler.worst(i), scheduler.slice(i));
+    }
+    if (sim::counters().sliceOverruns) {
+        printf("FAIL: %llu tareas pasadas de su rodaja\n", (unsigned long long)sim::counters().sliceOverruns);
+        return 1;
+    }
+
+    if (totalMissed) {
+        printf("FAIL: %d pulsaciones sin MIDI\n", totalMissed);
+        return 1;
+    }
+    return 0;
+}
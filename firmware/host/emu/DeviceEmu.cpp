@@ -0,0 +1,206 @@
+// Emulador del pedal sin placa: el firmware del build host (SerialCommander,
+// ConfigManager y la EEPROM simulada) detrás de un puerto serie de verdad.
+//
+// Lo que llega por stdin (o por el pty con --pty) entra al UART simulado byte
+// a byte a la velocidad del enlace; lo que el sketch escribe sale por stdout
+// al ritmo del cable. El reloj virtual va atado al de pared (--speed lo
+// acelera), así que los plazos de la App (reintentos a 1 s, timeouts) se
+// comportan como con el pedal. Los avisos van a stderr; "device_emu: listo"
+// marca el final del arranque.
+//
+// Uso: device_emu [--baud N] [--latency MS] [--loss P] [--seed N]
+//                 [--banks N] [--speed X] [--pty]
+//   --baud     velocidad del enlace (31250 por USB; 9600 ~ BT)
+//   --latency  retardo en cada sentido, además del tiempo de byte
+//   --loss     probabilidad de perder cada byte, en los dos sentidos
+//   --banks    bancos al arrancar (EEPROM nueva: ADDBANK/DELBANK hasta N)
+//   --speed    segundos virtuales por segundo de pared
+//   --pty      pseudo-terminal en vez de stdin/stdout; su ruta sale por stderr
+
+#include <SimHarness.h>
+#include <ConfigManager.h>
+#include <chrono>
+#include <csignal>
+#include <deque>
+#include <fcntl.h>
+#include <poll.h>
+#include <random>
+#include <string>
+#include <termios.h>
+#include <unistd.h>
+
+extern ConfigManager configManager;
+
+namespace {
+
+struct Options {
+    unsigned long baud = 31250;
+    double latencyMs = 0;
+    double loss = 0;
+    unsigned seed = 1;
+    int banks = 0; // 0 = los de la EEPROM nueva
+    double speed = 1;
+    bool pty = false;
+};
+
+struct Pending {
+    uint64_t atUs; // Instante virtual de entrega al host
+    uint8_t c;
+};
+
+volatile sig_atomic_t stopRequested = 0;
+
+void onSignal(int) { stopRequested = 1; }
+
+bool parseOptions(int argc, char** argv, Options& o) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        const char* val = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (arg == "--pty") {
+            o.pty = true;
+            continue;
+        }
+        if (!val) return false;
+        if (arg == "--baud") o.baud = strtoul(val, nullptr, 10);
+        else if (arg == "--latency") o.latencyMs = atof(val);
+        else if (arg == "--loss") o.loss = atof(val);
+        else if (arg == "--seed") o.seed = (unsigned)strtoul(val, nullptr, 10);
+        else if (arg == "--banks") o.banks = atoi(val);
+        else if (arg == "--speed") o.speed = atof(val);
+        else return false;
+        i++;
+    }
+    return o.baud >= 300 && o.loss >= 0 && o.loss < 1 && o.speed > 0 && o.latencyMs >= 0 &&
+           o.banks >= 0 && o.banks <= MAX_BANKS_CFG;
+}
+
+// Maestro de un pty en modo crudo. El esclavo queda abierto para que el
+// maestro no dé EIO mientras ningún cliente lo tiene abierto.
+int openPty(int& slave) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) return -1;
+    const char* path = ptsname(master);
+    slave = path ? open(path, O_RDWR | O_NOCTTY) : -1;
+    if (slave < 0) return -1;
+    termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    fprintf(stderr, "device_emu: pty %s\n", path);
+    return master;
+}
+
+// Lleva la EEPROM nueva a 'banks' bancos con los comandos de la App
+void setBanks(int banks) {
+    while (banks && configManager.getActiveBanksCount() < banks) {
+        if (harness::command("ADDBANK") != "OK:BANK_ADDED") break;
+    }
+    while (banks && configManager.getActiveBanksCount() > banks) {
+        if (harness::command("DELBANK") != "OK:BANK_REMOVED") break;
+    }
+    harness::command("FLUSH");
+    Serial.takeOutput();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parseOptions(argc, argv, opt)) {
+        fprintf(stderr, "uso: device_emu [--baud N] [--latency MS] [--loss P] [--seed N] "
+                        "[--banks N] [--speed X] [--pty]\n");
+        return 2;
+    }
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    int fdIn = STDIN_FILENO, fdOut = STDOUT_FILENO, slave = -1;
+    if (opt.pty) {
+        fdIn = fdOut = openPty(slave);
+        if (fdIn < 0) {
+            perror("device_emu: pty");
+            return 1;
+        }
+    }
+    fcntl(fdIn, F_SETFL, fcntl(fdIn, F_GETFL) | O_NONBLOCK);
+
+    harness::boot();
+    harness::runFor(3000000); // Splash
+    setBanks(opt.banks);
+    Serial.begin(opt.baud);
+    Serial.takeOutput();
+    fprintf(stderr, "device_emu: listo (%d bancos, %lu baudios, %.1f ms, pérdida %.3f)\n",
+            configManager.getActiveBanksCount(), opt.baud, opt.latencyMs, opt.loss);
+
+    std::mt19937 rng(opt.seed);
+    std::bernoulli_distribution lost(opt.loss);
+    const uint64_t byteUs = Serial.byteTimeUs();
+    const uint64_t latencyUs = (uint64_t)(opt.latencyMs * 1000);
+    uint64_t rxFreeUs = 0; // Fin del último byte programado hacia el pedal
+    uint64_t txFreeUs = 0; // Fin del último byte del pedal en el cable
+    std::deque<Pending> toHost;
+    bool inputOpen = true;
+    uint64_t drainUntilUs = 0;
+
+    const auto wallStart = std::chrono::steady_clock::now();
+    const uint64_t virtStart = sim::nowUs();
+    uint8_t buf[256];
+    std::string out;
+
+    while (!stopRequested) {
+        uint64_t now = sim::nowUs();
+
+        // Host -> pedal: cada byte entra en el UART cuando termina en el cable
+        if (inputOpen) {
+            ssize_t n = read(fdIn, buf, sizeof(buf));
+            if (n > 0) {
+                for (ssize_t i = 0; i < n; i++) {
+                    if (lost(rng)) continue;
+                    if (rxFreeUs < now + latencyUs) rxFreeUs = now + latencyUs;
+                    Serial.feed(&buf[i], 1, rxFreeUs);
+                    rxFreeUs += byteUs;
+                }
+            } else if (n == 0 && !opt.pty) {
+                inputOpen = false; // EOF: vaciar lo pendiente y salir
+                drainUntilUs = (rxFreeUs > now ? rxFreeUs : now) + 1000000;
+            }
+        }
+
+        harness::step();
+        now = sim::nowUs();
+
+        // Pedal -> host, al ritmo del cable y con la latencia del enlace
+        std::string written = Serial.takeOutput();
+        for (char c : written) {
+            txFreeUs = (txFreeUs > now ? txFreeUs : now) + byteUs;
+            if (!lost(rng)) toHost.push_back({txFreeUs + latencyUs, (uint8_t)c});
+        }
+        out.clear();
+        while (!toHost.empty() && toHost.front().atUs <= now) {
+            out += (char)toHost.front().c;
+            toHost.pop_front();
+        }
+        if (!out.empty() && write(fdOut, out.data(), out.size()) < 0 && errno != EAGAIN) break;
+
+        if (!inputOpen && toHost.empty() && now >= drainUntilUs) break;
+
+        // Ir por delante del reloj de pared: esperar, despertando si llega algo
+        double wallUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - wallStart).count();
+        double aheadUs = (double)(now - virtStart) - wallUs * opt.speed;
+        if (aheadUs > 0) {
+            timespec ts;
+            uint64_t waitNs = (uint64_t)(aheadUs / opt.speed * 1000);
+            ts.tv_sec = (time_t)(waitNs / 1000000000ULL);
+            ts.tv_nsec = (long)(waitNs % 1000000000ULL);
+            pollfd pfd = {fdIn, POLLIN, 0};
+            ppoll(inputOpen ? &pfd : nullptr, inputOpen ? 1 : 0, &ts, nullptr);
+        }
+    }
+
+    const sim::Counters& c = sim::counters();
+    fprintf(stderr, "device_emu: fin (%.1f s virtuales, RX perdidos en el UART %lu)\n",
+            (double)(sim::nowUs() - virtStart) / 1e6, (unsigned long)c.uartRxDropped);
+    if (slave >= 0) close(slave);
+    return 0;
+}
@@ -0,0 +1,179 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+// HAL mínima de Arduino para compilar el firmware en el host.
+// Solo implementa lo que usa controladorMidi; los tiempos salen de HostSim.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "binary.h"
+#include "HostSim.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t word;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define LED_BUILTIN 13
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+
+#define DEC 10
+#define HEX 16
+
+// Registros de entrada de puerto (lectura de 8 pines en una instrucción)
+#define PINB (sim::portInput('B'))
+#define PINC (sim::portInput('C'))
+#define PIND (sim::portInput('D'))
+
+// En host no hay interrupciones concurrentes: los ISR corren entre eventos.
+#define noInterrupts()
+#define interrupts()
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t val);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// --- Strings en flash (en host son punteros normales) ---
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper*>(string_literal))
+
+// <avr/pgmspace.h>: PROGMEM no hace nada y las lecturas son directas
+#define PROGMEM
+#define PGM_P const char*
+#define PSTR(s) (s)
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#define strlen_P strlen
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strcat_P strcat
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strstr_P strstr
+#define strchr_P strchr
+#define memcpy_P memcpy
+#define snprintf_P snprintf
+
+inline uint16_t pgm_read_word(const void* addr) {
+    uint16_t w;
+    memcpy(&w, addr, sizeof(w));
+    return w;
+}
+
+inline uint32_t pgm_read_dword(const void* addr) {
+    uint32_t d;
+    memcpy(&d, addr, sizeof(d));
+    return d;
+}
+
+// --- Print / Stream ---
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual int availableForWrite() { return 0; } // Como el core AVR: 0 = no lo sabe
+
+    size_t write(const char* str) {
+        size_t n = 0;
+        while (*str) n += write((uint8_t)*str++);
+        return n;
+    }
+    size_t write(const uint8_t* buf, size_t len) {
+        size_t n = 0;
+        for (size_t i = 0; i < len; i++) n += write(buf[i]);
+        return n;
+    }
+
+    size_t print(const __FlashStringHelper* s) { return write(reinterpret_cast<const char*>(s)); }
+    size_t print(const char* s) { return write(s); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char n, int base = DEC) { return printNumber(n, base); }
+    size_t print(int n, int base = DEC) { return printNumber(n, base); }
+    size_t print(unsigned int n, int base = DEC) { return printNumber(n, base); }
+    size_t print(long n, int base = DEC) { return printNumber(n, base); }
+    size_t print(unsigned long n, int base = DEC) { return printNumber((long long)n, base); }
+
+    size_t println() { return write("\r\n"); }
+    template <typename T> size_t println(T v) { size_t n = print(v); return n + println(); }
+    template <typename T> size_t println(T v, int base) { size_t n = print(v, base); return n + println(); }
+
+  private:
+    size_t printNumber(long long n, int base) {
+        char buf[24];
+        snprintf(buf, sizeof(buf), base == HEX ? "%llX" : "%lld", n);
+        return write(buf);
+    }
+};
+
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual void flush() {}
+};
+
+// --- UART hardware (USB + MIDI comparten el mismo TX) ---
+// TX con buffer de 64 bytes: write() no bloquea salvo que el buffer esté lleno.
+class HardwareSerial : public Stream {
+  public:
+    static const int TX_BUFFER_SIZE = 64;
+    static const int RX_BUFFER_SIZE = 64;
+
+    void begin(unsigned long baud);
+    void end() {}
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t write(uint8_t c) override;
+    using Print::write;
+    int availableForWrite() override; // Hueco libre en el buffer TX
+
+    // Emite un byte crudo y devuelve el instante en que termina en el cable.
+    uint64_t transmit(uint8_t c);
+    // Byte de tiempo real escrito en el registro de datos desde un ISR (ver
+    // MidiClock.h): no espera al buffer TX, sale tras el byte que está en el
+    // cable y el que ya espera en el registro. Lo de detrás se retrasa un byte.
+    uint64_t transmitRealtime(uint8_t c);
+
+    // --- Lado host ---
+    void inject(const char* data);       // Bytes disponibles ya en RX
+    void injectByte(uint8_t c);
+    // Llegada por el cable: un byte cada byteTimeUs() a partir de startUs, al
+    // buffer RX de 64 bytes del core (si está lleno, el byte se pierde)
+    void feed(const uint8_t* data, size_t len, uint64_t startUs);
+    void receiveByte(uint8_t c);
+    std::string takeOutput();            // Texto emitido por print/write
+    uint32_t byteTimeUs() const { return _byteUs; }
+
+  private:
+    uint32_t _byteUs = 320; // 31250 baudios por defecto
+    uint64_t _txFreeAtUs = 0;
+    std::string _rx;
+    size_t _rxPos = 0;
+    std::string _out;
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef EEPROM_H
+#define EEPROM_H
+
+// EEPROM simulada (1 KB). Igual que la librería AVR, put() usa update():
+// solo se programan los bytes que cambian. Cada byte deja la EEPROM ocupada
+// ~3.3 ms; quien lea o escriba antes espera, quien mire eeprom_is_ready() no.
+
+#include <Arduino.h>
+
+class EEPROMClass {
+  public:
+    uint8_t read(int idx) {
+        sim::eepromWaitReady();
+        sim::counters().eepromBytesRead++;
+        return sim::eepromData()[idx];
+    }
+
+    void write(int idx, uint8_t val) {
+        sim::eepromWaitReady();
+        sim::counters().eepromBytesWritten++;
+        sim::eepromStartWrite();
+        if (!sim::eepromPowered()) return; // Corte de luz simulado
+        sim::eepromData()[idx] = val;
+        sim::eepromWear()[idx]++;
+    }
+
+    void update(int idx, uint8_t val) {
+        if (read(idx) != val) write(idx, val);
+    }
+
+    template <typename T> T& get(int idx, T& t) {
+        uint8_t* p = (uint8_t*)&t;
+        for (size_t i = 0; i < sizeof(T); i++) p[i] = read(idx + (int)i);
+        return t;
+    }
+
+    template <typename T> const T& put(int idx, const T& t) {
+        const uint8_t* p = (const uint8_t*)&t;
+        for (size_t i = 0; i < sizeof(T); i++) update(idx + (int)i, p[i]);
+        return t;
+    }
+
+    uint16_t length() { return sim::EEPROM_SIZE; }
+};
+
+extern EEPROMClass EEPROM;
+
+// <avr/eeprom.h>: bit EEPE libre / espera activa
+inline bool eeprom_is_ready() { return sim::eepromReady(); }
+inline void eeprom_busy_wait() { sim::eepromWaitReady(); }
+
+#endif
@@ -0,0 +1,296 @@
+#include "HostSim.h"
+
+#include <algorithm>
+#include <Arduino.h>
+#include <EEPROM.h>
+
+namespace sim {
+
+namespace {
+
+struct Scheduled {
+    uint64_t timeUs;
+    uint64_t seq; // desempate FIFO para eventos del mismo instante
+    std::function<void()> fn;
+};
+
+struct State {
+    uint64_t now = 0;
+    uint64_t seq = 0;
+    std::vector<Scheduled> events; // min-heap por (timeUs, seq)
+    bool pins[NUM_PINS] = {};
+    uint16_t analog[ADC_CHANNELS] = {};
+    uint16_t analogNoise[ADC_CHANNELS] = {};
+    uint32_t noiseSeed = 1;
+    uint8_t eeprom[EEPROM_SIZE];
+    uint32_t eepromWear[EEPROM_SIZE] = {};
+    int64_t eepromWritesLeft = -1;
+    uint64_t eepromBusyUntil = 0;
+    std::vector<MidiEvent> midi;
+    Counters counters = {};
+
+    State() { memset(eeprom, 0xFF, sizeof(eeprom)); }
+};
+
+// Función-estática: segura aunque los constructores globales del sketch
+// (Button, LedManager) llamen a pinMode() durante la inicialización.
+State& state() {
+    static State s;
+    return s;
+}
+
+bool later(const Scheduled& a, const Scheduled& b) {
+    return a.timeUs != b.timeUs ? a.timeUs > b.timeUs : a.seq > b.seq;
+}
+
+} // namespace
+
+uint64_t nowUs() { return state().now; }
+
+void advance(uint64_t us) {
+    State& s = state();
+    uint64_t target = s.now + us;
+    while (!s.events.empty() && s.events.front().timeUs <= target) {
+        std::pop_heap(s.events.begin(), s.events.end(), later);
+        Scheduled ev = std::move(s.events.back());
+        s.events.pop_back();
+        if (ev.timeUs > s.now) s.now = ev.timeUs;
+        ev.fn();
+    }
+    if (target > s.now) s.now = target;
+}
+
+void charge(uint32_t us) { advance(us); }
+
+void at(uint64_t timeUs, std::function<void()> fn) {
+    State& s = state();
+    s.events.push_back(Scheduled{timeUs, s.seq++, std::move(fn)});
+    std::push_heap(s.events.begin(), s.events.end(), later);
+}
+
+size_t pendingEvents() { return state().events.size(); }
+
+void setPin(uint8_t pin, bool level) {
+    if (pin < NUM_PINS) state().pins[pin] = level;
+}
+
+bool pinLevel(uint8_t pin) {
+    return pin < NUM_PINS ? state().pins[pin] : false;
+}
+
+void schedulePin(uint64_t timeUs, uint8_t pin, bool level) {
+    at(timeUs, [pin, level]() { setPin(pin, level); });
+}
+
+uint8_t portInput(char port) {
+    int first = port == 'D' ? 0 : port == 'B' ? 8 : 14;
+    int count = port == 'D' ? 8 : 6;
+    uint8_t value = 0;
+    for (int i = 0; i < count; i++) {
+        if (pinLevel((uint8_t)(first + i))) value |= (uint8_t)(1 << i);
+    }
+    return value;
+}
+
+void setAnalog(uint8_t channel, uint16_t value, uint16_t noise) {
+    if (channel >= ADC_CHANNELS) return;
+    state().analog[channel] = value > 1023 ? 1023 : value;
+    state().analogNoise[channel] = noise;
+}
+
+uint16_t adcConvert(uint8_t channel) {
+    State& s = state();
+    s.counters.adcConversions++;
+    if (channel >= ADC_CHANNELS) return 0;
+    int v = s.analog[channel];
+    if (s.analogNoise[channel]) {
+        s.noiseSeed = s.noiseSeed * 1103515245u + 12345u; // LCG: misma secuencia en cada ejecución
+        v += (int)((s.noiseSeed >> 16) % (2u * s.analogNoise[channel] + 1)) - s.analogNoise[channel];
+    }
+    return (uint16_t)(v < 0 ? 0 : v > 1023 ? 1023 : v);
+}
+
+namespace {
+void timerTick(uint64_t timeUs, uint32_t periodUs, void (*isr)()) {
+    at(timeUs, [timeUs, periodUs, isr]() {
+        isr();
+        timerTick(timeUs + periodUs, periodUs, isr);
+    });
+}
+} // namespace
+
+void attachTimer(uint32_t periodUs, void (*isr)()) {
+    timerTick(nowUs() + periodUs, periodUs, isr);
+}
+
+uint8_t* eepromData() { return state().eeprom; }
+
+void eepromFill(uint8_t value) { memset(state().eeprom, value, EEPROM_SIZE); }
+
+uint32_t* eepromWear() { return state().eepromWear; }
+
+bool eepromReady() { return state().now >= state().eepromBusyUntil; }
+
+void eepromWaitReady() {
+    State& s = state();
+    if (s.now < s.eepromBusyUntil) advance(s.eepromBusyUntil - s.now);
+}
+
+void eepromStartWrite() { state().eepromBusyUntil = state().now + cost::EEPROM_WRITE_US; }
+
+void eepromCutAfter(int64_t writes) { state().eepromWritesLeft = writes; }
+
+bool eepromPowered() {
+    int64_t& left = state().eepromWritesLeft;
+    if (left < 0) return true;
+    if (left == 0) return false;
+    left--;
+    return true;
+}
+
+std::vector<MidiEvent>& midiLog() { return state().midi; }
+
+Counters& counters() { return state().counters; }
+
+void sliceOverrun(const char* name, unsigned long us, unsigned int sliceUs) {
+    state().counters.sliceOverruns++;
+    fprintf(stderr, "sim: tarea '%s' tardó %lu us (rodaja %u us)\n", name, us, sliceUs);
+}
+
+void reset() {
+    State& s = state();
+    s.now = 0;
+    s.seq = 0;
+    s.eepromBusyUntil = 0;
+    s.events.clear();
+    s.midi.clear();
+    s.counters = Counters();
+}
+
+} // namespace sim
+
+// --- API Arduino ---
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    if (pin >= sim::NUM_PINS) return;
+    // Con pull-up el pin lee HIGH hasta que el footswitch lo lleva a masa.
+    if (mode == INPUT_PULLUP) sim::setPin(pin, HIGH);
+}
+
+int digitalRead(uint8_t pin) {
+    sim::charge(sim::cost::DIGITAL_READ_US);
+    return sim::pinLevel(pin) ? HIGH : LOW;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    sim::charge(sim::cost::DIGITAL_WRITE_US);
+    sim::setPin(pin, val != LOW);
+}
+
+unsigned long millis() {
+    sim::charge(sim::cost::MILLIS_US);
+    return (unsigned long)(sim::nowUs() / 1000);
+}
+
+unsigned long micros() {
+    sim::charge(sim::cost::MILLIS_US);
+    return (unsigned long)sim::nowUs();
+}
+
+void delay(unsigned long ms) { sim::advance((uint64_t)ms * 1000); }
+
+void delayMicroseconds(unsigned int us) { sim::advance(us); }
+
+// --- HardwareSerial ---
+
+void HardwareSerial::begin(unsigned long baud) {
+    _byteUs = (uint32_t)(10000000UL / baud);
+}
+
+int HardwareSerial::available() { return (int)(_rx.size() - _rxPos); }
+
+int HardwareSerial::read() {
+    if (_rxPos >= _rx.size()) return -1;
+    uint8_t c = (uint8_t)_rx[_rxPos++];
+    if (_rxPos == _rx.size()) {
+        _rx.clear();
+        _rxPos = 0;
+    }
+    return c;
+}
+
+int HardwareSerial::peek() {
+    return _rxPos < _rx.size() ? (uint8_t)_rx[_rxPos] : -1;
+}
+
+uint64_t HardwareSerial::transmit(uint8_t c) {
+    sim::counters().uartTxBytes++;
+    uint64_t now = sim::nowUs();
+    // Buffer TX lleno: write() espera a que salga el byte más antiguo.
+    uint64_t backlogLimit = (uint64_t)TX_BUFFER_SIZE * _byteUs;
+    if (_txFreeAtUs > now + backlogLimit) {
+        sim::advance(_txFreeAtUs - backlogLimit - now);
+        now = sim::nowUs();
+    }
+    uint64_t start = _txFreeAtUs > now ? _txFreeAtUs : now;
+    _txFreeAtUs = start + _byteUs;
+    return _txFreeAtUs;
+}
+
+uint64_t HardwareSerial::transmitRealtime(uint8_t c) {
+    (void)c;
+    sim::counters().uartTxBytes++;
+    uint64_t now = sim::nowUs();
+    uint64_t start = now;
+    if (_txFreeAtUs > now) {
+        // Fin del byte en el cable y, si hay otro detrás, del que está en UDR
+        uint64_t rest = (_txFreeAtUs - now) % _byteUs;
+        uint64_t current = now + (rest ? rest : _byteUs);
+        start = std::min(_txFreeAtUs, current + _byteUs);
+    }
+    _txFreeAtUs = std::max(_txFreeAtUs, start) + _byteUs;
+    return start + _byteUs;
+}
+
+int HardwareSerial::availableForWrite() {
+    uint64_t now = sim::nowUs();
+    if (_txFreeAtUs <= now) return TX_BUFFER_SIZE - 1;
+    int queued = (int)((_txFreeAtUs - now + _byteUs - 1) / _byteUs);
+    return queued >= TX_BUFFER_SIZE - 1 ? 0 : TX_BUFFER_SIZE - 1 - queued;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    transmit(c);
+    _out += (char)c;
+    return 1;
+}
+
+void HardwareSerial::inject(const char* data) { _rx += data; }
+
+void HardwareSerial::injectByte(uint8_t c) { _rx += (char)c; }
+
+void HardwareSerial::receiveByte(uint8_t c) {
+    if (available() >= RX_BUFFER_SIZE) {
+        sim::counters().uartRxDropped++;
+        return;
+    }
+    _rx += (char)c;
+}
+
+void HardwareSerial::feed(const uint8_t* data, size_t len, uint64_t startUs) {
+    uint64_t t = startUs;
+    for (size_t i = 0; i < len; i++) {
+        t += _byteUs;
+        uint8_t c = data[i];
+        sim::at(t, [this, c]() { receiveByte(c); });
+    }
+}
+
+std::string HardwareSerial::takeOutput() {
+    std::string s;
+    s.swap(_out);
+    return s;
+}
+
+HardwareSerial Serial;
+EEPROMClass EEPROM;
@@ -0,0 +1,111 @@
+#ifndef HOSTSIM_H
+#define HOSTSIM_H
+
+// Núcleo de la simulación host (Linux) del firmware.
+// Reloj simulado en microsegundos, GPIO, EEPROM, eventos programados
+// y un registro de mensajes MIDI con su instante de salida por el cable.
+//
+// El tiempo solo avanza cuando el código "gasta" algo: delay(), una
+// escritura de EEPROM, un byte de I2C o de SoftwareSerial, o cuando el
+// harness llama a sim::advance(). Los costes son aproximaciones de un
+// ATmega328P a 16 MHz y sirven como referencia relativa, no absoluta.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace sim {
+
+// --- Modelo de costes (us) ---
+namespace cost {
+    const uint32_t DIGITAL_READ_US   = 4;    // digitalRead() con lookup de tablas
+    const uint32_t DIGITAL_WRITE_US  = 4;
+    const uint32_t MILLIS_US         = 1;    // lectura atómica de timer0_millis
+    const uint32_t EEPROM_WRITE_US   = 3300; // tiempo de programación de 1 byte
+    const uint32_t LCD_BYTE_US       = 550;  // 1 byte HD44780 vía PCF8574 @100kHz
+    const uint32_t LCD_CLEAR_US      = 2000; // comando clear (+ delay de la lib)
+}
+
+const int NUM_PINS = 20;      // D0..D13 + A0..A5
+const int EEPROM_SIZE = 1024; // ATmega328P
+
+// --- Reloj ---
+uint64_t nowUs();
+void advance(uint64_t us);     // Avanza el reloj ejecutando los eventos vencidos
+void charge(uint32_t us);      // Coste de una operación bloqueante (= advance)
+void at(uint64_t timeUs, std::function<void()> fn); // Evento programado
+size_t pendingEvents();
+
+// --- GPIO ---
+void setPin(uint8_t pin, bool level);       // Nivel eléctrico externo (botón)
+bool pinLevel(uint8_t pin);
+void schedulePin(uint64_t timeUs, uint8_t pin, bool level);
+uint8_t portInput(char port);               // Registro PINx: 'B' (D8-13), 'C' (A0-A5), 'D' (D0-7)
+
+// --- ADC ---
+// Tensión en una entrada analógica (canal del mux, 0..7) en cuentas de 10 bits.
+// Cada conversión le suma ruido uniforme en [-noise, noise] (pseudoaleatorio
+// pero repetible) y recorta a 0..1023. Como los pines, reset() no la toca.
+const int ADC_CHANNELS = 8;
+void setAnalog(uint8_t channel, uint16_t value, uint16_t noise = 0);
+uint16_t adcConvert(uint8_t channel);
+
+// --- Interrupciones de timer ---
+// Llama a 'isr' cada 'periodUs' de tiempo simulado, también durante delay()
+// y escrituras de EEPROM, igual que un timer hardware. El coste del ISR no se cobra.
+void attachTimer(uint32_t periodUs, void (*isr)());
+
+// --- EEPROM ---
+uint8_t* eepromData();
+void eepromFill(uint8_t value);
+uint32_t* eepromWear();             // Programaciones por celda (desgaste)
+// Como en el AVR, una escritura arranca la programación (EEPE) y vuelve; la
+// siguiente lectura o escritura espera a que termine (EEPROM_WRITE_US).
+bool eepromReady();
+void eepromWaitReady();
+void eepromStartWrite();
+// Corte de luz: tras 'writes' bytes más, las escrituras se pierden (-1 = nunca)
+void eepromCutAfter(int64_t writes);
+bool eepromPowered();               // Consume una escritura del presupuesto
+
+// --- MIDI OUT (registro) ---
+struct MidiEvent {
+    uint64_t queuedUs;  // Momento en que el firmware llamó a send*()
+    uint64_t wireUs;    // Último bit del mensaje sale por el UART
+    uint8_t status;
+    uint8_t data1;
+    uint8_t data2;
+    uint8_t length;
+};
+std::vector<MidiEvent>& midiLog();
+
+// --- Contadores globales ---
+struct Counters {
+    uint64_t eepromBytesWritten;
+    uint64_t eepromBytesRead;
+    uint64_t lcdBytes;
+    uint64_t lcdClears;
+    uint64_t uartTxBytes;
+    uint64_t uartRxDropped;
+    uint64_t softSerialTxBytes;
+    uint64_t softSerialRxDropped;
+    uint64_t btTxBytes;         // BtSerial (UART por software con Timer1)
+    uint64_t btRxDropped;       // Ring lleno o error de trama
+    uint64_t sliceOverruns;     // Tareas del Scheduler que se pasaron de su rodaja
+    uint64_t adcConversions;
+};
+Counters& counters();
+
+// El Scheduler avisa de una tarea que tardó más que su rodaja: se cuenta y
+// se informa por stderr (los tests y el benchmark fallan si el contador sube).
+void sliceOverrun(const char* name, unsigned long us, unsigned int sliceUs);
+
+// Reinicia reloj, eventos, registro MIDI y contadores.
+// No toca pines ni EEPROM (persisten como en el hardware).
+void reset();
+
+} // namespace sim
+
+#endif
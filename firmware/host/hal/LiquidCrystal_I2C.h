@@ -0,0 +1,84 @@
+#ifndef LIQUIDCRYSTAL_I2C_H
+#define LIQUIDCRYSTAL_I2C_H
+
+// LCD 16x2 I2C simulado. Mantiene el contenido visible en 'screen' para
+// poder inspeccionarlo y cobra el tiempo de bus de cada byte enviado.
+
+#include <Arduino.h>
+
+class LiquidCrystal_I2C : public Print {
+  public:
+    static const int MAX_COLS = 20;
+    static const int MAX_ROWS = 4;
+
+    char screen[MAX_ROWS][MAX_COLS + 1];
+
+    LiquidCrystal_I2C(uint8_t addr, uint8_t cols, uint8_t rows)
+        : _addr(addr), _cols(cols), _rows(rows) {
+        wipe();
+        active() = this;
+    }
+
+    // Último LCD construido (el sketch tiene uno): para inspeccionarlo en tests
+    static LiquidCrystal_I2C*& active() {
+        static LiquidCrystal_I2C* lcd = nullptr;
+        return lcd;
+    }
+
+    std::string row(int r) const { return std::string(screen[r], _cols); }
+
+    void init() { wipe(); sim::charge(sim::cost::LCD_CLEAR_US); }
+    void backlight() { command(); }
+    void noBacklight() { command(); }
+
+    void clear() {
+        wipe();
+        sim::counters().lcdClears++;
+        command();
+        sim::charge(sim::cost::LCD_CLEAR_US);
+    }
+
+    void home() { _col = 0; _row = 0; command(); }
+
+    void setCursor(uint8_t col, uint8_t row) {
+        _col = col;
+        _row = row < _rows ? row : _rows - 1;
+        command();
+    }
+
+    void createChar(uint8_t location, uint8_t charmap[]) {
+        (void)location; (void)charmap;
+        for (int i = 0; i < 9; i++) command();
+    }
+
+    size_t write(uint8_t c) override {
+        if (_col < _cols) screen[_row][_col] = (c < 8) ? (char)('0' + c) : (char)c;
+        _col++;
+        command();
+        return 1;
+    }
+    using Print::write;
+
+  private:
+    uint8_t _addr;
+    uint8_t _cols;
+    uint8_t _rows;
+    uint8_t _col = 0;
+    uint8_t _row = 0;
+
+    void command() {
+        sim::counters().lcdBytes++;
+        sim::charge(sim::cost::LCD_BYTE_US);
+    }
+
+    void wipe() {
+        for (int r = 0; r < MAX_ROWS; r++) {
+            memset(screen[r], ' ', MAX_COLS);
+            screen[r][_cols < MAX_COLS ? _cols : MAX_COLS] = 0;
+        }
+        _col = 0;
+        _row = 0;
+    }
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef MIDI_H
+#define MIDI_H
+
+// Sustituto host de arduino_midi_library: misma API de envío, pero cada
+// mensaje pasa por el UART simulado (Serial) y queda en sim::midiLog()
+// con el instante en que termina de salir por el cable.
+
+#include <Arduino.h>
+
+#define MIDI_CHANNEL_OMNI 0
+#define MIDI_CHANNEL_OFF 17
+
+namespace midi {
+
+typedef uint8_t DataByte;
+typedef uint8_t Channel;
+
+class SimMidiInterface {
+  public:
+    explicit SimMidiInterface(HardwareSerial& port) : _port(port) {}
+
+    void begin(Channel inChannel = 1) {
+        _inputChannel = inChannel;
+        _port.begin(31250);
+    }
+
+    void sendProgramChange(DataByte program, Channel channel) {
+        send(0xC0 | ((channel - 1) & 0x0F), program & 0x7F, 0, 2);
+    }
+
+    void sendControlChange(DataByte number, DataByte value, Channel channel) {
+        send(0xB0 | ((channel - 1) & 0x0F), number & 0x7F, value & 0x7F, 3);
+    }
+
+    bool read() { return false; }
+
+  private:
+    HardwareSerial& _port;
+    Channel _inputChannel = 1;
+
+    void send(uint8_t status, uint8_t d1, uint8_t d2, uint8_t len) {
+        sim::MidiEvent ev;
+        ev.queuedUs = sim::nowUs();
+        ev.status = status;
+        ev.data1 = d1;
+        ev.data2 = d2;
+        ev.length = len;
+        _port.transmit(status);
+        ev.wireUs = _port.transmit(d1);
+        if (len == 3) ev.wireUs = _port.transmit(d2);
+        sim::midiLog().push_back(ev);
+    }
+};
+
+} // namespace midi
+
+#define MIDI_CREATE_DEFAULT_INSTANCE() midi::SimMidiInterface MIDI(Serial)
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef SOFTWARESERIAL_H
+#define SOFTWARESERIAL_H
+
+// SoftwareSerial simulado: TX bloqueante (bit-banging, ~1 ms/byte a 9600)
+// y RX con el buffer de 64 bytes de la librería original (descarta si se llena).
+// Half-duplex como el original: TX corre con interrupciones desactivadas, así
+// que un byte que llega mientras se transmite se pierde.
+
+#include <Arduino.h>
+
+class SoftwareSerial : public Stream {
+  public:
+    static const int RX_BUFFER_SIZE = 64;
+
+    SoftwareSerial(uint8_t rxPin, uint8_t txPin) : _rxPin(rxPin), _txPin(txPin) {}
+
+    void begin(long baud) { _byteUs = (uint32_t)(10000000UL / baud); }
+    bool listen() { return true; }
+    bool isListening() { return true; }
+
+    int available() override { return _count; }
+
+    int read() override {
+        if (_count == 0) return -1;
+        uint8_t c = _buf[_head];
+        _head = (_head + 1) % RX_BUFFER_SIZE;
+        _count--;
+        return c;
+    }
+
+    int peek() override { return _count ? _buf[_head] : -1; }
+
+    size_t write(uint8_t c) override {
+        sim::counters().softSerialTxBytes++;
+        _out += (char)c;
+        _transmitting = true;
+        sim::charge(_byteUs);
+        _transmitting = false;
+        if (peer) peer(c);
+        return 1;
+    }
+    using Print::write;
+
+    // --- Lado host ---
+    // Dispositivo al otro lado (p.ej. emulador del HC-06): recibe cada byte enviado.
+    std::function<void(uint8_t)> peer;
+
+    // Llega un byte desde el módulo BT (se llama desde un evento sim::at).
+    void receiveByte(uint8_t c) {
+        if (_count >= RX_BUFFER_SIZE || _transmitting) {
+            sim::counters().softSerialRxDropped++;
+            return;
+        }
+        _buf[(_head + _count) % RX_BUFFER_SIZE] = c;
+        _count++;
+    }
+
+    // Programa la llegada de 'data' a la velocidad del enlace a partir de startUs.
+    void feed(const char* data, uint64_t startUs) {
+        uint64_t t = startUs;
+        for (const char* p = data; *p; p++) {
+            t += _byteUs;
+            uint8_t c = (uint8_t)*p;
+            sim::at(t, [this, c]() { receiveByte(c); });
+        }
+    }
+
+    std::string takeOutput() {
+        std::string s;
+        s.swap(_out);
+        return s;
+    }
+
+    uint32_t byteTimeUs() const { return _byteUs; }
+
+  private:
+    uint8_t _rxPin;
+    uint8_t _txPin;
+    uint32_t _byteUs = 1042;
+    uint8_t _buf[RX_BUFFER_SIZE];
+    int _head = 0;
+    int _count = 0;
+    bool _transmitting = false;
+    std::string _out;
+};
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+// Sin bus I2C real en host: LiquidCrystal_I2C simula el coste por byte.
+
+#include <Arduino.h>
+
+#endif
@@ -0,0 +1,223 @@
+// Tests de los bancos paginados: más bancos de los que caben en RAM, precarga
+// de los vecinos, lecturas bajo demanda y registros empaquetados de 8 bytes.
+
+#include <SimHarness.h>
+#include <ConfigManager.h>
+#include "TestCheck.h"
+
+using harness::addBanks;
+using harness::freshEeprom;
+
+namespace {
+
+// Deja que update() termine escrituras y precarga
+void settle(ConfigManager& cfg) {
+    for (int i = 0; i < 2000; i++) {
+        cfg.update();
+        sim::advance(500);
+    }
+}
+
+// Todos los bancos, con nombre y primer preset distintos
+void fillBanks(ConfigManager& cfg) {
+    addBanks(cfg, MAX_BANKS_CFG);
+    char name[9];
+    for (int b = 0; b < MAX_BANKS_CFG; b++) {
+        cfg.waitRoom(2);
+        snprintf(name, sizeof(name), "SONG %d", b);
+        cfg.setBankName(b, name);
+        ButtonConfig* btn = cfg.getButtonConfig(b, 0);
+        snprintf(btn->name, sizeof(btn->name), "S%d", b);
+        btn->value1 = b;
+        cfg.markButtonDirty(b, 0);
+        cfg.save();
+    }
+    cfg.flush();
+}
+
+void testAllBanksPersist() {
+    freshEeprom();
+    ConfigManager cfg;
+    cfg.begin();
+    fillBanks(cfg);
+    CHECK(cfg.getActiveBanksCount() == MAX_BANKS_CFG);
+    CHECK(!cfg.addBank());
+
+    ConfigManager reboot;
+    reboot.begin();
+    CHECK(reboot.getActiveBanksCount() == MAX_BANKS_CFG);
+    char name[9];
+    for (int b = 0; b < MAX_BANKS_CFG; b++) {
+        snprintf(name, sizeof(name), "SONG %d", b);
+        CHECK(strcmp(reboot.getBankName(b), name) == 0);
+        CHECK(reboot.getButtonConfig(b, 0)->value1 == b);
+    }
+    printf("  %d banks in %u pages, %u page misses\n", MAX_BANKS_CFG, CFG_PAGES, reboot.pageMisses());
+}
+
+// Nombres por defecto: caben en 4 caracteres y no se repiten pasado el banco 9
+void testDefaultSlotNames() {
+    freshEeprom();
+    ConfigManager cfg;
+    cfg.begin();
+    addBanks(cfg, MAX_BANKS_CFG);
+    CHECK(strcmp(cfg.getButtonConfig(0, 1)->name, "P0-1") == 0);
+    CHECK(strcmp(cfg.getButtonConfig(9, 2)->name, "P9-2") == 0);
+    CHECK(strcmp(cfg.getButtonConfig(12, 0)->name, "12-0") == 0);
+    char name[5];
+    for (int a = 0; a < MAX_BANKS_CFG * NUM_PRESETS_CFG; a++) {
+        for (int b = a + 1; b < MAX_BANKS_CFG * NUM_PRESETS_CFG; b++) {
+            strcpy(name, cfg.getButtonConfig(a / NUM_PRESETS_CFG, a % NUM_PRESETS_CFG)->name);
+            CHECK(strcmp(name, cfg.getButtonConfig(b / NUM_PRESETS_CFG, b % NUM_PRESETS_CFG)->name) != 0);
+        }
+    }
+}
+
+void testNeighboursArePrefetched() {
+    freshEeprom();
+    ConfigManager cfg;
+    cfg.begin();
+    fillBanks(cfg);
+
+    ConfigManager reboot;
+    reboot.begin();
+    reboot.focusBank(5);
+    settle(reboot);
+    CHECK(reboot.isPaged(4) && reboot.isPaged(5) && reboot.isPaged(6));
+    CHECK(!reboot.isPaged(12));
+
+    // Bank Up: ya estaba en RAM, no se lee nada
+    unsigned int misses = reboot.pageMisses();
+    uint64_t reads = sim::counters().eepromBytesRead;
+    CHECK(strcmp(reboot.getBankName(6), "SONG 6") == 0);
+    CHECK(reboot.pageMisses() == misses && sim::counters().eepromBytesRead == reads);
+
+    // Salto lejano: una página leída de EEPROM
+    CHECK(strcmp(reboot.getBankName(12), "SONG 12") == 0);
+    CHECK(reboot.pageMisses() == misses + 1);
+    CHECK(sim::counters().eepromBytesRead - reads <= 110);
+
+    // Los vecinos del banco 0 dan la vuelta
+    reboot.focusBank(0);
+    settle(reboot);
+    CHECK(reboot.isPaged(MAX_BANKS_CFG - 1) && reboot.isPaged(1));
+}
+
+void testPackRoundTrip() {
+    ButtonConfig in = {"WAH", 'C', 127, 0, 'D', 5, 64, 'S'};
+    byte rec[JOURNAL_RECORD_SIZE];
+    packButton(in, rec);
+    ButtonConfig out;
+    unpackButton(rec, out);
+    CHECK(memcmp(&in, &out, sizeof(in)) == 0);
+
+    // Todas las combinaciones de tipo, Long Press y modo
+    for (const char* t = CFG_TYPES; *t; t++) {
+        for (const char* lp = CFG_LP_TYPES; *lp; lp++) {
+            for (const char* m = CFG_MODES; *m; m++) {
+                ButtonConfig c = {"ABCD", *t, 1, 2, *lp, 3, 4, *m};
+                packButton(c, rec);
+                unpackButton(rec, out);
+                CHECK(out.type == *t && out.lpType == *lp && out.pressMode == *m);
+                CHECK(strcmp(out.name, "ABCD") == 0 && out.lpValue2 == 4);
+            }
+        }
+    }
+}
+
+void testEditsOutliveTheirPage() {
+    freshEeprom();
+    ConfigManager cfg;
+    cfg.begin();
+    fillBanks(cfg);
+
+    // Más bancos editados que páginas: los primeros salen de RAM antes de
+    // que update() los escriba
+    for (int b = 0; b < CFG_PAGES * 2; b++) {
+        strcpy(cfg.getButtonConfig(b, 2)->name, "EDIT");
+        cfg.markButtonDirty(b, 2);
+    }
+    cfg.save();
+    CHECK(strcmp(cfg.getButtonConfig(0, 2)->name, "EDIT") == 0); // Recargado con la cola encima
+    cfg.flush();
+
+    ConfigManager reboot;
+    reboot.begin();
+    for (int b = 0; b < CFG_PAGES * 2; b++) CHECK(strcmp(reboot.getButtonConfig(b, 2)->name, "EDIT") == 0);
+}
+
+void testDeleteMovesOnlyTheMap() {
+    freshEeprom();
+    ConfigManager cfg;
+    cfg.begin();
+    fillBanks(cfg);
+
+    uint64_t bytes = sim::counters().eepromBytesWritten;
+    CHECK(cfg.removeBank(3));
+    cfg.save();
+    cfg.flush();
+    // Antes se desplazaban todos los bancos de detrás (65 registros). Si el
+    // lote no cabe en lo que queda del journal, antes se vuelca lo que ya había.
+    CHECK(sim::counters().eepromBytesWritten - bytes <=
+          REC_META_COUNT * JOURNAL_ENTRY_SIZE + JOURNAL_SLOTS * JOURNAL_RECORD_SIZE);
+
+    ConfigManager reboot;
+    reboot.begin();
+    CHECK(reboot.getActiveBanksCount() == MAX_BANKS_CFG - 1);
+    CHECK(strcmp(reboot.getBankName(3), "SONG 4") == 0);
+    char name[9];
+    snprintf(name, sizeof(name), "SONG %d", MAX_BANKS_CFG - 1);
+    CHECK(strcmp(reboot.getBankName(MAX_BANKS_CFG - 2), name) == 0);
+
+    // El slot liberado se reutiliza limpio
+    CHECK(reboot.addBank());
+    snprintf(name, sizeof(name), "BANK %d", MAX_BANKS_CFG - 1);
+    CHECK(strcmp(reboot.getBankName(MAX_BANKS_CFG - 1), name) == 0);
+    CHECK(strcmp(reboot.getButtonConfig(MAX_BANKS_CFG - 1, 0)->name, "S3") != 0);
+}
+
+void testOversizedAbortIsPartial() {
+    freshEeprom();
+    ConfigManager cfg;
+    cfg.begin();
+    fillBanks(cfg);
+
+    // Cabe en cola + journal: el ABORT lo deshace todo
+    CHECK(cfg.beginTransaction());
+    for (int b = 0; b < 4; b++) cfg.setBankName(b, "TX");
+    settle(cfg);
+    CHECK(cfg.abortTransaction());
+    settle(cfg);
+    CHECK(!cfg.revertWasPartial());
+    CHECK(strcmp(cfg.getBankName(0), "SONG 0") == 0);
+
+    // Un rig entero sin COMMIT no cabe: lo que hubo que consolidar se queda
+    CHECK(cfg.beginTransaction());
+    for (int b = 0; b < MAX_BANKS_CFG; b++) {
+        cfg.waitRoom(2);
+        cfg.setBankName(b, "TX");
+        cfg.markButtonDirty(b, 1);
+        cfg.update();
+        sim::advance(20000);
+    }
+    settle(cfg);
+    CHECK(cfg.abortTransaction());
+    settle(cfg);
+    CHECK(cfg.revertWasPartial());
+    char name[9];
+    snprintf(name, sizeof(name), "SONG %d", MAX_BANKS_CFG - 1);
+    CHECK(strcmp(cfg.getBankName(MAX_BANKS_CFG - 1), name) == 0);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(testAllBanksPersist);
+    RUN_TEST(testDefaultSlotNames);
+    RUN_TEST(testNeighboursArePrefetched);
+    RUN_TEST(testPackRoundTrip);
+    RUN_TEST(testEditsOutliveTheirPage);
+    RUN_TEST(testDeleteMovesOnlyTheMap);
+    RUN_TEST(testOversizedAbortIsPartial);
+    return testFailures ? 1 : 0;
+}
@@ -0,0 +1,208 @@
+// Tests del protocolo binario: tramas SysEx con CRC, decodificadas byte a byte
+// y mezcladas en el mismo puerto con las líneas ASCII de siempre.
+
+#include <SimHarness.h>
+#include <ConfigManager.h>
+#include <BinaryFrame.h>
+#include <vector>
+#include "TestCheck.h"
+
+extern ConfigManager configManager;
+
+namespace {
+
+typedef std::vector<byte> Bytes;
+
+Bytes frame(byte op, const Bytes& payload) {
+    byte out[BF_FRAME_MAX];
+    byte n = encodeFrame(op, payload.data(), payload.size(), out);
+    return Bytes(out, out + n);
+}
+
+void inject(const Bytes& data) {
+    for (byte c : data) Serial.injectByte(c);
+}
+
+// Separa la salida del pedal en texto ASCII y tramas decodificadas
+struct Reply {
+    std::string text;
+    std::vector<Bytes> frames; // [op][payload...]
+
+    void parse(const std::string& out) {
+        FrameDecoder dec;
+        for (char ch : out) {
+            byte c = (byte)ch;
+            if (dec.active() || c == BF_START) {
+                if (dec.feed(c) == FrameDecoder::FRAME) {
+                    Bytes f(1, dec.op());
+                    for (byte i = 0; i < dec.length(); i++) f.push_back(dec.payload()[i]);
+                    frames.push_back(f);
+                }
+            } else {
+                text += ch;
+            }
+        }
+    }
+};
+
+// Envía 'data' y corre loop() hasta que aparezca una trama con 'op'
+Reply exchange(const Bytes& data, byte untilOp, uint64_t timeoutUs = 2000000) {
+    Serial.takeOutput();
+    inject(data);
+    std::string out;
+    Reply r;
+    harness::runUntil([&]() {
+        out += Serial.takeOutput();
+        r = Reply();
+        r.parse(out);
+        for (const Bytes& f : r.frames) {
+            if (f[0] == untilOp) return true;
+        }
+        return false;
+    }, timeoutUs);
+    return r;
+}
+
+Bytes record(const ButtonConfig& cfg) {
+    const byte* p = (const byte*)&cfg;
+    return Bytes(p, p + sizeof(cfg));
+}
+
+void testFrameRoundTrip() {
+    Bytes payload = {0x00, 0x7F, 0x80, 0xFF, 'A', 0xF0, 0xF7, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    Bytes f = frame(0x12, payload);
+    CHECK(f.size() <= BF_FRAME_MAX);
+    for (size_t i = 1; i + 1 < f.size(); i++) CHECK(f[i] < 0x80);
+
+    // Un Clock MIDI (F8) en medio no rompe la trama
+    f.insert(f.begin() + 5, 0xF8);
+    FrameDecoder dec;
+    byte last = FrameDecoder::NONE;
+    for (byte c : f) last = dec.feed(c);
+    CHECK(last == FrameDecoder::FRAME);
+    CHECK(dec.op() == 0x12);
+    CHECK(dec.length() == payload.size());
+    CHECK(memcmp(dec.payload(), payload.data(), payload.size()) == 0);
+
+    // Un bit cambiado: el CRC la tira
+    Bytes bad = frame(0x12, payload);
+    bad[6] ^= 0x01;
+    for (byte c : bad) last = dec.feed(c);
+    CHECK(last == FrameDecoder::ERROR);
+
+    // SysEx de otro fabricante: se ignora sin error
+    Bytes foreign = {0xF0, 0x43, 0x10, 0x4C, 0x00, 0xF7};
+    for (byte c : foreign) last = dec.feed(c);
+    CHECK(last == FrameDecoder::NONE);
+    CHECK(!dec.active());
+}
+
+void testBinarySave() {
+    harness::boot();
+    ButtonConfig cfg = {"WAH", 'C', 20, 127, 'D', 3, 0, 'S'};
+    Bytes payload = {0, 2};
+    Bytes rec = record(cfg);
+    payload.insert(payload.end(), rec.begin(), rec.end());
+
+    Reply r = exchange(frame(BF_OP_SAVE, payload), BF_OP_ACK);
+    CHECK(r.frames.size() == 1);
+    CHECK(r.frames[0] == Bytes({BF_OP_ACK, BF_OP_SAVE, BF_STATUS_OK}));
+    ButtonConfig* saved = configManager.getButtonConfig(0, 2);
+    CHECK(strcmp(saved->name, "WAH") == 0);
+    CHECK(saved->type == 'C' && saved->value1 == 20 && saved->value2 == 127);
+    CHECK(saved->lpType == 'D' && saved->lpValue1 == 3 && saved->pressMode == 'S');
+
+    // Fuera de rango: error, sin tocar nada
+    payload[0] = 99;
+    r = exchange(frame(BF_OP_SAVE, payload), BF_OP_ACK);
+    CHECK(r.frames.size() == 1 && r.frames[0][2] == BF_STATUS_FAIL);
+
+    // Trama rota: se avisa y se sigue aceptando lo siguiente
+    Bytes bad = frame(BF_OP_SAVEBANK, {0, 'L', 'I', 'V', 'E'});
+    bad[4] ^= 0x01;
+    r = exchange(bad, BF_OP_ACK);
+    CHECK(r.frames.size() == 1 && r.frames[0][2] == BF_STATUS_BAD_FRAME);
+    r = exchange(frame(BF_OP_SAVEBANK, {0, 'L', 'I', 'V', 'E'}), BF_OP_ACK);
+    CHECK(r.frames.size() == 1 && r.frames[0][2] == BF_STATUS_OK);
+    CHECK(strcmp(configManager.getBankName(0), "LIVE") == 0);
+}
+
+void testBinaryDump() {
+    harness::boot();
+    int data = 3 + 4 * configManager.getActiveBanksCount();
+    int total = data + MACRO_COUNT * MACRO_STEPS;
+    std::vector<Bytes> items;
+    uint64_t bytes = 0;
+    int from = 0;
+    while (from < total) {
+        uint64_t before = sim::counters().uartTxBytes;
+        Reply r = exchange(frame(BF_OP_GETALL, {(byte)from, 0, 8}), from + 8 < total ? BF_OP_MORE : BF_OP_END);
+        bytes += sim::counters().uartTxBytes - before;
+        CHECK(r.text.empty());
+        for (const Bytes& f : r.frames) {
+            if (f[0] != BF_OP_MORE && f[0] != BF_OP_END) items.push_back(f);
+        }
+        from += 8;
+    }
+    CHECK((int)items.size() == total);
+    CHECK(items[0][0] == BF_OP_BANK_COUNT && items[0][3] == configManager.getActiveBanksCount());
+    const char* bankName = configManager.getBankName(0);
+    CHECK(items[1][0] == BF_OP_BANK && items[1][3] == 0 && items[1][4] == configManager.getBankTempo(0));
+    CHECK(memcmp(&items[1][5], bankName, strlen(bankName)) == 0);
+    const Bytes& last = items[data - 1];
+    CHECK(last[0] == BF_OP_DATA && last[1] == data - 1);
+    ButtonConfig* cfg = configManager.getButtonConfig(last[3], last[4]);
+    CHECK(memcmp(&last[5], cfg, sizeof(ButtonConfig)) == 0);
+    const Bytes& step = items[total - 1];
+    CHECK(step[0] == BF_OP_MACRO && step[3] == MACRO_COUNT - 1 && step[4] == MACRO_STEPS - 1);
+    CHECK(memcmp(&step[5], &configManager.getMacro(MACRO_COUNT - 1)[MACRO_STEPS - 1], sizeof(MacroStep)) == 0);
+
+    // Mismo volcado en texto, para comparar bytes en el cable
+    uint64_t before = sim::counters().uartTxBytes;
+    for (from = 0; from < total; from += 8) {
+        harness::command(("GETALL:" + std::to_string(from) + ":8").c_str());
+        harness::runFor(500000);
+    }
+    uint64_t ascii = sim::counters().uartTxBytes - before;
+    printf("  dump of %d items: %llu B binary vs %llu B ascii\n", total, (unsigned long long)bytes,
+           (unsigned long long)ascii);
+    CHECK(bytes < ascii);
+}
+
+void testMixedWithAscii() {
+    harness::boot();
+    Bytes data;
+    const char* hello = "HELLO:BIN\n";
+    data.insert(data.end(), hello, hello + strlen(hello));
+    Bytes glo = {1};
+    Bytes rec = record(ButtonConfig{"TUN", 'D', 6, 0, 'N', 0, 0, 'R'});
+    glo.insert(glo.end(), rec.begin(), rec.end());
+    Bytes save = frame(BF_OP_SAVEGLO, glo);
+    data.insert(data.end(), save.begin(), save.end());
+    const char* flush = "FLUSH\n";
+    data.insert(data.end(), flush, flush + strlen(flush));
+
+    Reply r = exchange(data, BF_OP_ACK);
+    CHECK(r.text.find("READY:GP200_CONTROLLER_V3:BIN") != std::string::npos);
+    CHECK(r.frames.size() == 1 && r.frames[0][2] == BF_STATUS_OK);
+    CHECK(strcmp(configManager.getGlobalConfig(1)->name, "TUN") == 0);
+    std::string out;
+    harness::runUntil([&out]() {
+        out += Serial.takeOutput();
+        return out.find("OK:FLUSHED") != std::string::npos;
+    }, 2000000);
+    CHECK(out.find("OK:FLUSHED") != std::string::npos);
+
+    // HELLO sin BIN: respuesta de siempre
+    CHECK(harness::command("HELLO") == "READY:GP200_CONTROLLER_V3");
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(testFrameRoundTrip);
+    RUN_TEST(testBinarySave);
+    RUN_TEST(testBinaryDump);
+    RUN_TEST(testMixedWithAscii);
+    return testFailures ? 1 : 0;
+}
@@ -0,0 +1,167 @@
+// Tests del aprovisionamiento asíncrono del HC-06 contra un módulo emulado.
+
+#include <SimHarness.h>
+#include <BluetoothSetup.h>
+#include "TestCheck.h"
+
+namespace {
+
+// Emulador mínimo del HC-06 (firmware linvor): un comando termina tras un
+// silencio en la línea, sin CR/LF. AT+BAUDn responde a la velocidad vieja y
+// cambia después. Por encima de maxReliable las respuestas llegan corruptas
+// (enlace largo o ruidoso): el módulo entiende, el pedal no.
+struct Hc06 {
+    BtSerial& port;
+    long baud = 9600;
+    long maxReliable = 57600;
+    std::string pending;
+    std::string commands; // Comandos recibidos, separados por '|'
+    unsigned long lastByte = 0;
+    int garbage = 0;      // Bytes que llegaron a otra velocidad
+
+    explicit Hc06(BtSerial& p) : port(p) {
+        port.peer = [this](uint8_t c, long rate) {
+            if (rate != baud) {
+                garbage++;
+                return;
+            }
+            pending += (char)c;
+            unsigned long mark = ++lastByte;
+            sim::at(sim::nowUs() + 800000, [this, mark]() { endOfCommand(mark); });
+        };
+    }
+
+    void reply(const std::string& text) {
+        std::string out = text;
+        if (baud > maxReliable) {
+            for (char& c : out) c ^= 0x20;
+        }
+        port.feed(out.c_str(), sim::nowUs(), baud);
+    }
+
+    void endOfCommand(unsigned long mark) {
+        if (mark != lastByte || pending.empty()) return;
+        commands += pending + "|";
+        if (pending.compare(0, 7, "AT+NAME") == 0) {
+            reply("OKsetname");
+        } else if (pending.compare(0, 6, "AT+PIN") == 0) {
+            reply("OKsetPIN");
+        } else if (pending.compare(0, 7, "AT+BAUD") == 0) {
+            static const long RATES[] = { 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200 };
+            long rate = RATES[pending[7] - '1'];
+            reply("OK" + std::to_string(rate));
+            baud = rate; // Ya respondió a la vieja
+        } else {
+            reply("OK");
+        }
+        pending.clear();
+    }
+};
+
+void clearMarker() {
+    memset(sim::eepromData() + sim::EEPROM_SIZE - BT_MARKER_SIZE, 0xFF, BT_MARKER_SIZE);
+}
+
+// Corre el aprovisionamiento como lo haría loop(); devuelve el mayor coste por vuelta
+uint64_t runSetup(BluetoothSetup& bt, BtSerial& port) {
+    uint64_t worst = 0;
+    bt.begin();
+    uint64_t end = sim::nowUs() + 60000000;
+    while (!bt.isDone() && sim::nowUs() < end) {
+        uint64_t start = sim::nowUs();
+        bt.update(port);
+        if (sim::nowUs() - start > worst) worst = sim::nowUs() - start;
+        sim::advance(100);
+    }
+    return worst;
+}
+
+void testProvisionsFreshModule() {
+    clearMarker();
+    BtSerial port(0, 1);
+    port.begin(9600);
+    Hc06 module(port);
+    BluetoothSetup bt;
+
+    uint64_t worst = runSetup(bt, port);
+    CHECK(bt.isDone());
+    CHECK(bt.isProvisioned());
+    CHECK(module.commands == "AT|AT+NAMEMidiController|AT+PIN0290|AT+BAUD7|AT|AT|");
+    CHECK(bt.baud() == 57600 && port.baud() == 57600 && module.baud == 57600);
+    CHECK(module.garbage == 0);
+    // Los comandos van al ring TX sin esperar; la marca en EEPROM se escribe una vez
+    CHECK(worst < 5 * sim::cost::EEPROM_WRITE_US + 2000);
+}
+
+void testFallsBackToReliableBaud() {
+    clearMarker();
+    BtSerial port(0, 1);
+    port.begin(9600);
+    Hc06 module(port);
+    module.maxReliable = 38400;
+    BluetoothSetup bt;
+
+    runSetup(bt, port);
+    CHECK(bt.isProvisioned());
+    // 57600 no verifica: vuelta a 9600 a ciegas, verificación y 38400
+    CHECK(module.commands == "AT|AT+NAMEMidiController|AT+PIN0290|AT+BAUD7|AT|AT+BAUD4|AT|AT|"
+                            "AT+BAUD6|AT|AT|");
+    CHECK(bt.baud() == 38400 && port.baud() == 38400 && module.baud == 38400);
+}
+
+void testMarkerRestoresBaud() {
+    // La marca del test anterior dice 38400: sin comandos, directo a esa velocidad
+    BtSerial port(0, 1);
+    port.begin(9600);
+    Hc06 module(port);
+    module.baud = 38400;
+    BluetoothSetup bt;
+
+    uint64_t start = sim::nowUs();
+    runSetup(bt, port);
+    CHECK(bt.isProvisioned());
+    CHECK(module.commands.empty());
+    CHECK(port.takeOutput().empty());
+    CHECK(port.baud() == 38400);
+    CHECK(sim::nowUs() - start < BT_POWERUP_MS * 1000 + 1000);
+}
+
+void testFindsModuleAfterLostMarker() {
+    // Módulo ya a 57600 y EEPROM borrada: el probe lo busca velocidad a velocidad
+    clearMarker();
+    BtSerial port(0, 1);
+    port.begin(9600);
+    Hc06 module(port);
+    module.baud = 57600;
+    BluetoothSetup bt;
+
+    runSetup(bt, port);
+    CHECK(bt.isProvisioned());
+    CHECK(module.commands == "AT|AT+NAMEMidiController|AT+PIN0290|");
+    CHECK(bt.baud() == 57600 && port.baud() == 57600);
+    CHECK(module.garbage == 6); // Los "AT" a 9600, 19200 y 38400
+}
+
+void testSilentModuleGivesUp() {
+    clearMarker();
+    BtSerial port(0, 1);
+    port.begin(9600);
+    BluetoothSetup bt;
+
+    runSetup(bt, port);
+    CHECK(bt.isDone());
+    CHECK(!bt.isProvisioned());
+    // Un probe por velocidad; ni nombre ni PIN sin respuesta
+    CHECK(port.takeOutput() == "ATATATAT");
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(testProvisionsFreshModule);
+    RUN_TEST(testFallsBackToReliableBaud);
+    RUN_TEST(testMarkerRestoresBaud);
+    RUN_TEST(testFindsModuleAfterLostMarker);
+    RUN_TEST(testSilentModuleGivesUp);
+    return testFailures ? 1 : 0;
+}
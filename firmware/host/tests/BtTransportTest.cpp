@@ -0,0 +1,155 @@
+// Tests del transporte BT: BtSerial (ring por interrupciones) frente al
+// SoftwareSerial de antes, en caudal sostenido y bytes perdidos.
+
+#include <Arduino.h>
+#include <BtSerial.h>
+#include <SoftwareSerial.h>
+#include <string>
+#include "TestCheck.h"
+
+namespace {
+
+const int STREAM_BYTES = 4000;
+
+std::string pattern(int len) {
+    std::string s;
+    for (int i = 0; i < len; i++) s += (char)('A' + i % 26);
+    return s;
+}
+
+// Recibe 'data' a 'baud' con un loop() que vacía el puerto cada loopUs.
+// Devuelve lo leído y deja en *elapsedUs lo que tardó el último byte.
+template <typename Port>
+std::string receive(Port& port, const std::string& data, uint32_t loopUs, uint64_t* elapsedUs) {
+    uint64_t start = sim::nowUs();
+    port.feed(data.c_str(), start);
+    uint64_t end = start + (uint64_t)(data.size() + 2) * port.byteTimeUs();
+    std::string got;
+    while (sim::nowUs() < end) {
+        sim::advance(loopUs);
+        while (port.available() > 0) got += (char)port.read();
+    }
+    *elapsedUs = sim::nowUs() - start;
+    return got;
+}
+
+void testSustainedThroughput() {
+    const long RATES[] = { 9600, 38400, 57600 };
+    std::string data = pattern(STREAM_BYTES);
+    for (long rate : RATES) {
+        BtSerial port(0, 1);
+        port.begin(rate);
+        uint64_t elapsed;
+        uint64_t dropped = sim::counters().btRxDropped;
+        CHECK(receive(port, data, 1000, &elapsed) == data);
+        CHECK(sim::counters().btRxDropped == dropped);
+        double bytesPerSec = STREAM_BYTES * 1e6 / elapsed;
+        printf("  BtSerial @%ld: %.0f bytes/s, %u perdidos\n", rate, bytesPerSec, port.dropped());
+        CHECK(bytesPerSec > rate / 10 * 0.95);
+    }
+}
+
+// loop() parado 30 ms (splash, RESET de la EEPROM...) con una ráfaga entrando
+void testStalledLoop() {
+    std::string data = pattern(100); // 26 ms a 38400
+    uint64_t elapsed;
+
+    BtSerial bt(0, 1);
+    bt.begin(38400);
+    CHECK(receive(bt, data, 30000, &elapsed) == data);
+    CHECK(bt.dropped() == 0);
+
+    SoftwareSerial soft(0, 1);
+    soft.begin(38400);
+    uint64_t before = sim::counters().softSerialRxDropped;
+    std::string got = receive(soft, data, 30000, &elapsed);
+    uint64_t lost = sim::counters().softSerialRxDropped - before;
+    printf("  loop parado 30 ms @38400: BtSerial 0 perdidos, SoftwareSerial %llu\n",
+           (unsigned long long)lost);
+    CHECK(lost == data.size() - SoftwareSerial::RX_BUFFER_SIZE);
+    CHECK(got == data.substr(0, SoftwareSerial::RX_BUFFER_SIZE));
+}
+
+// Respuesta saliendo mientras llega la siguiente línea
+void testFullDuplex() {
+    std::string in = pattern(24);
+    std::string reply = "OK:SAVED\r\nOK:SAVED\r\n";
+
+    BtSerial bt(0, 1);
+    bt.begin(9600);
+    bt.feed(in.c_str(), sim::nowUs());
+    bt.print(reply.c_str());
+    bt.flush();
+    sim::advance(in.size() * bt.byteTimeUs());
+    std::string got;
+    while (bt.available() > 0) got += (char)bt.read();
+    CHECK(got == in);
+    CHECK(bt.takeOutput() == reply);
+
+    SoftwareSerial soft(0, 1);
+    soft.begin(9600);
+    uint64_t before = sim::counters().softSerialRxDropped;
+    soft.feed(in.c_str(), sim::nowUs());
+    soft.print(reply.c_str());
+    sim::advance(in.size() * soft.byteTimeUs());
+    uint64_t lost = sim::counters().softSerialRxDropped - before;
+    printf("  RX durante TX @9600: BtSerial 0 perdidos, SoftwareSerial %llu de %zu\n",
+           (unsigned long long)lost, in.size());
+    CHECK(lost > 0);
+}
+
+// write() no frena loop() mientras quepa en el ring
+void testWriteDoesNotBlock() {
+    BtSerial bt(0, 1);
+    bt.begin(9600);
+    CHECK(bt.availableForWrite() == BT_TX_RING - 1);
+    uint64_t start = sim::nowUs();
+    bt.print("AT+NAMEMidiController");
+    CHECK(sim::nowUs() - start < 10);
+    CHECK(bt.availableForWrite() == BT_TX_RING - 1 - 21);
+    bt.flush();
+    CHECK(bt.takeOutput() == "AT+NAMEMidiController");
+
+    SoftwareSerial soft(0, 1);
+    soft.begin(9600);
+    start = sim::nowUs();
+    soft.print("AT+NAMEMidiController");
+    CHECK(sim::nowUs() - start >= 21 * soft.byteTimeUs());
+}
+
+void testRingOverflowCounted() {
+    BtSerial bt(0, 1);
+    bt.begin(57600);
+    std::string data = pattern(200);
+    uint64_t before = sim::counters().btRxDropped;
+    bt.feed(data.c_str(), sim::nowUs());
+    sim::advance(data.size() * bt.byteTimeUs() + 1000);
+    CHECK(bt.available() == BT_RX_RING - 1);
+    CHECK(bt.dropped() == data.size() - (BT_RX_RING - 1));
+    CHECK(sim::counters().btRxDropped - before == bt.dropped());
+    // Lo que entró es el principio de la ráfaga, sin huecos
+    std::string got;
+    while (bt.available() > 0) got += (char)bt.read();
+    CHECK(got == data.substr(0, BT_RX_RING - 1));
+}
+
+void testBaudMismatchIsFramingError() {
+    BtSerial bt(0, 1);
+    bt.begin(38400);
+    bt.feed("OK", sim::nowUs(), 9600);
+    sim::advance(5000);
+    CHECK(bt.available() == 0);
+    CHECK(bt.framingErrors() == 2);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(testSustainedThroughput);
+    RUN_TEST(testStalledLoop);
+    RUN_TEST(testFullDuplex);
+    RUN_TEST(testWriteDoesNotBlock);
+    RUN_TEST(testRingOverflowCounted);
+    RUN_TEST(testBaudMismatchIsFramingError);
+    return testFailures ? 1 : 0;
+}
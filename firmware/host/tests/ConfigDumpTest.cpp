@@ -0,0 +1,145 @@
+// Tests del volcado GETALL por ventanas: sale a trozos desde loop() sin
+// frenar los footswitches y la App puede pedir solo las líneas que perdió.
+
+#include <SimHarness.h>
+#include <ConfigManager.h>
+#include <map>
+#include <set>
+#include "TestCheck.h"
+
+namespace {
+
+uint64_t worstLoop = 0;
+
+void recordLoop(uint64_t us) {
+    if (us > worstLoop) worstLoop = us;
+}
+
+// Cliente como el de app.js: guarda las líneas por número y pide lo que falta
+struct DumpClient {
+    std::map<int, std::string> items;
+    std::set<int> drop;   // Números que "se pierden" la primera vez
+    int total = -1;
+    int requests = 0;
+    bool begun = false;
+    std::string partial;
+
+    void send(const std::string& cmd) {
+        requests++;
+        Serial.inject((cmd + "\n").c_str());
+    }
+
+    int firstMissing() {
+        for (int i = 0; i < total; i++) {
+            if (!items.count(i)) return i;
+        }
+        return -1;
+    }
+
+    // Procesa la salida; true cuando ya está todo
+    bool poll() {
+        partial += Serial.takeOutput();
+        size_t eol;
+        while ((eol = partial.find('\n')) != std::string::npos) {
+            std::string line = partial.substr(0, eol);
+            partial.erase(0, eol + 1);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (!onLine(line)) return true;
+        }
+        return false;
+    }
+
+    bool onLine(const std::string& line) {
+        size_t bar = line.find('|');
+        if (bar != std::string::npos) {
+            int seq = atoi(line.c_str());
+            if (drop.erase(seq)) return true;
+            items[seq] = line.substr(bar + 1);
+        } else if (line == "BEGIN:CONFIG") {
+            begun = true;
+        } else if (line.compare(0, 5, "MORE:") == 0 || line.compare(0, 11, "END:CONFIG:") == 0) {
+            total = atoi(line.c_str() + line.rfind(':') + 1);
+            int next = firstMissing();
+            if (next < 0) return false;
+            send("GETALL:" + std::to_string(next) + ":8");
+        }
+        return true;
+    }
+
+    bool run(uint64_t timeoutUs) {
+        send("GETALL");
+        return harness::runUntil([this]() { return poll(); }, timeoutUs);
+    }
+};
+
+void testDumpComesInWindows() {
+    harness::boot();
+    harness::runFor(200000);
+    for (int i = 0; i < 3; i++) harness::command("ADDBANK");
+    harness::runFor(200000);
+    worstLoop = 0;
+    harness::setLoopObserver(recordLoop);
+
+    DumpClient client;
+    CHECK(client.run(2000000));
+    harness::setLoopObserver(nullptr);
+
+    int banks = atoi(client.items[0].c_str() + strlen("BANK_COUNT:"));
+    CHECK(client.begun);
+    CHECK(client.total == 3 + 4 * banks + MACRO_COUNT * MACRO_STEPS);
+    CHECK((int)client.items.size() == client.total);
+    CHECK(client.requests == (client.total + 7) / 8);
+    CHECK(client.items[1].compare(0, 7, "BANK:0:") == 0);
+    CHECK(client.items[3 + 4 * banks - 1].compare(0, 5, "DATA:") == 0);
+    CHECK(client.items[client.total - 1].compare(0, 6, "MACRO:") == 0);
+
+    // Nunca más de lo que cabe en el buffer TX: write() no espera
+    printf("  %d items in %d windows, worst loop %.2f ms\n", client.total, client.requests,
+           worstLoop / 1000.0);
+    CHECK(worstLoop < 3500);
+}
+
+void testLostLinesAreRequestedAgain() {
+    harness::boot();
+    DumpClient client;
+    client.drop = {0, 5, 11};
+    CHECK(client.run(2000000));
+    CHECK(client.drop.empty());
+    CHECK((int)client.items.size() == client.total);
+    CHECK(client.items[0].compare(0, 11, "BANK_COUNT:") == 0);
+    CHECK(client.items[11].compare(0, 5, "DATA:") == 0);
+}
+
+void testCommandsWaitForLineEnd() {
+    harness::boot();
+    Serial.takeOutput();
+    Serial.inject("GETALL\n");
+    harness::step();
+    harness::step(); // Volcado a medias
+    Serial.inject("FLUSH\n");
+
+    std::string out;
+    harness::runUntil([&out]() {
+        out += Serial.takeOutput();
+        return out.find("OK:FLUSHED") != std::string::npos;
+    }, 3000000); // Los ADDBANK anteriores aún se están escribiendo
+
+    // Cada línea está entera: la respuesta de FLUSH no parte ninguna
+    CHECK(out.find("OK:FLUSHED") != std::string::npos);
+    size_t pos = 0, eol;
+    while ((eol = out.find("\r\n", pos)) != std::string::npos) {
+        std::string line = out.substr(pos, eol - pos);
+        CHECK(line == "BEGIN:CONFIG" || line == "OK:FLUSHED" || line.find('|') != std::string::npos ||
+              line.compare(0, 5, "MORE:") == 0 || line.compare(0, 11, "END:CONFIG:") == 0);
+        pos = eol + 2;
+    }
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(testDumpComesInWindows);
+    RUN_TEST(testLostLinesAreRequestedAgain);
+    RUN_TEST(testCommandsWaitForLineEnd);
+    return testFailures ? 1 : 0;
+}
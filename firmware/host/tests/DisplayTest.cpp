@@ -0,0 +1,80 @@
+// Tests del render por diferencias del LCD: loop() nunca gasta más que el
+// presupuesto de bytes I2C por vuelta y los mensajes temporales caducan solos.
+
+#include <SimHarness.h>
+#include <LiquidCrystal_I2C.h>
+#include <MidiDictionary.h>
+#include "TestCheck.h"
+
+namespace {
+
+LiquidCrystal_I2C& lcd() { return *LiquidCrystal_I2C::active(); }
+
+uint64_t maxLoopUs = 0;
+void trackLoop(uint64_t us) {
+    if (us > maxLoopUs) maxLoopUs = us;
+}
+
+void testSplashCancelledByPress() {
+    CHECK(lcd().row(0).compare(0, 15, "MIDI Controller") == 0);
+
+    uint64_t t0 = sim::nowUs() + 1000;
+    harness::press(harness::PIN_BANK_UP, t0, 80000);
+    harness::runUntil([&]() { return sim::nowUs() > t0 + 150000; }, 1000000);
+    CHECK(lcd().row(0).compare(0, 14, "GP-200: BANK 0") == 0);
+    CHECK(lcd().row(1).compare(0, 4, "P0-0") == 0);
+}
+
+void testRenameRepaintsOnlyChangedCells() {
+    uint64_t clears = sim::counters().lcdClears;
+    uint64_t bytes = sim::counters().lcdBytes;
+    CHECK(harness::command("SAVEBANK:0:BANK 9") == "OK:BANK_RENAMED");
+    harness::runFor(100000);
+    CHECK(lcd().row(0).compare(0, 14, "GP-200: BANK 9") == 0);
+    CHECK(sim::counters().lcdClears == clears);
+    CHECK(sim::counters().lcdBytes - bytes <= 2); // setCursor + 1 carácter
+}
+
+void testOverlayExpiresWithoutBlocking() {
+    CHECK(harness::command("SAVE:0:0:P0-0:P:0:0:D:3:0") == "OK:SAVED");
+    harness::runFor(100000);
+
+    maxLoopUs = 0;
+    harness::setLoopObserver(trackLoop);
+    uint64_t t0 = sim::nowUs() + 1000;
+    harness::press(harness::PIN_PRESET_1, t0, 1200000);
+    harness::runUntil([&]() { return sim::nowUs() > t0 + 1100000; }, 5000000);
+    CHECK(lcd().row(0).compare(0, 3, "DLY") == 0);
+    CHECK(lcd().row(1).compare(0, 2, "ON") == 0);
+
+    harness::runUntil([&]() { return sim::nowUs() > t0 + 1800000; }, 5000000);
+    harness::setLoopObserver(nullptr);
+    CHECK(lcd().row(0).compare(0, 14, "GP-200: BANK 9") == 0);
+    // 6 bytes I2C * 550 us + resto de loop(): nunca los 600 ms del delay() antiguo
+    CHECK(maxLoopUs < 5000);
+}
+
+// Etiquetas y CC del diccionario salen de flash; con índice constante, al compilar
+static_assert(dictCC(DICT_DLY) == 55 && dictCC(DICT_SIZE) == 0, "CC del diccionario");
+
+void testDictionaryFromFlash() {
+    volatile int idx = DICT_LREC; // Índice de runtime, como el de un ButtonConfig
+    CHECK(getCCFromDict(idx) == 60);
+    CHECK(strcmp_P("L.REC", reinterpret_cast<PGM_P>(getNameFromDict(idx))) == 0);
+    CHECK(strcmp_P("???", reinterpret_cast<PGM_P>(getNameFromDict(DICT_SIZE))) == 0);
+    CHECK(getCCFromDict(-1) == 0);
+}
+
+} // namespace
+
+int main() {
+    harness::boot();
+    harness::runFor(100000);
+
+    RUN_TEST(testSplashCancelledByPress);
+    RUN_TEST(testRenameRepaintsOnlyChangedCells);
+    RUN_TEST(testOverlayExpiresWithoutBlocking);
+    RUN_TEST(testDictionaryFromFlash);
+
+    return testFailures ? 1 : 0;
+}
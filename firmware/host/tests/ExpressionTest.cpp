@@ -0,0 +1,224 @@
+// Tests de los pedales de expresión: registro de EEPROM, sobremuestreo del
+// ADC (con el retraso de un canal del mux), histéresis, ritmo de CC, curvas,
+// prioridad de los footswitches y comandos EXP / EXPCAL / GETEXP.
+
+#include <SimHarness.h>
+#include <ConfigManager.h>
+#include <ExpressionPedals.h>
+#include <vector>
+#include "TestCheck.h"
+
+using harness::freshEeprom;
+using harness::send;
+
+extern ConfigManager configManager;
+extern ExpressionPedals expression;
+
+namespace {
+
+const uint8_t CH_EXP0 = 2; // A2
+const uint8_t CH_EXP1 = 3; // A3
+const byte CC_WAH = 11;
+
+// CC de 'cc' que salieron desde 'from'
+std::vector<sim::MidiEvent> ccsSince(size_t from, byte cc) {
+    std::vector<sim::MidiEvent> out;
+    std::vector<sim::MidiEvent>& log = sim::midiLog();
+    for (size_t i = from; i < log.size(); i++) {
+        if ((log[i].status & 0xF0) == 0xB0 && log[i].data1 == cc) out.push_back(log[i]);
+    }
+    return out;
+}
+
+// Rampa lineal de la entrada 'ch' de 'from' a 'to' en 'us', a pasos de 1 ms
+void sweep(uint8_t ch, int from, int to, uint64_t us, uint16_t noise = 0) {
+    uint64_t t0 = sim::nowUs();
+    for (uint64_t t = 0; t <= us; t += 1000) {
+        int v = from + (int)((to - from) * (int64_t)t / (int64_t)us);
+        sim::at(t0 + t, [ch, v, noise]() { sim::setAnalog(ch, v, noise); });
+    }
+}
+
+void testPackExp() {
+    ExpConfig in[EXP_INPUTS] = { { 11, 'S', 900, 37 }, { 127, 'E', 1023, 0 } };
+    ExpConfig out[EXP_INPUTS];
+    byte rec[JOURNAL_RECORD_SIZE];
+    packExp(in, rec);
+    unpackExp(rec, out);
+    for (byte i = 0; i < EXP_INPUTS; i++) {
+        CHECK(out[i].cc == in[i].cc && out[i].curve == in[i].curve);
+        CHECK(out[i].heel == in[i].heel && out[i].toe == in[i].toe);
+    }
+
+    // Slot sin escribir: entrada apagada y sin calibrar
+    memset(rec, 0xFF, sizeof(rec));
+    unpackExp(rec, out);
+    CHECK(out[0].cc == 0 && out[0].curve == 'L' && out[0].heel == 0 && out[0].toe == 1023);
+
+    // Curvas: de 0 a 127 sin bajar nunca; la lineal es la identidad
+    for (byte c = 0; c < 4; c++) {
+        char curve = pgm_read_byte(EXP_CURVES + c);
+        CHECK(expCurve(curve, 0) == 0 && expCurve(curve, 127) == 127);
+        for (byte p = 1; p < 128; p++) CHECK(expCurve(curve, p) >= expCurve(curve, p - 1));
+    }
+    CHECK(expCurve('L', 64) == 64 && expCurve('E', 64) < 64 && expCurve('G', 64) > 64);
+}
+
+void testOversampling() {
+    freshEeprom();
+    sim::setAnalog(CH_EXP0, 700);
+    sim::setAnalog(CH_EXP1, 100);
+    harness::boot();
+    harness::runFor(3000000); // Splash
+
+    // Cada entrada lee su canal: la conversión tras cambiar el mux se tira
+    CHECK(expression.raw(0) == 700 && expression.raw(1) == 100);
+
+    // Ruido de +-2 cuentas: el promedio queda a menos de 1
+    sim::setAnalog(CH_EXP0, 700, 2);
+    harness::runFor(100000);
+    CHECK(expression.raw(0) >= 699 && expression.raw(0) <= 701);
+
+    // EXP_OVERSAMPLE + 1 conversiones por lectura: ~280 por entrada y segundo
+    unsigned long r0 = expression.readings();
+    uint64_t c0 = sim::counters().adcConversions;
+    harness::runFor(1000000);
+    unsigned long readings = expression.readings() - r0;
+    CHECK(readings == (sim::counters().adcConversions - c0) / (EXP_OVERSAMPLE + 1) ||
+          readings == (sim::counters().adcConversions - c0) / (EXP_OVERSAMPLE + 1) + 1);
+    CHECK(readings / EXP_INPUTS > 250 && readings / EXP_INPUTS < 300);
+
+    // Entrada apagada (CC 0, por defecto): nada sale
+    CHECK(ccsSince(0, 0).size() + ccsSince(0, CC_WAH).size() == 0);
+    CHECK(expression.value(0) == -1);
+}
+
+void testDeadband() {
+    // Justo en la frontera entre dos escalones y con ruido: la primera
+    // lectura fija la posición y luego nada baila
+    sim::setAnalog(CH_EXP0, 512, 4);
+    harness::runFor(20000);
+    size_t from = sim::midiLog().size();
+    CHECK(send("EXP:0:11:L") == "OK:EXP_SAVED");
+    harness::runFor(2000000);
+    CHECK(ccsSince(from, CC_WAH).empty());
+    CHECK(expression.value(0) == 63 || expression.value(0) == 64);
+}
+
+void testSweepRate() {
+    size_t from = sim::midiLog().size();
+    unsigned long ccs0 = expression.ccs();
+    sweep(CH_EXP0, 512, 1023, 300000, 2);
+    harness::runFor(400000);
+    std::vector<sim::MidiEvent> ccs = ccsSince(from, CC_WAH);
+
+    // Sube sin volver atrás hasta el tope, un CC cada EXP_INTERVAL_MS como mucho
+    CHECK(!ccs.empty() && ccs.back().data2 == 127);
+    CHECK(ccs.size() <= 300 / EXP_INTERVAL_MS + 2 && ccs.size() >= 20);
+    for (size_t i = 1; i < ccs.size(); i++) {
+        CHECK(ccs[i].data2 > ccs[i - 1].data2);
+        CHECK(ccs[i].queuedUs - ccs[i - 1].queuedUs >= (EXP_INTERVAL_MS - 1) * 1000UL); // Resolución de millis()
+    }
+    CHECK(expression.ccs() - ccs0 == ccs.size());
+    // Al ir más rápido que el ritmo, valores intermedios se quedaron sin salir
+    CHECK(expression.coalesced() > 0);
+
+    // Quieto arriba: nada más
+    from = sim::midiLog().size();
+    harness::runFor(500000);
+    CHECK(ccsSince(from, CC_WAH).empty());
+
+    // Y de vuelta hasta el talón
+    sweep(CH_EXP0, 1023, 0, 200000, 2);
+    harness::runFor(300000);
+    ccs = ccsSince(from, CC_WAH);
+    CHECK(!ccs.empty() && ccs.back().data2 == 0);
+}
+
+void testFootswitchFirst() {
+    // Pedal moviéndose y pisada a la vez: el PC no espera a los CC del pedal
+    CHECK(send("SAVE:0:0:WAH:P:7:0:N:0:0:I") == "OK:SAVED");
+    size_t from = sim::midiLog().size();
+    sweep(CH_EXP0, 0, 1023, 400000, 2);
+    harness::press(harness::PIN_PRESET_1, sim::nowUs() + 150000, 60000);
+    harness::runFor(500000);
+
+    uint64_t pcLatency = 0;
+    bool found = false;
+    std::vector<sim::MidiEvent>& log = sim::midiLog();
+    for (size_t i = from; i < log.size(); i++) {
+        if ((log[i].status & 0xF0) == 0xC0 && log[i].data1 == 7) {
+            pcLatency = log[i].wireUs - log[i].queuedUs;
+            found = true;
+        }
+    }
+    CHECK(found);
+    // Como mucho detrás de un CC que ya estaba en el UART (3 bytes a 31250)
+    CHECK(pcLatency <= 2000);
+    CHECK(ccsSince(from, CC_WAH).back().data2 == 127);
+}
+
+void testCalibration() {
+    // Pedal al revés y con poco recorrido: talón en 900, punta en 100
+    sim::setAnalog(CH_EXP0, 900);
+    harness::runFor(50000);
+    CHECK(send("EXPCAL:0:HEEL") == "OK:EXP_CALIBRATED");
+    sim::setAnalog(CH_EXP0, 100);
+    harness::runFor(50000);
+    CHECK(send("EXPCAL:0:TOE") == "OK:EXP_CALIBRATED");
+    CHECK(send("EXP:0:11:E") == "OK:EXP_SAVED");
+    CHECK(configManager.expConfigs[0].heel == 900 && configManager.expConfigs[0].toe == 100);
+
+    harness::runFor(50000);
+    CHECK(expression.value(0) == 127);
+    sim::setAnalog(CH_EXP0, 880); // Dentro del margen del talón
+    harness::runFor(50000);
+    CHECK(expression.value(0) == 0);
+    sim::setAnalog(CH_EXP0, 500);
+    harness::runFor(50000);
+    CHECK(expression.value(0) == expCurve('E', 64) || expression.value(0) == expCurve('E', 63));
+
+    // Errores
+    CHECK(send("EXP:2:11:L") == "ERR:EXP_FAIL");
+    CHECK(send("EXP:0:128:L") == "ERR:EXP_FAIL");
+    CHECK(send("EXP:0:11:X") == "ERR:EXP_FAIL");
+    CHECK(send("EXPCAL:0:MID") == "ERR:EXP_FAIL");
+    CHECK(send("EXPCAL:5:TOE") == "ERR:EXP_FAIL");
+
+    // GETEXP: una línea por entrada
+    Serial.takeOutput();
+    Serial.inject("GETEXP\n");
+    std::string out;
+    harness::runUntil([&out]() {
+        out += Serial.takeOutput();
+        return out.find("END:EXP\r\n") != std::string::npos;
+    }, 1000000);
+    char line[48];
+    snprintf(line, sizeof(line), "EXP:0:11:E:900:100:500:%d\r\n", expression.value(0));
+    CHECK(out.find(line) != std::string::npos);
+    CHECK(out.find("EXP:1:0:L:0:1023:100:-1\r\n") != std::string::npos);
+
+    // Persiste
+    CHECK(send("FLUSH") == "OK:FLUSHED");
+    ConfigManager reboot;
+    reboot.begin();
+    CHECK(reboot.expConfigs[0].cc == 11 && reboot.expConfigs[0].curve == 'E');
+    CHECK(reboot.expConfigs[0].heel == 900 && reboot.expConfigs[0].toe == 100);
+    CHECK(reboot.expConfigs[1].cc == 0);
+
+    // RESET apaga los pedales
+    CHECK(send("RESET") == "OK:RESET_DONE");
+    CHECK(configManager.expConfigs[0].cc == 0 && configManager.expConfigs[0].toe == 1023);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(testPackExp);
+    RUN_TEST(testOversampling);
+    RUN_TEST(testDeadband);
+    RUN_TEST(testSweepRate);
+    RUN_TEST(testFootswitchFirst);
+    RUN_TEST(testCalibration);
+    return testFailures ? 1 : 0;
+}
@@ -0,0 +1,206 @@
+// Tests de las macros: tipo 'M' en los registros de 8 bytes, pasos en la
+// EEPROM, comando MACRO y reproducción con retardos sin bloquear loop().
+
+#include <SimHarness.h>
+#include <ConfigManager.h>
+#include <MacroPlayer.h>
+#include <vector>
+#include "TestCheck.h"
+
+using harness::freshEeprom;
+using harness::send;
+using harness::press;
+
+extern ConfigManager configManager;
+extern MacroPlayer macroPlayer;
+
+namespace {
+
+ButtonConfig button(char type, char lpType, char mode) {
+    ButtonConfig b;
+    strcpy(b.name, "MAC");
+    b.type = type;
+    b.value1 = 3;
+    b.value2 = 100;
+    b.lpType = lpType;
+    b.lpValue1 = 2;
+    b.lpValue2 = 127;
+    b.pressMode = mode;
+    return b;
+}
+
+// Todas las combinaciones de tipo, Long Press y modo vuelven iguales
+void testPackRoundTrip() {
+    const char TYPES[] = "PDCNM";
+    const char LP[] = "NCPDM";
+    const char MODES[] = "RIS";
+    byte rec[JOURNAL_RECORD_SIZE];
+    for (char t : std::string(TYPES)) {
+        for (char lp : std::string(LP)) {
+            for (char m : std::string(MODES)) {
+                ButtonConfig in = button(t, lp, m), out;
+                packButton(in, rec);
+                unpackButton(rec, out);
+                CHECK(out.type == t && out.lpType == lp && out.pressMode == m);
+                CHECK(strcmp(out.name, "MAC") == 0 && out.value1 == 3 && out.value2 == 100);
+                CHECK(out.lpValue1 == 2 && out.lpValue2 == 127);
+            }
+        }
+    }
+
+    // Sin 'M' los bits 6 y 7 quedan a 0: un registro de antes se lee igual
+    ButtonConfig old = button('C', 'D', 'S');
+    packButton(old, rec);
+    CHECK((rec[6] & 0x80) == 0 && (rec[7] & 0x80) == 0);
+}
+
+void testMacrosPersist() {
+    freshEeprom();
+    ConfigManager cfg;
+    cfg.begin();
+    for (int m = 0; m < MACRO_COUNT; m++) {
+        for (int i = 0; i < MACRO_STEPS; i++) CHECK(cfg.getMacro(m)[i].type == 'N');
+    }
+    CHECK(cfg.getMacro(MACRO_COUNT) == nullptr);
+
+    MacroStep* steps = cfg.getMacro(2);
+    steps[0] = { 'P', 5, 1, 0 };
+    steps[1] = { 'D', 4, 127, 5 };
+    cfg.markMacroDirty(2, 0);
+    cfg.markMacroDirty(2, 1);
+    cfg.save();
+    // Otra macro en RAM mientras la 2 sigue en cola
+    cfg.getMacro(1)[0] = { 'C', 20, 64, 0 };
+    cfg.markMacroDirty(1, 0);
+    cfg.save();
+    cfg.flush();
+
+    ConfigManager reboot;
+    reboot.begin();
+    steps = reboot.getMacro(2);
+    CHECK(steps[0].type == 'P' && steps[0].value1 == 5 && steps[0].value2 == 1);
+    CHECK(steps[1].type == 'D' && steps[1].value1 == 4 && steps[1].delay == 5);
+    CHECK(steps[2].type == 'N');
+    CHECK(reboot.getMacro(1)[0].type == 'C' && reboot.getMacro(1)[0].value1 == 20);
+    CHECK(reboot.getMacro(0)[0].type == 'N');
+
+    // RESET solo baja la máscara: los registros viejos ya no se leen
+    reboot.resetToDefaults();
+    reboot.save();
+    reboot.flush();
+    CHECK(reboot.getMacro(2)[0].type == 'N');
+    ConfigManager again;
+    again.begin();
+    CHECK(again.getMacro(2)[0].type == 'N' && again.getMacro(1)[0].type == 'N');
+}
+
+// CC 20..23 que manda la macro, con su instante de encolado
+std::vector<sim::MidiEvent> macroEvents(size_t from) {
+    std::vector<sim::MidiEvent> out;
+    std::vector<sim::MidiEvent>& log = sim::midiLog();
+    for (size_t i = from; i < log.size(); i++) {
+        if (log[i].status == 0xB0 && log[i].data1 >= 20 && log[i].data1 <= 23) out.push_back(log[i]);
+    }
+    return out;
+}
+
+// Respuesta de 'line', dejando que salga del todo: un ERR tras una ráfaga de
+// OK esperaría al UART dentro de la tarea
+void testMacroCommand() {
+    freshEeprom();
+    harness::boot();
+    harness::runFor(3000000); // Splash
+
+    CHECK(send("MACRO:0:0:C:20:1:0") == "OK:MACRO_SAVED");
+    CHECK(send("MACRO:0:1:C:21:2:0") == "OK:MACRO_SAVED");
+    CHECK(send("MACRO:0:2:C:22:3:48") == "OK:MACRO_SAVED"); // 50 ms
+    CHECK(send("MACRO:0:3:C:23:4:50") == "OK:MACRO_SAVED");
+    CHECK(send("MACRO:4:0:C:20:1:0") == "ERR:MACRO_FAIL");
+    CHECK(send("MACRO:0:6:C:20:1:0") == "ERR:MACRO_FAIL");
+    CHECK(send("MACRO:0:4:X:20:1:0") == "ERR:MACRO_FAIL");
+    CHECK(send("MACRO:0:4") == "ERR:MACRO_FAIL");
+
+    MacroStep* steps = configManager.getMacro(0);
+    CHECK(steps[2].type == 'C' && steps[2].value1 == 22 && steps[2].delay == 5);
+    CHECK(steps[4].type == 'N');
+
+    // Preset 1 y Long Press del 2 disparan la macro 0
+    CHECK(send("SAVE:0:0:MAC:M:0:0:N:0:0:I") == "OK:SAVED");
+    CHECK(send("SAVE:0:1:FX:D:1:0:M:0:0:R") == "OK:SAVED");
+    CHECK(configManager.getButtonConfig(0, 0)->type == 'M');
+    CHECK(configManager.getButtonConfig(0, 1)->lpType == 'M');
+}
+
+// Offsets 0/0/50/100 ms desde la pisada, sin acumular el retraso de loop()
+void testPlaybackTiming() {
+    uint64_t overruns = sim::counters().sliceOverruns;
+    unsigned int played = macroPlayer.played();
+    size_t from = sim::midiLog().size();
+    uint64_t at = sim::nowUs() + 1000;
+    press(harness::PIN_PRESET_1, at, 60000);
+    harness::runFor(300000);
+
+    std::vector<sim::MidiEvent> ev = macroEvents(from);
+    CHECK(ev.size() == 4);
+    if (ev.size() != 4) return;
+    for (int i = 0; i < 4; i++) CHECK(ev[i].data1 == 20 + i && ev[i].data2 == 1 + i);
+    uint64_t t0 = ev[0].queuedUs;
+    CHECK(t0 - at < 60000); // Debounce (50 ms) + una vuelta
+    CHECK(ev[1].queuedUs == t0);
+    const uint64_t OFFSETS[] = { 0, 0, 50000, 100000 };
+    for (int i = 2; i < 4; i++) {
+        int64_t err = (int64_t)(ev[i].queuedUs - t0) - (int64_t)OFFSETS[i];
+        printf("  paso %d: %+lld us\n", i, (long long)err);
+        CHECK(err > -1000 && err < 5000);
+    }
+    CHECK(macroPlayer.played() == played + 1);
+    CHECK(!macroPlayer.playing());
+    CHECK(sim::counters().sliceOverruns == overruns);
+}
+
+// Pisar otra vez reinicia: el paso pendiente de la primera no sale
+void testRepressRestarts() {
+    CHECK(send("MACRO:0:3:C:23:4:300") == "OK:MACRO_SAVED");
+    unsigned int played = macroPlayer.played();
+    size_t from = sim::midiLog().size();
+    uint64_t at = sim::nowUs() + 1000;
+    press(harness::PIN_PRESET_1, at, 60000);
+    press(harness::PIN_PRESET_1, at + 200000, 60000); // Pasado el lockout
+    harness::runFor(800000);
+
+    std::vector<sim::MidiEvent> ev = macroEvents(from);
+    CHECK(ev.size() == 7);
+    if (ev.size() != 7) return;
+    const byte ORDER[] = { 20, 21, 22, 20, 21, 22, 23 };
+    for (int i = 0; i < 7; i++) CHECK(ev[i].data1 == ORDER[i]);
+    // Paso 2 (50 ms) + paso 3 (300 ms) desde el reinicio, con el mismo margen
+    int64_t err = (int64_t)(ev[6].queuedUs - ev[3].queuedUs) - 350000;
+    CHECK(err > -1000 && err < 5000);
+    CHECK(macroPlayer.played() == played + 1);
+}
+
+// Long Press 'M' y la macro tocada desde el botón global
+void testLongPressAndGlobal() {
+    size_t from = sim::midiLog().size();
+    press(harness::PIN_PRESET_2, sim::nowUs() + 1000, 1200000);
+    harness::runFor(1800000);
+    CHECK(macroEvents(from).size() == 4);
+
+    CHECK(send("SAVEGLO:0:MAC:M:0:0") == "OK:SAVED_GLO");
+    from = sim::midiLog().size();
+    press(harness::PIN_GUITAR_CHANGE, sim::nowUs() + 1000, 60000);
+    harness::runFor(800000);
+    CHECK(macroEvents(from).size() == 4);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(testPackRoundTrip);
+    RUN_TEST(testMacrosPersist);
+    RUN_TEST(testMacroCommand);
+    RUN_TEST(testPlaybackTiming);
+    RUN_TEST(testRepressRestarts);
+    RUN_TEST(testLongPressAndGlobal);
+    return testFailures ? 1 : 0;
+}
@@ -0,0 +1,161 @@
+// Tests de las métricas en el pedal: cubetas log2, saturación sin perder el
+// reparto y el volcado STATS / STATSRESET por el protocolo de la App.
+
+#include <SimHarness.h>
+#include <Metrics.h>
+#include <SerialCommander.h>
+#include <string>
+#include "TestCheck.h"
+
+extern Metrics metrics;
+
+namespace {
+
+void testBuckets() {
+    Metrics m;
+    m.record(MET_LOOP_US, 100);   // < 128 us
+    m.record(MET_LOOP_US, 200);   // 128..255
+    m.record(MET_LOOP_US, 9000);  // >= 8192
+    CHECK(m.count(MET_LOOP_US, 0) == 1);
+    CHECK(m.count(MET_LOOP_US, 1) == 1);
+    CHECK(m.count(MET_LOOP_US, 7) == 1);
+    CHECK(m.maximum(MET_LOOP_US) == 9000);
+
+    m.record(MET_LATENCY_MS, 0);
+    m.record(MET_LATENCY_MS, 1);
+    m.record(MET_LATENCY_MS, 3);
+    m.record(MET_LATENCY_MS, 100000); // Máximo saturado a 16 bits
+    CHECK(m.count(MET_LATENCY_MS, 0) == 1);
+    CHECK(m.count(MET_LATENCY_MS, 1) == 1);
+    CHECK(m.count(MET_LATENCY_MS, 2) == 1);
+    CHECK(m.count(MET_LATENCY_MS, 7) == 1);
+    CHECK(m.maximum(MET_LATENCY_MS) == 0xFFFF);
+}
+
+void testSaturationHalves() {
+    Metrics m;
+    for (int i = 0; i < 4; i++) m.record(MET_EEPROM_US, 300);
+    for (long i = 0; i < 0xFFFF; i++) m.record(MET_EEPROM_US, 10);
+    CHECK(m.count(MET_EEPROM_US, 0) == 0xFFFF);
+    m.record(MET_EEPROM_US, 10);
+    CHECK(m.count(MET_EEPROM_US, 0) == 0x8000);
+    CHECK(m.count(MET_EEPROM_US, 2) == 2);
+}
+
+// Manda una línea y recoge la respuesta hasta 'last' (o el timeout)
+std::string exchange(const char* line, const char* last) {
+    Serial.takeOutput();
+    Serial.inject(line);
+    Serial.inject("\n");
+    std::string out;
+    harness::runUntil([&]() {
+        out += Serial.takeOutput();
+        return out.find(last) != std::string::npos;
+    }, 2000000);
+    return out;
+}
+
+// Campo 'n' (desde 0) de la línea que empieza por 'prefix'
+long field(const std::string& out, const char* prefix, int n) {
+    size_t at = out.find(prefix);
+    if (at == std::string::npos) return -1;
+    std::string line = out.substr(at, out.find('\r', at) - at);
+    size_t pos = 0;
+    for (int i = 0; i < n; i++) {
+        pos = line.find(':', pos);
+        if (pos == std::string::npos) return -1;
+        pos++;
+    }
+    return atol(line.c_str() + pos);
+}
+
+void testStatsCommand() {
+    CHECK(exchange("STATSRESET", "\n").find("OK:STATS_RESET") != std::string::npos);
+    harness::command("HELLO");
+
+    // Una pisada de P1 (PC): su latencia entra en el histograma
+    size_t before = sim::midiLog().size();
+    harness::press(harness::PIN_PRESET_1, sim::nowUs() + 2000, 80000);
+    harness::runFor(300000);
+    CHECK(sim::midiLog().size() > before);
+
+    std::string out = exchange("STATS", "STATS:END");
+    CHECK(out.find("STATS:BEGIN:") != std::string::npos);
+    long loops = 0;
+    for (int b = 0; b < MET_BUCKETS; b++) loops += field(out, "STAT:LOOP:", 2 + b);
+    CHECK(loops > 1000);
+    long presses = 0;
+    for (int b = 0; b < MET_BUCKETS; b++) presses += field(out, "STAT:LAT:", 2 + b);
+    CHECK(presses == 1);
+    // Acción al soltar: flanco de subida -> UART = debounce (50 ms) + una vuelta
+    CHECK(field(out, "STAT:LAT:", 2 + 6) == 1);
+    CHECK(field(out, "STAT:MAX:", 3) >= 50 && field(out, "STAT:MAX:", 3) < 55);
+    // El RX se suma al final de cada update(): STATSRESET cuenta tras su reset
+    CHECK(field(out, "STAT:RX:", 2) == 11 + 6 + 6);
+    CHECK(field(out, "STAT:CMD:", 2) == 1);  // HELLO
+    CHECK(field(out, "STAT:CMD:", 7) == 1);  // Este STATS
+    CHECK(field(out, "STAT:DROP:", 2) == 0);
+
+    // Las líneas caben en el buffer de SerialCommander
+    size_t start = 0, end;
+    while ((end = out.find("\r\n", start)) != std::string::npos) {
+        CHECK(end - start < SC_LINE_SIZE - 2);
+        start = end + 2;
+    }
+
+    exchange("STATSRESET", "OK:STATS_RESET");
+    CHECK(metrics.commands(MET_CMD_READ) == 0 && metrics.rx(MET_PORT_USB) == 11);
+}
+
+void testStatsAndEepromDuringEdits() {
+    exchange("STATSRESET", "OK:STATS_RESET");
+    CHECK(harness::command("SAVE:0:1:FX:D:3:0:N:0:0") == "OK:SAVED");
+    exchange("FLUSH", "OK:FLUSHED");
+    CHECK(metrics.commands(MET_CMD_EDIT) == 1 && metrics.commands(MET_CMD_TX) == 1);
+    long writes = 0;
+    for (int b = 0; b < MET_BUCKETS; b++) writes += metrics.count(MET_EEPROM_US, b);
+    CHECK(writes > 0);
+    CHECK(metrics.maximum(MET_EEPROM_US) > 0);
+}
+
+void testStatsWhileDumping() {
+    // STATS no corta un GETALL en curso
+    std::string out = exchange("GETALL\nSTATS", "END:CONFIG");
+    CHECK(out.find("ERR:BUSY") != std::string::npos);
+    CHECK(out.find("BEGIN:CONFIG") != std::string::npos);
+}
+
+void testBufferOverflowCounted() {
+    exchange("STATSRESET", "OK:STATS_RESET");
+    std::string longLine(SC_BUFFER_SIZE + 4, 'X');
+    CHECK(exchange(longLine.c_str(), "ERR:BUFF_OVF").find("ERR:BUFF_OVF") != std::string::npos);
+    CHECK(metrics.overflows() == 1);
+}
+
+// Compilado con METRICS_ENABLED 0: el pedal no tiene nada que contar
+void testDisabled() {
+    CHECK(harness::command("STATS") == "ERR:NO_STATS");
+    CHECK(harness::command("STATSRESET") == "ERR:NO_STATS");
+}
+
+} // namespace
+
+int main() {
+    if (!Metrics::enabled) {
+        harness::boot();
+        RUN_TEST(testDisabled);
+        return testFailures ? 1 : 0;
+    }
+
+    RUN_TEST(testBuckets);
+    RUN_TEST(testSaturationHalves);
+
+    harness::boot();
+    harness::runFor(200000);
+    RUN_TEST(testStatsCommand);
+    RUN_TEST(testStatsAndEepromDuringEdits);
+    RUN_TEST(testStatsWhileDumping);
+    RUN_TEST(testBufferOverflowCounted);
+
+    return testFailures ? 1 : 0;
+}
@@ -0,0 +1,153 @@
+// Tests del demux de MIDI IN: mensajes MIDI (running status, SysEx, realtime)
+// y comandos de la App mezclados en el mismo Serial a 31250 baudios.
+
+#include <SimHarness.h>
+#include <ConfigManager.h>
+#include <MidiInput.h>
+#include <vector>
+#include "TestCheck.h"
+
+extern ConfigManager configManager;
+extern MidiInput midiIn;
+extern bool ledStates[3];
+extern bool globalEffectStates[];
+extern int currentBank;
+extern int currentPresetIndex;
+
+namespace {
+
+typedef std::vector<uint8_t> Bytes;
+
+struct Msg {
+    byte status, data1, data2;
+};
+std::vector<Msg> received;
+
+void record(byte status, byte data1, byte data2) {
+    received.push_back({status, data1, data2});
+}
+
+Bytes text(const char* s) {
+    return Bytes(s, s + strlen(s));
+}
+
+Bytes operator+(Bytes a, const Bytes& b) {
+    a.insert(a.end(), b.begin(), b.end());
+    return a;
+}
+
+// Rutas de cada byte, como letras: M = MIDI, T = texto, S/F = trama
+std::string routes(MidiInput& in, const Bytes& data, unsigned long now) {
+    std::string out;
+    for (uint8_t c : data) out += "MTSF"[in.route(c, now)];
+    return out;
+}
+
+void testRoutes() {
+    MidiInput in;
+    received.clear();
+    in.setHandler(record);
+
+    // Un CC en medio de una línea y un Clock entre letras
+    CHECK(routes(in, text("SA") + Bytes{0xB0, 55, 127} + text("V") + Bytes{0xF8} + text("E\n"), 0) ==
+          "TTMMMTMTT");
+    CHECK(received.size() == 1 && received[0].data1 == 55 && received[0].data2 == 127);
+
+    // Running status: el 2º CC llega sin status
+    received.clear();
+    CHECK(routes(in, {0xB0, 49, 127, 50, 0, 0xC0, 5, 6}, 100) == "MMMMMMMM");
+    CHECK(received.size() == 4);
+    CHECK(received[1].status == 0xB0 && received[1].data1 == 50 && received[1].data2 == 0);
+    CHECK(received[3].status == 0xC0 && received[3].data1 == 6);
+
+    // Pasado el timeout, un byte de datos ya es texto
+    CHECK(routes(in, text("H"), 100 + MIDI_RS_TIMEOUT_MS) == "T");
+    CHECK(routes(in, text("\n"), 200) == "T");
+
+    // SysEx ajeno entero a MIDI; cancela el running status
+    received.clear();
+    CHECK(routes(in, Bytes{0xB0, 1, 2, 0xF0, 0x43, 0x10, 0x4C, 0xF7} + text("X\n"), 300) == "MMMMMMMMTT");
+    CHECK(received.size() == 1);
+
+    // Trama de configuración: F0 se retiene hasta ver el fabricante
+    CHECK(routes(in, {0xF0, BF_MANUFACTURER, 0x00, 0x01, 0xF8, 0xF7}, 400) == "MSFFMF");
+}
+
+// Programa 'data' en el RX de Serial a 31250 baudios desde ahora
+void feedWire(const Bytes& data) {
+    Serial.feed(data.data(), data.size(), sim::nowUs());
+}
+
+void testInterleavedAtWireRate() {
+    harness::boot();
+    harness::command("SAVE:0:1:FX:D:3:0:N:0:0");  // Slot 2 = DLY (CC 55)
+    harness::command("SAVE:0:2:LEAD:P:7:0:N:0:0"); // Slot 3 = PC 7
+    harness::runFor(100000);
+    Serial.takeOutput();
+    received.clear();
+    size_t midiOut = sim::midiLog().size();
+    unsigned int before = midiIn.messages();
+    uint64_t dropped = sim::counters().uartRxDropped;
+
+    // Todo seguido, sin huecos: Clock entre las letras, running status,
+    // SysEx de la GP-200 y un Program Change en medio de un comando
+    Bytes hello;
+    for (char c : std::string("HELLO\n")) hello = hello + Bytes{(uint8_t)c, 0xF8};
+    Bytes stream = hello +
+                   Bytes{0xB0, 55, 0, 55, 127, 55, 0, 55, 127} +
+                   Bytes{0xF0, 0x43, 0x10, 0x4C, 0x00, 0x00, 0x7E, 0x00, 0xF7} +
+                   text("SAVEB") + Bytes{0xB0, 0, 0, 0xC0, 7} + text("ANK:0:LIVE\n") +
+                   text("FLUSH\n");
+    feedWire(stream);
+
+    std::string out;
+    bool done = harness::runUntil([&out]() {
+        out += Serial.takeOutput();
+        return out.find("OK:FLUSHED") != std::string::npos;
+    }, 2000000);
+    CHECK(done);
+    CHECK(out.find("READY:GP200_CONTROLLER_V3") != std::string::npos);
+    CHECK(out.find("OK:BANK_RENAMED") != std::string::npos);
+    CHECK(strcmp(configManager.getBankName(0), "LIVE") == 0);
+
+    CHECK(midiIn.messages() - before == 6);
+    CHECK(globalEffectStates[3] && ledStates[1]);
+    CHECK(currentBank == 0 && currentPresetIndex == 2);
+    CHECK(sim::counters().uartRxDropped == dropped);
+    CHECK(sim::midiLog().size() == midiOut); // Nada de eco hacia la GP-200
+}
+
+void testMidiFloodDuringDump() {
+    harness::boot();
+    harness::runFor(100000);
+    Serial.takeOutput();
+    uint64_t dropped = sim::counters().uartRxDropped;
+    unsigned int before = midiIn.messages();
+
+    // GETALL y, detrás, 1 s de CCs del pedal de expresión (running status)
+    Bytes flood = text("GETALL\n") + Bytes{0xB0};
+    const int CCS = 1500;
+    for (int i = 0; i < CCS; i++) flood = flood + Bytes{7, (uint8_t)(i & 0x7F)};
+    feedWire(flood);
+
+    std::string out;
+    harness::runUntil([&out]() {
+        out += Serial.takeOutput();
+        return out.find("MORE:") != std::string::npos || out.find("END:CONFIG") != std::string::npos;
+    }, 2000000);
+    harness::runFor(1200000);
+    printf("  %u CCs parsed during dump, %llu RX bytes dropped\n", midiIn.messages() - before,
+           (unsigned long long)(sim::counters().uartRxDropped - dropped));
+    CHECK(out.find("BEGIN:CONFIG") != std::string::npos);
+    CHECK(midiIn.messages() - before == CCS);
+    CHECK(sim::counters().uartRxDropped == dropped);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(testRoutes);
+    RUN_TEST(testInterleavedAtWireRate);
+    RUN_TEST(testMidiFloodDuringDump);
+    return testFailures ? 1 : 0;
+}
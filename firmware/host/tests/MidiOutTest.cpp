@@ -0,0 +1,150 @@
+// Tests de la cola de salida MIDI: Bank Select y CC repetidos no salen, el
+// running status ahorra bytes y update() nunca espera al UART.
+
+#include <SimHarness.h>
+#include <MidiOut.h>
+#include "TestCheck.h"
+
+using harness::press;
+
+extern MidiOut midiOut;
+
+namespace {
+
+uint64_t txBytes() {
+    return sim::counters().uartTxBytes;
+}
+
+// Corre update() al ritmo del cable hasta vaciar la cola
+void drain(MidiOut& out) {
+    while (!out.idle()) {
+        out.update();
+        sim::advance(320);
+    }
+}
+
+void testSuppression() {
+    harness::boot();
+    MidiOut out(Serial);
+    size_t before = sim::midiLog().size();
+
+    out.sendPreset(2, 5, 1);
+    out.sendPreset(2, 6, 1);          // Mismo banco: solo PC
+    out.sendControlChange(55, 127, 1);
+    out.sendControlChange(55, 127, 1); // Ya está así: nada
+    out.forceControlChange(68, 127, 1);
+    out.forceControlChange(68, 127, 1); // Disparo: sale las dos veces
+    drain(out);
+
+    std::vector<sim::MidiEvent>& log = sim::midiLog();
+    CHECK(log.size() - before == 6);
+    CHECK(log[before].status == 0xB0 && log[before].data1 == 0 && log[before].data2 == 2);
+    CHECK(log[before + 2].status == 0xC0 && log[before + 2].data1 == 6);
+    CHECK(out.sent() == 6 && out.suppressed() == 2);
+
+    // Un Program Change nuevo resetea los efectos: el CC vuelve a salir
+    out.sendProgramChange(7, 1);
+    out.sendControlChange(55, 127, 1);
+    out.sendPreset(3, 7, 2); // Otro canal, su propio banco
+    drain(out);
+    CHECK(log.size() - before == 10);
+    CHECK(log[before + 8].status == 0xB1 && log[before + 8].data1 == 0);
+}
+
+void testRunningStatus() {
+    harness::boot();
+    MidiOut out(Serial);
+    uint64_t bytes = txBytes();
+
+    // Tres CC en la misma tanda: 3 + 2 + 2 bytes
+    out.sendControlChange(7, 10, 1);
+    out.sendControlChange(7, 20, 1);
+    out.sendControlChange(7, 30, 1);
+    out.update();
+    CHECK(txBytes() - bytes == 7);
+    CHECK(out.bytesSaved() == 2);
+
+    // Tanda nueva: el status vuelve a ir completo (la App usa el mismo cable)
+    bytes = txBytes();
+    out.sendControlChange(7, 40, 1);
+    out.update();
+    CHECK(txBytes() - bytes == 3);
+
+    // Repetido + running status: 3 bytes del CC omitido y 1 del status
+    out.sendControlChange(7, 40, 1);
+    out.sendControlChange(8, 1, 1);
+    out.sendControlChange(9, 1, 1);
+    out.update();
+    printf("  sent %lu, suppressed %lu, %lu bytes saved\n", out.sent(), out.suppressed(), out.bytesSaved());
+    CHECK(out.suppressed() == 1 && out.bytesSaved() == 2 + 3 + 1);
+}
+
+void testNeverBlocks() {
+    harness::boot();
+    MidiOut out(Serial);
+
+    // UART ya casi lleno (p.ej. una línea de GETALL saliendo)
+    for (int i = 0; i < 62; i++) Serial.transmit('x');
+    for (byte cc = 1; cc <= 12; cc++) out.sendControlChange(cc, 127, 1);
+    uint64_t t0 = sim::nowUs();
+    out.update();
+    CHECK(sim::nowUs() == t0); // Nada de esperas dentro de loop()
+    CHECK(!out.idle());
+
+    size_t before = sim::midiLog().size();
+    drain(out);
+    CHECK(sim::midiLog().size() - before == 12);
+    CHECK(out.overflows() == 0);
+}
+
+void testMidiInKeepsCacheInSync() {
+    harness::boot();
+    MidiOut out(Serial);
+
+    // La GP-200 cambia de banco y preset por su cuenta
+    out.noteIncoming(0xB0, 0, 4);
+    out.noteIncoming(0xC0, 9, 0);
+    out.noteIncoming(0xB0, 55, 127);
+    size_t before = sim::midiLog().size();
+    out.sendPreset(4, 1, 1);
+    out.sendControlChange(55, 0, 1);
+    drain(out);
+    CHECK(sim::midiLog().size() - before == 2); // Sin CC0: ya estaba en el banco 4
+
+    // PC sin Bank Select delante: el banco ya no se sabe
+    out.noteIncoming(0xC0, 3, 0);
+    before = sim::midiLog().size();
+    out.sendPreset(4, 1, 1);
+    drain(out);
+    CHECK(sim::midiLog().size() - before == 2);
+}
+
+void testPresetRecallOnDevice() {
+    harness::boot();
+    CHECK(harness::command("SAVE:0:1:LEAD:P:7:0:N:0:0") == "OK:SAVED");
+    harness::runFor(100000);
+
+    size_t before = sim::midiLog().size();
+    unsigned long suppressed = midiOut.suppressed();
+    press(harness::PIN_PRESET_1, sim::nowUs() + 10000, 80000);
+    harness::runFor(200000);
+    press(harness::PIN_PRESET_2, sim::nowUs() + 10000, 80000);
+    harness::runFor(200000);
+
+    // P1: CC0 + PC0; P2 en el mismo banco: solo PC7
+    std::vector<sim::MidiEvent>& log = sim::midiLog();
+    CHECK(log.size() - before == 3);
+    if (log.size() - before == 3) CHECK(log[before + 2].status == 0xC0 && log[before + 2].data1 == 7);
+    CHECK(midiOut.suppressed() - suppressed == 1);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(testSuppression);
+    RUN_TEST(testRunningStatus);
+    RUN_TEST(testNeverBlocks);
+    RUN_TEST(testMidiInKeepsCacheInSync);
+    RUN_TEST(testPresetRecallOnDevice);
+    return testFailures ? 1 : 0;
+}
@@ -0,0 +1,314 @@
+// Tests de la persistencia incremental: solo se escriben los registros
+// modificados, el journal rota y un corte de luz nunca deja una imagen rota.
+
+#include <SimHarness.h>
+#include <ConfigManager.h>
+#include "TestCheck.h"
+
+extern ConfigManager configManager;
+
+namespace {
+
+// EEPROM virgen y configuración por defecto ya formateada
+// Además pone a cero el desgaste por celda
+void freshEeprom() {
+    memset(sim::eepromWear(), 0, sim::EEPROM_SIZE * sizeof(uint32_t));
+    harness::freshEeprom();
+}
+
+void renamePreset(ConfigManager& cfg, int b, int p, const char* name) {
+    strncpy(cfg.getButtonConfig(b, p)->name, name, 4);
+    cfg.getButtonConfig(b, p)->name[4] = 0;
+    cfg.markButtonDirty(b, p);
+    cfg.save();
+    cfg.flush();
+}
+
+// Nombre del preset tras un "reinicio" (ConfigManager nuevo leyendo la EEPROM)
+std::string nameAfterReboot(int b, int p) {
+    ConfigManager cfg;
+    cfg.begin();
+    return cfg.getButtonConfig(b, p)->name;
+}
+
+void testSaveWritesOnlyDirtyRecord() {
+    freshEeprom();
+    ConfigManager cfg;
+    cfg.begin();
+
+    uint64_t before = sim::counters().eepromBytesWritten;
+    renamePreset(cfg, 0, 1, "DLY");
+    uint64_t written = sim::counters().eepromBytesWritten - before;
+    CHECK(written > 0);
+    CHECK(written <= JOURNAL_ENTRY_SIZE);
+    CHECK(nameAfterReboot(0, 1) == "DLY");
+
+    // Sin cambios marcados, save() no toca la EEPROM
+    before = sim::counters().eepromBytesWritten;
+    cfg.save();
+    cfg.flush();
+    CHECK(sim::counters().eepromBytesWritten == before);
+}
+
+void testTornEntryIsIgnored() {
+    freshEeprom();
+    ConfigManager cfg;
+    cfg.begin();
+    renamePreset(cfg, 0, 0, "CLN");
+
+    sim::eepromCutAfter(5); // Se corta a mitad de la entrada
+    renamePreset(cfg, 0, 0, "DRV");
+    sim::eepromCutAfter(-1);
+    CHECK(nameAfterReboot(0, 0) == "CLN");
+
+    // El siguiente save reutiliza el hueco sin problema
+    ConfigManager again;
+    again.begin();
+    renamePreset(again, 0, 0, "LEAD");
+    CHECK(nameAfterReboot(0, 0) == "LEAD");
+}
+
+void testBatchIsAtomic() {
+    freshEeprom();
+    ConfigManager cfg;
+    cfg.begin();
+    cfg.addBank();
+    cfg.save();
+    cfg.flush();
+
+    // Nombre del banco y un preset en un solo lote: corte a mitad del 2º registro
+    sim::eepromCutAfter(JOURNAL_ENTRY_SIZE + 4);
+    cfg.setBankName(1, "SOLO");
+    strcpy(cfg.getButtonConfig(1, 0)->name, "INTRO");
+    cfg.markButtonDirty(1, 0);
+    cfg.save();
+    cfg.flush();
+    sim::eepromCutAfter(-1);
+
+    ConfigManager reboot;
+    reboot.begin();
+    CHECK(reboot.getActiveBanksCount() == 2);
+    CHECK(strcmp(reboot.getBankName(1), "BANK 1") == 0);
+    CHECK(strcmp(reboot.getButtonConfig(1, 0)->name, "INTRO") != 0);
+
+    // Borrar un banco solo reescribe el mapa de slots: un registro
+    uint64_t bytes = sim::counters().eepromBytesWritten;
+    reboot.removeBank(0);
+    reboot.flush();
+    CHECK(sim::counters().eepromBytesWritten - bytes <= JOURNAL_ENTRY_SIZE);
+    CHECK(strcmp(reboot.getBankName(0), "BANK 1") == 0);
+}
+
+void testHotSlotRotates() {
+    freshEeprom();
+    ConfigManager cfg;
+    cfg.begin();
+
+    const int EDITS = 320;
+    char name[5];
+    for (int i = 0; i < EDITS; i++) {
+        snprintf(name, sizeof(name), "%d", i);
+        renamePreset(cfg, 0, 2, name);
+    }
+    CHECK(nameAfterReboot(0, 2) == name);
+
+    // Rescribir la imagen entera programaba las mismas celdas en cada edición
+    uint32_t worst = 0;
+    for (int i = 0; i < sim::EEPROM_SIZE; i++) {
+        if (sim::eepromWear()[i] > worst) worst = sim::eepromWear()[i];
+    }
+    printf("  %d edits -> max %u writes per cell\n", EDITS, worst);
+    CHECK(worst <= EDITS / 8);
+}
+
+void testCrashDuringFold() {
+    freshEeprom();
+    ConfigManager cfg;
+    cfg.begin();
+    for (int i = 0; i < JOURNAL_SLOTS; i++) renamePreset(cfg, 0, i % 3, i % 2 ? "ODD" : "EVEN");
+
+    // El siguiente save vuelca el journal a la imagen base antes de escribir
+    sim::eepromCutAfter(3);
+    renamePreset(cfg, 0, 0, "LOST");
+    sim::eepromCutAfter(-1);
+
+    // Lo último confirmado antes del corte (i = 15, 13 y 14)
+    ConfigManager reboot;
+    reboot.begin();
+    CHECK(strcmp(reboot.getButtonConfig(0, 0)->name, "ODD") == 0);
+    CHECK(strcmp(reboot.getButtonConfig(0, 1)->name, "ODD") == 0);
+    CHECK(strcmp(reboot.getButtonConfig(0, 2)->name, "EVEN") == 0);
+}
+
+void testWriteBehindNeverBlocks() {
+    freshEeprom();
+    ConfigManager cfg;
+    cfg.begin();
+
+    // RESET entero: muchos registros y un fold por medio
+    cfg.resetToDefaults();
+    cfg.save();
+    CHECK(!cfg.isDurable());
+
+    uint64_t worst = 0;
+    int loops = 0;
+    bool edited = false;
+    while (!cfg.isDurable()) {
+        uint64_t start = sim::nowUs();
+        cfg.update();
+        if (sim::nowUs() - start > worst) worst = sim::nowUs() - start;
+        sim::advance(500); // Resto de loop()
+        loops++;
+        // Edición a mitad del vaciado: va en el lote siguiente
+        if (loops == 50 && !edited) {
+            edited = true;
+            strcpy(cfg.getButtonConfig(0, 0)->name, "MID");
+            cfg.markButtonDirty(0, 0);
+            cfg.save();
+        }
+    }
+    printf("  reset drained in %d loops, worst update() %llu us\n", loops, (unsigned long long)worst);
+    CHECK(worst == 0);
+    CHECK(nameAfterReboot(0, 0) == "MID");
+}
+
+void testTransactionPersistsOnce() {
+    freshEeprom();
+    ConfigManager cfg;
+    cfg.begin();
+
+    uint64_t before = sim::counters().eepromBytesWritten;
+    CHECK(cfg.beginTransaction());
+    CHECK(!cfg.beginTransaction());
+    for (int p = 0; p < NUM_PRESETS_CFG; p++) {
+        snprintf(cfg.getButtonConfig(0, p)->name, 5, "TX%d", p);
+        cfg.markButtonDirty(0, p);
+        cfg.save(); // Un save() suelto no debe sacar nada de la transacción
+        cfg.flush();
+    }
+    cfg.setBankName(0, "SETLIST");
+    CHECK(sim::counters().eepromBytesWritten == before);
+    CHECK(nameAfterReboot(0, 1) == "P0-1");
+
+    CHECK(cfg.commitTransaction());
+    cfg.flush();
+    CHECK(sim::counters().eepromBytesWritten - before <= 4 * JOURNAL_ENTRY_SIZE);
+    CHECK(nameAfterReboot(0, 1) == "TX1");
+}
+
+void testAbortRestoresRam() {
+    freshEeprom();
+    ConfigManager cfg;
+    cfg.begin();
+    renamePreset(cfg, 0, 0, "KEEP");
+
+    CHECK(cfg.beginTransaction());
+    strcpy(cfg.getButtonConfig(0, 0)->name, "DROP");
+    cfg.markButtonDirty(0, 0);
+    cfg.setBankName(0, "NOPE");
+    CHECK(cfg.abortTransaction());
+    CHECK(cfg.isReverting());
+    CHECK(!cfg.beginTransaction()); // Hasta terminar de recargar
+
+    while (cfg.isReverting()) {
+        cfg.update();
+        sim::advance(500);
+    }
+    CHECK(strcmp(cfg.getButtonConfig(0, 0)->name, "KEEP") == 0);
+    CHECK(strcmp(cfg.getBankName(0), "BANK 0") == 0);
+    CHECK(nameAfterReboot(0, 0) == "KEEP");
+}
+
+// Una edición más grande que el hueco de la cola dentro de una transacción:
+// la cola no baja sola (lote abierto), así que update() adelanta lo de la
+// transacción al journal hasta que quepa. Sin esperar dentro de markDirty().
+void testHeldEditGetsRoom() {
+    freshEeprom();
+    ConfigManager cfg;
+    cfg.begin();
+    renamePreset(cfg, 0, 0, "KEEP");
+
+    const byte RESET_RECORDS = REC_META_COUNT + REC_PER_BANK + 3;
+    CHECK(cfg.beginTransaction());
+    for (int p = 0; p < NUM_PRESETS_CFG; p++) {
+        strcpy(cfg.getButtonConfig(0, p)->name, "TX");
+        cfg.markButtonDirty(0, p);
+    }
+    cfg.setBankName(0, "TX");
+    cfg.getGlobalConfig(0)->value1 = 7;
+    cfg.markGlobalDirty(0);
+    cfg.getGlobalConfig(1)->value1 = 7;
+    cfg.markGlobalDirty(1);
+    CHECK(!cfg.hasRoom(RESET_RECORDS));
+
+    int loops = 0;
+    while (!cfg.hasRoom(RESET_RECORDS) && loops < 1000) {
+        cfg.update();
+        sim::advance(500);
+        loops++;
+    }
+    CHECK(cfg.hasRoom(RESET_RECORDS));
+    cfg.resetToDefaults();
+    CHECK(cfg.lost() == 0);
+
+    // Lo adelantado va sin commit: el ABORT lo deshace igual
+    CHECK(cfg.abortTransaction());
+    while (cfg.isReverting()) {
+        cfg.update();
+        sim::advance(500);
+    }
+    CHECK(!cfg.revertWasPartial());
+    CHECK(strcmp(cfg.getButtonConfig(0, 0)->name, "KEEP") == 0);
+    CHECK(nameAfterReboot(0, 0) == "KEEP");
+}
+
+// Subida en una sola transacción, por ventanas que terminan en TXSYNC. Las
+// ediciones retenidas no dejan de leer el puerto: lo que llega detrás se
+// aparta y no se pierde nada en el buffer RX.
+void testWindowKeepsReadingWhileHeld() {
+    harness::boot();
+    harness::runFor(3000000); // Splash
+    CHECK(harness::command("SAVEBANK:0:KEEP") == "OK:BANK_RENAMED");
+    harness::runUntil([]() { return configManager.isDurable(); }, 1000000);
+    int banks = configManager.getActiveBanksCount();
+    uint64_t dropped = sim::counters().uartRxDropped;
+    unsigned int stalls = configManager.stalls();
+
+    CHECK(harness::command("BEGINTX") == "OK:TX_BEGIN");
+    const char* window = "SAVEBANK:0:A\nRESET\nADDBANK\nADDBANK\n"
+                         "SAVEBANK:0:ONE\nSAVEBANK:1:TWO\nSAVEBANK:2:THREE\nSAVEBANK:0:FOUR\nTXSYNC\n";
+    CHECK(strlen(window) > Serial.RX_BUFFER_SIZE);
+    Serial.takeOutput();
+    Serial.feed((const uint8_t*)window, strlen(window), sim::nowUs());
+    std::string out;
+    harness::runUntil([&]() {
+        out += Serial.takeOutput();
+        return out.find("OK:TX_SYNC:") != std::string::npos;
+    }, 2000000);
+    CHECK(out.find("OK:TX_SYNC:5") != std::string::npos);
+    CHECK(sim::counters().uartRxDropped == dropped);
+    CHECK(configManager.stalls() > stalls); // Hubo ediciones retenidas
+    CHECK(configManager.lost() == 0);
+    CHECK(strcmp(configManager.getBankName(2), "THREE") == 0);
+
+    // Todo en la misma transacción: el ABORT deshace también lo adelantado
+    CHECK(harness::command("ABORT") == "OK:TX_ABORTED");
+    CHECK(configManager.getActiveBanksCount() == banks);
+    CHECK(strcmp(configManager.getBankName(0), "KEEP") == 0);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(testSaveWritesOnlyDirtyRecord);
+    RUN_TEST(testTornEntryIsIgnored);
+    RUN_TEST(testBatchIsAtomic);
+    RUN_TEST(testHotSlotRotates);
+    RUN_TEST(testCrashDuringFold);
+    RUN_TEST(testWriteBehindNeverBlocks);
+    RUN_TEST(testTransactionPersistsOnce);
+    RUN_TEST(testAbortRestoresRam);
+    RUN_TEST(testHeldEditGetsRoom);
+    RUN_TEST(testWindowKeepsReadingWhileHeld);
+    return testFailures ? 1 : 0;
+}
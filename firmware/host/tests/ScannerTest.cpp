@@ -0,0 +1,84 @@
+// Tests del escaneo por interrupción: los flancos se capturan con su instante
+// real aunque loop() esté bloqueado, y se procesan en orden al volver.
+
+#include <SimHarness.h>
+#include "TestCheck.h"
+
+using harness::press;
+
+namespace {
+
+// Simula un loop() bloqueado (save(), GETALL...) durante 'us': el tiempo
+// avanza y el ISR del timer sigue muestreando, pero loop() no corre.
+void stall(uint64_t us) {
+    sim::advance(us);
+}
+
+size_t countStatus(size_t from, uint8_t status, uint8_t data1) {
+    std::vector<sim::MidiEvent>& log = sim::midiLog();
+    size_t n = 0;
+    for (size_t i = from; i < log.size(); i++) {
+        if (log[i].status == status && log[i].data1 == data1) n++;
+    }
+    return n;
+}
+
+void testShortPressDuringStall() {
+    size_t before = sim::midiLog().size();
+    uint64_t t0 = sim::nowUs() + 10000;
+    press(harness::PIN_PRESET_1, t0, 80000);
+    stall(500000);
+    CHECK(sim::midiLog().size() == before); // Nada sale mientras loop() no corre
+
+    harness::runFor(100000);
+    // P1 por defecto: CC0 + PC 0
+    CHECK(countStatus(before, 0xC0, 0) == 1);
+}
+
+void testLongPressResolvedFromTimestamps() {
+    CHECK(harness::command("SAVE:0:0:P1:P:0:0:C:20:127") == "OK:SAVED");
+    harness::runFor(200000);
+
+    size_t before = sim::midiLog().size();
+    uint64_t t0 = sim::nowUs() + 10000;
+    press(harness::PIN_PRESET_1, t0, 1200000);
+    stall(2000000); // Pisada completa (más de 1 s) sin pasar por loop()
+
+    harness::runFor(100000);
+    CHECK(countStatus(before, 0xB0, 20) == 1); // Long Press
+    CHECK(countStatus(before, 0xC0, 0) == 0);  // Sin click al soltar
+}
+
+void testOrderPreservedAcrossButtons() {
+    CHECK(harness::command("SAVE:0:1:FX:D:3:0:N:0:0") == "OK:SAVED");
+    CHECK(harness::command("SAVE:0:2:P3:P:7:0:N:0:0") == "OK:SAVED");
+    harness::runFor(200000);
+
+    size_t before = sim::midiLog().size();
+    uint64_t t0 = sim::nowUs() + 10000;
+    press(harness::PIN_PRESET_3, t0, 70000);
+    press(harness::PIN_PRESET_2, t0 + 100000, 70000);
+    stall(400000);
+    harness::runFor(100000);
+
+    std::vector<sim::MidiEvent>& log = sim::midiLog();
+    // PC7 (el banco 0 ya se mandó con P1: sin CC0), luego CC de DLY
+    CHECK(log.size() - before == 2);
+    if (log.size() - before == 2) {
+        CHECK(log[before].status == 0xC0 && log[before].data1 == 7);
+        CHECK(log[before + 1].status == 0xB0 && log[before + 1].data1 == 55);
+    }
+}
+
+} // namespace
+
+int main() {
+    harness::boot();
+    harness::runFor(100000);
+
+    RUN_TEST(testShortPressDuringStall);
+    RUN_TEST(testLongPressResolvedFromTimestamps);
+    RUN_TEST(testOrderPreservedAcrossButtons);
+
+    return testFailures ? 1 : 0;
+}
@@ -0,0 +1,243 @@
+// Tests de las escenas: estado de los efectos por preset en el registro de
+// escenas del banco, comando SCENE, captura con Long Press 'S' y recuperación
+// que solo manda los CC que cambian (y sin PC si la GP-200 ya está en él).
+
+#include <SimHarness.h>
+#include <ConfigManager.h>
+#include <MidiDictionary.h>
+#include <vector>
+#include "TestCheck.h"
+
+using harness::addBanks;
+using harness::freshEeprom;
+using harness::send;
+using harness::press;
+
+extern ConfigManager configManager;
+extern bool globalEffectStates[];
+uint16_t currentScene();
+
+namespace {
+
+const uint16_t SCENE_A = 1u << DICT_DIST | 1u << DICT_DLY | 1u << DICT_REV;
+const uint16_t SCENE_B = 1u << DICT_DIST | 1u << DICT_MOD | 1u << DICT_CTRL1;
+
+int bits(uint16_t v) {
+    int n = 0;
+    for (; v; v &= v - 1) n++;
+    return n;
+}
+
+void testPackScenes() {
+    uint16_t in[NUM_PRESETS_CFG] = { 0, SCENE_NONE, SCENE_BITS }, out[NUM_PRESETS_CFG];
+    byte rec[JOURNAL_RECORD_SIZE];
+    packScenes(in, rec);
+    unpackScenes(rec, out);
+    CHECK(memcmp(in, out, sizeof(in)) == 0);
+
+    // Slot sin escribir: ninguna escena
+    memset(rec, 0xFF, sizeof(rec));
+    unpackScenes(rec, out);
+    for (int p = 0; p < NUM_PRESETS_CFG; p++) CHECK(out[p] == SCENE_NONE);
+
+    // Los disparos no son parte de una escena
+    CHECK(DICT_SCENE_MASK & (1u << DICT_DIST));
+    CHECK(!(DICT_SCENE_MASK & (1u << DICT_TAP)) && !(DICT_SCENE_MASK & (1u << DICT_LREC)));
+}
+
+void testScenesPersist() {
+    freshEeprom();
+    ConfigManager cfg;
+    cfg.begin();
+    addBanks(cfg, 7);
+    CHECK(cfg.getScene(3, 1) == SCENE_NONE);
+    uint16_t hash = cfg.bankHash(3);
+
+    cfg.setScene(3, 1, SCENE_A);
+    cfg.setScene(3, 2, 0); // Todo apagado también es una escena
+    cfg.save();
+    CHECK(cfg.bankHash(3) != hash);
+    hash = cfg.bankHash(3);
+    for (int b = 4; b < cfg.getActiveBanksCount(); b++) cfg.getBankName(b); // Sacarlo de RAM
+    CHECK(!cfg.isPaged(3) && cfg.bankHash(3) == hash);
+    cfg.flush();
+
+    ConfigManager reboot;
+    reboot.begin();
+    CHECK(reboot.bankHash(3) == hash);
+    CHECK(reboot.getScene(3, 0) == SCENE_NONE);
+    CHECK(reboot.getScene(3, 1) == SCENE_A);
+    CHECK(reboot.getScene(3, 2) == 0);
+
+    // Un banco nuevo en un slot usado no hereda escenas
+    CHECK(reboot.removeBank(3));
+    CHECK(reboot.addBank());
+    CHECK(reboot.getScene(reboot.getActiveBanksCount() - 1, 1) == SCENE_NONE);
+}
+
+std::string bankDump(int bank) {
+    char cmd[16];
+    snprintf(cmd, sizeof(cmd), "GETBANK:%d\n", bank);
+    Serial.inject(cmd);
+    std::string out;
+    harness::runUntil([&out]() {
+        out += Serial.takeOutput();
+        size_t end = out.find("END:BANK:");
+        return end != std::string::npos && out.find('\n', end) != std::string::npos;
+    }, 2000000);
+    return out;
+}
+
+void testSceneCommand() {
+    freshEeprom();
+    harness::boot();
+    harness::runFor(3000000); // Splash
+
+    char cmd[32];
+    snprintf(cmd, sizeof(cmd), "SCENE:0:0:%u", SCENE_A | 1u << DICT_TAP);
+    CHECK(send(cmd) == "OK:SCENE_SAVED");
+    CHECK(configManager.getScene(0, 0) == SCENE_A); // Sin el TAP
+    CHECK(send("SCENE:0:1:0") == "OK:SCENE_SAVED");
+    CHECK(send("SCENE:0:1:-") == "OK:SCENE_SAVED");
+    CHECK(configManager.getScene(0, 1) == SCENE_NONE);
+    CHECK(send("SCENE:1:0:5") == "ERR:SCENE_FAIL");
+    CHECK(send("SCENE:0:3:5") == "ERR:SCENE_FAIL");
+    CHECK(send("SCENE:0:0") == "ERR:SCENE_FAIL");
+
+    std::string dump = bankDump(0);
+    snprintf(cmd, sizeof(cmd), ":R:%u\r\n", SCENE_A);
+    CHECK(dump.find(cmd) != std::string::npos);
+    CHECK(dump.find("|DATA:0:1:") != std::string::npos && dump.find(":R:-\r\n") != std::string::npos);
+}
+
+// Mensajes que salieron desde 'from'
+struct Sent {
+    int pcs = 0;
+    std::vector<byte> ccs;
+};
+
+Sent sentSince(size_t from) {
+    Sent s;
+    std::vector<sim::MidiEvent>& log = sim::midiLog();
+    for (size_t i = from; i < log.size(); i++) {
+        if ((log[i].status & 0xF0) == 0xC0) s.pcs++;
+        else if ((log[i].status & 0xF0) == 0xB0 && log[i].data1 != 0) s.ccs.push_back(log[i].data1);
+    }
+    return s;
+}
+
+Sent pressAndCount(uint8_t pin, uint64_t holdUs = 60000) {
+    size_t from = sim::midiLog().size();
+    press(pin, sim::nowUs() + 1000, holdUs);
+    harness::runFor(holdUs + 300000);
+    return sentSince(from);
+}
+
+void testMinimalRecall() {
+    // Slots 1 y 2: mismo preset (PC 5) con escenas distintas; 3: otro sin escena
+    CHECK(send("SAVE:0:0:VERS:P:5:0:N:0:0:I") == "OK:SAVED");
+    CHECK(send("SAVE:0:1:CHOR:P:5:0:N:0:0:I") == "OK:SAVED");
+    CHECK(send("SAVE:0:2:SOLO:P:9:0:S:0:0:R") == "OK:SAVED");
+    char cmd[32];
+    snprintf(cmd, sizeof(cmd), "SCENE:0:0:%u", SCENE_A);
+    CHECK(send(cmd) == "OK:SCENE_SAVED");
+    snprintf(cmd, sizeof(cmd), "SCENE:0:1:%u", SCENE_B);
+    CHECK(send(cmd) == "OK:SCENE_SAVED");
+
+    // Preset nuevo: PC y todos los efectos de la escena (la GP-200 los recarga)
+    Sent s = pressAndCount(harness::PIN_PRESET_1);
+    CHECK(s.pcs == 1 && (int)s.ccs.size() == bits(DICT_SCENE_MASK));
+
+    // Misma escena otra vez: nada
+    s = pressAndCount(harness::PIN_PRESET_1);
+    CHECK(s.pcs == 0 && s.ccs.empty());
+
+    // Otra escena del mismo preset: sin PC, solo lo que cambia
+    s = pressAndCount(harness::PIN_PRESET_2);
+    CHECK(s.pcs == 0 && (int)s.ccs.size() == bits(SCENE_A ^ SCENE_B));
+    CHECK(globalEffectStates[DICT_MOD] && !globalEffectStates[DICT_DLY]);
+
+    // Lo cambiado en la pedalera (MIDI IN) cuenta como estado actual
+    byte distOff[] = { 0xB0, dictCC(DICT_DIST), 0 };
+    Serial.feed(distOff, sizeof(distOff), sim::nowUs());
+    harness::runFor(20000);
+    s = pressAndCount(harness::PIN_PRESET_2);
+    CHECK(s.pcs == 0 && s.ccs.size() == 1 && s.ccs[0] == dictCC(DICT_DIST));
+
+    // Sin escena: solo el PC, como siempre
+    s = pressAndCount(harness::PIN_PRESET_3);
+    CHECK(s.pcs == 1 && s.ccs.empty());
+
+    // Toggle vuelve al anterior con su escena: PC 5 + escena B entera
+    s = pressAndCount(harness::PIN_TOGGLE);
+    CHECK(s.pcs == 1 && (int)s.ccs.size() == bits(DICT_SCENE_MASK));
+}
+
+void testCaptureFromFootswitch() {
+    // Long Press 'S' del slot 3 guarda lo que suena (escena B tras el Toggle)
+    uint16_t expected = SCENE_B;
+    for (int idx = 0; idx < DICT_SIZE; idx++) CHECK(globalEffectStates[idx] == ((expected >> idx) & 1));
+    CHECK(configManager.getScene(0, 2) == SCENE_NONE);
+    Sent s = pressAndCount(harness::PIN_PRESET_3, 1200000);
+    CHECK(configManager.getScene(0, 2) == expected);
+    CHECK(s.pcs == 0 && s.ccs.empty()); // Guardar no manda nada
+
+    CHECK(send("FLUSH") == "OK:FLUSHED");
+    ConfigManager reboot;
+    reboot.begin();
+    CHECK(reboot.getScene(0, 2) == expected);
+}
+
+// La App subiendo un lote: la cola de la EEPROM se vuelve a llenar tras cada
+// vuelta de loop() con ediciones que no cambian nada
+bool keepQueueFull = false;
+uint64_t worstLoopUs = 0;
+void fillQueue(uint64_t loopUs) {
+    if (loopUs > worstLoopUs) worstLoopUs = loopUs;
+    while (keepQueueFull && configManager.hasRoom(1)) {
+        char name[9];
+        strcpy(name, configManager.getBankName(0));
+        configManager.setBankName(0, name);
+        configManager.save();
+    }
+}
+
+void testCaptureWithQueueFull() {
+    // Suena la escena A; el slot 3 guarda la B
+    pressAndCount(harness::PIN_PRESET_1);
+    CHECK(currentScene() == SCENE_A && configManager.getScene(0, 2) == SCENE_B);
+
+    unsigned int stalls = configManager.stalls();
+    worstLoopUs = 0;
+    keepQueueFull = true;
+    harness::setLoopObserver(fillQueue);
+    uint64_t t0 = sim::nowUs() + 1000;
+    press(harness::PIN_PRESET_3, t0, 1200000);
+    harness::runUntil([&]() { return sim::nowUs() > t0 + 1100000; }, 5000000);
+
+    // El botón no esperó a la EEPROM: la escena salió de la cola en cuanto
+    // hubo sitio, antes que la siguiente edición de la App
+    CHECK(configManager.stalls() == stalls + 1);
+    CHECK(configManager.getScene(0, 2) == SCENE_A);
+    CHECK(worstLoopUs < 4000); // Como mucho el byte de EEPROM de cada vuelta
+
+    keepQueueFull = false;
+    harness::setLoopObserver(nullptr);
+    harness::runFor(1000000);
+    CHECK(send("FLUSH") == "OK:FLUSHED");
+    ConfigManager reboot;
+    reboot.begin();
+    CHECK(reboot.getScene(0, 2) == SCENE_A);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(testPackScenes);
+    RUN_TEST(testScenesPersist);
+    RUN_TEST(testSceneCommand);
+    RUN_TEST(testMinimalRecall);
+    RUN_TEST(testCaptureFromFootswitch);
+    RUN_TEST(testCaptureWithQueueFull);
+    return testFailures ? 1 : 0;
+}
@@ -0,0 +1,163 @@
+// Tests del planificador cooperativo: orden por vencimiento, periódicas,
+// cancelación, tabla llena, detección de rodajas excedidas y el firmware
+// entero sin ninguna tarea pasándose de su rodaja.
+
+#include <SimHarness.h>
+#include <Scheduler.h>
+#include <ConfigManager.h>
+#include <algorithm>
+#include <string>
+#include "TestCheck.h"
+
+extern Scheduler scheduler;
+extern ConfigManager configManager;
+
+namespace {
+
+std::string trace;
+
+void mark(void* ctx) {
+    trace += *(const char*)ctx;
+}
+
+void slow(void*) {
+    sim::charge(500);
+}
+
+const char A = 'a', B = 'b', C = 'c';
+
+void testOrderByDeadline() {
+    Scheduler s;
+    byte a = s.add(mark, (void*)&A, 100, PSTR("a"));
+    byte b = s.add(mark, (void*)&B, 100, PSTR("b"));
+    byte c = s.add(mark, (void*)&C, 100, PSTR("c"));
+    trace.clear();
+    s.post(a, 30);
+    s.post(b, 10);
+    s.post(c, 20);
+    CHECK(s.armed(a) && s.armed(b) && s.armed(c));
+    s.run();
+    CHECK(trace.empty()); // Nada vencido todavía
+    for (int i = 0; i < 40; i++) {
+        sim::advance(1000);
+        s.run();
+    }
+    CHECK(trace == "bca");
+    CHECK(!s.armed(a) && !s.armed(b) && !s.armed(c));
+}
+
+void testPostMovesDeadline() {
+    Scheduler s;
+    byte a = s.add(mark, (void*)&A, 100, PSTR("a"));
+    trace.clear();
+    s.post(a, 10);
+    sim::advance(8000);
+    s.post(a, 10); // Como el mensaje del LCD: la nueva pisada alarga el plazo
+    sim::advance(5000);
+    s.run();
+    CHECK(trace.empty());
+    sim::advance(6000);
+    s.run();
+    CHECK(trace == "a");
+}
+
+void testPeriodicAndEveryRun() {
+    Scheduler s;
+    byte a = s.add(mark, (void*)&A, 100, PSTR("a"));
+    byte b = s.add(mark, (void*)&B, 100, PSTR("b"));
+    trace.clear();
+    s.every(a, 0);
+    s.every(b, 10);
+    for (int i = 0; i < 25; i++) {
+        s.run();
+        sim::advance(1000);
+    }
+    // 'a' en cada vuelta y una sola vez por vuelta; 'b' cada 10 ms
+    CHECK(std::count(trace.begin(), trace.end(), 'a') == 25);
+    CHECK(std::count(trace.begin(), trace.end(), 'b') == 2);
+}
+
+void testCancel() {
+    Scheduler s;
+    byte a = s.add(mark, (void*)&A, 100, PSTR("a"));
+    byte b = s.add(mark, (void*)&B, 100, PSTR("b"));
+    trace.clear();
+    s.every(a, 0);
+    s.post(b, 5);
+    s.cancel(b);
+    sim::advance(10000);
+    s.run();
+    s.cancel(a);
+    s.run();
+    CHECK(trace == "a");
+    CHECK(!s.armed(a) && !s.armed(b));
+}
+
+void testTableFull() {
+    Scheduler s;
+    for (byte i = 0; i < SCHED_MAX_TASKS; i++) CHECK(s.add(mark, (void*)&A, 100, PSTR("a")) == i);
+    CHECK(s.add(mark, (void*)&A, 100, PSTR("a")) == SCHED_NONE);
+    CHECK(s.count() == SCHED_MAX_TASKS);
+}
+
+void testOverrunDetected() {
+    Scheduler s;
+    byte t = s.add(slow, nullptr, 200, PSTR("lenta"));
+    uint64_t before = sim::counters().sliceOverruns;
+    s.every(t, 0);
+    s.run();
+    CHECK(s.overruns() == 1);
+    CHECK(s.worst(t) >= 500);
+    CHECK(sim::counters().sliceOverruns - before == 1);
+}
+
+// Firmware entero: splash, pisadas con mensajes y LEDs, ediciones a ráfaga
+// (sin esperar el OK) y RESET. Ninguna tarea pasa de su rodaja.
+void testFirmwareStaysInSlices() {
+    harness::boot();
+    uint64_t before = sim::counters().sliceOverruns;
+    harness::runFor(3000000); // Splash completo
+
+    uint64_t t0 = sim::nowUs() + 1000;
+    const uint8_t PINS[] = { harness::PIN_PRESET_1, harness::PIN_PRESET_2, harness::PIN_BANK_UP,
+                             harness::PIN_TOGGLE, harness::PIN_PRESET_3 };
+    for (int i = 0; i < 20; i++) harness::press(PINS[i % 5], t0 + i * 150000, i % 4 == 0 ? 900000 : 60000);
+    harness::runFor(4000000);
+
+    // Diez ADDBANK de golpe: más registros que la cola de la EEPROM
+    unsigned int stalls = configManager.stalls();
+    Serial.takeOutput();
+    for (int i = 0; i < 10; i++) Serial.inject("ADDBANK\n");
+    std::string out;
+    harness::runUntil([&]() {
+        out += Serial.takeOutput();
+        size_t n = 0;
+        for (size_t at = out.find("OK:BANK_ADDED"); at != std::string::npos; at = out.find("OK:BANK_ADDED", at + 1)) n++;
+        return n == 10;
+    }, 10000000);
+    CHECK(configManager.getActiveBanksCount() >= 11);
+    CHECK(configManager.stalls() > stalls); // Esperaron fuera, no dentro de markDirty()
+
+    CHECK(harness::command("RESET") == "OK:RESET_DONE");
+    harness::runUntil([]() { return configManager.isDurable(); }, 10000000);
+
+    CHECK(sim::counters().sliceOverruns == before);
+    for (byte i = 0; i < scheduler.count(); i++) {
+        printf("  %-11s peor %5u us  rodaja %5u us\n", scheduler.name(i), scheduler.worst(i),
+               scheduler.slice(i));
+        CHECK(scheduler.worst(i) <= scheduler.slice(i));
+    }
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(testOrderByDeadline);
+    RUN_TEST(testPostMovesDeadline);
+    RUN_TEST(testPeriodicAndEveryRun);
+    RUN_TEST(testCancel);
+    RUN_TEST(testTableFull);
+    RUN_TEST(testOverrunDetected);
+    RUN_TEST(testFirmwareStaysInSlices);
+    return testFailures ? 1 : 0;
+}
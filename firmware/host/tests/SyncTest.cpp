@@ -0,0 +1,281 @@
+// Tests de la sincronización por diferencias: HASHES (generación + CRC por
+// banco, global y macro) y GETBANK. Un pedal sin cambios se lee con una sola
+// petición; uno con un banco editado, con dos.
+
+#include <SimHarness.h>
+#include <ConfigManager.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "TestCheck.h"
+
+using harness::addBanks;
+using harness::freshEeprom;
+
+extern ConfigManager configManager;
+
+namespace {
+
+std::vector<uint16_t> allHashes(ConfigManager& cfg) {
+    std::vector<uint16_t> out;
+    for (int b = 0; b < cfg.getActiveBanksCount(); b++) out.push_back(cfg.bankHash(b));
+    for (int g = 0; g < 2; g++) out.push_back(cfg.globalHash(g));
+    for (int m = 0; m < MACRO_COUNT; m++) out.push_back(cfg.macroHash(m));
+    return out;
+}
+
+// El hash es del contenido: igual con el banco en RAM, fuera de ella o tras reiniciar
+void testHashIgnoresPaging() {
+    freshEeprom();
+    ConfigManager cfg;
+    cfg.begin();
+    addBanks(cfg, 9);
+    cfg.setBankName(7, "VERSE");
+    cfg.setBankTempo(7, 96);
+    cfg.getButtonConfig(7, 1)->type = 'D';
+    cfg.markButtonDirty(7, 1);
+    cfg.getMacro(2)[0] = { 'C', 20, 64, 3 };
+    cfg.markMacroDirty(2, 0);
+    cfg.save();
+
+    cfg.getBankName(7); // En RAM, con la edición aún en la cola
+    std::vector<uint16_t> before = allHashes(cfg);
+    for (int b = 0; b < cfg.getActiveBanksCount(); b++) cfg.getBankName(b); // Paginar todo
+    cfg.getMacro(0);
+    CHECK(allHashes(cfg) == before);
+
+    cfg.flush();
+    ConfigManager reboot;
+    reboot.begin();
+    CHECK(allHashes(reboot) == before);
+    CHECK(!reboot.isPaged(7) && reboot.bankHash(7) == before[7]);
+}
+
+// Una edición cambia su hash y la generación, y nada más
+void testEditChangesOneHash() {
+    ConfigManager cfg;
+    cfg.begin();
+    std::vector<uint16_t> before = allHashes(cfg);
+    uint16_t gen = cfg.generation();
+
+    cfg.getButtonConfig(3, 2)->value1 = 42;
+    cfg.markButtonDirty(3, 2);
+    std::vector<uint16_t> after = allHashes(cfg);
+    CHECK(cfg.generation() != gen);
+    for (size_t i = 0; i < before.size(); i++) CHECK((before[i] != after[i]) == (i == 3));
+
+    cfg.getGlobalConfig(1)->value2 = 9;
+    cfg.markGlobalDirty(1);
+    CHECK(cfg.globalHash(1) != before[cfg.getActiveBanksCount() + 1]);
+    CHECK(cfg.globalHash(0) == before[cfg.getActiveBanksCount()]);
+
+    // ABORT vuelve a lo de la EEPROM y a sus hashes
+    cfg.save();
+    cfg.flush();
+    before = allHashes(cfg);
+    CHECK(cfg.beginTransaction());
+    cfg.setBankName(1, "TMP");
+    CHECK(cfg.bankHash(1) != before[1]);
+    gen = cfg.generation();
+    CHECK(cfg.abortTransaction());
+    cfg.flush();
+    cfg.update();
+    CHECK(allHashes(cfg) == before);
+    CHECK(cfg.generation() != gen);
+}
+
+// Cliente parecido al de app.js: caché por banco, global y macro con su hash
+struct SyncClient {
+    struct Cached {
+        uint16_t hash = 0;
+        std::vector<std::string> lines;
+    };
+    std::vector<Cached> banks, globals, macros;
+    uint16_t gen = 0;
+    int requests = 0;
+    uint64_t bytes = 0;
+
+    std::string partial;
+    int bankCount = 0;
+    std::vector<uint16_t> hashes[3]; // B, G, M
+    std::map<int, std::string> items;
+    std::vector<std::string> queue; // Una petición cada vez: el pedal contesta ERR:BUSY a la segunda
+    bool done = false;
+
+    void send(const std::string& cmd) {
+        requests++;
+        Serial.inject((cmd + "\n").c_str());
+    }
+
+    std::vector<uint16_t>& list(char kind) {
+        return hashes[kind == 'B' ? 0 : (kind == 'G' ? 1 : 2)];
+    }
+
+    void onLine(const std::string& line) {
+        size_t bar = line.find('|');
+        if (bar != std::string::npos) {
+            items[atoi(line.c_str())] = line.substr(bar + 1);
+        } else if (line.compare(0, 11, "HASHES:END:") == 0) {
+            gen = (uint16_t)atoi(line.c_str() + 11);
+            fetchChanged();
+        } else if (line.compare(0, 7, "HASHES:") == 0) {
+            bankCount = atoi(line.c_str() + line.rfind(':') + 1);
+            for (auto& h : hashes) h.clear();
+        } else if (line.compare(0, 5, "HASH:") == 0) {
+            std::vector<uint16_t>& l = list(line[5]);
+            const char* hex = line.c_str() + line.rfind(':') + 1;
+            for (size_t i = 0; i + 4 <= strlen(hex); i += 4) l.push_back((uint16_t)strtol(std::string(hex + i, 4).c_str(), nullptr, 16));
+        } else if (line.compare(0, 9, "END:BANK:") == 0 || line.compare(0, 5, "MORE:") == 0 ||
+                   line.compare(0, 11, "END:CONFIG:") == 0) {
+            next();
+        }
+    }
+
+    // Lo que no coincide con la caché: GETBANK por banco, GETALL para el resto
+    void fetchChanged() {
+        banks.resize(bankCount);
+        globals.resize(2);
+        macros.resize(MACRO_COUNT);
+        items.clear();
+        for (int b = 0; b < bankCount; b++) {
+            if (banks[b].lines.empty() || banks[b].hash != hashes[0][b]) {
+                queue.push_back("GETBANK:" + std::to_string(b));
+            }
+        }
+        for (int g = 0; g < 2; g++) {
+            if (globals[g].lines.empty() || globals[g].hash != hashes[1][g]) {
+                queue.push_back("GETALL:" + std::to_string(bankCount + 1 + g) + ":1");
+            }
+        }
+        for (int m = 0; m < MACRO_COUNT; m++) {
+            if (macros[m].lines.empty() || macros[m].hash != hashes[2][m]) {
+                queue.push_back("GETALL:" + std::to_string(3 + 4 * bankCount + m * MACRO_STEPS) + ":" +
+                                std::to_string(MACRO_STEPS));
+            }
+        }
+        next();
+    }
+
+    void next() {
+        if (queue.empty()) {
+            store();
+            return;
+        }
+        send(queue.front());
+        queue.erase(queue.begin());
+    }
+
+    void store() {
+        for (int b = 0; b < bankCount; b++) {
+            if (!items.count(b + 1)) continue;
+            banks[b].lines = { items[b + 1] };
+            for (int p = 0; p < NUM_PRESETS_CFG; p++) banks[b].lines.push_back(items[bankCount + 3 + 3 * b + p]);
+            banks[b].hash = hashes[0][b];
+        }
+        for (int g = 0; g < 2; g++) {
+            if (!items.count(bankCount + 1 + g)) continue;
+            globals[g].lines = { items[bankCount + 1 + g] };
+            globals[g].hash = hashes[1][g];
+        }
+        for (int m = 0; m < MACRO_COUNT; m++) {
+            int first = 3 + 4 * bankCount + m * MACRO_STEPS;
+            if (!items.count(first)) continue;
+            macros[m].lines.clear();
+            for (int s = 0; s < MACRO_STEPS; s++) macros[m].lines.push_back(items[first + s]);
+            macros[m].hash = hashes[2][m];
+        }
+        done = true;
+    }
+
+    bool sync() {
+        requests = 0;
+        bytes = 0;
+        done = false;
+        queue.clear();
+        send("HASHES");
+        return harness::runUntil([this]() {
+            std::string out = Serial.takeOutput();
+            bytes += out.size();
+            partial += out;
+            size_t eol;
+            while ((eol = partial.find('\n')) != std::string::npos) {
+                std::string line = partial.substr(0, eol);
+                partial.erase(0, eol + 1);
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                onLine(line);
+            }
+            return done;
+        }, 5000000);
+    }
+};
+
+void testDeltaSync() {
+    freshEeprom();
+    harness::boot();
+    harness::runFor(3000000); // Splash
+    for (int i = 0; i < 11; i++) CHECK(harness::command("ADDBANK") == "OK:BANK_ADDED");
+    harness::runFor(200000);
+    int banks = configManager.getActiveBanksCount();
+
+    SyncClient client;
+    CHECK(client.sync());
+    printf("  first sync: %d requests, %llu B\n", client.requests, (unsigned long long)client.bytes);
+    CHECK(client.requests == 1 + banks + 2 + MACRO_COUNT);
+    CHECK((int)client.banks.size() == banks);
+    CHECK(client.banks[4].lines[0].compare(0, 7, "BANK:4:") == 0);
+    CHECK(client.banks[4].lines[3].compare(0, 9, "DATA:4:2:") == 0);
+
+    // Sin cambios: una sola petición
+    CHECK(client.sync());
+    printf("  unchanged: %d request, %llu B\n", client.requests, (unsigned long long)client.bytes);
+    CHECK(client.requests == 1);
+
+    // Un banco editado (desde el otro puerto, p.ej.): solo ese banco
+    CHECK(harness::command("SAVE:6:1:NEW:P:9:0:N:0:0:R") == "OK:SAVED");
+    uint16_t gen = client.gen;
+    CHECK(client.sync());
+    CHECK(client.requests == 2);
+    CHECK(client.gen != gen);
+    CHECK(client.banks[6].lines[2].compare(0, 14, "DATA:6:1:NEW:P") == 0);
+
+    // Macro y global
+    CHECK(harness::command("MACRO:3:0:C:20:1:0") == "OK:MACRO_SAVED");
+    CHECK(harness::command("SAVEGLO:0:TAP:D:5:0") == "OK:SAVED_GLO");
+    CHECK(client.sync());
+    CHECK(client.requests == 3);
+    CHECK(client.macros[3].lines[0].compare(0, 11, "MACRO:3:0:C") == 0);
+    CHECK(client.globals[0].lines[0].compare(0, 13, "DATAGLO:0:TAP") == 0);
+
+    // Borrar un banco desplaza los de detrás y cambia los números de línea
+    CHECK(harness::command("DELBANK:0") == "OK:BANK_REMOVED");
+    harness::runFor(200000);
+    CHECK(client.sync());
+    CHECK((int)client.banks.size() == banks - 1);
+    CHECK(client.banks[5].lines[2].compare(0, 14, "DATA:5:1:NEW:P") == 0);
+    CHECK(client.macros[3].lines[0].compare(0, 11, "MACRO:3:0:C") == 0);
+    CHECK(client.sync() && client.requests == 1);
+}
+
+void testGetBankErrors() {
+    CHECK(harness::command("GETBANK:40") == "ERR:GETBANK_FAIL");
+    CHECK(harness::command("GETBANK") == "ERR:GETBANK_FAIL");
+    harness::runFor(100000);
+    Serial.takeOutput();
+    Serial.inject("HASHES\nHASHES\n");
+    std::string out;
+    harness::runUntil([&out]() {
+        out += Serial.takeOutput();
+        return out.find("HASHES:END:") != std::string::npos;
+    }, 2000000);
+    CHECK(out.find("ERR:BUSY") != std::string::npos);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(testHashIgnoresPaging);
+    RUN_TEST(testEditChangesOneHash);
+    RUN_TEST(testDeltaSync);
+    RUN_TEST(testGetBankErrors);
+    return testFailures ? 1 : 0;
+}
@@ -0,0 +1,193 @@
+// Tests del tap tempo y del reloj MIDI: media con descarte de fallos, BPM por
+// banco en la EEPROM, comandos TEMPO/CLOCK y pulsos 0xF8 en su sitio.
+
+#include <SimHarness.h>
+#include <ConfigManager.h>
+#include <MidiDictionary.h>
+#include <MidiClock.h>
+#include <TapTempo.h>
+#include <string>
+#include <vector>
+#include "TestCheck.h"
+
+using harness::freshEeprom;
+using harness::send;
+using harness::press;
+
+extern ConfigManager configManager;
+extern MidiClock midiClock;
+
+namespace {
+
+const uint64_t BYTE_US = 320; // Un byte a 31250
+
+// Instantes (inicio en el cable) de los 0xF8 desde 'from'
+std::vector<uint64_t> pulses(size_t from) {
+    std::vector<uint64_t> out;
+    std::vector<sim::MidiEvent>& log = sim::midiLog();
+    for (size_t i = from; i < log.size(); i++) {
+        if (log[i].status == 0xF8) out.push_back(log[i].wireUs - BYTE_US);
+    }
+    return out;
+}
+
+void testTapAverage() {
+    TapTempo tap;
+    CHECK(!tap.tap(1000)); // La primera solo arranca la serie
+    CHECK(tap.tap(1500) && tap.beatUs() == 500000);
+    CHECK(tap.tap(2010));
+    CHECK(tap.tap(2490));
+    CHECK(tap.beatUs() == 496666); // (500 + 510 + 480) / 3 ms
+
+    // Rebote: ni cuenta ni mueve la referencia
+    CHECK(!tap.tap(2600));
+    CHECK(tap.tap(2990) && tap.samples() == 4);
+
+    // Pisada perdida: el doble cuenta como dos intervalos
+    CHECK(tap.tap(3990) && tap.samples() == 6);
+    CHECK(tap.beatUs() > 495000 && tap.beatUs() < 502000);
+
+    // Un fallo aislado se descarta; dos iguales son un tempo nuevo
+    unsigned long beat = tap.beatUs();
+    CHECK(!tap.tap(4690));
+    CHECK(tap.beatUs() == beat);
+    CHECK(tap.tap(5390) && tap.samples() == 2 && tap.beatUs() == 700000);
+
+    // Tras TAP_TIMEOUT_MS empieza otra serie y el tempo se conserva hasta el siguiente intervalo
+    CHECK(!tap.tap(9000));
+    CHECK(tap.beatUs() == 700000);
+    CHECK(tap.tap(9400) && tap.samples() == 1 && tap.beatUs() == 400000);
+}
+
+// El BPM va en el bit alto de los bytes del nombre: sin bytes nuevos
+void testBankTempoPersists() {
+    freshEeprom();
+    ConfigManager cfg;
+    cfg.begin();
+    CHECK(cfg.getBankTempo(0) == 0);
+    cfg.setBankName(0, "ABCDEFGH");
+    cfg.setBankTempo(0, 250);
+    cfg.setBankTempo(1, 93);
+    cfg.save();
+    cfg.flush();
+
+    ConfigManager reboot;
+    reboot.begin();
+    CHECK(reboot.getBankTempo(0) == 250 && strcmp(reboot.getBankName(0), "ABCDEFGH") == 0);
+    CHECK(reboot.getBankTempo(1) == 93);
+    CHECK(reboot.getBankTempo(2) == 0);
+
+    // Renombrar no pierde el tempo
+    reboot.setBankName(1, "X");
+    reboot.save();
+    reboot.flush();
+    ConfigManager again;
+    again.begin();
+    CHECK(again.getBankTempo(1) == 93 && strcmp(again.getBankName(1), "X") == 0);
+}
+
+void testTempoCommands() {
+    freshEeprom();
+    harness::boot();
+    harness::runFor(3000000); // Splash
+    if (configManager.getActiveBanksCount() < 2) CHECK(send("ADDBANK") == "OK:BANK_ADDED");
+
+    CHECK(!midiClock.running());
+    CHECK(send("TEMPO:0:20") == "ERR:TEMPO_FAIL");
+    CHECK(send("TEMPO:0:251") == "ERR:TEMPO_FAIL");
+    CHECK(send("TEMPO:40:120") == "ERR:TEMPO_FAIL");
+    CHECK(send("TEMPO:0") == "ERR:TEMPO_FAIL");
+    CHECK(send("CLOCK:300") == "ERR:CLOCK_FAIL");
+
+    // El banco actual se aplica al momento
+    CHECK(send("TEMPO:0:120") == "OK:TEMPO_SAVED");
+    CHECK(configManager.getBankTempo(0) == 120);
+    CHECK(midiClock.running() && midiClock.bpm10() == 1200);
+
+    CHECK(send("CLOCK:0") == "OK:CLOCK");
+    CHECK(!midiClock.running());
+    CHECK(send("CLOCK:90") == "OK:CLOCK");
+    CHECK(midiClock.bpm10() == 900);
+    CHECK(configManager.getBankTempo(0) == 120);
+}
+
+// 24 pulsos por negra, sin deriva aunque el período no sea un número
+// entero de ticks (120 BPM = 20833,3 us) y con loop() trabajando
+void testClockPeriod() {
+    CHECK(send("CLOCK:120") == "OK:CLOCK");
+    harness::runFor(100000);
+    size_t from = sim::midiLog().size();
+    harness::command("GETALL");
+    harness::runFor(2000000);
+
+    std::vector<uint64_t> p = pulses(from);
+    CHECK(p.size() >= 95);
+    if (p.size() < 95) return;
+    const double PULSE = 500000.0 / 24;
+    double worst = 0;
+    for (size_t k = 0; k < p.size(); k++) {
+        double err = (double)(p[k] - p[0]) - k * PULSE;
+        if (err < 0) err = -err;
+        if (err > worst) worst = err;
+    }
+    printf("  %zu pulsos, error de fase máx %.0f us\n", p.size(), worst);
+    CHECK(worst < 2 * BYTE_US + 2 * CLOCK_TICK_US);
+}
+
+// Cuatro pisadas a 100 BPM: el reloj toma el tempo y la fase del pie
+void testTapDrivesClock() {
+    std::string save = "SAVE:0:2:TAP:D:" + std::to_string(DICT_TAP) + ":0:N:0:0:R";
+    CHECK(send(save.c_str()) == "OK:SAVED");
+    CHECK(send("CLOCK:0") == "OK:CLOCK");
+
+    size_t from = sim::midiLog().size();
+    uint64_t at = (sim::nowUs() / 1000 + 10) * 1000;
+    for (int i = 0; i < 4; i++) press(harness::PIN_PRESET_3, at + i * 600000ULL, 60000);
+    harness::runFor(4 * 600000ULL);
+
+    int taps = 0;
+    std::vector<sim::MidiEvent>& log = sim::midiLog();
+    for (size_t i = from; i < log.size(); i++) {
+        if (log[i].status == 0xB0 && log[i].data1 == dictCC(DICT_TAP)) {
+            taps++;
+            CHECK(log[i].data2 == 127);
+        }
+    }
+    CHECK(taps == 4);
+    CHECK(midiClock.running() && midiClock.beatUs() > 598000 && midiClock.beatUs() < 602000);
+
+    // Los pulsos caen en la rejilla de la última pisada (+1 ms del escáner)
+    uint64_t last = at + 3 * 600000ULL;
+    const uint64_t PULSE = 600000 / 24;
+    std::vector<uint64_t> p = pulses(from);
+    CHECK(!p.empty());
+    for (uint64_t t : p) {
+        if (t < last) continue;
+        uint64_t phase = (t - last) % PULSE;
+        int64_t err = phase > PULSE / 2 ? (int64_t)phase - (int64_t)PULSE : (int64_t)phase;
+        CHECK(err > -1000 - (int64_t)BYTE_US && err < 1000 + 2 * (int64_t)BYTE_US);
+    }
+}
+
+// Tempo del banco al entrar en él; un banco sin tempo no toca el reloj
+void testBankRecall() {
+    CHECK(midiClock.bpm10() == 1000);
+    press(harness::PIN_BANK_UP, sim::nowUs() + 1000, 60000);
+    harness::runFor(300000);
+    CHECK(configManager.getBankTempo(1) == 0 && midiClock.bpm10() == 1000);
+    press(harness::PIN_BANK_DOWN, sim::nowUs() + 1000, 60000);
+    harness::runFor(300000);
+    CHECK(midiClock.bpm10() == 1200);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(testTapAverage);
+    RUN_TEST(testBankTempoPersists);
+    RUN_TEST(testTempoCommands);
+    RUN_TEST(testClockPeriod);
+    RUN_TEST(testTapDrivesClock);
+    RUN_TEST(testBankRecall);
+    return testFailures ? 1 : 0;
+}
@@ -0,0 +1,25 @@
+#ifndef TESTCHECK_H
+#define TESTCHECK_H
+
+// Aserciones mínimas para los tests host (sin framework externo).
+
+#include <stdio.h>
+
+static int testFailures = 0;
+
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);        \
+            testFailures++;                                                 \
+        }                                                                   \
+    } while (0)
+
+#define RUN_TEST(fn)                                                        \
+    do {                                                                    \
+        int before = testFailures;                                          \
+        fn();                                                               \
+        printf("%s %s\n", testFailures == before ? "ok  " : "FAIL", #fn);   \
+    } while (0)
+
+#endif
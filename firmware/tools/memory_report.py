@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+"""Presupuesto de RAM y flash por módulo del firmware.
+
+Lee los símbolos del .elf que genera el Arduino IDE / arduino-cli y los
+reparte por módulo (el header de donde salen). Falla si algún módulo se pasa
+de su presupuesto de RAM o si no quedan STACK_RESERVE bytes libres para la
+pila: así una función nueva no se come la pila sin que nadie se entere.
+
+    arduino-cli compile -b arduino:avr:uno --output-dir build firmware/controladorMidi
+    python3 firmware/tools/memory_report.py build/controladorMidi.ino.elf
+
+RAM = .data + .bss. Flash = código + PROGMEM + la copia inicial de .data.
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+
+SRAM_SIZE = 2048      # ATmega328P
+STACK_RESERVE = 400   # Mínimo libre para pila (ISR + llamadas anidadas de loop())
+
+# RAM máxima por módulo (bytes, tamaños AVR). Subir un número aquí es una
+# decisión explícita, no un efecto secundario.
+RAM_BUDGET = {
+    "ConfigManager": 512,     # 4 páginas + cola de escritura + journal + una macro
+    "SerialCommander": 430,   # Dos instancias (USB y BT), línea de 64 para STATS y 48 apartados
+    "Button": 300,            # 8 footswitches
+    "FootswitchScanner": 200, # Ring de muestras del ISR
+    "MidiOut": 150,
+    "DisplayManager": 130,    # 3 framebuffers de 16x2
+    "controladorMidi": 120,   # Estado global del sketch
+    "ButtonEventQueue": 110,
+    "BluetoothSetup": 60,
+    "BtSerial": 190,          # Ring RX de 128 + TX de 32
+    "LedManager": 30,
+    "MacroPlayer": 40,        # Copia de los 6 pasos + estado
+    "TapTempo": 30,           # 6 intervalos + estado
+    "MidiClock": 40,          # Período, fase y contadores del ISR + ClockSafePort (un Stream)
+    "ExpressionPedals": 70,   # 2 entradas (escala, posición, último CC) + estado del ISR del ADC
+    "MidiInput": 20,
+    "Scheduler": 180,         # 10 tareas de 16 bytes + orden por vencimiento
+    "Metrics": 110,           # 3 histogramas de 8 cubetas + contadores (0 sin METRICS_ENABLED)
+    "MidiDictionary": 0,      # Todo en flash
+    "PSTR": 0,
+    "core": 380,              # Serial, Wire, millis()...
+}
+
+# Objetos globales del sketch -> módulo de su clase (sin info de depuración
+# el .elf solo dice dónde se definió la variable, no de qué tipo es)
+GLOBALS = [
+    (r"^configManager$", "ConfigManager"),
+    (r"^commander(USB|BT)$", "SerialCommander"),
+    (r"^display$", "DisplayManager"),
+    (r"^midiOut$", "MidiOut"),
+    (r"^midiIn$", "MidiInput"),
+    (r"^metrics$", "Metrics"),
+    (r"^scheduler$", "Scheduler"),
+    (r"^footswitches$", "FootswitchScanner"),
+    (r"^buttonEvents$", "ButtonEventQueue"),
+    (r"^btn[A-Z]\w*$", "Button"),
+    (r"^ledManager$", "LedManager"),
+    (r"^macroPlayer$", "MacroPlayer"),
+    (r"^tapTempo$", "TapTempo"),
+    (r"^(midiClock|usbPort)$", "MidiClock"),
+    (r"^expression$", "ExpressionPedals"),
+    (r"^EXP_\w+$", "ExpressionPedals"),
+    (r"^btSetup$", "BluetoothSetup"),
+    (r"^btSerial$", "BtSerial"),
+    (r"^BT_BAUDS$", "BluetoothSetup"),
+    (r"^(midiDictionary|dictCC\w*)$", "MidiDictionary"),
+    (r"^(SPLASH_DURATIONS|notaMusical\w*)$", "DisplayManager"),
+    (r"^CFG_\w+$", "ConfigManager"),
+    (r"^BT_(NAME|PIN)$", "BluetoothSetup"),
+]
+
+FIRMWARE_FILES = {
+    os.path.splitext(f)[0]
+    for f in os.listdir(os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "controladorMidi"))
+}
+
+
+def module_of(name, location):
+    for pattern, module in GLOBALS:
+        if re.match(pattern, name):
+            return module
+    # Métodos: Clase::metodo
+    cls = name.split("::")[0] if "::" in name else None
+    if cls in FIRMWARE_FILES:
+        return cls
+    if location:
+        base = os.path.splitext(os.path.basename(location.split(":")[0]))[0]
+        if base in FIRMWARE_FILES:
+            return base
+    if name.startswith("__c.") or name.startswith("__c_"):
+        return "PSTR"  # Literales PSTR()/F(): el .elf no dice de qué función son
+    return "core"
+
+
+def read_symbols(nm, elf):
+    out = subprocess.run([nm, "-S", "-C", "-l", "--size-sort", elf],
+                         check=True, capture_output=True, text=True).stdout
+    for line in out.splitlines():
+        # addr size type name[\tfile:line]
+        name_part, _, location = line.partition("\t")
+        fields = name_part.split(None, 3)
+        if len(fields) < 4:
+            continue
+        yield fields[3], int(fields[1], 16), fields[2], location
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("elf")
+    parser.add_argument("--nm", default="avr-nm")
+    args = parser.parse_args()
+
+    ram, flash = {}, {}
+    for name, size, kind, location in read_symbols(args.nm, args.elf):
+        module = module_of(name, location)
+        k = kind.lower()
+        if k in "bd":
+            ram[module] = ram.get(module, 0) + size
+        if k in "dtrw":
+            flash[module] = flash.get(module, 0) + size
+
+    failed = False
+    print("%-18s %8s %8s %8s" % ("module", "RAM", "budget", "flash"))
+    for module in sorted(set(ram) | set(flash), key=lambda m: -ram.get(m, 0)):
+        used = ram.get(module, 0)
+        budget = RAM_BUDGET.get(module)
+        over = budget is not None and used > budget
+        failed |= over
+        print("%-18s %8d %8s %8d%s" % (module, used, budget if budget is not None else "-",
+                                       flash.get(module, 0), "  OVER BUDGET" if over else ""))
+
+    total = sum(ram.values())
+    free = SRAM_SIZE - total
+    print("%-18s %8d  (%d free for stack, reserve %d)" % ("total", total, free, STACK_RESERVE))
+    print("%-18s %8d" % ("flash total", sum(flash.values())))
+    if free < STACK_RESERVE:
+        print("FAIL: la pila se queda sin margen")
+        failed = True
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,52 +1,50 @@
 // Diccionario de Efectos (Debe coincidir con MidiDictionary.h)
+// scene: efecto con estado, entra en las escenas (la última columna de allí)
 const EFFECT_DICT = [
-    { name: "DIST (Distortion)", id: 0 },
-    { name: "AMP (Amplifier)", id: 1 },
-    { name: "MOD (Modulation)", id: 2 },
-    { name: "DLY (Delay)", id: 3 },
-    { name: "REV (Reverb)", id: 4 },
-    { name: "WAH (Wah)", id: 5 },
+    { name: "DIST (Distortion)", id: 0, scene: true },
+    { name: "AMP (Amplifier)", id: 1, scene: true },
+    { name: "MOD (Modulation)", id: 2, scene: true },
+    { name: "DLY (Delay)", id: 3, scene: true },
+    { name: "REV (Reverb)", id: 4, scene: true },
+    { name: "WAH (Wah)", id: 5, scene: true },
     { name: "TUNER (Tuner)", id: 6 },
     { name: "LOOP (Looper On/Off)", id: 7 },
     { name: "L.REC (Looper Rec)", id: 8 },
     { name: "L.PLY (Looper Play)", id: 9 },
-    { name: "CTRL1", id: 10 },
-    { name: "CTRL2", id: 11 },
-    { name: "CTRL3", id: 12 },
+    { name: "CTRL1", id: 10, scene: true },
+    { name: "CTRL2", id: 11, scene: true },
+    { name: "CTRL3", id: 12, scene: true },
     { name: "TAP (Tap Tempo)", id: 13 }
 ];
 
+// Interfaz sobre protocol.js (estado, comandos y parser del pedal)
 let port;
-let writer;
 let isConnected = false;
 
-// Estado local
-// Estado local
-const NUM_BANKS = 10; // Definido fijo para la matriz inicial
-let activeBanksCount = 0; // Se actualiza via Serial
-const NUM_PRESETS = 3;
-
-let configs = []; // Matriz [Bank][Preset]
-let bankNames = []; // Array de nombres de bancos
-
-// Inicializar matriz (se limpiará al recibir config)
-function resetLocalConfig() {
-    configs = [];
-    bankNames = [];
-    activeBanksCount = 0;
-}
-
-// Inicializar matriz vacía
-for (let b = 0; b < NUM_BANKS; b++) {
-    bankNames[b] = `BANK ${b}`;
-    configs[b] = [];
-    for (let p = 0; p < NUM_PRESETS; p++) {
-        configs[b][p] = { name: "INIT", type: "P", val1: 0, val2: 0 };
-    }
-}
-
 let currentBank = 0;
 
+// Avisos de protocol.js a la interfaz
+Object.assign(protocolUI, {
+    toast: showToast,
+    loadState: (loading) => {
+        const btn = document.getElementById('btnLoad');
+        btn.classList.toggle('loading', loading);
+        btn.innerHTML = loading ? "Leyendo..." : "📥 Leer Configuración"; // Spinner agregado por CSS
+    },
+    configLoaded: () => {
+        renderPedalboard();
+        // Habilitar panel global también
+        document.getElementById('globalPanel').classList.remove('disabled');
+        document.getElementById('macroPanel').classList.remove('disabled');
+        document.getElementById('statsPanel').classList.remove('disabled');
+        renderMacro();
+    },
+    globalChanged: renderGlobal,
+    uploadState: (busy) => document.getElementById('btnUpload').classList.toggle('loading', busy),
+    stats: renderStats,
+    statsUnsupported: () => setStatsLive(false)
+});
+
 document.addEventListener('DOMContentLoaded', () => {
     initUI();
 
@@ -70,13 +68,14 @@ document.addEventListener('DOMContentLoaded', () => {
 
     document.getElementById('btnModeBT').addEventListener('click', () => {
         modal.classList.remove('active');
-        connectSerial(9600); // Velocidad Standard HC-06 (Software Serial)
+        connectSerial(9600); // El puerto SPP ignora la velocidad: la del HC-06 la negocia el pedal
     });
 
 
     // document.getElementById('btnLoad').addEventListener('click', () => sendCommand("GETALL"));
     // Reemplazado por lógica robusta:
     document.getElementById('btnLoad').addEventListener('click', startConfigLoad);
+    document.getElementById('btnUpload').addEventListener('click', uploadRig);
 
     // Controles de Navegación
     document.getElementById('btnPrevBank').addEventListener('click', () => {
@@ -94,23 +93,21 @@ document.addEventListener('DOMContentLoaded', () => {
     document.getElementById('btnSaveBank').addEventListener('click', () => {
         const name = document.getElementById('txtBankName').value.toUpperCase().substring(0, 8);
         saveBankName(currentBank, name);
+        const bpm = parseInt(document.getElementById('numBankBpm').value) || 0;
+        if (bpm !== (bankTempos[currentBank] || 0)) saveBankTempo(currentBank, bpm);
     });
 
     // Gestión Dinámica Bancos
     document.getElementById('btnAddBank').addEventListener('click', () => {
         if (confirm("¿Agregar un nuevo banco al final?")) {
-            sendCommand("ADDBANK");
-            // Esperar respuesta OK:BANK_ADDED que disparará recarga si implementamos refresh
-            // O podemos hacer un reload manual tras un delay
-            setTimeout(startConfigLoad, 500);
+            addBank(); // Con OK:BANK_ADDED se relee la configuración
         }
     });
 
     document.getElementById('btnDelBank').addEventListener('click', () => {
         if (confirm(`¿BORRAR el Banco ${currentBank}? Esta acción no se puede deshacer.`)) {
             // FIX: Enviar índice específico para borrar EL ACTUAL, no el último
-            sendCommand(`DELBANK:${currentBank}`);
-            setTimeout(startConfigLoad, 500);
+            deleteBank(currentBank);
         }
     });
 });
@@ -126,6 +123,28 @@ function initUI() {
             sel.appendChild(opt);
         });
     });
+    document.querySelectorAll('.fs-val1-macro').forEach(sel => {
+        for (let m = 0; m < NUM_MACROS; m++) {
+            const opt = document.createElement('option');
+            opt.value = m;
+            opt.textContent = `Macro ${m + 1}`;
+            sel.appendChild(opt);
+        }
+    });
+
+    // Casillas de la escena: una por efecto con estado
+    document.querySelectorAll('.scene-fx').forEach(box => {
+        EFFECT_DICT.filter(fx => fx.scene).forEach(fx => {
+            const label = document.createElement('label');
+            label.innerHTML = `<input type="checkbox" class="fs-scene-fx" data-fx="${fx.id}"> ${fx.name.split(" ")[0]}`;
+            box.appendChild(label);
+        });
+    });
+    document.querySelectorAll('.fs-scene-on').forEach(chk => {
+        chk.addEventListener('change', () => {
+            chk.closest('.footswitch').querySelector('.scene-fx').style.display = chk.checked ? 'grid' : 'none';
+        });
+    });
 
     // Listeners para Toggle Tipo LP
     document.querySelectorAll('.fs-lp-type').forEach((sel) => {
@@ -137,6 +156,7 @@ function initUI() {
             container.querySelector('.lp-opt-p').style.display = 'none';
             container.querySelector('.lp-opt-c').style.display = 'none';
             container.querySelector('.lp-opt-d').style.display = 'none';
+            container.querySelector('.lp-opt-m').style.display = 'none';
 
             if (type === 'P') {
                 container.querySelector('.lp-opt-p').style.display = 'flex';
@@ -144,6 +164,8 @@ function initUI() {
                 container.querySelector('.lp-opt-c').style.display = 'flex';
             } else if (type === 'D') {
                 container.querySelector('.lp-opt-d').style.display = 'block';
+            } else if (type === 'M') {
+                container.querySelector('.lp-opt-m').style.display = 'block';
             }
         });
     });
@@ -153,9 +175,13 @@ function initUI() {
         sel.addEventListener('change', (e) => {
             const container = sel.closest('.footswitch');
             const type = e.target.value;
+            container.querySelector('.fs-options-macro').style.display = type === 'M' ? 'block' : 'none';
             if (type === 'P') {
                 container.querySelector('.fs-options-preset').style.display = 'grid'; // Grid por el cambio css
                 container.querySelector('.fs-options-dict').style.display = 'none';
+            } else if (type === 'M') {
+                container.querySelector('.fs-options-preset').style.display = 'none';
+                container.querySelector('.fs-options-dict').style.display = 'none';
             } else {
                 container.querySelector('.fs-options-preset').style.display = 'none';
                 container.querySelector('.fs-options-dict').style.display = 'block';
@@ -163,6 +189,14 @@ function initUI() {
         });
     });
 
+    // Lo editado a mano ya no es lo que renderPedalboard() pintó
+    document.querySelectorAll('.footswitch').forEach(el => {
+        const i = parseInt(el.dataset.index);
+        const forget = (e) => { if (e.isTrusted) renderedSlots[i] = null; };
+        el.addEventListener('input', forget);
+        el.addEventListener('change', forget);
+    });
+
     // Listeners para Guardar Slot
     document.querySelectorAll('.btn-save-slot').forEach(btn => {
         btn.addEventListener('click', (e) => {
@@ -225,10 +259,6 @@ function showToast(message, type = 'success') {
 
 // --- SERIAL LOGIC ---
 
-// Variable global para el writer
-let textEncoder;
-let writableStreamClosed;
-
 async function connectSerial(baudRate) {
     if (!navigator.serial) {
         showToast("WebSerial no soportado. Usa Chrome/Edge.", "error");
@@ -241,10 +271,9 @@ async function connectSerial(baudRate) {
         console.log(`Abriendo puerto a ${baudRate} baudios...`);
         await port.open({ baudRate: baudRate });
 
-        // Configurar Writer una sola vez
-        textEncoder = new TextEncoderStream();
-        writableStreamClosed = textEncoder.readable.pipeTo(port.writable);
-        writer = textEncoder.writable.getWriter();
+        // Configurar Writer una sola vez (bytes crudos: texto y tramas binarias)
+        writer = port.writable.getWriter();
+        binaryProtocol = false;
 
         isConnected = true;
         document.getElementById('statusText').textContent = "🟢 Conectado";
@@ -261,7 +290,7 @@ async function connectSerial(baudRate) {
 
         // Handshake & Sync
         setTimeout(() => {
-            sendCommand("HELLO");
+            sendCommand("HELLO:BIN");
             startConfigLoad();
         }, 500);
 
@@ -272,15 +301,13 @@ async function connectSerial(baudRate) {
 }
 
 async function readLoop() {
-    const textDecoder = new TextDecoderStream();
-    const readableStreamClosed = port.readable.pipeTo(textDecoder.writable);
-    const reader = textDecoder.readable.getReader();
+    const reader = port.readable.getReader();
 
     try {
         while (true) {
             const { value, done } = await reader.read();
             if (done) break;
-            if (value) parseSerialData(value);
+            if (value) parseSerialBytes(value);
         }
     } catch (error) {
         console.error(error);
@@ -298,121 +325,78 @@ function getValetonLabel(pc) {
     return `Valeton: ${bankStr}-${slots[slotIndex]}`;
 }
 
-let buffer = "";
-function parseSerialData(data) {
-    buffer += data;
-    const lines = buffer.split(/\r?\n/);
-    buffer = lines.pop();
-
-    lines.forEach(line => {
-        // console.log("RX:", line);
-        if (line.trim() === "") return;
-
-        if (line.startsWith("BANK:")) {
-            // BANK:ID:NAME
-            const parts = line.split(":");
-            if (parts.length >= 3) {
-                const id = parseInt(parts[1]);
-                const name = parts[2] || "";
-
-                // Expandir arrays si es necesario
-                if (id >= activeBanksCount) activeBanksCount = id + 1;
-                bankNames[id] = name;
-            }
+// El pedalboard se repinta a trozos: cada slot recuerda qué config pintó
+// (la misma referencia de configs[b][p] = nada nuevo) y dentro de él solo se
+// escribe el campo que difiere del DOM. Un 'change' sintético solo cuando el
+// tipo cambia de verdad (reorganiza las opciones visibles). Lo que el usuario
+// toca a mano invalida su slot.
+const renderedSlots = [null, null, null];
+const renderedGlobals = [null, null];
+
+function setValue(el, v) {
+    v = String(v);
+    if (el.value !== v) el.value = v;
+}
 
-        } else if (line.startsWith("DATAGLO:")) {
-            // DATAGLO:ID:NAME:TYPE:V1:V2
-            const parts = line.split(":");
-            if (parts.length >= 6) {
-                const id = parseInt(parts[1]);
-                const name = parts[2];
-                const type = parts[3];
-                const v1 = parseInt(parts[4]);
-                const v2 = parseInt(parts[5]);
-
-                // Update UI directly
-                const card = document.querySelector(`.global-card[data-id="${id}"]`);
-                if (card) {
-                    card.querySelector('.gc-name').value = name;
-                    card.querySelector('.gc-type').value = type;
-                    card.querySelector('.gc-type').dispatchEvent(new Event('change')); // Trigger visibility
-
-                    if (type === 'P') {
-                        card.querySelector('.gc-v1').value = v1;
-                        card.querySelector('.gc-v2').value = v2;
-                    } else {
-                        card.querySelector('.gc-val-dict').value = v1;
-                    }
-                }
-            }
+function setText(el, v) {
+    if (el.textContent !== v) el.textContent = v;
+}
 
-        } else if (line.startsWith("DATA:")) {
-            // DATA:B:P:NAME:TYPE:V1:V2 (NO GUITAR)
-            const parts = line.split(":");
-            if (parts.length >= 7) {
-                const b = parseInt(parts[1]);
-                const p = parseInt(parts[2]);
-
-                if (!configs[b]) configs[b] = [];
-
-                let lpType = 'N';
-                let lpV1 = 0;
-                let lpV2 = 0;
-
-                // Check for new Long Press params
-                if (parts.length >= 10) {
-                    lpType = parts[7];
-                    lpV1 = parseInt(parts[8]);
-                    lpV2 = parseInt(parts[9]);
-                }
-
-                configs[b][p] = {
-                    name: parts[3],
-                    type: parts[4],
-                    val1: parseInt(parts[5]),
-                    val2: parseInt(parts[6]),
-                    lpType: lpType,
-                    lpV1: lpV1,
-                    lpV2: lpV2
-                };
-            }
-        } else if (line.startsWith("END:CONFIG")) {
-            renderPedalboard();
-            // Lógica de éxito para el loader
-            stopConfigLoad(true);
-            // showToast("Configuración Sincronizada"); // Ya lo hace stopConfigLoad
-        } else if (line.startsWith("OK:SAVED")) {
-            showToast("Botón Guardado");
-        } else if (line.startsWith("OK:BANK_RENAMED")) {
-            showToast("Banco Renombrado");
-            bankNames[currentBank] = document.getElementById('txtBankName').value.toUpperCase();
-        } else if (line.startsWith("OK:BANK_ADDED")) {
-            showToast("Banco Agregado - Recargando...");
-            // startConfigLoad(); // Triggered by button, but good backup 
-        } else if (line.startsWith("OK:BANK_REMOVED")) {
-            showToast("Banco Eliminado - Recargando...");
-        } else if (line.startsWith("ERR:MAX_BANKS")) {
-            showToast("Límite de Bancos Alcanzado", "error");
-        } else if (line.startsWith("ERR:MIN_BANKS")) {
-            showToast("No se puede borrar el último banco", "error");
-        } else if (line.startsWith("READY:")) {
-            console.log("Pedal Ready");
-            showToast("Pedal Listo ✅");
-        }
-    });
+function setSelect(el, v) {
+    if (el.value === String(v)) return;
+    el.value = v;
+    el.dispatchEvent(new Event('change'));
 }
 
-async function sendCommand(cmd) {
-    if (!writer) {
-        showToast("No conectado", "error");
-        return;
+function setChecked(el, v) {
+    if (el.checked === v) return;
+    el.checked = v;
+    el.dispatchEvent(new Event('change'));
+}
+
+function renderSlot(el, data) {
+    setValue(el.querySelector('.fs-name'), data.name);
+    setSelect(el.querySelector('.fs-type'), data.type);
+
+    if (data.type === 'P') {
+        const inputPC = el.querySelector('.fs-val1-pc');
+        setValue(inputPC, data.val1);
+        setValue(el.querySelector('.fs-val2-pc'), data.val2);
+
+        // Update Helper manually
+        const helper = inputPC.parentNode.querySelector('.valeton-helper');
+        if (helper) setText(helper, getValetonLabel(data.val1));
+
+    } else if (data.type === 'M') {
+        setValue(el.querySelector('.fs-val1-macro'), data.val1);
+    } else {
+        setValue(el.querySelector('.fs-val1-dict'), data.val1);
     }
-    try {
-        await writer.write(cmd + "\n");
-    } catch (err) {
-        console.error("Error writing:", err);
-        showToast("Error de escritura", "error");
+
+    setValue(el.querySelector('.fs-press-mode'), data.pressMode || 'R');
+
+    // --- Update Long Press UI ---
+    setSelect(el.querySelector('.fs-lp-type'), data.lpType || 'N');
+
+    if (data.lpType === 'P') {
+        setValue(el.querySelector('.fs-lp-v1-p'), data.lpV1);
+        setValue(el.querySelector('.fs-lp-v2-p'), data.lpV2);
+    } else if (data.lpType === 'C') {
+        setValue(el.querySelector('.fs-lp-v1-c'), data.lpV1);
+        setValue(el.querySelector('.fs-lp-v2-c'), data.lpV2);
+    } else if (data.lpType === 'D') {
+        setValue(el.querySelector('.fs-lp-val-d'), data.lpV1);
+    } else if (data.lpType === 'M') {
+        setValue(el.querySelector('.fs-lp-val-m'), data.lpV1);
     }
+
+    // --- Escena (null = sin escena) ---
+    const scene = data.scene === undefined ? null : data.scene;
+    setChecked(el.querySelector('.fs-scene-on'), scene !== null);
+    el.querySelectorAll('.fs-scene-fx').forEach(box => {
+        const on = scene !== null && ((scene >> parseInt(box.dataset.fx)) & 1) === 1;
+        if (box.checked !== on) box.checked = on;
+    });
 }
 
 function renderPedalboard() {
@@ -420,57 +404,22 @@ function renderPedalboard() {
     if (activeBanksCount == 0) return; // Nada cargado aun
     if (currentBank >= activeBanksCount) currentBank = activeBanksCount - 1;
 
-    document.getElementById('lblBankIndex').textContent = `BANK ${currentBank} / ${activeBanksCount - 1}`;
+    setText(document.getElementById('lblBankIndex'), `BANK ${currentBank} / ${activeBanksCount - 1}`);
     const nameInput = document.getElementById('txtBankName');
-    if (nameInput) nameInput.value = bankNames[currentBank] || "";
+    if (nameInput) setValue(nameInput, bankNames[currentBank] || "");
+    const bpmInput = document.getElementById('numBankBpm');
+    if (bpmInput) setValue(bpmInput, bankTempos[currentBank] || "");
 
     // Habilitar/Deshabilitar botón borrar
-    const btnDel = document.getElementById('btnDelBank');
-    if (activeBanksCount <= 1) btnDel.classList.add('disabled');
-    else btnDel.classList.remove('disabled');
+    document.getElementById('btnDelBank').classList.toggle('disabled', activeBanksCount <= 1);
 
     // Update Slots
+    if (!configs[currentBank]) configs[currentBank] = []; // Safety
     for (let i = 0; i < 3; i++) {
-        if (!configs[currentBank]) configs[currentBank] = []; // Safety
-
         const data = configs[currentBank][i];
-        const el = document.querySelector(`.footswitch[data-index="${i}"]`);
-
-        if (!data) continue;
-
-        el.querySelector('.fs-name').value = data.name;
-        el.querySelector('.fs-type').value = data.type;
-
-        // Disparar evento change
-        el.querySelector('.fs-type').dispatchEvent(new Event('change'));
-
-        if (data.type === 'P') {
-            const inputPC = el.querySelector('.fs-val1-pc');
-            inputPC.value = data.val1;
-            el.querySelector('.fs-val2-pc').value = data.val2;
-
-            // Update Helper manually
-            const helper = inputPC.parentNode.querySelector('.valeton-helper');
-            if (helper) helper.textContent = getValetonLabel(data.val1);
-
-        } else {
-            el.querySelector('.fs-val1-dict').value = data.val1;
-        }
-
-        // --- Update Long Press UI ---
-        const lpSel = el.querySelector('.fs-lp-type');
-        lpSel.value = data.lpType || 'N';
-        lpSel.dispatchEvent(new Event('change')); // Update visibility
-
-        if (data.lpType === 'P') {
-            el.querySelector('.fs-lp-v1-p').value = data.lpV1;
-            el.querySelector('.fs-lp-v2-p').value = data.lpV2;
-        } else if (data.lpType === 'C') {
-            el.querySelector('.fs-lp-v1-c').value = data.lpV1;
-            el.querySelector('.fs-lp-v2-c').value = data.lpV2;
-        } else if (data.lpType === 'D') {
-            el.querySelector('.fs-lp-val-d').value = data.lpV1;
-        }
+        if (!data || renderedSlots[i] === data) continue;
+        renderSlot(document.querySelector(`.footswitch[data-index="${i}"]`), data);
+        renderedSlots[i] = data;
     }
 }
 
@@ -485,6 +434,8 @@ function getSlotData(el) {
     if (type === 'P') {
         v1 = el.querySelector('.fs-val1-pc').value;
         v2 = el.querySelector('.fs-val2-pc').value;
+    } else if (type === 'M') {
+        v1 = el.querySelector('.fs-val1-macro').value;
     } else {
         v1 = el.querySelector('.fs-val1-dict').value;
     }
@@ -502,6 +453,8 @@ function getSlotData(el) {
         lpV2 = el.querySelector('.fs-lp-v2-c').value;
     } else if (lpType === 'D') {
         lpV1 = el.querySelector('.fs-lp-val-d').value;
+    } else if (lpType === 'M') {
+        lpV1 = el.querySelector('.fs-lp-val-m').value;
     }
 
     return {
@@ -513,95 +466,33 @@ function getSlotData(el) {
         v2: v2 || 0,
         lpType: lpType,
         lpV1: lpV1 || 0,
-        lpV2: lpV2 || 0
-    };
-}
-
-
-function saveSlot(data) {
-    // SAVE:B:P:NAME:TYPE:V1:V2:LPT:LPV1:LPV2
-    const cmd = `SAVE:${data.b}:${data.p}:${data.name}:${data.type}:${data.v1}:${data.v2}:${data.lpType}:${data.lpV1}:${data.lpV2}`;
-    console.log("TX:", cmd);
-    sendCommand(cmd);
-
-    // Update local config cache
-    configs[data.b][data.p] = {
-        name: data.name,
-        type: data.type,
-        val1: parseInt(data.v1),
-        val2: parseInt(data.v2),
-        lpType: data.lpType,
-        lpV1: parseInt(data.lpV1),
-        lpV2: parseInt(data.lpV2)
+        lpV2: lpV2 || 0,
+        pressMode: el.querySelector('.fs-press-mode').value,
+        scene: getSlotScene(el)
     };
 }
 
-function saveBankName(bankIdx, name) {
-    // SAVEBANK:B:NAME
-    const cmd = `SAVEBANK:${bankIdx}:${name}`;
-    console.log("TX:", cmd);
-    sendCommand(cmd);
-}
-
-// --- CONFIG LOAD RETRY LOGIC ---
-let configLoadTimer = null;
-let configTimeoutInfo = null;
-let isConfigLoading = false;
-
-function startConfigLoad() {
-    if (isConfigLoading) return;
-
-    isConfigLoading = true;
-    const btn = document.getElementById('btnLoad');
-    const originalText = btn.innerHTML;
-
-    btn.classList.add('loading');
-    btn.innerHTML = "Leyendo..."; // Spinner agregado por CSS
-
-    // FIX: Resetear memoria local para evitar "bancos fantasma"
-    resetLocalConfig();
-
-    // 1. Envío inicial
-    sendCommand("GETALL");
-
-    // 2. Setup Retry Loop (cada 2 segundos)
-    configLoadTimer = setInterval(() => {
-        console.log("Re-intentando leer configuración...");
-        sendCommand("GETALL");
-    }, 2000);
-
-    // 3. Setup Max Timeout (10 segundos)
-    configTimeoutInfo = setTimeout(() => {
-        stopConfigLoad(false); // Fail
-        showToast("Tiempo de espera agotado. Verifica conexión.", "error");
-    }, 10000);
+// Bit i = efecto i encendido; null si el slot no fija efectos
+function getSlotScene(el) {
+    if (!el.querySelector('.fs-scene-on').checked) return null;
+    let scene = 0;
+    el.querySelectorAll('.fs-scene-fx').forEach(box => {
+        if (box.checked) scene |= 1 << parseInt(box.dataset.fx);
+    });
+    return scene;
 }
 
-
-
-function stopConfigLoad(success) {
-    if (!isConfigLoading) return;
-
-    isConfigLoading = false;
-    const btn = document.getElementById('btnLoad');
-
-    // Limpiar Timers
-    if (configLoadTimer) clearInterval(configLoadTimer);
-    if (configTimeoutInfo) clearTimeout(configTimeoutInfo);
-
-    // Reset UI
-    btn.classList.remove('loading');
-    btn.innerHTML = "📥 Leer Configuración"; // Restaurar texto
-
-    if (success) {
-        showToast("Configuración Sincronizada ✅");
-        // Habilitar panel global también
-        document.getElementById('globalPanel').classList.remove('disabled');
+// Sube todo lo local, con lo editado en pantalla y aún sin guardar
+function uploadRig() {
+    if (activeBanksCount > 0 && !pendingTx) {
+        document.querySelectorAll('.footswitch').forEach(el => cacheSlot(getSlotData(el)));
+        document.querySelectorAll('.global-card').forEach(readGlobalCard);
+        readMacroSteps();
     }
+    uploadConfig();
 }
 
 // --- GLOBAL LOGIC ---
-const globalConfigs = [{}, {}]; // ID 0 and 1
 
 function initGlobalUI() {
     // Reusar lógica de selects de efectos (ya poblados por clase fs-val1-dict)
@@ -611,9 +502,13 @@ function initGlobalUI() {
         sel.addEventListener('change', (e) => {
             const card = e.target.closest('.global-card');
             const val = e.target.value;
+            card.querySelector('.gc-options-macro').style.display = val === 'M' ? 'block' : 'none';
             if (val === 'P') {
                 card.querySelector('.gc-options-preset').style.display = 'flex';
                 card.querySelector('.gc-options-dict').style.display = 'none';
+            } else if (val === 'M') {
+                card.querySelector('.gc-options-preset').style.display = 'none';
+                card.querySelector('.gc-options-dict').style.display = 'none';
             } else {
                 card.querySelector('.gc-options-preset').style.display = 'none';
                 card.querySelector('.gc-options-dict').style.display = 'block';
@@ -621,35 +516,181 @@ function initGlobalUI() {
         });
     });
 
+    document.querySelectorAll('.global-card').forEach(card => {
+        const id = parseInt(card.dataset.id);
+        const forget = (e) => { if (e.isTrusted) renderedGlobals[id] = null; };
+        card.addEventListener('input', forget);
+        card.addEventListener('change', forget);
+    });
+
     // Listeners Save
     document.querySelectorAll('.btn-save-global').forEach(btn => {
         btn.addEventListener('click', (e) => {
-            const card = e.target.closest('.global-card');
-            const id = card.dataset.id;
-
-            const name = card.querySelector('.gc-name').value.toUpperCase();
-            const type = card.querySelector('.gc-type').value;
-            let v1 = 0, v2 = 0;
-
-            if (type === 'P') {
-                v1 = card.querySelector('.gc-v1').value || 0;
-                v2 = card.querySelector('.gc-v2').value || 0;
-            } else {
-                const sel = card.querySelector('.gc-val-dict select');
-                // Nota: la estructura HTML de arriba era simplificada, 
-                // la clase es .gc-val-dict y ADENTRO podría estar el select o ser el select.
-                // Revisando HTML insertado: <select class="gc-val-dict fs-val1-dict">
-                v1 = card.querySelector('.gc-val-dict').value;
-            }
-
-            // SAVEGLO:ID:NAME:TYPE:V1:V2
-            const cmd = `SAVEGLO:${id}:${name}:${type}:${v1}:${v2}`;
+            const cmd = buildGlobalCommand(readGlobalCard(e.target.closest('.global-card')));
             console.log("TX GLO:", cmd);
             sendCommand(cmd);
         });
     });
 }
+
+// Carga globalConfigs[id] en su tarjeta (solo lo que cambió, como los slots)
+function renderGlobal(id) {
+    const g = globalConfigs[id];
+    const card = document.querySelector(`.global-card[data-id="${id}"]`);
+    if (!card || !g || renderedGlobals[id] === g) return;
+    renderedGlobals[id] = g;
+    setValue(card.querySelector('.gc-name'), g.name);
+    setSelect(card.querySelector('.gc-type'), g.type); // Trigger visibility
+
+    if (g.type === 'P') {
+        setValue(card.querySelector('.gc-v1'), g.v1);
+        setValue(card.querySelector('.gc-v2'), g.v2);
+    } else if (g.type === 'M') {
+        setValue(card.querySelector('.gc-val-macro'), g.v1);
+    } else {
+        setValue(card.querySelector('.gc-val-dict'), g.v1);
+    }
+}
+
+// Tarjeta -> globalConfigs[id] (lo que se ve es lo pintado). Devuelve el id.
+function readGlobalCard(card) {
+    const id = parseInt(card.dataset.id);
+
+    const name = card.querySelector('.gc-name').value.toUpperCase();
+    const type = card.querySelector('.gc-type').value;
+    let v1 = 0, v2 = 0;
+
+    if (type === 'P') {
+        v1 = card.querySelector('.gc-v1').value || 0;
+        v2 = card.querySelector('.gc-v2').value || 0;
+    } else if (type === 'M') {
+        v1 = card.querySelector('.gc-val-macro').value;
+    } else {
+        v1 = card.querySelector('.gc-val-dict').value;
+    }
+
+    globalConfigs[id] = { name: name, type: type, v1: parseInt(v1) || 0, v2: parseInt(v2) || 0 };
+    renderedGlobals[id] = globalConfigs[id];
+    return id;
+}
 // Llamar esto en initUI() o DOMContentLoaded
 document.addEventListener('DOMContentLoaded', () => {
     initGlobalUI(); // ...existing code...
 });
+
+// --- MACROS ---
+// Hasta MACRO_STEPS pasos: P = preset (v1 prog, v2 bank), C = CC (v1 nº, v2
+// valor), D = efecto del diccionario (v2 >= 64 enciende). El retardo cuenta
+// desde el paso anterior; el pedal lo redondea a MACRO_TICK_MS.
+const MACRO_TYPES = [["N", "-- Fin --"], ["P", "Preset (PC)"], ["C", "Midi CC"], ["D", "Efecto"]];
+
+function initMacroUI() {
+    const body = document.getElementById('macroSteps');
+    body.innerHTML = Array.from({ length: MACRO_STEPS }, (_, s) => `
+        <tr data-step="${s}">
+            <td>${s + 1}</td>
+            <td><select class="ms-type">${MACRO_TYPES.map(([v, label]) => `<option value="${v}">${label}</option>`).join('')}</select></td>
+            <td><input type="number" class="ms-v1" min="0" max="127"></td>
+            <td><input type="number" class="ms-v2" min="0" max="127"></td>
+            <td><input type="number" class="ms-ms" min="0" max="${255 * MACRO_TICK_MS}" step="${MACRO_TICK_MS}"></td>
+        </tr>`).join('');
+
+    const sel = document.getElementById('selMacro');
+    sel.addEventListener('focus', readMacroSteps); // Lo editado se queda al cambiar de macro
+    sel.addEventListener('change', renderMacro);
+    document.getElementById('btnSaveMacro').addEventListener('click', () => {
+        readMacroSteps();
+        saveMacro(parseInt(sel.value));
+    });
+}
+
+function renderMacro() {
+    const steps = macros[parseInt(document.getElementById('selMacro').value) || 0];
+    document.querySelectorAll('#macroSteps tr').forEach((row, s) => {
+        row.querySelector('.ms-type').value = steps[s].type;
+        row.querySelector('.ms-v1').value = steps[s].v1;
+        row.querySelector('.ms-v2').value = steps[s].v2;
+        row.querySelector('.ms-ms').value = steps[s].ms;
+    });
+}
+
+function readMacroSteps() {
+    const steps = macros[parseInt(document.getElementById('selMacro').value) || 0];
+    document.querySelectorAll('#macroSteps tr').forEach((row, s) => {
+        steps[s] = {
+            type: row.querySelector('.ms-type').value,
+            v1: parseInt(row.querySelector('.ms-v1').value) || 0,
+            v2: parseInt(row.querySelector('.ms-v2').value) || 0,
+            ms: parseInt(row.querySelector('.ms-ms').value) || 0
+        };
+    });
+}
+
+document.addEventListener('DOMContentLoaded', () => {
+    initMacroUI();
+    renderMacro();
+});
+
+// --- MÉTRICAS DEL PEDAL (STATS) ---
+// El pedal responde STATS:BEGIN:<s>, una línea STAT:... por métrica y
+// STATS:END. Los histogramas son 8 cubetas log2 (ver Metrics.h); en vivo se
+// piden cada STATS_POLL_MS, nunca durante una lectura o subida de config.
+const STATS_POLL_MS = 2000;
+const STATS_COUNTERS = [
+    ["RX", ["Bytes RX USB", "Bytes RX BT"]],
+    ["CMD", ["Lecturas", "Ediciones", "Bancos", "Transacciones", "Tramas", "Otros"]],
+    ["DROP", ["ERR:BUFF_OVF", "Lockout", "Cola llena", "ISR sin hueco", "Esperas EEPROM", "Cola MIDI llena", "BT RX perdidos"]]
+];
+let statsTimer = null;
+
+function setStatsLive(on) {
+    document.getElementById('chkStatsLive').checked = on;
+    if (statsTimer) clearInterval(statsTimer);
+    statsTimer = on ? setInterval(requestStats, STATS_POLL_MS) : null;
+    if (on) requestStats();
+}
+
+function formatBucket(base, unit, i) {
+    const fmt = (v) => unit === 'us' && v >= 1000 ? `${v / 1000}ms` : `${v}${unit}`;
+    if (i === 7) return `≥${fmt(base * 64)}`;
+    return `<${fmt(base * (1 << i))}`;
+}
+
+function renderStats(stats) {
+    const maxIndex = { LOOP: 0, LAT: 1, EEP: 2 };
+    document.querySelectorAll('.stats-hist').forEach(el => {
+        const name = el.dataset.hist;
+        const counts = stats[name] || [];
+        const top = Math.max(1, ...counts);
+        const base = parseInt(el.dataset.base);
+        el.innerHTML = counts.map((c, i) => `
+            <div class="stats-bar" title="${c}">
+                <div class="fill" style="height:${(c / top) * 80}%"></div>
+                <span>${formatBucket(base, el.dataset.unit, i)}</span>
+            </div>`).join('');
+
+        let maxEl = el.nextElementSibling;
+        if (!maxEl || !maxEl.classList.contains('stats-max')) {
+            maxEl = document.createElement('div');
+            maxEl.className = 'stats-max';
+            el.after(maxEl);
+        }
+        const max = stats.MAX ? stats.MAX[maxIndex[name]] : 0;
+        maxEl.textContent = `Máx: ${max >= 65535 ? '≥65535' : max} ${el.dataset.unit}`;
+    });
+
+    const dl = document.getElementById('statsCounters');
+    dl.innerHTML = STATS_COUNTERS.map(([key, labels]) => labels.map((label, i) => {
+        const v = stats[key] ? stats[key][i] : 0;
+        const warn = key === "DROP" && v > 0 ? ' class="warn"' : '';
+        return `<dt>${label}</dt><dd${warn}>${v}</dd>`;
+    }).join('')).join('');
+
+    document.getElementById('statsSince').textContent = `Desde hace ${stats.since} s`;
+}
+
+document.addEventListener('DOMContentLoaded', () => {
+    document.getElementById('btnStats').addEventListener('click', requestStats);
+    document.getElementById('btnStatsReset').addEventListener('click', () => sendCommand("STATSRESET"));
+    document.getElementById('chkStatsLive').addEventListener('change', (e) => setStatsLive(e.target.checked));
+});
@@ -0,0 +1,204 @@
+// Bench de punta a punta: protocol.js (lo mismo que corre en el navegador)
+// contra el firmware del build host detrás de device_emu, sin placa.
+//
+// Mide, con el enlace que se pida (baudios, latencia, pérdida de bytes):
+//   - HELLO:BIN y la lectura completa (HASHES + GETALL por ventanas)
+//   - la relectura con la caché (solo HASHES si nada cambió)
+//   - la subida en lote de todo el rig (BEGINTX / TXSYNC / COMMIT) y su
+//     comprobación con una lectura completa
+//   - ADDBANK y DELBANK con su relectura
+// Todo va en tiempo del pedal: con --speed X el emulador corre X veces más
+// rápido y protocol.js ve sus relojes (Date.now, setTimeout, setInterval)
+// acelerados igual, así que reintentos y timeouts caen en el mismo sitio que
+// a velocidad real y los milisegundos medidos no dependen de X.
+//
+// Uso: node webapp/bench/e2e_bench.js [--emu ruta] [--baud N] [--latency MS]
+//          [--loss P] [--seed N] [--banks N] [--speed X] [--text] [--check]
+// --text no pide el protocolo binario; --check sale con error si algo falla.
+
+const fs = require('fs');
+const path = require('path');
+const vm = require('vm');
+const { spawn } = require('child_process');
+const { performance } = require('perf_hooks');
+
+const args = { emu: path.join(__dirname, '..', '..', 'firmware', 'host', 'build', 'device_emu'),
+               baud: 31250, latency: 0, loss: 0, seed: 1, banks: 15, speed: 1, text: false, check: false };
+for (let i = 2; i < process.argv.length; i++) {
+    const key = process.argv[i].replace(/^--/, '');
+    if (typeof args[key] === 'boolean') args[key] = true;
+    else if (key in args) args[key] = key === 'emu' ? process.argv[++i] : parseFloat(process.argv[++i]);
+    else throw new Error(`Opción desconocida: ${process.argv[i]}`);
+}
+
+const emu = spawn(args.emu, ['--baud', args.baud, '--latency', args.latency, '--loss', args.loss,
+                             '--seed', args.seed, '--banks', args.banks, '--speed', args.speed].map(String),
+                  { stdio: ['pipe', 'pipe', 'pipe'] });
+let emuLog = "";
+emu.stderr.on('data', (d) => { emuLog += d; });
+emu.on('error', (err) => {
+    console.error(`No se pudo arrancar ${args.emu}: ${err.message}`);
+    process.exit(2);
+});
+
+// --- protocol.js en un contexto propio, con el reloj del pedal ---
+const wallStart = performance.now();
+const pedalNow = () => (performance.now() - wallStart) * args.speed;
+const wallMs = (pedalMs) => pedalMs / args.speed;
+const toasts = [];
+const storage = new Map();
+const io = { tx: 0, rx: 0, writes: 0 };
+const waiters = new Set();
+
+const context = vm.createContext({
+    TextDecoder, TextEncoder, Uint8Array,
+    console: { log() {}, warn() {}, error: console.error },
+    setTimeout: (fn, ms, ...rest) => setTimeout(fn, wallMs(ms || 0), ...rest),
+    setInterval: (fn, ms, ...rest) => setInterval(fn, wallMs(ms || 0), ...rest),
+    clearTimeout, clearInterval,
+    Date: { now: () => Math.floor(pedalNow()) },
+    localStorage: { getItem: (k) => storage.has(k) ? storage.get(k) : null, setItem: (k, v) => storage.set(k, v) },
+    emuWrite: (bytes) => new Promise((resolve) => {
+        io.tx += bytes.length;
+        io.writes++;
+        emu.stdin.write(Buffer.from(bytes), resolve);
+    }),
+    Math, JSON, parseInt, isNaN, String, Array, Set, Map, Object
+});
+vm.runInContext(fs.readFileSync(path.join(__dirname, '..', 'protocol.js'), 'utf8'), context, { filename: 'protocol.js' });
+const app = (expr) => vm.runInContext(expr, context);
+
+// Cada aviso de la interfaz despierta a quien lo espera
+function notify(event, value) {
+    for (const w of [...waiters]) w(event, value);
+}
+const ui = app('protocolUI');
+ui.toast = (message, type = 'success') => {
+    toasts.push({ message, type });
+    notify('toast', message);
+};
+ui.loadState = (loading) => { if (!loading) notify('loadEnd'); };
+ui.configLoaded = () => notify('loaded');
+ui.uploadState = (busy) => { if (!busy) notify('uploadEnd'); };
+app('writer = { write: emuWrite }');
+
+const parseSerialBytes = app('parseSerialBytes');
+emu.stdout.on('data', (buf) => {
+    io.rx += buf.length;
+    parseSerialBytes(new Uint8Array(buf));
+});
+
+// Espera el evento que 'done' acepte; null si vence el plazo (ms del pedal)
+function waitFor(done, timeoutMs) {
+    return new Promise((resolve) => {
+        const timer = setTimeout(() => {
+            waiters.delete(w);
+            resolve(null);
+        }, wallMs(timeoutMs));
+        const w = (event, value) => {
+            const r = done(event, value);
+            if (r === undefined) return;
+            clearTimeout(timer);
+            waiters.delete(w);
+            resolve(r);
+        };
+        waiters.add(w);
+    });
+}
+
+const untilLoaded = (event) => event === 'loaded' ? true : (event === 'loadEnd' ? false : undefined);
+
+// --- Operaciones ---
+const results = [];
+
+async function measure(label, start, wait, verify) {
+    const before = { ...io };
+    const t0 = pedalNow();
+    start();
+    let ok = await wait();
+    const ms = pedalNow() - t0;
+    if (ok && verify) ok = verify();
+    results.push({ label, ok: !!ok, ms, writes: io.writes - before.writes, tx: io.tx - before.tx, rx: io.rx - before.rx });
+    // Lo que quede en vuelo (reintentos, ecos) no debe contar en la siguiente
+    await new Promise((r) => setTimeout(r, wallMs(200 + 2 * args.latency)));
+}
+
+async function handshake() {
+    // HELLO:BIN puede perderse: tres intentos y si no, texto
+    for (let i = 0; i < 3; i++) {
+        app('sendCommand("HELLO:BIN")');
+        if (await waitFor((e, v) => e === 'toast' && v.startsWith("Pedal Listo") ? true : undefined, 1000)) return true;
+    }
+    return false;
+}
+
+function snapshot() {
+    return JSON.stringify(app('({ n: activeBanksCount, names: bankNames.slice(0, activeBanksCount), tempos: bankTempos.slice(0, activeBanksCount), configs: configs.slice(0, activeBanksCount), globalConfigs, macros })'));
+}
+
+// Cambia toda la configuración local: la subida tiene que llevar cada línea
+function editEverything(round) {
+    app(`for (let b = 0; b < activeBanksCount; b++) {
+        bankNames[b] = "E2E" + b + "R${round}";
+        bankTempos[b] = 60 + b;
+        for (let p = 0; p < NUM_PRESETS; p++) {
+            configs[b][p] = { name: "S" + b + "" + p, type: p === 2 ? "D" : "P", val1: (b * 3 + p) % 128, val2: ${round},
+                              lpType: "C", lpV1: 20 + p, lpV2: 127, pressMode: p === 1 ? "I" : "R",
+                              scene: p === 2 ? null : (b * 37 + p + ${round}) & 0x1C3F }; // Solo efectos con estado
+        }
+    }
+    globalConfigs[0] = { name: "GL0", type: "D", v1: 13, v2: 0 };
+    globalConfigs[1] = { name: "GL1", type: "P", v1: 5, v2: ${round} };
+    macros[1][0] = { type: "C", v1: 30, v2: 64, ms: 50 };`);
+}
+
+async function run() {
+    const ready = await new Promise((resolve) => {
+        const check = () => { if (emuLog.includes("listo")) resolve(true); };
+        emu.stderr.on('data', check);
+        emu.on('exit', () => resolve(false));
+        check();
+    });
+    if (!ready) {
+        console.error(emuLog.trim());
+        process.exit(2);
+    }
+
+    const binary = args.text ? false : await handshake();
+    const banks = args.banks || 1;
+    console.log(`enlace: ${args.baud} baudios, latencia ${args.latency} ms, pérdida ${args.loss}, ${binary ? 'binario' : 'texto'}, ${banks} bancos`);
+
+    await measure("lectura completa", () => app('startConfigLoad()'), () => waitFor(untilLoaded, 30000),
+                  () => app('activeBanksCount') === banks);
+    await measure("relectura (caché)", () => app('startConfigLoad()'), () => waitFor(untilLoaded, 30000));
+
+    editEverything(1);
+    const uploaded = snapshot();
+    await measure("subida en lote", () => app('uploadConfig()'), () => waitFor((e) => e === 'uploadEnd' ? true : undefined, 60000),
+                  () => toasts[toasts.length - 1].message.startsWith("Rig guardado"));
+    storage.clear(); // Sin caché: todo lo que se compara viene del pedal
+    await measure("lectura tras subida", () => app('startConfigLoad()'), () => waitFor(untilLoaded, 30000),
+                  () => snapshot() === uploaded);
+
+    const namesBefore = app('bankNames.slice()');
+    await measure("ADDBANK + relectura", () => app('addBank()'), () => waitFor(untilLoaded, 15000),
+                  () => app('activeBanksCount') === banks + 1);
+    await measure("DELBANK + relectura", () => app('deleteBank(0)'), () => waitFor(untilLoaded, 15000),
+                  () => app('activeBanksCount') === banks && app('bankNames[0]') === namesBefore[1]);
+
+    console.log(`${"operación".padEnd(22)} ${"ms".padStart(8)} ${"envíos".padStart(7)} ${"TX B".padStart(7)} ${"RX B".padStart(7)}`);
+    for (const r of results) {
+        console.log(`${r.label.padEnd(22)} ${r.ms.toFixed(0).padStart(8)} ${String(r.writes).padStart(7)} ${String(r.tx).padStart(7)} ${String(r.rx).padStart(7)}  ${r.ok ? 'ok' : 'FALLO'}`);
+    }
+    const errors = toasts.filter(t => t.type === 'error').map(t => t.message);
+    if (errors.length) console.log(`avisos de error: ${[...new Set(errors)].join(' | ')}`);
+
+    emu.stdin.end();
+    await new Promise((r) => emu.on('exit', r));
+    const end = emuLog.split("\n").find(l => l.includes("fin ("));
+    if (end) console.log(end); // Bytes que el UART del pedal tiró por buffer lleno
+    const failed = results.some(r => !r.ok);
+    process.exit(args.check && failed ? 1 : 0);
+}
+
+run();
@@ -0,0 +1,146 @@
+// Bench sin navegador del parser (protocol.js) y del render (app.js).
+//
+// Reproduce una captura del puerto serie (por defecto capture.txt: HELLO,
+// HASHES, un GETALL completo de 21 bancos, un GETBANK, un SAVE y STATS,
+// grabada del build host del firmware) en trozos del tamaño que entrega el
+// BT y mide:
+//   - parse: el escáner incremental frente al split del buffer entero de antes
+//   - render: cambiar de banco, repintar sin cambios y repintar tras un DATA
+//     de un solo slot, con las escrituras al DOM y los 'change' sintéticos
+//
+// Uso: node webapp/bench/parse_bench.js [captura] [bytes por trozo] [repeticiones]
+// El DOM es un doble mínimo que solo cuenta escrituras: los tiempos de render
+// son los de app.js, no los de layout del navegador.
+
+const fs = require('fs');
+const path = require('path');
+const vm = require('vm');
+const { performance } = require('perf_hooks');
+
+const capturePath = process.argv[2] || path.join(__dirname, 'capture.txt');
+const chunkSize = parseInt(process.argv[3]) || 20; // Un paquete SPP típico
+const repeat = parseInt(process.argv[4]) || 50;
+
+// --- Doble del DOM ---
+const dom = { writes: 0, events: 0 };
+
+class FakeElement {
+    constructor() {
+        this._value = "";
+        this._text = "";
+        this._children = new Map();
+        this.dataset = {};
+        this.style = {};
+        this.classList = {
+            add: () => {}, remove: () => {}, contains: () => false,
+            toggle: () => {}
+        };
+        this.parentNode = this;
+    }
+    get value() { return this._value; }
+    set value(v) { this._value = String(v); dom.writes++; }
+    get textContent() { return this._text; }
+    set textContent(v) { this._text = String(v); dom.writes++; }
+    set innerHTML(v) { dom.writes++; }
+    querySelector(sel) {
+        if (!this._children.has(sel)) this._children.set(sel, new FakeElement());
+        return this._children.get(sel);
+    }
+    querySelectorAll() { return []; }
+    dispatchEvent() { dom.events++; }
+    addEventListener() {}
+    appendChild() {}
+    closest() { return this; }
+    after() {}
+    remove() {}
+}
+
+const document = new FakeElement();
+document.getElementById = (id) => document.querySelector('#' + id);
+document.createElement = () => new FakeElement();
+document.body = new FakeElement();
+
+const context = vm.createContext({
+    document,
+    Event: class { constructor(type) { this.type = type; } },
+    TextDecoder, TextEncoder, Uint8Array,
+    console: { log() {}, warn() {}, error: console.error },
+    setTimeout: () => 0, clearTimeout: () => {}, setInterval: () => 0, clearInterval: () => {},
+    requestAnimationFrame: () => 0,
+    localStorage: { getItem: () => null, setItem: () => {} },
+    navigator: {},
+    Date, Math, JSON, parseInt, isNaN, String, Array, Set, Map
+});
+for (const file of ['protocol.js', 'app.js']) {
+    vm.runInContext(fs.readFileSync(path.join(__dirname, '..', file), 'utf8'), context, { filename: file });
+}
+const app = (expr) => vm.runInContext(expr, context);
+
+// --- Parse ---
+const capture = fs.readFileSync(capturePath);
+const chunks = [];
+for (let i = 0; i < capture.length; i += chunkSize) chunks.push(capture.subarray(i, i + chunkSize));
+
+// El de antes: todo el buffer a split() en cada trozo
+app(`
+    var legacyBuffer = "";
+    function legacyParse(data) {
+        legacyBuffer += data;
+        const lines = legacyBuffer.split(/\\r?\\n/);
+        legacyBuffer = lines.pop();
+        lines.forEach(line => { if (line.trim() !== "") dispatchLine(line); });
+    }
+`);
+
+function timeParse(feed) {
+    const decoder = new TextDecoder();
+    const t0 = performance.now();
+    for (let r = 0; r < repeat; r++) {
+        for (const c of chunks) feed(c, decoder);
+    }
+    return (performance.now() - t0) / repeat;
+}
+
+const parseBytes = app('parseSerialBytes');
+const legacyParse = app('legacyParse');
+timeParse((c) => parseBytes(c)); // Calentar
+const incremental = timeParse((c) => parseBytes(c));
+const legacy = timeParse((c, d) => legacyParse(d.decode(c, { stream: true })));
+
+const lines = capture.toString().split('\n').length - 1;
+console.log(`captura: ${capture.length} B, ${lines} líneas, ${chunks.length} trozos de ${chunkSize} B`);
+console.log(`parse incremental: ${(incremental * 1000).toFixed(1)} us/captura (${(incremental * 1e6 / capture.length).toFixed(1)} ns/B)`);
+console.log(`parse split():     ${(legacy * 1000).toFixed(1)} us/captura (${(legacy * 1e6 / capture.length).toFixed(1)} ns/B)`);
+
+const banks = app('activeBanksCount');
+if (banks === 0) {
+    console.log("La captura no trae configuración: sin bench de render");
+    process.exit(0);
+}
+
+// --- Render ---
+function timeRender(label, prepare) {
+    let writes = 0, events = 0, ms = 0;
+    for (let r = 0; r < repeat; r++) {
+        prepare(r);
+        dom.writes = dom.events = 0;
+        const t0 = performance.now();
+        app('renderPedalboard()');
+        ms += performance.now() - t0;
+        writes += dom.writes;
+        events += dom.events;
+    }
+    console.log(`${label.padEnd(22)} ${(ms * 1000 / repeat).toFixed(1).padStart(7)} us  ${(writes / repeat).toFixed(1).padStart(5)} escrituras  ${(events / repeat).toFixed(1).padStart(4)} change`);
+}
+
+console.log(`render (${banks} bancos, media de ${repeat}):`);
+timeRender("cambio de banco", (r) => app(`currentBank = ${1 + (r % (banks - 1))}`));
+timeRender("sin cambios", () => {});
+timeRender("un slot (DATA)", (r) => {
+    const b = app('currentBank');
+    app(`parseSerialData("DATA:${b}:1:P${r % 10}:P:${r % 128}:0:N:0:0:R\\n")`);
+});
+timeRender("un slot (otro tipo)", (r) => {
+    const b = app('currentBank');
+    app(`parseSerialData("DATA:${b}:2:TAP:${r % 2 ? 'D' : 'P'}:13:0:N:0:0:R\\n")`);
+});
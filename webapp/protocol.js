@@ -0,0 +1,837 @@
+// Protocolo con el pedal, sin DOM: estado de la configuración, envío de
+// comandos (texto o tramas), parser de lo recibido, lectura (HASHES /
+// GETBANK / GETALL con reintentos) y subida en lote. app.js pone la interfaz
+// encima; webapp/bench/e2e_bench.js lo carga en Node contra el emulador del
+// firmware (firmware/host, device_emu).
+
+let writer; // { write(Uint8Array) }: el del puerto WebSerial o el del emulador
+
+// Lo que la interfaz tiene que enterarse. app.js sustituye las funciones;
+// sin interfaz se quedan en la consola o en nada.
+const protocolUI = {
+    toast: (message, type = 'success') => console.log(`[${type}] ${message}`),
+    loadState: (loading) => {},   // Lectura de configuración en curso / terminada
+    configLoaded: () => {},       // Configuración completa en configs, bankNames...
+    globalChanged: (id) => {},    // globalConfigs[id] nuevo
+    uploadState: (busy) => {},    // Subida en lote en curso / terminada
+    stats: (stats) => {},         // Respuesta completa de STATS
+    statsUnsupported: () => {}    // Firmware sin métricas
+};
+
+// Estado local
+const NUM_BANKS = 10; // Definido fijo para la matriz inicial
+let activeBanksCount = 0; // Se actualiza via Serial
+const NUM_PRESETS = 3;
+// Macros: igual que MACRO_COUNT / MACRO_STEPS / MACRO_TICK_MS en ConfigManager.h
+const NUM_MACROS = 4;
+const MACRO_STEPS = 6;
+const MACRO_TICK_MS = 10;
+
+let configs = []; // Matriz [Bank][Preset]
+let bankNames = []; // Array de nombres de bancos
+let bankTempos = []; // BPM por banco para el reloj MIDI (0 = sin tempo)
+let macros = []; // [Macro][Paso] = { type, v1, v2, ms }
+const globalConfigs = [{}, {}]; // ID 0 and 1
+
+function resetMacros() {
+    macros = [];
+    for (let m = 0; m < NUM_MACROS; m++) {
+        macros[m] = [];
+        for (let s = 0; s < MACRO_STEPS; s++) macros[m][s] = { type: 'N', v1: 0, v2: 0, ms: 0 };
+    }
+}
+resetMacros();
+
+// Inicializar matriz (se limpiará al recibir config)
+function resetLocalConfig() {
+    configs = [];
+    bankNames = [];
+    bankTempos = [];
+    activeBanksCount = 0;
+    resetMacros();
+}
+
+// Inicializar matriz vacía
+for (let b = 0; b < NUM_BANKS; b++) {
+    bankNames[b] = `BANK ${b}`;
+    bankTempos[b] = 0;
+    configs[b] = [];
+    for (let p = 0; p < NUM_PRESETS; p++) {
+        configs[b][p] = { name: "INIT", type: "P", val1: 0, val2: 0, pressMode: "R" };
+    }
+}
+
+let textEncoder = new TextEncoder();
+let binaryProtocol = false; // El pedal respondió READY:...:BIN
+
+async function sendCommand(cmd) {
+    if (!writer) {
+        protocolUI.toast("No conectado", "error");
+        return;
+    }
+    try {
+        // Con protocolo binario, cada línea que lo admite viaja como trama
+        const bytes = [];
+        for (const line of cmd.split("\n")) {
+            const frame = binaryProtocol ? commandToFrame(line) : null;
+            if (frame) bytes.push(...frame);
+            else bytes.push(...textEncoder.encode(line + "\n"));
+        }
+        await writer.write(new Uint8Array(bytes));
+    } catch (err) {
+        console.error("Error writing:", err);
+        protocolUI.toast("Error de escritura", "error");
+    }
+}
+
+// --- PROTOCOLO BINARIO (ver BinaryFrame.h) ---
+// Tramas F0 7D <cuerpo en grupos de 7 bits> F7, cuerpo = [op][len][payload][crc8].
+// Se usan solo si el pedal contesta READY:...:BIN. La App sigue pensando en
+// líneas ASCII: sendCommand() traduce SAVE/SAVEGLO/SAVEBANK/GETALL a tramas y
+// las tramas recibidas se convierten a su línea equivalente.
+const BF_START = 0xF0;
+const BF_END = 0xF7;
+const BF_MANUFACTURER = 0x7D;
+const BF_OP = { GETALL: 0x01, SAVE: 0x02, SAVEGLO: 0x03, SAVEBANK: 0x04, ACK: 0x40,
+                BANK_COUNT: 0x41, BANK: 0x42, GLOBAL: 0x43, DATA: 0x44, MORE: 0x45, END: 0x46,
+                MACRO: 0x47 };
+const BF_ACK_LINES = {
+    [BF_OP.SAVE]: ["OK:SAVED", "ERR:SAVE_FAIL"],
+    [BF_OP.SAVEGLO]: ["OK:SAVED_GLO", "ERR:SAVE_GLO_FAIL"],
+    [BF_OP.SAVEBANK]: ["OK:BANK_RENAMED", "ERR:SAVEBANK_FAIL"]
+};
+
+// CRC-8 Dallas/Maxim, igual que crc8() en EepromJournal.h
+function crc8(bytes) {
+    let crc = 0;
+    for (let b of bytes) {
+        for (let i = 0; i < 8; i++) {
+            const mix = (crc ^ b) & 0x01;
+            crc >>= 1;
+            if (mix) crc ^= 0x8C;
+            b >>= 1;
+        }
+    }
+    return crc;
+}
+
+function encodeFrame(op, payload) {
+    const body = [op, payload.length, ...payload];
+    body.push(crc8(body));
+    const out = [BF_START, BF_MANUFACTURER];
+    for (let i = 0; i < body.length; i += 7) {
+        const group = body.slice(i, i + 7);
+        out.push(group.reduce((msbs, b, j) => msbs | ((b >> 7) << j), 0));
+        group.forEach(b => out.push(b & 0x7F));
+    }
+    out.push(BF_END);
+    return out;
+}
+
+// ButtonConfig tal cual está en la EEPROM: name[5], type, v1, v2, lpType, lpV1, lpV2, mode
+function packButton(name, type, v1, v2, lpType, lpV1, lpV2, mode) {
+    const rec = [];
+    for (let i = 0; i < 4; i++) rec.push(i < name.length ? name.charCodeAt(i) & 0x7F : 0);
+    rec.push(0, type.charCodeAt(0), +v1, +v2, lpType.charCodeAt(0), +lpV1, +lpV2, mode.charCodeAt(0));
+    return rec;
+}
+
+// Línea ASCII -> trama, o null si el comando no tiene versión binaria
+function commandToFrame(cmd) {
+    const p = cmd.split(":");
+    if (p[0] === "GETALL") {
+        const from = parseInt(p[1] || 0);
+        return encodeFrame(BF_OP.GETALL, [from & 0xFF, from >> 8, parseInt(p[2] || DUMP_WINDOW)]);
+    } else if (p[0] === "SAVE" && p.length >= 11) {
+        return encodeFrame(BF_OP.SAVE, [+p[1], +p[2], ...packButton(p[3], p[4], p[5], p[6], p[7], p[8], p[9], p[10])]);
+    } else if (p[0] === "SAVEGLO" && p.length >= 6) {
+        return encodeFrame(BF_OP.SAVEGLO, [+p[1], ...packButton(p[2], p[3], p[4], p[5], 'N', 0, 0, 'R')]);
+    } else if (p[0] === "SAVEBANK" && p.length >= 3) {
+        const name = [...p[2].substring(0, 8)].map(c => c.charCodeAt(0) & 0x7F);
+        return encodeFrame(BF_OP.SAVEBANK, [+p[1], ...name]);
+    }
+    return null;
+}
+
+// Trama recibida -> la línea que el pedal habría mandado en ASCII
+function frameToLine(op, d) {
+    const u16 = i => d[i] | (d[i + 1] << 8);
+    const text = (from, to) => String.fromCharCode(...d.slice(from, to)).split("\0")[0];
+    const button = i => [text(i, i + 5), ...[5, 6, 7, 8, 9, 10, 11].map(k =>
+        (k === 5 || k === 8 || k === 11) ? String.fromCharCode(d[i + k]) : d[i + k])].join(":");
+
+    switch (op) {
+        case BF_OP.ACK: {
+            const lines = BF_ACK_LINES[d[0]];
+            if (d[1] === 2) return "ERR:BAD_FRAME";
+            return lines ? lines[d[1] === 0 ? 0 : 1] : null;
+        }
+        case BF_OP.BANK_COUNT: return `${u16(0)}|BANK_COUNT:${d[2]}`;
+        case BF_OP.BANK: return `${u16(0)}|BANK:${d[2]}:${text(4, d.length)}:${d[3]}`;
+        case BF_OP.GLOBAL: return `${u16(0)}|DATAGLO:${d[2]}:${button(3).split(":").slice(0, 4).join(":")}`;
+        case BF_OP.DATA: {
+            // Detrás del ButtonConfig, la escena del slot (0xFFFF = sin escena)
+            const scene = d.length >= 18 ? (u16(16) === 0xFFFF ? ":-" : `:${u16(16)}`) : "";
+            return `${u16(0)}|DATA:${d[2]}:${d[3]}:${button(4)}${scene}`;
+        }
+        case BF_OP.MACRO:
+            // MacroStep: tipo, v1, v2, retardo en ticks
+            return `${u16(0)}|MACRO:${d[2]}:${d[3]}:${String.fromCharCode(d[4])}:${d[5]}:${d[6]}:${d[7] * MACRO_TICK_MS}`;
+        case BF_OP.MORE: return `MORE:${u16(0)}:${u16(2)}`;
+        case BF_OP.END: return `END:CONFIG:${u16(0)}`;
+    }
+    return null;
+}
+
+// Decodificador incremental, como FrameDecoder en el firmware
+const rxFrame = { active: false, manufacturer: false, body: [], msbs: 0, group: 0 };
+const asciiDecoder = new TextDecoder();
+
+function feedFrame(c) {
+    const f = rxFrame;
+    if (c === BF_START) {
+        Object.assign(f, { active: true, manufacturer: false, body: [], group: 0 });
+        return;
+    }
+    if (c >= 0xF8) return; // Realtime MIDI
+    if (c === BF_END) {
+        f.active = false;
+        const b = f.body;
+        if (b.length < 3 || b[1] !== b.length - 3 || crc8(b.slice(0, -1)) !== b[b.length - 1]) {
+            console.warn("Trama binaria corrupta");
+            return;
+        }
+        const line = frameToLine(b[0], b.slice(2, -1));
+        // El pedal nunca parte una línea ASCII con una trama: el buffer está vacío
+        if (line) parseSerialData(line + "\n");
+        return;
+    }
+    if (c & 0x80) {
+        f.active = false;
+        return;
+    }
+    if (!f.manufacturer) {
+        f.manufacturer = true;
+        f.active = c === BF_MANUFACTURER;
+        return;
+    }
+    if (f.group === 0) {
+        f.msbs = c;
+        f.group = 1;
+        return;
+    }
+    f.body.push(c | (((f.msbs >> (f.group - 1)) & 1) << 7));
+    f.group = f.group === 7 ? 0 : f.group + 1;
+}
+
+// Separa tramas binarias del texto ASCII en el flujo de bytes del puerto
+function parseSerialBytes(bytes) {
+    let start = 0;
+    for (let i = 0; i < bytes.length; i++) {
+        const c = bytes[i];
+        // Reloj MIDI (0xF8) y demás tiempo real: pueden caer en medio de una línea
+        if (!rxFrame.active && c !== BF_START && c < 0xF8) continue;
+        if (i > start) parseSerialData(asciiDecoder.decode(bytes.subarray(start, i), { stream: true }));
+        feedFrame(c);
+        start = i + 1;
+    }
+    if (start < bytes.length) parseSerialData(asciiDecoder.decode(bytes.subarray(start), { stream: true }));
+}
+
+// Recepción por líneas. Por BT llegan trozos de pocos bytes: solo se busca
+// el fin de línea en lo nuevo y lo que queda a medias espera en rxPartial.
+let rxPartial = "";
+function parseSerialData(data) {
+    let start = 0;
+    let eol;
+    while ((eol = data.indexOf("\n", start)) !== -1) {
+        let line = rxPartial + data.substring(start, eol);
+        rxPartial = "";
+        start = eol + 1;
+        if (line.endsWith("\r")) line = line.slice(0, -1);
+        if (line.trim() !== "") dispatchLine(line);
+    }
+    if (start < data.length) rxPartial += data.substring(start);
+}
+
+// Una línea a su manejador de LINE_HANDLERS: primero por los dos primeros
+// campos ("OK:SAVED", "END:BANK"...) y si no, por el primero ("DATA")
+function dispatchLine(line) {
+    // console.log("RX:", line);
+
+    // Líneas del volcado numeradas: "7|DATA:..."
+    const bar = line.indexOf("|");
+    if (bar > 0 && bar < 6) {
+        const seq = parseInt(line);
+        if (!isNaN(seq)) {
+            dumpSeen.add(seq);
+            lastDumpRx = Date.now();
+            line = line.substring(bar + 1);
+        }
+    }
+
+    const parts = line.split(":");
+    const handler = (parts.length > 1 && LINE_HANDLERS[parts[0] + ":" + parts[1]]) || LINE_HANDLERS[parts[0]];
+    if (handler) handler(parts, line);
+}
+
+function onSaved() {
+    protocolUI.toast("Botón Guardado");
+}
+
+// Fin de ventana: MORE:<siguiente>:<total> / END:CONFIG:<total>
+function onDumpWindowEnd(parts) {
+    dumpTotal = parseInt(parts[parts.length - 1]);
+    lastDumpRx = Date.now();
+    requestMissing();
+}
+
+const LINE_HANDLERS = {
+    "BANK_COUNT": (parts) => {
+        activeBanksCount = parseInt(parts[1]);
+    },
+
+    // BANK:ID:NAME:BPM
+    "BANK": (parts) => {
+        if (parts.length < 3) return;
+        const id = parseInt(parts[1]);
+        // Expandir arrays si es necesario
+        if (id >= activeBanksCount) activeBanksCount = id + 1;
+        bankNames[id] = parts[2] || "";
+        bankTempos[id] = parseInt(parts[3]) || 0;
+    },
+
+    // DATAGLO:ID:NAME:TYPE:V1:V2
+    "DATAGLO": (parts) => {
+        if (parts.length < 6) return;
+        const id = parseInt(parts[1]);
+        globalConfigs[id] = { name: parts[2], type: parts[3], v1: parseInt(parts[4]), v2: parseInt(parts[5]) };
+        protocolUI.globalChanged(id);
+    },
+
+    // DATA:B:P:NAME:TYPE:V1:V2[:LPT:LPV1:LPV2[:MODE[:SCENE]]]
+    "DATA": (parts) => {
+        if (parts.length < 7) return;
+        const b = parseInt(parts[1]);
+        const p = parseInt(parts[2]);
+        if (!configs[b]) configs[b] = [];
+
+        // Long Press y modo de disparo (R=Al soltar, I=Inmediato, S=Especulativo)
+        const lp = parts.length >= 10;
+        configs[b][p] = {
+            name: parts[3],
+            type: parts[4],
+            val1: parseInt(parts[5]),
+            val2: parseInt(parts[6]),
+            lpType: lp ? parts[7] : 'N',
+            lpV1: lp ? parseInt(parts[8]) : 0,
+            lpV2: lp ? parseInt(parts[9]) : 0,
+            pressMode: parts.length >= 11 ? parts[10] : 'R',
+            // Escena: bit i = efecto i del diccionario encendido; null = sin escena
+            scene: parts.length >= 12 && parts[11] !== '-' ? parseInt(parts[11]) : null
+        };
+    },
+
+    // MACRO:M:S:TYPE:V1:V2:MS
+    "MACRO": (parts) => {
+        const m = parseInt(parts[1]);
+        const s = parseInt(parts[2]);
+        if (parts.length >= 7 && macros[m] && s < MACRO_STEPS) {
+            macros[m][s] = { type: parts[3], v1: parseInt(parts[4]), v2: parseInt(parts[5]), ms: parseInt(parts[6]) };
+        }
+    },
+
+    "HASHES:END": (parts) => finishHashes(parseInt(parts[2])),
+
+    // HASHES:<generación>:<bancos>
+    "HASHES": (parts) => {
+        syncHashes = { gen: parseInt(parts[1]), banks: parseInt(parts[2]), B: [], G: [], M: [] };
+        lastDumpRx = Date.now();
+    },
+
+    // HASH:<B|G|M>:<primero>:<4 hex por elemento>
+    "HASH": (parts) => {
+        const list = syncHashes && syncHashes[parts[1]];
+        if (list) {
+            const first = parseInt(parts[2]);
+            for (let i = 0; i + 4 <= parts[3].length; i += 4) list[first + i / 4] = parts[3].substr(i, 4);
+        }
+        lastDumpRx = Date.now();
+    },
+
+    "END:BANK": () => {
+        lastDumpRx = Date.now();
+        requestMissing();
+    },
+    "ERR:GETBANK_FAIL": () => {
+        // Cambió el número de bancos a mitad: empezar de nuevo
+        if (isConfigLoading) requestHashes();
+    },
+    "MORE": onDumpWindowEnd,
+    "END:CONFIG": onDumpWindowEnd,
+
+    "OK:TX_BEGIN": () => sendTxWindow(),
+    "OK:TX_SYNC": (parts) => txWindowDone(parseInt(parts[2])),
+    "OK:TX_COMMIT": (parts) => finishTx(parseInt(parts[2])),
+    "OK:TX_ABORTED": () => {
+        // Transacción vieja descartada: reintentar la nuestra
+        if (pendingTx) sendCommand("BEGINTX");
+    },
+    "ERR:TX_ACTIVE": () => {
+        // Quedó una subida a medias (p.ej. desconexión): descartarla primero
+        sendCommand("ABORT");
+    },
+
+    "OK:MACRO_SAVED": () => {
+        // Una línea por paso: aviso solo con el último
+        if (macroAcks > 0 && --macroAcks === 0) protocolUI.toast("Macro Guardada");
+    },
+    "ERR:MACRO_FAIL": () => {
+        macroAcks = 0;
+        protocolUI.toast("Error guardando macro", "error");
+    },
+    "OK:SAVED": onSaved,
+    "OK:SAVED_GLO": onSaved,
+    "OK:BANK_RENAMED": () => {
+        protocolUI.toast("Banco Renombrado");
+        if (pendingBankName) bankNames[pendingBankName.b] = pendingBankName.name;
+        pendingBankName = null;
+    },
+    "OK:TEMPO_SAVED": () => protocolUI.toast("Tempo Guardado"),
+    "OK:SCENE_SAVED": () => protocolUI.toast("Escena Guardada"),
+    "ERR:SCENE_FAIL": () => protocolUI.toast("Error guardando escena", "error"),
+    "ERR:TEMPO_FAIL": () => protocolUI.toast("Tempo inválido (0 o 30-250 BPM)", "error"),
+    // Cambian los números de línea del volcado: releer en cuanto el pedal lo confirma
+    "OK:BANK_ADDED": () => {
+        protocolUI.toast("Banco Agregado - Recargando...");
+        startConfigLoad();
+    },
+    "OK:BANK_REMOVED": () => {
+        protocolUI.toast("Banco Eliminado - Recargando...");
+        startConfigLoad();
+    },
+    "ERR:MAX_BANKS": () => protocolUI.toast("Límite de Bancos Alcanzado", "error"),
+    "ERR:MIN_BANKS": () => protocolUI.toast("No se puede borrar el último banco", "error"),
+    "ERR:BAD_FRAME": () => protocolUI.toast("Trama corrupta, reintenta", "error"),
+
+    "STATS:BEGIN": (parts) => {
+        statsRx = { since: parseInt(parts[2]) };
+    },
+    // STAT:<NOMBRE>:<v1>:<v2>...
+    "STAT": (parts) => {
+        if (statsRx) statsRx[parts[1]] = parts.slice(2).map(v => parseInt(v));
+    },
+    "STATS:END": () => {
+        if (statsRx) protocolUI.stats(statsRx);
+        statsRx = null;
+        statsInFlight = false;
+    },
+    "OK:STATS_RESET": () => {
+        protocolUI.toast("Métricas a cero");
+        requestStats();
+    },
+    "ERR:NO_STATS": () => {
+        statsInFlight = false;
+        protocolUI.statsUnsupported();
+        protocolUI.toast("Firmware sin métricas (METRICS_ENABLED 0)", "error");
+    },
+    "ERR:BUSY": () => {
+        statsInFlight = false; // Volcado en curso: se reintenta en la siguiente vuelta
+    },
+
+    "READY": (parts, line) => {
+        binaryProtocol = line.endsWith(":BIN");
+        console.log("Pedal Ready", binaryProtocol ? "(binario)" : "");
+        protocolUI.toast("Pedal Listo ✅");
+    }
+};
+
+// --- EDICIONES SUELTAS ---
+let pendingBankName = null; // SAVEBANK enviado, a la espera de OK:BANK_RENAMED
+
+function buildSaveCommand(data) {
+    // SAVE:B:P:NAME:TYPE:V1:V2:LPT:LPV1:LPV2:MODE
+    return `SAVE:${data.b}:${data.p}:${data.name}:${data.type}:${data.v1}:${data.v2}:${data.lpType}:${data.lpV1}:${data.lpV2}:${data.pressMode}`;
+}
+
+function buildSceneCommand(data) {
+    // SCENE:B:P:MASK (- = sin escena)
+    return `SCENE:${data.b}:${data.p}:${data.scene === null ? '-' : data.scene}`;
+}
+
+function saveSlot(data) {
+    const cmd = buildSaveCommand(data);
+    console.log("TX:", cmd);
+    const old = configs[data.b] && configs[data.b][data.p];
+    const sceneChanged = (old ? old.scene : null) !== data.scene;
+    sendCommand(sceneChanged ? cmd + "\n" + buildSceneCommand(data) : cmd);
+    cacheSlot(data);
+}
+
+// Update local config cache
+function cacheSlot(data) {
+    configs[data.b][data.p] = {
+        name: data.name,
+        type: data.type,
+        val1: parseInt(data.v1),
+        val2: parseInt(data.v2),
+        lpType: data.lpType,
+        lpV1: parseInt(data.lpV1),
+        lpV2: parseInt(data.lpV2),
+        pressMode: data.pressMode,
+        scene: data.scene
+    };
+}
+
+function buildGlobalCommand(id) {
+    const g = globalConfigs[id];
+    // SAVEGLO:ID:NAME:TYPE:V1:V2
+    return `SAVEGLO:${id}:${g.name}:${g.type}:${g.v1}:${g.v2}`;
+}
+
+function buildMacroCommands(m) {
+    // MACRO:M:S:TYPE:V1:V2:MS
+    return macros[m].map((st, s) => `MACRO:${m}:${s}:${st.type}:${st.v1}:${st.v2}:${st.ms}`);
+}
+
+let macroAcks = 0;
+
+function saveMacro(m) {
+    const lines = buildMacroCommands(m);
+    macroAcks = lines.length;
+    sendCommand(lines.join("\n"));
+}
+
+function saveBankName(bankIdx, name) {
+    // SAVEBANK:B:NAME
+    const cmd = `SAVEBANK:${bankIdx}:${name}`;
+    console.log("TX:", cmd);
+    pendingBankName = { b: bankIdx, name: name };
+    sendCommand(cmd);
+}
+
+function saveBankTempo(bankIdx, bpm) {
+    // TEMPO:B:BPM (0 = el banco no cambia el reloj)
+    bankTempos[bankIdx] = bpm;
+    sendCommand(`TEMPO:${bankIdx}:${bpm}`);
+}
+
+// Tras el OK el pedal ya tiene el banco: LINE_HANDLERS relee la configuración
+function addBank() {
+    sendCommand("ADDBANK");
+}
+
+function deleteBank(bankIdx) {
+    sendCommand(`DELBANK:${bankIdx}`);
+}
+
+// --- SUBIDA EN LOTE (BEGINTX / TXSYNC / COMMIT) ---
+// Todo el rig va en una sola transacción: el pedal lo guarda junto en el
+// COMMIT y un ABORT lo deshace entero. Las líneas salen sin esperar respuesta
+// por línea, en ventanas de hasta TX_WINDOW_BYTES que terminan en TXSYNC; el
+// pedal contesta OK:TX_SYNC:<n> cuando ya aplicó todo lo anterior y entonces
+// sale la siguiente. Mientras espera a la EEPROM aparta lo que llega
+// (SC_STAGE_SIZE en SerialCommander.h) además de su buffer RX de 64 bytes:
+// una ventana nunca pasa de lo que cabe en los dos.
+const TX_WINDOW_BYTES = 96;
+let pendingTx = null;
+
+function buildRigCommands() {
+    const lines = [];
+    for (let b = 0; b < activeBanksCount; b++) {
+        lines.push(`SAVEBANK:${b}:${bankNames[b]}`);
+        if (bankTempos[b]) lines.push(`TEMPO:${b}:${bankTempos[b]}`);
+        for (let p = 0; p < NUM_PRESETS; p++) {
+            const c = configs[b] && configs[b][p];
+            if (!c) continue;
+            const data = {
+                b: b, p: p, name: c.name, type: c.type, v1: c.val1, v2: c.val2,
+                lpType: c.lpType || 'N', lpV1: c.lpV1 || 0, lpV2: c.lpV2 || 0,
+                pressMode: c.pressMode || 'R', scene: c.scene === undefined ? null : c.scene
+            };
+            lines.push(buildSaveCommand(data));
+            // Como el tempo: la escena solo si el slot tiene
+            if (data.scene !== null) lines.push(buildSceneCommand(data));
+        }
+    }
+    globalConfigs.forEach((g, id) => { if (g.type) lines.push(buildGlobalCommand(id)); });
+    for (let m = 0; m < NUM_MACROS; m++) lines.push(...buildMacroCommands(m));
+    return lines;
+}
+
+// Reparte las líneas en ventanas; cada una cuenta su "\n" y el TXSYNC final
+function buildTxWindows(lines) {
+    const windows = [];
+    let bytes = TX_WINDOW_BYTES;
+    for (const line of lines) {
+        if (bytes + line.length + 1 > TX_WINDOW_BYTES - "TXSYNC\n".length) {
+            windows.push([]);
+            bytes = 0;
+        }
+        windows[windows.length - 1].push(line);
+        bytes += line.length + 1;
+    }
+    return windows;
+}
+
+// Sube toda la configuración local (configs, bankNames, globalConfigs, macros)
+function uploadConfig() {
+    if (activeBanksCount === 0) {
+        protocolUI.toast("Primero lee la configuración", "error");
+        return;
+    }
+    if (pendingTx) return;
+
+    pendingTx = { windows: buildTxWindows(buildRigCommands()), next: 0, sent: 0 };
+    protocolUI.uploadState(true);
+    armTxTimer();
+    sendCommand("BEGINTX");
+}
+
+// Cada respuesta del pedal da otros 5 s
+function armTxTimer() {
+    if (pendingTx.timer) clearTimeout(pendingTx.timer);
+    pendingTx.timer = setTimeout(() => {
+        sendCommand("ABORT");
+        endTx();
+        protocolUI.toast("Subida sin respuesta. Verifica conexión.", "error");
+    }, 5000);
+}
+
+function sendTxWindow() {
+    if (!pendingTx) return;
+    const lines = pendingTx.windows[pendingTx.next++];
+    pendingTx.sent += lines.length;
+    console.log(`TX ventana ${pendingTx.next}/${pendingTx.windows.length}: ${lines.length} líneas`);
+    armTxTimer();
+    sendCommand(lines.join("\n") + "\nTXSYNC");
+}
+
+function txWindowDone(count) {
+    if (!pendingTx) return;
+    if (count !== pendingTx.sent) {
+        // Alguna línea se perdió por el camino: no se guarda nada
+        sendCommand("ABORT");
+        const sent = pendingTx.sent;
+        endTx();
+        protocolUI.toast(`Llegaron ${count}/${sent} líneas. No se guardó nada, vuelve a subir.`, "error");
+        return;
+    }
+    if (pendingTx.next < pendingTx.windows.length) {
+        sendTxWindow();
+        return;
+    }
+    armTxTimer();
+    sendCommand("COMMIT");
+}
+
+function finishTx(count) {
+    if (!pendingTx) return;
+    const sent = pendingTx.sent;
+    endTx();
+    if (count !== sent) {
+        protocolUI.toast(`Llegaron ${count}/${sent} líneas. Vuelve a subir.`, "error");
+        return;
+    }
+    protocolUI.toast(`Rig guardado (${count} cambios) ✅`);
+}
+
+function endTx() {
+    if (pendingTx && pendingTx.timer) clearTimeout(pendingTx.timer);
+    pendingTx = null;
+    protocolUI.uploadState(false);
+}
+
+// --- CONFIG LOAD RETRY LOGIC ---
+let configLoadTimer = null;
+let configTimeoutInfo = null;
+let isConfigLoading = false;
+
+// El pedal manda la configuración en ventanas de DUMP_WINDOW líneas numeradas.
+// Si se pierde alguna (BT), solo se vuelve a pedir ese hueco.
+const DUMP_WINDOW = 8;
+let dumpSeen = new Set();
+let dumpTotal = -1;
+let lastDumpRx = 0;
+
+// Pide el primer tramo que falta o, si no falta nada, termina la carga
+function requestMissing() {
+    if (!isConfigLoading) return;
+
+    // Firmware antiguo: END:CONFIG sin total y sin numerar
+    if (isNaN(dumpTotal)) dumpTotal = dumpSeen.size;
+
+    let from = 0;
+    while (from < dumpTotal && dumpSeen.has(from)) from++;
+    if (from >= dumpTotal) {
+        stopConfigLoad(true);
+        return;
+    }
+    // Un banco suelto (el de al lado ya está) se pide entero con GETBANK:
+    // su nombre y sus slots no son contiguos en el volcado
+    const b = from - 1;
+    if (b >= 0 && b < activeBanksCount && (b + 1 === activeBanksCount || dumpSeen.has(from + 1)) &&
+        bankSeqs(b).every(i => !dumpSeen.has(i))) {
+        sendCommand(`GETBANK:${b}`);
+        return;
+    }
+    let count = 1;
+    while (count < DUMP_WINDOW && from + count < dumpTotal && !dumpSeen.has(from + count)) count++;
+    sendCommand(`GETALL:${from}:${count}`);
+}
+
+// --- Sincronización por diferencias ---
+// La App guarda la última configuración leída con el hash (CRC-16) de cada
+// banco, global y macro. Al conectar pide HASHES y solo descarga lo que no
+// coincide: con el pedal sin cambios basta esa petición. Si la generación
+// cambió entre el principio y el final de HASHES, se vuelve a pedir.
+// Firmware sin HASHES no contesta: a 1 s se cae al GETALL de siempre.
+const CONFIG_CACHE_KEY = "gp200.configCache";
+let syncHashes = null;
+
+// Números de línea del volcado (los de GETALL) de cada elemento
+function bankSeqs(b) {
+    const seqs = [b + 1];
+    for (let p = 0; p < NUM_PRESETS; p++) seqs.push(activeBanksCount + 3 + NUM_PRESETS * b + p);
+    return seqs;
+}
+
+function macroSeqs(m) {
+    const first = 3 + 4 * activeBanksCount + m * MACRO_STEPS;
+    return Array.from({ length: MACRO_STEPS }, (_, s) => first + s);
+}
+
+function loadConfigCache() {
+    try {
+        return JSON.parse(localStorage.getItem(CONFIG_CACHE_KEY)) || null;
+    } catch (e) {
+        return null;
+    }
+}
+
+function saveConfigCache() {
+    if (!syncHashes) return; // Firmware sin HASHES: nada con qué comparar la próxima vez
+    const cache = {
+        banks: Array.from({ length: activeBanksCount }, (_, b) => ({
+            hash: syncHashes.B[b], name: bankNames[b], tempo: bankTempos[b], slots: configs[b]
+        })),
+        globals: globalConfigs.map((g, i) => ({ hash: syncHashes.G[i], cfg: g })),
+        macros: macros.map((steps, m) => ({ hash: syncHashes.M[m], steps: steps }))
+    };
+    try {
+        localStorage.setItem(CONFIG_CACHE_KEY, JSON.stringify(cache));
+    } catch (e) {
+        console.warn("No se pudo guardar la caché de configuración", e);
+    }
+}
+
+function requestHashes() {
+    syncHashes = null;
+    dumpSeen = new Set();
+    dumpTotal = -1;
+    lastDumpRx = Date.now();
+    sendCommand("HASHES");
+}
+
+// Fin de HASHES: lo que coincide sale de la caché, el resto se pide
+function finishHashes(gen) {
+    if (!isConfigLoading || !syncHashes) return;
+    if (gen !== syncHashes.gen) {
+        requestHashes(); // Editado mientras tanto
+        return;
+    }
+    activeBanksCount = syncHashes.banks;
+    dumpTotal = 3 + 4 * activeBanksCount + NUM_MACROS * MACRO_STEPS;
+    dumpSeen.add(0); // BANK_COUNT ya viene en HASHES
+
+    const cache = loadConfigCache();
+    if (cache) {
+        for (let b = 0; b < activeBanksCount; b++) {
+            const c = cache.banks && cache.banks[b];
+            if (!c || c.hash !== syncHashes.B[b]) continue;
+            bankNames[b] = c.name;
+            bankTempos[b] = c.tempo;
+            configs[b] = c.slots;
+            bankSeqs(b).forEach(i => dumpSeen.add(i));
+        }
+        for (let g = 0; g < 2; g++) {
+            const c = cache.globals && cache.globals[g];
+            if (!c || c.hash !== syncHashes.G[g]) continue;
+            globalConfigs[g] = c.cfg;
+            protocolUI.globalChanged(g);
+            dumpSeen.add(activeBanksCount + 1 + g);
+        }
+        for (let m = 0; m < NUM_MACROS; m++) {
+            const c = cache.macros && cache.macros[m];
+            if (!c || c.hash !== syncHashes.M[m]) continue;
+            macros[m] = c.steps;
+            macroSeqs(m).forEach(i => dumpSeen.add(i));
+        }
+    }
+    requestMissing();
+}
+
+function startConfigLoad() {
+    if (isConfigLoading) return;
+
+    isConfigLoading = true;
+    protocolUI.loadState(true);
+
+    // FIX: Resetear memoria local para evitar "bancos fantasma"
+    resetLocalConfig();
+
+    // 1. Envío inicial: hashes para comparar con la caché
+    requestHashes();
+
+    // 2. Si el pedal se calla 1 s, pedir lo que falte (o todo si no contestó
+    // a HASHES: firmware antiguo)
+    configLoadTimer = setInterval(() => {
+        if (Date.now() - lastDumpRx < 1000) return;
+        console.log("Re-intentando leer configuración...");
+        lastDumpRx = Date.now();
+        if (dumpTotal < 0) {
+            syncHashes = null;
+            sendCommand("GETALL");
+        } else {
+            requestMissing();
+        }
+    }, 250);
+
+    // 3. Setup Max Timeout (10 segundos)
+    configTimeoutInfo = setTimeout(() => {
+        stopConfigLoad(false); // Fail
+        protocolUI.toast("Tiempo de espera agotado. Verifica conexión.", "error");
+    }, 10000);
+}
+
+function stopConfigLoad(success) {
+    if (!isConfigLoading) return;
+
+    isConfigLoading = false;
+
+    // Limpiar Timers
+    if (configLoadTimer) clearInterval(configLoadTimer);
+    if (configTimeoutInfo) clearTimeout(configTimeoutInfo);
+
+    if (success) {
+        saveConfigCache();
+        protocolUI.toast("Configuración Sincronizada ✅");
+        protocolUI.configLoaded();
+    }
+    protocolUI.loadState(false);
+}
+
+// --- MÉTRICAS DEL PEDAL (STATS) ---
+// El pedal responde STATS:BEGIN:<s>, una línea STAT:... por métrica y
+// STATS:END. Nunca se piden durante una lectura o subida de config.
+let statsRx = null;
+let statsInFlight = false;
+const STATS_TIMEOUT_MS = 4000;
+
+function requestStats() {
+    if (statsInFlight || isConfigLoading || pendingTx) return;
+    statsInFlight = true;
+    sendCommand("STATS");
+    // Si la respuesta se pierde, no bloquear las siguientes
+    setTimeout(() => { statsInFlight = false; }, STATS_TIMEOUT_MS);
+}